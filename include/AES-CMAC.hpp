@@ -11,12 +11,49 @@
     
 class AESCMAC {
 public:
+/***
+ * @brief Intermediate state of a CMAC computation
+ *
+ * Holds the subkeys and the chaining value after the blocks absorbed so far,
+ * so a known message prefix can be processed ahead of time.
+ */
+struct State {
+    std::array<uint8_t, 16> x{};  ///< Chaining value
+    std::array<uint8_t, 16> k1{}; ///< Subkey for a complete last block
+    std::array<uint8_t, 16> k2{}; ///< Subkey for a padded last block
+};
+
 /***
  * @brief Calculate AES-CMAC for a given message and key
  */
 static std::array<uint8_t, 16> calculate(const std::vector<uint8_t>& message, 
                                         const std::array<uint8_t, 16>& key);
 
+/***
+ * @brief Start a CMAC computation
+ * @param state Receives the subkeys and a zero chaining value
+ * @param key The CMAC key
+ */
+static void begin(State& state, const std::array<uint8_t, 16>& key);
+
+/***
+ * @brief Process one complete block that is not the last of the message
+ * @param state State from begin()
+ * @param key The CMAC key
+ * @param block 16 bytes of the message
+ */
+static void absorb(State& state, const std::array<uint8_t, 16>& key, const uint8_t* block);
+
+/***
+ * @brief Process the rest of the message and return the CMAC
+ * @param state State after the blocks absorbed so far
+ * @param key The CMAC key
+ * @param data Remaining bytes of the message
+ * @param length Number of remaining bytes
+ */
+static std::array<uint8_t, 16> finish(const State& state, const std::array<uint8_t, 16>& key,
+                                      const uint8_t* data, size_t length);
+
 /***
  * @brief Calculate AES-CMAC for a given message and key
  */
@@ -0,0 +1,71 @@
+/**
+ * @file AESBatch.hpp
+ * @brief AES-128 over many independent blocks at once
+ *
+ * A single AES block is a chain of ten dependent rounds, so encrypting blocks
+ * one after the other leaves most of the AES unit idle. The batch API takes
+ * any number of (key, block) pairs, possibly under different keys, and runs
+ * the rounds of up to eight blocks interleaved. On x86 CPUs with AES-NI this
+ * is done with the AES instructions directly; elsewhere the blocks go through
+ * OpenSSL, one context per run of blocks sharing a key.
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @class AESBatch
+ * @brief Batched AES-128 encryption
+ */
+class AESBatch {
+public:
+    /// Blocks whose rounds are interleaved
+    static constexpr size_t LANES = 8;
+
+    /**
+     * @brief Expanded AES-128 key, reused by every block encrypted with it
+     */
+    struct Key {
+        std::array<uint8_t, 16> key{};                   ///< Cipher key
+        alignas(16) uint8_t round_keys[11][16] = {};     ///< Key schedule, only filled when accelerated()
+    };
+
+    /**
+     * @brief One block to encrypt
+     *
+     * Input and output may point to the same block.
+     */
+    struct Block {
+        const Key* key = nullptr;
+        const uint8_t* input = nullptr;
+        uint8_t* output = nullptr;
+    };
+
+    /**
+     * @brief Expand a key
+     *
+     * @param key Cipher key
+     * @param out Receives the expanded key
+     */
+    static void expand(const std::array<uint8_t, 16>& key, Key& out);
+
+    /**
+     * @brief Encrypt independent blocks (AES-128 ECB)
+     *
+     * @param blocks Blocks to encrypt
+     * @param count Number of blocks
+     */
+    static void encrypt(const Block* blocks, size_t count);
+
+    /**
+     * @brief Check if the AES instructions are used
+     *
+     * @return True if the CPU has AES-NI
+     */
+    static bool accelerated();
+};
@@ -0,0 +1,151 @@
+/**
+ * @file AirtimeLedger.hpp
+ * @brief Persistent record of recent transmissions for duty-cycle accounting
+ *
+ * Every uplink is appended to a ring of fixed-size records in a memory-mapped
+ * file: wall-clock timestamp, frequency, regulatory sub-band and air time. The
+ * duty-cycle state is rebuilt from the ledger at startup, so a restarted
+ * process neither exceeds its budget nor waits longer than needed, and the
+ * file can be inspected afterwards to audit airtime usage.
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class IOExecutor;
+
+/**
+ * @class AirtimeLedger
+ * @brief mmap-backed ring file of transmissions
+ */
+class AirtimeLedger {
+public:
+    /// Size of one record in the file
+    static constexpr size_t RECORD_SIZE = 32;
+    /// Sub-band of frequencies outside the EU868 plan
+    static constexpr uint8_t NO_SUBBAND = 0xFF;
+
+    /**
+     * @brief One transmission
+     */
+    struct Record {
+        int64_t time_ms = 0;          ///< End of the transmission, ms since the Unix epoch
+        float frequency = 0.0f;       ///< Frequency in MHz
+        float airtime_ms = 0.0f;      ///< Time on air in milliseconds
+        uint8_t subband = NO_SUBBAND; ///< Sub-band index from subBand()
+    };
+
+    AirtimeLedger() = default;
+    ~AirtimeLedger();
+
+    AirtimeLedger(const AirtimeLedger&) = delete;
+    AirtimeLedger& operator=(const AirtimeLedger&) = delete;
+
+    /**
+     * @brief Open or create the ledger file
+     *
+     * An existing file keeps its capacity; the capacity argument only applies
+     * to new files.
+     *
+     * @param filename Path of the ledger file
+     * @param capacity Number of records kept before the oldest is overwritten
+     * @return True if successful
+     */
+    bool open(const std::string& filename, size_t capacity = 4096);
+
+    /**
+     * @brief Flush and unmap the file
+     */
+    void close();
+
+    /**
+     * @brief Check if a ledger file is open
+     *
+     * @return True if open
+     */
+    bool isOpen() const { return base != nullptr; }
+
+    /**
+     * @brief Record a transmission that ended now
+     *
+     * @param frequency Frequency in MHz
+     * @param airtime_ms Time on air in milliseconds
+     * @return True if the record was written
+     */
+    bool append(float frequency, float airtime_ms);
+
+    /**
+     * @brief Hand the syncs of new records to an I/O executor
+     *
+     * While the executor runs, a record is flushed by its I/O thread instead
+     * of by msync() in the caller, so it is durable a few milliseconds later.
+     *
+     * @param executor Executor, nullptr to sync in the caller
+     */
+    void setExecutor(IOExecutor* executor);
+
+    /**
+     * @brief Get the transmissions within a time window
+     *
+     * Records time-stamped in the future (the wall clock went backwards) are
+     * reported as ending now.
+     *
+     * @param window How far back to look
+     * @return Records, oldest first
+     */
+    std::vector<Record> recent(std::chrono::milliseconds window) const;
+
+    /**
+     * @brief Total air time of a sub-band within a time window
+     *
+     * @param subband Sub-band index from subBand()
+     * @param window How far back to look
+     * @return Air time in milliseconds
+     */
+    float airtime(uint8_t subband, std::chrono::milliseconds window) const;
+
+    /**
+     * @brief Number of records in the ring
+     */
+    size_t capacity() const { return slots; }
+
+    /**
+     * @brief Map a frequency to its ETSI EN 300 220 sub-band (EU868)
+     *
+     * 0: 863.0-865.0 MHz (0.1%), 1: 865.0-868.0 MHz (1%), 2: 868.0-868.6 MHz (1%),
+     * 3: 868.7-869.2 MHz (0.1%), 4: 869.4-869.65 MHz (10%), 5: 869.7-870.0 MHz (1%)
+     *
+     * @param frequency Frequency in MHz
+     * @return Sub-band index, NO_SUBBAND outside these ranges
+     */
+    static uint8_t subBand(float frequency);
+
+private:
+    /// File header, the records follow at offset HEADER_SIZE
+    struct FileHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t record_count;
+        uint32_t record_size;
+    };
+    static constexpr size_t HEADER_SIZE = 64;
+
+    uint8_t* record(size_t index) const { return base + HEADER_SIZE + index * RECORD_SIZE; }
+    bool readRecord(size_t index, Record& out, uint32_t* sequence = nullptr) const;
+    static int64_t nowMs();
+
+    uint8_t* base = nullptr;
+    size_t mapped_length = 0;
+    size_t slots = 0;
+    size_t next = 0;       ///< Index of the next record to write
+    uint32_t sequence = 0; ///< Sequence of the next record
+    int fd = -1;
+    IOExecutor* executor = nullptr;
+};
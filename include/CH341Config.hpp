@@ -29,6 +29,7 @@
 #ifndef CH341_CONFIG_HPP
 #define CH341_CONFIG_HPP
 
+#include <cstddef>
 #include <cstdint>
 
 namespace CH341Config
@@ -40,11 +41,14 @@ namespace CH341Config
     // Endpoints
     constexpr uint8_t BULK_WRITE_EP = 0x02;
     constexpr uint8_t BULK_READ_EP = 0x82;
+    constexpr uint8_t INTERRUPT_EP = 0x81;     ///< Reports INT# rising edges
+    constexpr int INTERRUPT_REPORT_LENGTH = 8;
 
     // Packet Configuration
     constexpr uint8_t PACKET_LENGTH = 0x20;
     constexpr uint16_t MAX_PACKETS = 256;
     constexpr uint16_t MAX_PACKET_LEN = PACKET_LENGTH * MAX_PACKETS;
+    constexpr size_t USB_BUFFER_LENGTH = MAX_PACKET_LEN; ///< Persistent TX and RX buffers, each
 
     // Pin mapping for CH341F
     constexpr uint8_t PIN_MISO = 0x02;
@@ -58,6 +62,8 @@ namespace CH341Config
     constexpr uint8_t CMD_UIO_STM_OUT = 0x80;
     constexpr uint8_t CMD_UIO_STM_DIR = 0x40;
     constexpr uint8_t CMD_UIO_STM_END = 0x20;
+    constexpr uint8_t CMD_UIO_STM_US = 0xC0;
+    constexpr uint8_t UIO_STM_US_MAX = 0x3F;
     constexpr uint8_t CMD_I2C_STREAM = 0xAA;
     constexpr uint8_t CMD_I2C_STM_SET = 0x60;
     constexpr uint8_t CMD_I2C_STM_END = 0x00;
@@ -33,6 +33,8 @@
 #include <vector>
 #include <string>
 #include <thread>
+#include <atomic>
+#include <memory>
 
 /**
  * @class CH341SPI
@@ -71,6 +73,33 @@ public:
      */
     std::vector<uint8_t> transfer(const std::vector<uint8_t>& write_data, size_t read_length = 0);
 
+    /**
+     * @brief Transfers data over SPI using caller provided buffers.
+     *
+     * The whole transaction (chip select and every data byte) is packed into a
+     * single bulk OUT submission, followed by the bulk IN reads of the clocked bytes.
+     *
+     * @param write_data Data to be written to the SPI bus.
+     * @param write_length Number of bytes to write.
+     * @param read_data Buffer receiving the bytes read after the written ones.
+     * @param read_length Number of bytes to read from the SPI bus.
+     * @return True if the transfer was successful, false otherwise.
+     */
+    bool transfer(const uint8_t* write_data, size_t write_length, uint8_t* read_data, size_t read_length) override;
+
+    /**
+     * @brief Transfers several chip select segments in a single bulk submission.
+     *
+     * Each segment is preceded by a CS pulse packet that also carries the guard
+     * delay of the previous segment (UIO stream delay commands, up to about
+     * 1.6 ms). Chip select is released at the end of the batch.
+     *
+     * @param segments The segments to transfer, in order.
+     * @param count The number of segments.
+     * @return True if every segment was transferred, false otherwise.
+     */
+    bool transferBatch(const SPISegment* segments, size_t count) override;
+
     /**
      * @brief Writes a digital value to a specified pin.
      * @param pin The pin number.
@@ -97,14 +126,14 @@ public:
     /**
      * @brief Configure interrupt settings for a pin
      * 
+     * The CH341 has a single interrupt input, INT#, so the pin is ignored.
+     * Wire the radio's DIO0 to INT#.
+     * 
      * @param pin The pin number
      * @param enable True to enable the interrupt, false to disable it
      * @return True if the operation was successful, false otherwise
      */
-    bool configureInterrupt(uint8_t pin, bool enable) override {
-        // CH341 doesn't support native interrupts, would need external handling
-        return false;
-    }
+    bool configureInterrupt(uint8_t pin, bool enable) override;
 
     /**
      * @brief Set interrupt callback
@@ -117,6 +146,11 @@ public:
     /**
      * @brief Enable or disable interrupts
      * 
+     * Rising edges of INT# are reported by the adapter on its interrupt IN
+     * endpoint and delivered through an asynchronous transfer, handled by a
+     * libusb event thread of this adapter; the callback runs on that thread.
+     * Adapters without the endpoint fall back to polling INT# every 10 ms.
+     * 
      * @param enable True to enable interrupts, false to disable them
      * @return True if successful, false otherwise
      */
@@ -150,7 +184,17 @@ private:
     InterruptCallback interruptCallback; ///< Callback function for interrupts.
     bool interruptEnabled; ///< Flag to indicate if interrupts are enabled.
     std::thread interruptThread; ///< Thread for monitoring interrupts.
-    bool threadRunning; ///< Flag to indicate if the interrupt monitoring thread is running.
+    std::atomic<bool> threadRunning; ///< Flag to indicate if the interrupt monitoring thread is running.
+    libusb_transfer *interruptTransfer = nullptr; ///< Transfer on the interrupt endpoint.
+    std::atomic<bool> interruptPending{false}; ///< The interrupt transfer is submitted.
+    uint8_t interruptReport[8]; ///< Report received on the interrupt endpoint.
+    bool interruptLevel = false; ///< INT# level seen by the polling fallback.
+    uint8_t *usb_tx = nullptr; ///< Persistent command stream buffer, USB_BUFFER_LENGTH bytes.
+    uint8_t *usb_rx = nullptr; ///< Persistent response buffer, USB_BUFFER_LENGTH bytes.
+    bool usb_dev_mem = false; ///< The buffers come from libusb_dev_mem_alloc().
+    std::unique_ptr<uint8_t[]> heap_buffers; ///< Storage of the buffers without usbfs mmap.
+    std::vector<uint8_t> tx_stream; ///< Command stream larger than the persistent buffer.
+    std::vector<uint8_t> rx_stream; ///< Response larger than the persistent buffer.
 
     /**
      * @brief Configures the SPI stream.
@@ -158,6 +202,45 @@ private:
      */
     bool configStream();
 
+    /**
+     * @brief Allocates the persistent transfer buffers of the open device.
+     *
+     * The buffers are mapped from usbfs with libusb_dev_mem_alloc() where the
+     * kernel supports it, so the kernel transfers them without copying them
+     * into its own bounce buffers. Otherwise they are ordinary heap memory.
+     */
+    void allocateBuffers();
+
+    /**
+     * @brief Frees the persistent transfer buffers, before the device is closed.
+     */
+    void freeBuffers();
+
+    /**
+     * @brief Sends a command stream from the persistent buffer.
+     * @param length Number of bytes built in usb_tx.
+     * @return 0 if the whole stream was sent, a libusb error code otherwise.
+     */
+    int sendCommand(int length);
+
+    /**
+     * @brief Builds and submits the USB stream for a list of SPI segments.
+     * @param segments The segments to transfer, in order.
+     * @param count The number of segments.
+     * @param release_cs Release chip select after the last segment.
+     * @return True if the transfer was successful, false otherwise.
+     */
+    bool transferStream(const SPISegment* segments, size_t count, bool release_cs);
+
+    /**
+     * @brief Writes a UIO stream packet pulsing chip select.
+     * @param ptr Start of the packet in the command stream.
+     * @param delay_us Guard delay with chip select released.
+     * @param assert_cs Assert chip select again at the end of the packet.
+     * @return Start of the next packet.
+     */
+    static uint8_t* appendCSPacket(uint8_t* ptr, uint16_t delay_us, bool assert_cs);
+
     /**
      * @brief Enables or disables the pins.
      * @param enable Set to true to enable pins, false to disable.
@@ -172,8 +255,23 @@ private:
      */
     uint8_t swapBits(uint8_t byte);
 
+    /**
+     * @brief Submits the transfer on the interrupt endpoint.
+     * @return True if the transfer was submitted, false otherwise.
+     */
+    bool submitInterruptTransfer();
+
+    /**
+     * @brief Completion of the interrupt endpoint transfer, on the event thread.
+     * @param transfer The completed transfer.
+     */
+    static void LIBUSB_CALL interruptTransferDone(libusb_transfer *transfer);
+
     /**
      * @brief Thread function for monitoring interrupts.
+     *
+     * Handles the libusb events of the interrupt transfer, or polls INT#
+     * when the adapter has no interrupt endpoint or the transfer fails.
      */
     void interruptMonitoringThread();
 };
\ No newline at end of file
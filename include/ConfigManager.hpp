@@ -76,6 +76,21 @@ public:
      */
     int getNestedInt(const std::string& path, int defaultValue = 0);
 
+    /**
+     * @brief Retrieves a nested floating point value from the configuration.
+     * @param path The path to the nested configuration setting.
+     * @param defaultValue The default value to return if the path is not found. Defaults to 0.
+     * @return The numeric value associated with the path, or the default value if the path is not found.
+     */
+    double getNestedDouble(const std::string& path, double defaultValue = 0.0);
+
+    /**
+     * @brief Retrieves the number of elements of a nested array.
+     * @param path The path to the nested array. Array elements are addressed with numeric parts, e.g. "gateway.radios.0.sf".
+     * @return The number of elements, or 0 if the path is not found or is not an array.
+     */
+    int getNestedArraySize(const std::string& path);
+
     /**
      * @brief Retrieves a nested boolean value from the configuration.
      * @param path The path to the nested configuration setting.
@@ -0,0 +1,74 @@
+/**
+ * @file EventNotifier.hpp
+ * @brief Pollable file descriptor for driving the stack from an event loop
+ *
+ * One epoll descriptor groups a timerfd, armed for the next protocol
+ * deadline, and an eventfd, signalled when something needs servicing now (a
+ * radio interrupt, a frame queued from another thread). The epoll descriptor
+ * becomes readable when either fires, so an application adds it to its own
+ * epoll, libuv or asio loop and sleeps until the stack has work to do.
+ *
+ * Linux only; elsewhere open() fails and the caller keeps polling update().
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+#pragma once
+
+#include <chrono>
+
+/**
+ * @class EventNotifier
+ * @brief timerfd + eventfd behind one epoll descriptor
+ */
+class EventNotifier {
+public:
+    EventNotifier() = default;
+    ~EventNotifier();
+
+    EventNotifier(const EventNotifier&) = delete;
+    EventNotifier& operator=(const EventNotifier&) = delete;
+
+    /**
+     * @brief Create the descriptors
+     *
+     * @return True if successful
+     */
+    bool open();
+
+    /**
+     * @brief Close the descriptors
+     */
+    void close();
+
+    /**
+     * @brief Descriptor to wait on, -1 if not open
+     */
+    int fd() const { return epollFd; }
+
+    /**
+     * @brief Make the descriptor readable at a point in time
+     *
+     * Replaces the previous deadline. time_point::max() disarms the timer.
+     *
+     * @param deadline When the stack next needs servicing
+     */
+    void arm(std::chrono::steady_clock::time_point deadline);
+
+    /**
+     * @brief Make the descriptor readable now
+     *
+     * Safe to call from any thread and from a signal handler.
+     */
+    void notify();
+
+    /**
+     * @brief Clear the readiness of both the timer and the wakeups
+     */
+    void consume();
+
+private:
+    int epollFd = -1;
+    int timerFd = -1;
+    int wakeFd = -1;
+};
@@ -0,0 +1,181 @@
+/**
+ * @file IOExecutor.hpp
+ * @brief Background executor for persistence, capture and IPC I/O
+ *
+ * File writes, fsyncs, socket sends and session file replacements are queued
+ * by the caller and carried out by one I/O thread, so the MAC and radio
+ * threads never enter the kernel for them. The I/O thread takes everything
+ * queued since its last pass and submits it as one io_uring batch: one
+ * io_uring_enter() for all the writes, syncs and sends of an uplink instead
+ * of one system call each.
+ *
+ * io_uring is driven through the raw system calls, no liburing needed. Where
+ * it is unavailable (old kernel, seccomp, not Linux) the I/O thread makes the
+ * same calls one by one; the caller's thread is offloaded either way.
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @class IOExecutor
+ * @brief Batched asynchronous file and socket I/O on one thread
+ */
+class IOExecutor {
+public:
+    /**
+     * @brief Called on the I/O thread with the result of an operation
+     *
+     * Bytes transferred, 0 for a sync, or -errno.
+     */
+    typedef std::function<void(int result)> Completion;
+
+    IOExecutor();
+    ~IOExecutor();
+
+    IOExecutor(const IOExecutor&) = delete;
+    IOExecutor& operator=(const IOExecutor&) = delete;
+
+    /**
+     * @brief Start the I/O thread
+     *
+     * @param queue_depth Submission queue entries of the io_uring
+     * @return True if successful
+     */
+    bool start(unsigned queue_depth = 64);
+
+    /**
+     * @brief Complete the queued operations and stop the I/O thread
+     */
+    void stop();
+
+    /**
+     * @brief Check if the I/O thread is running
+     */
+    bool isRunning() const { return running.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Check if operations go through io_uring rather than plain system calls
+     */
+    bool usesIoUring() const { return ringActive.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Queue a positioned write
+     *
+     * @param fd File descriptor, kept open until the write completes (see flush())
+     * @param offset File offset
+     * @param data Bytes to write
+     * @param datasync Follow the write with fdatasync()
+     * @param done Optional completion
+     * @return False if the executor is not running; the caller does the I/O itself
+     */
+    bool write(int fd, uint64_t offset, std::vector<uint8_t> data, bool datasync = false, Completion done = nullptr);
+
+    /**
+     * @brief Queue an fdatasync() of a file range
+     *
+     * Also writes back pages modified through a shared mapping of the file,
+     * like msync(MS_SYNC).
+     *
+     * @param fd File descriptor, kept open until the sync completes
+     * @param offset Start of the range
+     * @param length Length of the range, 0 for the whole file
+     * @param done Optional completion
+     * @return False if the executor is not running
+     */
+    bool sync(int fd, uint64_t offset = 0, uint64_t length = 0, Completion done = nullptr);
+
+    /**
+     * @brief Queue a non-blocking send on a socket
+     *
+     * Sends on the same descriptor are carried out in the order they were
+     * queued.
+     *
+     * @param fd Connected socket, kept open until the send completes
+     * @param data Bytes to send
+     * @param done Optional completion
+     * @return False if the executor is not running
+     */
+    bool send(int fd, std::vector<uint8_t> data, Completion done = nullptr);
+
+    /**
+     * @brief Queue the atomic replacement of a file
+     *
+     * The contents are written to path.tmp, synced and renamed over the path,
+     * so a power cut leaves either the old or the new file. When several
+     * replacements of the same file are waiting together, only the last one is
+     * carried out and the earlier ones complete with its result.
+     *
+     * @param path File to replace
+     * @param contents New contents
+     * @param done Optional completion
+     * @return False if the executor is not running
+     */
+    bool replaceFile(const std::string& path, std::string contents, Completion done = nullptr);
+
+    /**
+     * @brief Queue a function to run on the I/O thread
+     *
+     * It runs after the operations queued before it have completed.
+     *
+     * @param task Function to run
+     * @return False if the executor is not running
+     */
+    bool call(std::function<void()> task);
+
+    /**
+     * @brief Wait until everything queued so far has completed
+     *
+     * Call it before closing a descriptor that has operations queued.
+     */
+    void flush();
+
+    /**
+     * @brief Number of submission batches, each costing one io_uring_enter()
+     */
+    uint64_t batches() const { return batchCount.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Number of operations completed
+     */
+    uint64_t operations() const { return operationCount.load(std::memory_order_relaxed); }
+
+    struct Op;
+    struct Ring;
+
+private:
+    bool enqueue(Op&& op);
+    void workerLoop();
+    void execute(std::vector<Op>& batch);
+    void executeRing(const std::vector<Op*>& ops);
+    void executeDirect(Op& op);
+    void finish(Op& op);
+
+    std::unique_ptr<Ring> ring;
+    std::atomic<bool> ringActive{false};
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::vector<Op> pending;
+    uint64_t queued = 0;      ///< Operations queued since start (under mutex)
+    uint64_t completed = 0;   ///< Operations completed since start (under mutex)
+    int flushWaiters = 0;
+
+    std::atomic<bool> running{false};
+    std::atomic<bool> stopping{false};
+    std::thread worker;
+    std::atomic<uint64_t> batchCount{0};
+    std::atomic<uint64_t> operationCount{0};
+};
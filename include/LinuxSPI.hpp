@@ -5,6 +5,12 @@
  * interface available in Linux. It allows communication with SPI devices and
  * control of GPIO pins for interrupt handling.
  * 
+ * GPIO pins are lines of a GPIO character device (/dev/gpiochipN, uAPI v2).
+ * All configured lines are held by one line request for the lifetime of the
+ * object, so a pin access is a single ioctl and several pins can be read or
+ * written atomically. Pin numbers are line offsets on the chip, the BCM
+ * numbers on a Raspberry Pi.
+ * 
  * @note This class is designed to work on Linux systems with spidev support.
  * 
  * @param device The SPI device path (default: "/dev/spidev0.0").
@@ -20,9 +26,9 @@
 #include <string>
 #include <thread>
 #include <atomic>
-#include <map>
-#include <fstream>
+#include <vector>
 #include <fcntl.h>
+#include <cstring>
 
 #ifdef _WIN32
 #include <io.h>
@@ -30,6 +36,13 @@
 #include <unistd.h>
 #endif
 
+#ifdef __linux__
+#include <linux/spi/spidev.h>
+#include <sys/ioctl.h>
+#endif
+
+struct gpio_v2_line_config;
+
 /**
  * @class LinuxSPI
  * @brief A class to interface with SPI devices on Linux systems.
@@ -75,7 +88,82 @@ class LinuxSPI : public SPIInterface {
      * @return A vector containing the data read from the SPI device.
      */
     std::vector<uint8_t> transfer(const std::vector<uint8_t>& write_data, size_t read_length = 0);
+
+    /**
+     * @brief Transfers data over the SPI interface using caller provided buffers.
+     * 
+     * The write and read phases are submitted as two segments of a single
+     * SPI_IOC_MESSAGE ioctl, with chip select held between them. The method is
+     * defined inline so that statically dispatched callers reduce a register
+     * access to the ioctl itself.
+     * 
+     * @param write_data The data to be written to the SPI device.
+     * @param write_length The number of bytes to write.
+     * @param read_data Buffer receiving the data read after the written bytes.
+     * @param read_length The number of bytes to read from the SPI device.
+     * @return true if the transfer was successful, false otherwise.
+     */
+    bool transfer(const uint8_t* write_data, size_t write_length, uint8_t* read_data, size_t read_length) override {
+#ifdef __linux__
+        if (fd < 0) {
+            return false;
+        }
+
+        struct spi_ioc_transfer tr[2];
+        std::memset(tr, 0, sizeof(tr));
+        unsigned int segments = 0;
+
+        if (write_length > 0) {
+            tr[segments].tx_buf = reinterpret_cast<uintptr_t>(write_data);
+            tr[segments].len = static_cast<uint32_t>(write_length);
+            tr[segments].speed_hz = speed_hz;
+            tr[segments].bits_per_word = 8;
+            segments++;
+        }
+        if (read_length > 0) {
+            tr[segments].rx_buf = reinterpret_cast<uintptr_t>(read_data);
+            tr[segments].len = static_cast<uint32_t>(read_length);
+            tr[segments].speed_hz = speed_hz;
+            tr[segments].bits_per_word = 8;
+            segments++;
+        }
+        if (segments == 0) {
+            return true;
+        }
+
+        if (ioctl(fd, SPI_IOC_MESSAGE(segments), tr) < 0) {
+            reportTransferError();
+            return false;
+        }
+        return true;
+#else
+        reportTransferError();
+        return false;
+#endif
+    }
+
+    /**
+     * @brief Transfers several chip select segments in a single ioctl.
+     * 
+     * Segments are chained with cs_change so chip select is released between
+     * them, and each segment's guard time is passed as delay_usecs. Large
+     * batches are split into several SPI_IOC_MESSAGE calls.
+     * 
+     * @param segments The segments to transfer, in order.
+     * @param count The number of segments.
+     * @return true if every segment was transferred, false otherwise.
+     */
+    bool transferBatch(const SPISegment* segments, size_t count) override;
     
+    /**
+     * @brief Selects the GPIO chip the pins belong to.
+     * 
+     * Must be called before the first pinMode().
+     * 
+     * @param path The GPIO character device (default is "/dev/gpiochip0").
+     */
+    void setGPIOChip(const std::string& path);
+
     /**
      * @brief Sets the value of a GPIO pin.
      * 
@@ -92,6 +180,26 @@ class LinuxSPI : public SPIInterface {
      * @return The value of the GPIO pin (true for high, false for low).
      */
     bool digitalRead(uint8_t pin);
+
+    /**
+     * @brief Sets several output pins at the same time, in one ioctl.
+     * 
+     * @param pins The GPIO pin numbers.
+     * @param values The values to set, one per pin.
+     * @param count The number of pins.
+     * @return true if the values were set, false otherwise.
+     */
+    bool digitalWriteMany(const uint8_t* pins, const bool* values, size_t count);
+
+    /**
+     * @brief Reads several pins sampled at the same time, in one ioctl.
+     * 
+     * @param pins The GPIO pin numbers.
+     * @param values Receives the values, one per pin.
+     * @param count The number of pins.
+     * @return true if the values were read, false otherwise.
+     */
+    bool digitalReadMany(const uint8_t* pins, bool* values, size_t count);
     
     /**
      * @brief Sets the mode of a GPIO pin.
@@ -105,37 +213,15 @@ class LinuxSPI : public SPIInterface {
     /**
      * @brief Configure interrupt settings for a GPIO pin
      * 
+     * The pin becomes the interrupt line, configured as an input if it is
+     * not configured yet. Rising edges are detected once enableInterrupt()
+     * is called.
+     * 
      * @param pin The pin number
      * @param enable True to enable the interrupt, false to disable it
      * @return True if the operation was successful, false otherwise
      */
-    bool configureInterrupt(uint8_t pin, bool enable) override {
-        // Basic implementation using sysfs
-        // In a real implementation, would use proper GPIO interrupts
-        std::string gpio_path = "/sys/class/gpio/gpio" + std::to_string(pin);
-        
-        // Check if GPIO exists
-        if (access(gpio_path.c_str(), F_OK) == -1) {
-            // Need to export
-            std::ofstream export_file("/sys/class/gpio/export");
-            if (!export_file.is_open()) {
-                return false;
-            }
-            export_file << pin;
-            export_file.close();
-        }
-        
-        // Configure edge for interrupt
-        std::string edge_path = gpio_path + "/edge";
-        std::ofstream edge_file(edge_path);
-        if (!edge_file.is_open()) {
-            return false;
-        }
-        edge_file << (enable ? "both" : "none");
-        edge_file.close();
-        
-        return true;
-    }
+    bool configureInterrupt(uint8_t pin, bool enable) override;
     
     /**
      * @brief Set interrupt callback
@@ -168,10 +254,16 @@ private:
     uint8_t spi_mode;
     int fd; // File descriptor para el dispositivo SPI
     
-    // GPIO paths
-    std::string gpio_export_path;
-    std::string gpio_unexport_path;
-    std::map<uint8_t, std::string> gpio_pin_paths;
+    // GPIO lines, all held by one line request on the GPIO chip
+    struct GPIOLine {
+        uint8_t pin;    ///< Line offset on the chip
+        uint64_t flags; ///< GPIO_V2_LINE_FLAG_* of the line
+        bool value;     ///< Last value written (outputs)
+    };
+    std::string gpio_chip_path = "/dev/gpiochip0";
+    std::vector<GPIOLine> gpio_lines; ///< Index is the bit of the line in the request
+    int gpio_request_fd = -1;
+    size_t gpio_requested = 0;        ///< Lines held by gpio_request_fd
     
     // Interrupt handling
     InterruptCallback interruptCallback;
@@ -182,48 +274,56 @@ private:
     bool interrupt_enabled = false;
     
     /**
-     * @brief Exports a GPIO pin for use.
+     * @brief Finds the line of a pin.
      * 
      * @param pin The GPIO pin number.
-     * @return true if the pin was successfully exported, false otherwise.
+     * @return The index of the line, -1 if the pin is not configured.
      */
-    bool exportGPIO(uint8_t pin);
+    int lineIndex(uint8_t pin) const;
 
     /**
-     * @brief Unexports a GPIO pin.
+     * @brief Builds the configuration of the first lines.
      * 
-     * @param pin The GPIO pin number.
-     * @return true if the pin was successfully unexported, false otherwise.
+     * @param count Number of lines, from the start of gpio_lines.
+     * @param config Configuration to fill.
+     * @return true if successful, false if the lines need too many attributes.
      */
-    bool unexportGPIO(uint8_t pin);
+    bool lineConfig(size_t count, gpio_v2_line_config& config) const;
 
     /**
-     * @brief Sets the direction of a GPIO pin.
+     * @brief Requests the first lines from the GPIO chip.
      * 
-     * @param pin The GPIO pin number.
-     * @param direction The direction to set ("in" for input, "out" for output).
-     * @return true if the direction was successfully set, false otherwise.
+     * @param count Number of lines, from the start of gpio_lines.
+     * @return The descriptor of the line request, -1 on failure.
      */
-    bool setGPIODirection(uint8_t pin, const std::string& direction);
+    int openLineRequest(size_t count);
 
     /**
-     * @brief Writes a value to a GPIO pin.
+     * @brief Applies the line configuration to the line request.
      * 
-     * @param pin The GPIO pin number.
-     * @param value The value to write (true for high, false for low).
-     * @return true if the value was successfully written, false otherwise.
+     * Reconfigures the request in place, or requests the lines again when a
+     * line was added. Output levels are kept. If the new set cannot be
+     * requested, the lines held before are requested again.
+     * 
+     * @return true if successful, false otherwise.
      */
-    bool writeGPIOValue(uint8_t pin, bool value);
+    bool requestLines();
 
     /**
-     * @brief Reads the value of a GPIO pin.
+     * @brief Configures a pin, adding its line if needed.
      * 
      * @param pin The GPIO pin number.
-     * @return The value of the GPIO pin (true for high, false for low).
+     * @param flags The GPIO_V2_LINE_FLAG_* of the line.
+     * @return true if successful, false otherwise.
      */
-    bool readGPIOValue(uint8_t pin);
+    bool setLineFlags(uint8_t pin, uint64_t flags);
 
     void interruptThread();
+
+    /**
+     * @brief Reports a failed SPI transfer.
+     */
+    void reportTransferError();
 };
 
 
@@ -26,6 +26,9 @@
 #include <functional>
 #include <chrono>
 #include "SPIInterface.hpp"
+#include "Radio.hpp"
+#include "RealTime.hpp"
+#include "SessionMirror.hpp"
 
 // LoRaWAN MAC commands
 #define MAC_LINK_CHECK_REQ 0x02
@@ -131,6 +134,78 @@ public:
         bool confirmed;               /**< Whether the message is confirmed */
     };
 
+    /**
+     * @brief Noise floor statistics of one channel from an RSSI survey.
+     */
+    struct ChannelNoise {
+        float frequency = 0.0f; /**< Channel frequency in MHz */
+        float min = 0.0f;       /**< Lowest sample in dBm */
+        float mean = 0.0f;      /**< Mean of the samples in dBm */
+        float p95 = 0.0f;       /**< 95th percentile of the samples in dBm */
+        size_t samples = 0;     /**< Number of samples taken */
+    };
+
+    /**
+     * @brief Delivery statistics of one channel used by the channel picker.
+     */
+    struct ChannelQuality {
+        float delivery = 0.5f;      /**< Smoothed downlink/ACK success after uplinks (0-1) */
+        float crcErrorRate = 0.0f;  /**< Smoothed CRC error rate in RX1 (0-1) */
+        float noiseFloor = 0.0f;    /**< p95 noise from the last survey in dBm, 0 if not surveyed */
+        uint32_t uplinks = 0;       /**< Uplinks sent on the channel */
+        uint32_t downlinks = 0;     /**< Downlinks received after uplinks on the channel */
+    };
+
+    /**
+     * @brief Per-message transmission options.
+     */
+    struct SendOptions {
+        bool confirmed = false;        /**< Whether the message should be confirmed */
+        bool force_duty_cycle = false; /**< Whether to ignore the duty cycle */
+        int deadline_ms = 0;           /**< Latest end of transmission after send(), 0 for none */
+        int priority = 0;              /**< Urgency, higher values may use more power */
+        float target_delivery = 0.9f;  /**< Wanted delivery probability (0-1) */
+    };
+
+    /// Number of data rates in the policy tables (DR0-DR7)
+    static constexpr int DATA_RATES = 8;
+
+    /**
+     * @brief What a transmission policy knows about the next frame.
+     * 
+     * The tables are indexed by data rate; only entries between min_dr and
+     * max_dr are valid.
+     */
+    struct TxPolicyInput {
+        size_t frame_size = 0;          /**< PHYPayload size in bytes */
+        int deadline_ms = 0;            /**< From SendOptions */
+        int priority = 0;               /**< From SendOptions */
+        float target_delivery = 0.9f;   /**< From SendOptions */
+        uint8_t adr_dr = 0;             /**< Data rate chosen by ADR */
+        uint8_t min_dr = 0;             /**< Slowest data rate the frame fits in */
+        uint8_t max_dr = 0;             /**< Fastest data rate allowed by the channel plan and ADR */
+        int8_t power = 14;              /**< Current TX power in dBm */
+        int8_t max_power = 14;          /**< Regional maximum TX power in dBm */
+        uint8_t nb_trans = 1;           /**< Transmissions of an unconfirmed frame */
+        bool margin_known = false;      /**< Whether link_margin holds an estimate */
+        std::array<float, DATA_RATES> airtime_ms{};  /**< Time on air per data rate */
+        std::array<float, DATA_RATES> wait_ms{};     /**< Duty-cycle wait before a channel is free */
+        std::array<float, DATA_RATES> link_margin{}; /**< Estimated SNR above the demodulation floor in dB */
+    };
+
+    /**
+     * @brief Data rate and power chosen for one frame.
+     */
+    struct TxPolicyDecision {
+        uint8_t dr = 0;     /**< Data rate index */
+        int8_t power = 14;  /**< TX power in dBm */
+    };
+
+    /**
+     * @brief Callback type choosing the data rate and power of each frame.
+     */
+    typedef std::function<TxPolicyDecision(const TxPolicyInput&)> TxPolicy;
+
     /**
      * @brief Callback type for received messages.
      */
@@ -144,17 +219,27 @@ public:
     /**
      * @brief Default constructor.
      * 
-     * Initializes a LoRaWAN instance with default SPI interface (CH341SPI).
+     * Initializes a LoRaWAN instance with an RFM95 on the default SPI interface
+     * (CH341SPI, or the backend selected with RFM_USE_CH341/RFM_USE_LINUX_SPI).
      */
     LoRaWAN();
 
     /**
      * @brief Constructor with custom SPI interface.
      * 
+     * Uses an RFM95 radio on the given interface.
+     * 
      * @param spi_interface A unique pointer to an SPIInterface implementation
      */
     explicit LoRaWAN(std::unique_ptr<SPIInterface> spi_interface);
 
+    /**
+     * @brief Constructor with a radio driver.
+     * 
+     * @param radio A unique pointer to a Radio implementation (RFM95, SX126x...)
+     */
+    explicit LoRaWAN(std::unique_ptr<Radio> radio);
+
     /**
      * @brief Destructor.
      */
@@ -232,6 +317,26 @@ public:
      */
     bool join(JoinMode mode, unsigned long timeout = 10000);
 
+    /**
+     * @brief Start an OTAA join without blocking.
+     * 
+     * Sends the Join Request and returns; update() opens the join accept
+     * windows JOIN_ACCEPT_DELAY1 and JOIN_ACCEPT_DELAY2 after it. A stored
+     * session is restored instead, like join() does. Nothing else may be
+     * sent until the join has finished.
+     * 
+     * @param done Called from update() with the outcome, only if the join was started
+     * @return true if the Join Request was sent or a session was restored
+     */
+    bool startJoin(std::function<void(bool)> done = nullptr);
+
+    /**
+     * @brief Check if a join started with startJoin() is in progress.
+     * 
+     * @return true while waiting for the Join Accept
+     */
+    bool isJoining() const;
+
     /**
      * @brief Encrypt a payload.
      * 
@@ -277,9 +382,112 @@ public:
 
     /**
      * @brief Reset the duty cycle usage.
+     * 
+     * With the airtime ledger enabled, the usage is rebuilt from the
+     * transmissions of the last hour instead of being cleared.
      */
     void resetDutyCycle();
 
+    /**
+     * @brief Fetch queued downlinks without waiting for the next application uplink.
+     * 
+     * When a Class A downlink has FPending set, or a confirmed downlink needs an
+     * ACK, update() sends an empty uplink (carrying the ACK and any pending MAC
+     * answers) as soon as the duty cycle allows, until the network reports an
+     * empty queue. Enabled by default.
+     * 
+     * @param enable Whether to enable the downlink drain
+     */
+    void setDownlinkDrain(bool enable);
+
+    /**
+     * @brief Keep a persistent ledger of transmissions for duty-cycle accounting.
+     * 
+     * Every uplink and join request is recorded with its timestamp, sub-band
+     * and air time. The duty-cycle state is rebuilt from the ledger when it
+     * is enabled, so it survives restarts.
+     * 
+     * @param filename Path of the ledger file
+     * @param capacity Number of transmissions kept in a new file
+     * @return true if the ledger file could be opened
+     */
+    bool enableAirtimeLedger(const std::string& filename, size_t capacity = 4096);
+
+    /**
+     * @brief Get the air time used in the sub-band of a frequency.
+     * 
+     * @param frequency Frequency in MHz
+     * @param window_s Time window in seconds
+     * @return Air time in milliseconds recorded in the ledger, 0 if disabled
+     */
+    float getSubBandAirtime(float frequency, int window_s = 3600) const;
+
+    /**
+     * @brief Mirror the session to standby processes over a Unix socket.
+     * 
+     * The session state is sent whenever it changes and as a heartbeat from
+     * update(). Frame counters are reserved in blocks and the reservation is
+     * sent before the first FCnt of a block is used.
+     * 
+     * @param socket_path Path of the Unix socket standbys connect to
+     * @return true if the socket could be opened
+     */
+    bool enableSessionMirror(const std::string& socket_path);
+
+    /**
+     * @brief Get the current session state as mirrored to standbys.
+     * 
+     * @return Session keys, counters and MAC parameters
+     */
+    SessionMirror::State getSessionState() const;
+
+    /**
+     * @brief Take over a session mirrored from another process.
+     * 
+     * The uplink counter continues after the last FCnt reserved by the
+     * previous active process. The radio must be initialized.
+     * 
+     * @param state Replica received by a standby
+     */
+    void resumeSession(const SessionMirror::State& state);
+
+    /**
+     * @brief Capture every transmitted and received frame to a pcap file.
+     * 
+     * The file uses the LoRaTap link type, readable by Wireshark. Frames are
+     * written by a background thread and the file is rotated at max_bytes.
+     * 
+     * @param path Path of the pcap file
+     * @param max_bytes Size at which the file is rotated
+     * @param max_files Number of files kept, including the current one
+     * @return true if the capture file could be opened
+     */
+    bool enableCapture(const std::string& path, size_t max_bytes = 10 * 1024 * 1024, int max_files = 5);
+
+    /**
+     * @brief Write the pending frames and stop capturing.
+     */
+    void disableCapture();
+
+    /**
+     * @brief Move persistence, capture and mirror I/O to a background thread.
+     * 
+     * Airtime ledger and uplink queue syncs, session file saves, capture
+     * writes and mirror sends are queued and submitted in batches through
+     * io_uring where the kernel allows it, so send() and update() no longer
+     * wait for the disk. A record is durable a few milliseconds after the
+     * call that wrote it instead of before it returns.
+     * 
+     * @param queue_depth Submission queue entries of the io_uring
+     * @return true if the I/O thread is running
+     */
+    bool enableAsyncIO(unsigned queue_depth = 64);
+
+    /**
+     * @brief Complete the queued I/O and go back to synchronous I/O.
+     */
+    void disableAsyncIO();
+
     /**
      * @brief Send a message.
      * 
@@ -287,16 +495,111 @@ public:
      * @param port The port number
      * @param confirmed Whether the message should be confirmed
      * @param force_duty_cycle Whether to force transmission even if duty cycle limits are reached
-     * @return true if the message was sent successfully, false otherwise
+     * @return true if the message was sent successfully, false otherwise. With the
+     *         uplink queue enabled, true also when the message was queued because
+     *         the device is not joined or older messages are still queued.
      */
     bool send(const std::vector<uint8_t>& data, uint8_t port, bool confirmed = false, bool force_duty_cycle = false);
 
+    /**
+     * @brief Send a message with per-message options.
+     * 
+     * The transmission policy, if set, picks the data rate and power of the frame.
+     * 
+     * @param data The payload to send
+     * @param port The port number
+     * @param options Confirmation, duty cycle, deadline, priority and delivery target
+     * @return true if the message was sent (or queued, see above)
+     */
+    bool send(const std::vector<uint8_t>& data, uint8_t port, const SendOptions& options);
+
+    /**
+     * @brief Send a message and get notified of its outcome.
+     * 
+     * For an unconfirmed message the outcome is the transmission itself. For
+     * a confirmed one it is known when the ACK arrives (true) or the retries
+     * run out or the frame is abandoned (false). A message stored in the
+     * uplink queue has no outcome until update() sends it from the queue.
+     * 
+     * @param data The payload to send
+     * @param port The port number
+     * @param options Confirmation, duty cycle, deadline, priority and delivery target
+     * @param done Called from update() with the outcome, only if the message was sent or queued
+     * @return true if the message was sent or queued
+     */
+    bool send(const std::vector<uint8_t>& data, uint8_t port, const SendOptions& options,
+              std::function<void(bool)> done);
+
+    /**
+     * @brief Set the policy choosing the data rate and power of each frame.
+     * 
+     * Without a policy every frame uses the ADR data rate and power.
+     * 
+     * @param policy The policy, for example airtimeTxPolicy, or nullptr
+     */
+    void setTxPolicy(TxPolicy policy);
+
+    /**
+     * @brief Policy that minimises air time for a delivery target.
+     * 
+     * Picks the fastest data rate whose estimated delivery probability, from
+     * the link margin and NbTrans, reaches the target and that ends before the
+     * deadline. If none does, the most reliable one is used, at full power for
+     * priority messages. Without a link estimate the ADR choice is kept.
+     * 
+     * @param input Frame and link information
+     * @return Data rate and power
+     */
+    static TxPolicyDecision airtimeTxPolicy(const TxPolicyInput& input);
+
     /**
      * @brief Update the LoRaWAN state.
      * 
-     * Should be called regularly to handle received messages and other events.
+     * Handles received messages and everything that is due: RX1/RX2 opening
+     * and closing, retransmissions, queued uplinks, downlink drain. Frames
+     * waiting for the duty cycle are rescheduled for when a channel frees up.
+     * 
+     * @return Time until update() next has something to do, so the caller can
+     *         sleep that long. While the radio is listening it is at most
+     *         RX_POLL_MS, unless setIrqWakeup() is enabled and the interrupt
+     *         wakes the caller. milliseconds::max() if nothing is scheduled.
+     */
+    std::chrono::milliseconds update();
+
+    /**
+     * @brief Get a file descriptor that becomes readable when the stack needs servicing.
+     * 
+     * The descriptor fires at the next protocol deadline (RX window, retry,
+     * backfill, heartbeat) and when notifyEvent() is called. Add it to an
+     * epoll/libuv/asio loop and call processEvents() when it is readable,
+     * instead of calling update() periodically. Linux only.
+     * 
+     * @return Descriptor to poll for reading, -1 if not supported
+     */
+    int getEventFd();
+
+    /**
+     * @brief Handle what is due and re-arm the event descriptor.
+     */
+    void processEvents();
+
+    /**
+     * @brief Make the event descriptor readable now.
+     * 
+     * Call it from the radio's DIO interrupt or after queuing work from
+     * another thread. Safe to call from any thread.
+     */
+    void notifyEvent();
+
+    /**
+     * @brief Declare that the radio's RX done interrupt is wired to notifyEvent().
+     * 
+     * Without it, the event descriptor also fires every RX_POLL_MS while the
+     * radio is listening, to check the IRQ flags.
+     * 
+     * @param enable true if received frames are signalled by an interrupt
      */
-    void update();
+    void setIrqWakeup(bool enable);
 
     /**
      * @brief Receive a message.
@@ -307,6 +610,18 @@ public:
      */
     bool receive(Message& message, unsigned long timeout = 1000);
 
+    /**
+     * @brief Get the next downlink without blocking.
+     * 
+     * Takes the oldest message already queued, or the next one update()
+     * receives. Pending requests are served in order and get the downlinks
+     * before the onReceive() callback.
+     * 
+     * @param timeout Time to wait for a downlink, milliseconds::max() for no limit
+     * @param done Called from update() with true and the message, or false on timeout
+     */
+    void receiveNext(std::chrono::milliseconds timeout, std::function<void(bool, const Message&)> done);
+
     /**
      * @brief Set a callback for received messages.
      * 
@@ -407,6 +722,99 @@ public:
      */
     float getSingleChannelFrequency() const;
 
+    /**
+     * @brief Measure the noise floor of every channel in the region plan.
+     * 
+     * Samples the instantaneous RSSI on each enabled channel and on RX2. The
+     * radio returns to standby afterwards, update() restores reception.
+     * 
+     * @param samples_per_channel RSSI samples taken on each channel
+     * @return Statistics per channel, empty if the radio cannot sample RSSI
+     */
+    std::vector<ChannelNoise> surveyChannels(size_t samples_per_channel = 32);
+
+    /**
+     * @brief Run the channel survey from update() while a Class A device is idle.
+     * 
+     * @param enable Whether to enable background surveys
+     * @param interval_s Minimum time between surveys in seconds
+     * @param samples_per_channel RSSI samples taken on each channel
+     */
+    void setBackgroundSurvey(bool enable, int interval_s = 60, size_t samples_per_channel = 32);
+
+    /**
+     * @brief Get the results of the last channel survey.
+     * 
+     * @return Statistics per channel
+     */
+    const std::vector<ChannelNoise>& getChannelNoise() const;
+
+    /**
+     * @brief Get the quality statistics of a channel.
+     * 
+     * @param channel The channel index
+     * @return Channel statistics, defaults for an invalid channel
+     */
+    ChannelQuality getChannelQuality(int channel) const;
+
+    /**
+     * @brief Tune unconfirmed repetitions from the observed loss.
+     * 
+     * Raises NbTrans above the network value (up to MAX_ADAPTIVE_NBTRANS) so that
+     * the delivery probability reaches TARGET_DELIVERY at the loss rate measured
+     * on confirmed uplinks.
+     * 
+     * @param enable Whether to enable adaptive repetitions
+     */
+    void setAdaptiveNbTrans(bool enable);
+
+    /**
+     * @brief Get the number of transmissions of unconfirmed frames.
+     * 
+     * @return NbTrans from LinkADRReq, raised by the adaptive mode if enabled
+     */
+    uint8_t getNbTrans() const;
+
+    /**
+     * @brief Store uplinks in a persistent queue while the device is offline.
+     * 
+     * Messages passed to send() while not joined, or while older messages are
+     * still queued, are written to a ring file that survives restarts. update()
+     * drains the queue in order once the session is joined or restored.
+     * 
+     * @param filename Path of the queue file
+     * @param capacity Number of messages for a new file
+     * @return true if the queue file could be opened
+     */
+    bool enableUplinkQueue(const std::string& filename, size_t capacity = 1024);
+
+    /**
+     * @brief Add a message to the uplink queue.
+     * 
+     * @param data The payload (max UplinkQueue::MAX_PAYLOAD bytes)
+     * @param port The port number
+     * @param confirmed Whether the message should be confirmed
+     * @return false if the queue is disabled or full
+     */
+    bool queueUplink(const std::vector<uint8_t>& data, uint8_t port, bool confirmed = false);
+
+    /**
+     * @brief Get the number of queued uplinks.
+     * 
+     * @return Messages waiting in the uplink queue
+     */
+    size_t getQueuedUplinks() const;
+
+    /**
+     * @brief Set the minimum time between queued uplinks.
+     * 
+     * The queue is never drained faster than the duty cycle allows; the
+     * interval leaves airtime and FCnt space for live traffic.
+     * 
+     * @param ms Minimum interval in milliseconds, 0 to send as fast as allowed
+     */
+    void setBackfillInterval(int ms);
+
     /**
      * @brief Set the transmission power.
      * 
@@ -506,6 +914,17 @@ public:
      */
     void processLinkADRReq(const std::vector<uint8_t>& cmd, size_t index, std::vector<uint8_t>& response);
 
+    /**
+     * @brief Check if an uplink MAC command is waiting for the next uplink.
+     * 
+     * Walks the pending commands by their lengths, so payload bytes are not
+     * mistaken for command identifiers.
+     * 
+     * @param cid The command identifier
+     * @return true if the command is pending
+     */
+    bool isMACCommandPending(uint8_t cid) const;
+
     /**
      * @brief Send ADR statistics.
      */
@@ -537,9 +956,36 @@ public:
     void updateRxWindows();
 
     /**
-     * @brief Handle confirmations.
+     * @brief Run pending retransmissions.
+     * 
+     * Confirmed frames are retried up to MAX_RETRIES transmissions, ACK_TIMEOUT
+     * (1-3 s) after RX2 closes. Unconfirmed frames are repeated NbTrans times.
+     * Each transmission reuses the stored frame, so the FCnt does not change,
+     * and moves to another channel. Never blocks: a transmission waits in
+     * update() until a channel's duty cycle allows it.
      */
-    void handleConfirmation();
+    void updateRetransmissions();
+
+    /**
+     * @brief Build a data uplink frame with the current FCnt.
+     * 
+     * @param data Payload to encrypt
+     * @param port The port number
+     * @param confirmed Whether the message should be confirmed
+     * @param ackbit Whether to acknowledge a confirmed downlink
+     * @return Complete PHYPayload including the MIC
+     */
+    std::vector<uint8_t> buildUplink(const std::vector<uint8_t>& data, uint8_t port, bool confirmed, bool ackbit);
+
+    /**
+     * @brief Transmit a built frame and open the RX windows.
+     * 
+     * @param frame Complete PHYPayload
+     * @param force_duty_cycle Whether to ignore the duty cycle
+     * @param retransmission Whether the frame was sent before, to change channel
+     * @return true if the frame was sent
+     */
+    bool transmitFrame(const std::vector<uint8_t>& frame, bool force_duty_cycle, bool retransmission);
 
     /**
      * @brief Send an acknowledgment.
@@ -572,11 +1018,264 @@ public:
      */
     void requestLinkCheck();
 
+    /**
+     * @brief Request the network time (DeviceTimeReq) with the next uplink.
+     */
+    void requestDeviceTime();
+
+    /**
+     * @brief Get the network time from the last DeviceTimeAns.
+     * 
+     * @param gps_ms Receives the current GPS time in milliseconds
+     * @return false if no DeviceTimeAns has been received
+     */
+    bool getNetworkTime(int64_t& gps_ms) const;
+
+    /**
+     * @brief Get the start of this device's next uplink slot.
+     * 
+     * The period is split so that every device gets a fixed offset derived from
+     * a hash of its DevEUI. Slots are aligned to the network time when a
+     * DeviceTimeAns was received, otherwise to the local clock converted to GPS
+     * time. A random jitter of up to jitter_ms is added.
+     * 
+     * @param period_s Uplink period in seconds
+     * @param jitter_ms Maximum random delay added to the slot in milliseconds
+     * @return Time of the next uplink, always in the future
+     */
+    std::chrono::steady_clock::time_point nextUplinkSlot(int period_s, int jitter_ms = 0) const;
+
+    /**
+     * @brief Get how late the RX1 and RX2 windows were opened.
+     * 
+     * Measured from the nominal opening time (TxDone plus the receive
+     * delay) to the moment update() reconfigured the radio, for data and
+     * join accept windows since the start.
+     * 
+     * @return Lateness statistics in microseconds
+     */
+    LatencyStats::Summary getWindowLateness() const;
+
     /**
      * @brief Update the data rate from the spreading factor.
      */
     void updateDataRateFromSF();
 
+    /**
+     * @brief Pick the uplink channel.
+     * 
+     * Weighted-random choice among the enabled channels whose duty cycle allows
+     * the transmission, favouring channels that deliver downlinks, have few RX1
+     * CRC errors and a low noise floor.
+     * 
+     * @param payload_size Size of the frame in bytes
+     * @param exclude Channel to avoid if another one is available, -1 for none
+     * @return The channel index
+     */
+    int selectChannel(size_t payload_size, int exclude = -1);
+
+    /**
+     * @brief Check the duty cycle of a channel without registering usage.
+     * 
+     * @param channel The channel index
+     * @param air_time_ms Air time of the transmission in milliseconds
+     * @return true if the channel can transmit now
+     */
+    bool isChannelAvailable(int channel, float air_time_ms) const;
+
+    /**
+     * @brief Check if a channel is defined and enabled by the ChMask of LinkADRReq.
+     * 
+     * @param channel The channel index
+     * @return true if uplinks may use the channel
+     */
+    bool isChannelEnabled(int channel) const;
+
+    /**
+     * @brief Ask the transmission policy for the data rate and power of a frame.
+     * 
+     * @param frame_size PHYPayload size in bytes
+     * @param options Options given to send()
+     */
+    void selectDataRate(size_t frame_size, const SendOptions& options);
+
+    /**
+     * @brief Map a data rate to spreading factor and bandwidth.
+     * 
+     * @param dataRate The data rate index
+     * @param sf Receives the spreading factor
+     * @param bw Receives the bandwidth in kHz
+     */
+    void dataRateToSF(uint8_t dataRate, int& sf, float& bw) const;
+
+    /**
+     * @brief Time on air of a frame with explicit modulation parameters.
+     * 
+     * @param payload_size Size of the frame in bytes
+     * @param sf Spreading factor
+     * @param bw Bandwidth in kHz
+     * @return Time on air in milliseconds
+     */
+    float timeOnAir(size_t payload_size, int sf, float bw) const;
+
+    /**
+     * @brief Time until any usable channel can send a transmission.
+     * 
+     * @param air_time_ms Air time of the transmission in milliseconds
+     * @return Wait in milliseconds, 0 if a channel is free now
+     */
+    float dutyCycleWait(float air_time_ms) const;
+
+    /**
+     * @brief Send an empty uplink to open RX windows for pending downlinks.
+     */
+    void updateDownlinkDrain();
+
+    /**
+     * @brief Register a transmission in the duty-cycle state and the ledger.
+     * 
+     * @param frequency Frequency in MHz
+     * @param air_time_ms Air time of the transmission in milliseconds
+     */
+    void registerAirtime(float frequency, float air_time_ms);
+
+    /**
+     * @brief Check if any usable channel can transmit now.
+     * 
+     * @param air_time_ms Air time of the transmission in milliseconds
+     * @return true if a channel's duty cycle allows the transmission
+     */
+    bool anyChannelAvailable(float air_time_ms) const;
+
+    /**
+     * @brief Send the oldest queued uplink when the MAC is idle.
+     */
+    void drainUplinkQueue();
+
+    /**
+     * @brief Precompute the keystream and MIC state of the next uplink.
+     */
+    void precomputeUplink();
+
+    /**
+     * @brief Earliest time at which update() has something to do.
+     * 
+     * @return Deadline, time_point::max() if nothing is scheduled
+     */
+    std::chrono::steady_clock::time_point nextEventTime() const;
+
+    /**
+     * @brief When the first channel's duty cycle allows a frame.
+     * 
+     * @param air_time_ms Air time of the frame
+     * @return Time the frame can be sent
+     */
+    std::chrono::steady_clock::time_point channelReleaseTime(float air_time_ms) const;
+
+    /**
+     * @brief Reserve a block of frame counters with the standbys before using a new one.
+     */
+    void reserveFrameCounter();
+
+    /**
+     * @brief Send the session state to the standbys if it changed or a heartbeat is due.
+     * 
+     * @param force Send even if nothing changed, and before returning
+     */
+    void publishSessionState(bool force);
+
+    /**
+     * @brief Sleep, sending the mirror heartbeats that fall due meanwhile.
+     * 
+     * @param duration Time to sleep
+     */
+    void sleepWithHeartbeat(std::chrono::milliseconds duration);
+
+    /**
+     * @brief Add a received frame to the capture, if enabled.
+     * 
+     * @param frame PHYPayload
+     * @param info RSSI and SNR of the frame, nullptr to read them from the radio
+     */
+    void captureDownlink(const std::vector<uint8_t>& frame, const Radio::PacketInfo* info = nullptr);
+
+    /**
+     * @brief Record whether the last uplink got a downlink.
+     * 
+     * @param delivered true if a downlink or ACK was received
+     */
+    void recordDownlinkOutcome(bool delivered);
+
+    /**
+     * @brief Configure the radio and send a Join Request, blocking until TxDone.
+     * 
+     * @return true if the Join Request was sent
+     */
+    bool sendJoinRequest();
+
+    /**
+     * @brief Process a Join Accept and start the session.
+     * 
+     * @param response Frame received in a join accept window
+     * @return true if the Join Accept was valid
+     */
+    bool acceptJoin(std::vector<uint8_t>& response);
+
+    /**
+     * @brief Open and close the join accept windows of startJoin().
+     */
+    void updateJoin();
+
+    /**
+     * @brief End the join started by startJoin() and report its outcome.
+     * 
+     * @param ok true if the device joined
+     */
+    void finishJoin(bool ok);
+
+    /**
+     * @brief Check if send() stores a message in the uplink queue.
+     * 
+     * @param data The payload to send
+     * @return true if the device is offline or older messages are still queued
+     */
+    bool queuesUplink(const std::vector<uint8_t>& data) const;
+
+    /**
+     * @brief Hand the callback of a message that went on air to its outcome.
+     * 
+     * @param confirmed true to wait for the ACK, false to complete at once
+     * @param done Callback given to send()
+     */
+    void awaitSendOutcome(bool confirmed, std::function<void(bool)> done);
+
+    /**
+     * @brief Report the outcome of the confirmed message sent with a callback.
+     * 
+     * @param delivered true if the ACK was received
+     */
+    void completeSend(bool delivered);
+
+    /**
+     * @brief Time out the receiveNext() requests whose deadline has passed.
+     */
+    void expireReceiveWaiters();
+
+    /**
+     * @brief Queue a completion callback for the end of update().
+     * 
+     * Completions never run inside the call that started the operation, so
+     * a callback can start the next one.
+     * 
+     * @param completion Callback bound to its result
+     */
+    void deferCompletion(std::function<void()> completion);
+
+    /**
+     * @brief Run the completions queued so far.
+     */
+    void runCompletions();
+
     /**
      * @brief Set verbose mode.
      * 
@@ -622,9 +1321,6 @@ private:
     // Confirmation state variables
     ConfirmationState confirmState = NONE;
     int confirmRetries = 0;
-    std::chrono::steady_clock::time_point lastConfirmAttempt;
-    std::vector<uint8_t> pendingAck;
-    uint8_t ackPort;
     bool needsAck = false;
     uint16_t lastFcntDown = 0;
 
@@ -652,12 +1348,46 @@ private:
     static constexpr unsigned long RECEIVE_DELAY1 = 1000;
     static constexpr unsigned long RECEIVE_DELAY2 = 2000;
     static constexpr unsigned long WINDOW_DURATION = 500;
+    static constexpr unsigned long JOIN_ACCEPT_DELAY1 = 5000;
+    static constexpr unsigned long JOIN_ACCEPT_DELAY2 = 6000;
     
     // ADR constants
     static constexpr uint8_t ADR_ACK_LIMIT = 64;
     static constexpr uint8_t ADR_ACK_DELAY = 32;
     static constexpr uint8_t MAX_RETRIES = 8;
 
+    // Retransmission constants
+    static constexpr int ACK_TIMEOUT_MIN_MS = 1000;
+    static constexpr int ACK_TIMEOUT_MAX_MS = 3000;
+    static constexpr int RETX_BACKOFF_MS = 1000;
+    static constexpr int MAX_ADAPTIVE_NBTRANS = 3;
+    static constexpr float TARGET_DELIVERY = 0.9f;
+
+    // MHDR + FHDR without FOpts + FPort + MIC around a queued payload
+    static constexpr size_t FRAME_OVERHEAD = 13;
+
+    // Per-message data rate policy: EU868 MACPayload limits per DR, SX127x
+    // demodulation floor per SF (SF7-SF12) and the fading assumed around the
+    // link margin estimate
+    static constexpr int MAX_LORA_DR = 5;
+    static constexpr size_t MAX_MAC_PAYLOAD[MAX_LORA_DR + 1] = { 59, 59, 59, 123, 230, 230 };
+    static constexpr float REQUIRED_SNR[6] = { -7.5f, -10.0f, -12.5f, -15.0f, -17.5f, -20.0f };
+    static constexpr float LINK_FADE_SIGMA_DB = 3.0f;
+
+    // Session mirror: frame counters reserved per message and heartbeat period
+    static constexpr uint32_t MIRROR_FCNT_BLOCK = 16;
+    static constexpr int MIRROR_HEARTBEAT_MS = 200;
+
+    // IRQ flag polling period while listening without an interrupt wakeup
+    static constexpr int RX_POLL_MS = 50;
+
+    // GPS time is Unix time minus the GPS epoch offset plus the leap seconds
+    static constexpr int64_t GPS_EPOCH_OFFSET_S = 315964800;
+    static constexpr int64_t GPS_LEAP_SECONDS = 18;
+
+    // Smoothing factor of the channel quality averages
+    static constexpr float QUALITY_ALPHA = 0.2f;
+
     
     // Callbacks
     ReceiveCallback receiveCallback = nullptr;
@@ -0,0 +1,178 @@
+/**
+ * @file LoRaWANAsync.hpp
+ * @brief C++20 coroutine interface for join, send and receive
+ *
+ * Wraps the non-blocking operations of LoRaWAN (startJoin(), send() with a
+ * completion and receiveNext()) in awaitables, so an application writes the
+ * protocol exchange as straight-line code:
+ *
+ * @code
+ * LoRaWANAsync::Task run(LoRaWAN& lorawan) {
+ *     if (!co_await LoRaWANAsync::join(lorawan))
+ *         co_return;
+ *     LoRaWAN::SendOptions options;
+ *     options.confirmed = true;
+ *     std::vector<uint8_t> payload = {0x01, 0x02};
+ *     bool acked = co_await LoRaWANAsync::send(lorawan, payload, 1, options);
+ *     auto downlink = co_await LoRaWANAsync::receive(lorawan, std::chrono::seconds(30));
+ * }
+ * @endcode
+ *
+ * Coroutines are resumed from update() (or processEvents()) on the thread
+ * that drives the stack, never from the call that suspends them, so no
+ * locking is needed and a resumed coroutine can start the next operation.
+ * No thread is blocked while an operation is pending.
+ *
+ * Requires C++20, enabled with the LORAWAN_COROUTINES CMake option.
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+#pragma once
+
+#if __cplusplus < 202002L
+#error "LoRaWANAsync.hpp requires C++20, configure with -DLORAWAN_COROUTINES=ON"
+#endif
+
+#include "LoRaWAN.hpp"
+
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <vector>
+
+namespace LoRaWANAsync {
+
+/**
+ * @brief Coroutine that runs on its own once started.
+ *
+ * The coroutine starts when it is called and its frame is freed when it
+ * finishes; there is nothing to await or destroy. An exception escaping the
+ * coroutine terminates the program, like one escaping a thread.
+ */
+struct Task {
+    struct promise_type {
+        Task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+/**
+ * @brief Awaitable OTAA join, resumes with true once joined.
+ */
+class JoinAwaiter {
+public:
+    explicit JoinAwaiter(LoRaWAN& lorawan) : lorawan(lorawan) {}
+
+    bool await_ready() const { return false; }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+        // Not started: resume at once with false
+        return lorawan.startJoin([this, handle](bool ok) {
+            result = ok;
+            handle.resume();
+        });
+    }
+
+    bool await_resume() const { return result; }
+
+private:
+    LoRaWAN& lorawan;
+    bool result = false;
+};
+
+/**
+ * @brief Awaitable uplink, resumes with true once sent (unconfirmed) or acknowledged (confirmed).
+ *
+ * A message that goes to the uplink queue resumes once the queue has sent it.
+ */
+class SendAwaiter {
+public:
+    SendAwaiter(LoRaWAN& lorawan, std::vector<uint8_t> data, uint8_t port, const LoRaWAN::SendOptions& options)
+        : lorawan(lorawan), data(std::move(data)), port(port), options(options) {}
+
+    bool await_ready() const { return false; }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+        return lorawan.send(data, port, options, [this, handle](bool ok) {
+            result = ok;
+            handle.resume();
+        });
+    }
+
+    bool await_resume() const { return result; }
+
+private:
+    LoRaWAN& lorawan;
+    std::vector<uint8_t> data;
+    uint8_t port;
+    LoRaWAN::SendOptions options;
+    bool result = false;
+};
+
+/**
+ * @brief Awaitable downlink, resumes with the message or std::nullopt on timeout.
+ */
+class ReceiveAwaiter {
+public:
+    ReceiveAwaiter(LoRaWAN& lorawan, std::chrono::milliseconds timeout) : lorawan(lorawan), timeout(timeout) {}
+
+    bool await_ready() const { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        lorawan.receiveNext(timeout, [this, handle](bool ok, const LoRaWAN::Message& message) {
+            if (ok)
+                result = message;
+            handle.resume();
+        });
+    }
+
+    std::optional<LoRaWAN::Message> await_resume() { return std::move(result); }
+
+private:
+    LoRaWAN& lorawan;
+    std::chrono::milliseconds timeout;
+    std::optional<LoRaWAN::Message> result;
+};
+
+/**
+ * @brief Join with OTAA, or restore the stored session.
+ *
+ * @param lorawan Stack driven by update() or processEvents()
+ * @return Awaitable resuming with true if joined
+ */
+inline JoinAwaiter join(LoRaWAN& lorawan) {
+    return JoinAwaiter(lorawan);
+}
+
+/**
+ * @brief Send a message.
+ *
+ * @param lorawan Stack driven by update() or processEvents()
+ * @param data The payload to send
+ * @param port The port number
+ * @param options Confirmation, duty cycle, deadline, priority and delivery target
+ * @return Awaitable resuming with the outcome, see LoRaWAN::send()
+ */
+inline SendAwaiter send(LoRaWAN& lorawan, std::vector<uint8_t> data, uint8_t port,
+                        const LoRaWAN::SendOptions& options = LoRaWAN::SendOptions()) {
+    return SendAwaiter(lorawan, std::move(data), port, options);
+}
+
+/**
+ * @brief Wait for the next downlink.
+ *
+ * @param lorawan Stack driven by update() or processEvents()
+ * @param timeout Time to wait, milliseconds::max() for no limit
+ * @return Awaitable resuming with the message, std::nullopt on timeout
+ */
+inline ReceiveAwaiter receive(LoRaWAN& lorawan, std::chrono::milliseconds timeout) {
+    return ReceiveAwaiter(lorawan, timeout);
+}
+
+} // namespace LoRaWANAsync
@@ -0,0 +1,211 @@
+/**
+ * @file Logger.hpp
+ * @brief Asynchronous logger for the radio and MAC layers
+ *
+ * Logging from the SPI and MAC code must not block in the middle of radio
+ * timing. Each thread formats its messages into a ring of fixed-size records
+ * that only it writes and only the writer thread reads, so logging takes no
+ * lock and makes no system call. The writer thread sends the records to the
+ * console, a file or journald.
+ *
+ * The LOG_WARNING/LOG_ERROR macros are rate limited per call site, so an
+ * error repeated in a loop (a USB timeout storm, for example) costs an atomic
+ * increment once its budget is spent. The next message that gets through
+ * reports how many were suppressed.
+ *
+ * Until start() is called, messages are written synchronously to std::cout
+ * (debug, info) or std::cerr (warning, error), as before.
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @class Logger
+ * @brief Process-wide asynchronous logger
+ */
+class Logger {
+public:
+    /// Message severity
+    enum class Level : uint8_t {
+        Debug,
+        Info,
+        Warning,
+        Error
+    };
+
+    /// Destination of the writer thread
+    enum class Sink {
+        Console,  ///< stdout, warnings and errors to stderr
+        File,     ///< Appended to a file
+        Journald  ///< systemd journal (native protocol)
+    };
+
+    /**
+     * @brief Rate limit state of one call site
+     */
+    struct RateLimit {
+        std::atomic<int64_t> window_start{0};
+        std::atomic<uint32_t> count{0};
+        std::atomic<uint32_t> suppressed{0};
+    };
+
+    /**
+     * @brief Get the process-wide logger
+     */
+    static Logger& instance();
+
+    ~Logger();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    /**
+     * @brief Start the writer thread
+     *
+     * @param sink Destination of the messages
+     * @param path Log file for Sink::File
+     * @return True if successful
+     */
+    bool start(Sink sink, const std::string& path = "");
+
+    /**
+     * @brief Write the pending messages and stop the writer thread
+     */
+    void stop();
+
+    /**
+     * @brief Set the lowest severity that is logged
+     *
+     * @param level Minimum level
+     */
+    void setLevel(Level level) { minLevel.store(level, std::memory_order_relaxed); }
+
+    /**
+     * @brief Check if messages of a severity are logged
+     */
+    bool enabled(Level level) const { return level >= minLevel.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Set the rate limit of LOG_WARNING and LOG_ERROR call sites
+     *
+     * @param burst Messages per call site and window
+     * @param window Length of the window
+     */
+    void setRateLimit(uint32_t burst, std::chrono::milliseconds window);
+
+    /**
+     * @brief Count a message against the rate limit of its call site
+     *
+     * @param limit State of the call site
+     * @param suppressed Receives the messages suppressed in the previous window
+     * @return True if the message may be logged
+     */
+    bool admit(RateLimit& limit, uint32_t& suppressed);
+
+    /**
+     * @brief Log a message
+     *
+     * @param level Severity
+     * @param message Text, without a trailing newline
+     * @param suppressed Similar messages suppressed before this one
+     */
+    void log(Level level, const std::string& message, uint32_t suppressed = 0);
+
+    /**
+     * @brief Log the complete lines written to debugStream()
+     */
+    void flushDebug();
+
+    /**
+     * @brief Thread-local stream to format a message, cleared
+     */
+    static std::ostringstream& lineStream();
+
+    /**
+     * @brief Thread-local stream collecting debug output until a newline
+     */
+    static std::ostringstream& debugStream();
+
+    /**
+     * @brief Number of messages dropped because a thread's ring was full
+     */
+    uint64_t dropped() const { return droppedTotal.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Parse a level name ("debug", "info", "warning", "error")
+     *
+     * @param name Level name
+     * @param level Receives the level
+     * @return False if the name is unknown
+     */
+    static bool parseLevel(const std::string& name, Level& level);
+
+    struct Ring;
+
+private:
+    Logger() = default;
+
+    Ring& localRing();
+    void writerLoop();
+    size_t drain();
+    void write(Level level, int64_t time_ms, const char* text, size_t length, uint32_t suppressed);
+
+    std::atomic<Level> minLevel{Level::Debug};
+    std::atomic<uint32_t> rateBurst{5};
+    std::atomic<int64_t> rateWindowMs{10000};
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<uint64_t> droppedTotal{0};
+
+    std::mutex ringsMutex;
+    std::vector<std::shared_ptr<Ring>> rings;
+
+    std::atomic<bool> running{false};
+    std::atomic<bool> stopping{false};
+    std::thread writer;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    Sink sink = Sink::Console;
+    std::FILE* file = nullptr;
+    int journal = -1;
+};
+
+/// Log at a level, formatted with operator<< like std::cout
+#define LOG_AT(level, x) do { \
+        if (Logger::instance().enabled(level)) { \
+            std::ostringstream& log_stream_ = Logger::lineStream(); \
+            log_stream_ << x; \
+            Logger::instance().log(level, log_stream_.str()); \
+        } \
+    } while (0)
+
+/// Log at a level, at most the configured burst per window from this call site
+#define LOG_LIMITED(level, x) do { \
+        if (Logger::instance().enabled(level)) { \
+            static Logger::RateLimit log_limit_; \
+            uint32_t log_suppressed_ = 0; \
+            if (Logger::instance().admit(log_limit_, log_suppressed_)) { \
+                std::ostringstream& log_stream_ = Logger::lineStream(); \
+                log_stream_ << x; \
+                Logger::instance().log(level, log_stream_.str(), log_suppressed_); \
+            } \
+        } \
+    } while (0)
+
+#define LOG_DEBUG(x) LOG_AT(Logger::Level::Debug, x)
+#define LOG_INFO(x) LOG_AT(Logger::Level::Info, x)
+#define LOG_WARNING(x) LOG_LIMITED(Logger::Level::Warning, x)
+#define LOG_ERROR(x) LOG_LIMITED(Logger::Level::Error, x)
@@ -0,0 +1,125 @@
+/**
+ * @file PacketCapture.hpp
+ * @brief pcap capture of LoRa frames with LoRaTap headers
+ *
+ * Every frame sent or received by the MAC layer can be written to a pcap file
+ * with link type LoRaTap (270), which Wireshark decodes down to the LoRaWAN
+ * MAC. Each record carries the frequency, spreading factor, bandwidth, RSSI
+ * and SNR of the frame and its capture time, followed by the PHYPayload.
+ *
+ * The MAC thread only copies the frame into a slot of a lock-free ring; a
+ * writer thread empties the ring to disk and rotates the file when it reaches
+ * its size limit, so capture can stay enabled on production units without
+ * adding file I/O to the radio timing.
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+#pragma once
+
+#include "Radio.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class IOExecutor;
+
+/**
+ * @class PacketCapture
+ * @brief Background pcap writer for LoRa frames
+ */
+class PacketCapture {
+public:
+    PacketCapture();
+    ~PacketCapture();
+
+    PacketCapture(const PacketCapture&) = delete;
+    PacketCapture& operator=(const PacketCapture&) = delete;
+
+    /**
+     * @brief Start capturing to a file
+     *
+     * An existing capture at the path is rotated out first. Rotated files are
+     * named path.1 (newest) to path.(max_files - 1) (oldest).
+     *
+     * @param path Path of the pcap file
+     * @param max_bytes Size at which the file is rotated
+     * @param max_files Number of files kept, including the current one
+     * @return True if successful
+     */
+    bool open(const std::string& path, size_t max_bytes = 10 * 1024 * 1024, int max_files = 5);
+
+    /**
+     * @brief Write the pending frames and stop capturing
+     */
+    void close();
+
+    /**
+     * @brief Check if capture is running
+     */
+    bool isOpen() const { return running.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Queue a frame for the capture file
+     *
+     * Safe to call from any thread, takes no lock and makes no system call.
+     *
+     * @param frame PHYPayload
+     * @param profile Channel and modulation the frame was sent or received with
+     * @param info RSSI and SNR of a received frame, nullptr for a transmitted one
+     * @return False if the ring was full and the frame was dropped
+     */
+    bool record(const std::vector<uint8_t>& frame, const Radio::Profile& profile, const Radio::PacketInfo* info);
+
+    /**
+     * @brief Number of frames dropped because the ring was full
+     */
+    uint64_t dropped() const { return droppedTotal.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Hand the file writes to an I/O executor
+     *
+     * The writer thread then queues each batch of records as one positioned
+     * write, submitted together with the other persistence I/O.
+     *
+     * @param executor Executor, nullptr to write from the writer thread
+     */
+    void setExecutor(IOExecutor* executor);
+
+    struct Slot;
+
+private:
+    void writerLoop();
+    size_t drain();
+    bool openFile();
+    void closeFile();
+    void rotateFiles();
+    void writeBuffer();
+
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<size_t> enqueuePos{0}; ///< Next slot a producer claims
+    size_t dequeuePos = 0;             ///< Next slot the writer reads
+    std::atomic<uint64_t> droppedPending{0};
+    std::atomic<uint64_t> droppedTotal{0};
+
+    std::atomic<bool> running{false};
+    std::atomic<bool> stopping{false};
+    std::thread writer;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+
+    std::string filePath;
+    size_t maxBytes = 0;
+    int maxFiles = 0;
+    std::FILE* file = nullptr;
+    size_t fileBytes = 0;
+    std::vector<uint8_t> buffer;       ///< Records encoded by the writer
+    std::atomic<IOExecutor*> executor{nullptr};
+};
@@ -0,0 +1,203 @@
+/**
+ * @file PacketForwarder.hpp
+ * @brief Single/multi-channel gateway using the Semtech UDP packet forwarder protocol
+ *
+ * Each radio listens continuously on its own channel/SF pair. Received frames
+ * are timestamped and forwarded to a network server in PUSH_DATA messages; all
+ * frames collected within a short window are sent as one JSON document. The
+ * forwarder keeps the downstream path open with PULL_DATA and transmits the
+ * PULL_RESP downlinks at the concentrator timestamp they are scheduled for.
+ *
+ * With one radio this is a single-channel gateway; with several CH341 radios on
+ * different channels it behaves as a pseudo multi-channel gateway.
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+#pragma once
+
+#include "Radio.hpp"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @class PacketForwarder
+ * @brief Semtech UDP (protocol version 2) packet forwarder over Radio drivers
+ */
+class PacketForwarder {
+public:
+    // Protocol identifiers
+    static constexpr uint8_t PROTOCOL_VERSION = 0x02;
+    static constexpr uint8_t PUSH_DATA = 0x00;
+    static constexpr uint8_t PUSH_ACK = 0x01;
+    static constexpr uint8_t PULL_DATA = 0x02;
+    static constexpr uint8_t PULL_RESP = 0x03;
+    static constexpr uint8_t PULL_ACK = 0x04;
+    static constexpr uint8_t TX_ACK = 0x05;
+
+    /**
+     * @brief Gateway counters reported in "stat" messages
+     */
+    struct Stats {
+        uint32_t rxnb = 0;   ///< Packets received
+        uint32_t rxok = 0;   ///< Packets received with a valid CRC
+        uint32_t rxfw = 0;   ///< Packets forwarded
+        uint32_t pushes = 0; ///< PUSH_DATA datagrams sent
+        uint32_t acks = 0;   ///< PUSH_ACK datagrams received
+        uint32_t dwnb = 0;   ///< Downlinks received
+        uint32_t txnb = 0;   ///< Downlinks transmitted
+    };
+
+    /**
+     * @brief Constructor
+     *
+     * @param gateway_eui Gateway EUI as 16 hex characters
+     * @param server Network server host name or address
+     * @param port_up Server port for PUSH_DATA
+     * @param port_down Server port for PULL_DATA
+     */
+    PacketForwarder(const std::string& gateway_eui, const std::string& server,
+                    uint16_t port_up = 1700, uint16_t port_down = 1700);
+
+    /**
+     * @brief Destructor
+     */
+    ~PacketForwarder();
+
+    /**
+     * @brief Add a radio listening on a channel
+     *
+     * @param radio Radio driver, begin() is called by PacketForwarder::begin()
+     * @param profile Channel and modulation the radio listens on
+     * @return Index of the radio, reported as "chan" in rxpk
+     */
+    size_t addRadio(std::unique_ptr<Radio> radio, const Radio::Profile& profile);
+
+    /**
+     * @brief Select the radio used for downlinks (default 0)
+     *
+     * @param index Radio index
+     */
+    void setTxRadio(size_t index) { tx_radio = index; }
+
+    /**
+     * @brief Set the PULL_DATA keepalive interval
+     *
+     * @param seconds Interval in seconds
+     */
+    void setKeepaliveInterval(int seconds) { keepalive_interval = std::chrono::seconds(seconds); }
+
+    /**
+     * @brief Set the status report interval
+     *
+     * @param seconds Interval in seconds
+     */
+    void setStatInterval(int seconds) { stat_interval = std::chrono::seconds(seconds); }
+
+    /**
+     * @brief Set how long received frames are collected before a PUSH_DATA
+     *
+     * @param ms Batch window in milliseconds
+     */
+    void setBatchWindow(int ms) { batch_window = std::chrono::milliseconds(ms); }
+
+    /**
+     * @brief Start the radios and open the UDP sockets
+     *
+     * @return True if successful
+     */
+    bool begin();
+
+    /**
+     * @brief Stop the radios and close the sockets
+     */
+    void end();
+
+    /**
+     * @brief Service radios, server messages and scheduled downlinks
+     *
+     * Call this from the main loop, it does not block except for the final
+     * wait before a scheduled downlink.
+     */
+    void update();
+
+    /**
+     * @brief Access the gateway counters
+     *
+     * @return Counters
+     */
+    const Stats& getStats() const { return stats; }
+
+private:
+    /// Received frame waiting to be forwarded
+    struct RxPacket {
+        size_t channel;
+        uint32_t tmst;
+        std::chrono::system_clock::time_point time;
+        Radio::PacketInfo info;
+        bool crc_ok;
+        std::vector<uint8_t> data;
+    };
+
+    /// Downlink waiting for its transmission time
+    struct TxPacket {
+        bool immediate;
+        uint32_t tmst;
+        Radio::Profile profile;
+        int power;
+        std::vector<uint8_t> data;
+    };
+
+    struct Channel {
+        std::unique_ptr<Radio> radio;
+        Radio::Profile profile;
+    };
+
+    /// Downlinks are configured this long before their timestamp
+    static constexpr int32_t TX_PREPARE_US = 50000;
+    /// Transmission is started this long before the timestamp to cover the
+    /// payload upload and the radio start-up
+    static constexpr int32_t TX_LEAD_US = 2000;
+    /// Downlinks scheduled further ahead are rejected
+    static constexpr int32_t TX_MAX_AHEAD_US = 30000000;
+    /// Maximum number of frames in one PUSH_DATA
+    static constexpr size_t MAX_BATCH = 8;
+
+    void pollRadios();
+    void flushUplinks(bool force_stat);
+    void sendPullData();
+    void receiveDownstream();
+    void handlePullResp(const uint8_t* data, size_t length);
+    void sendTxAck(uint16_t token, const char* error);
+    void processTxQueue();
+    void startReceive(Channel& channel);
+    bool sendDatagram(int fd, uint8_t identifier, uint16_t token, const std::string& json);
+    uint32_t timestamp() const;
+
+    std::array<uint8_t, 8> eui;
+    std::string server_host;
+    uint16_t server_port_up;
+    uint16_t server_port_down;
+    int sock_up = -1;
+    int sock_down = -1;
+
+    std::vector<Channel> channels;
+    size_t tx_radio = 0;
+
+    std::vector<RxPacket> pending_rx;
+    std::deque<TxPacket> tx_queue;
+    Stats stats;
+
+    std::chrono::steady_clock::time_point epoch;
+    std::chrono::steady_clock::time_point first_pending;
+    std::chrono::steady_clock::time_point last_pull;
+    std::chrono::steady_clock::time_point last_stat;
+    std::chrono::steady_clock::duration keepalive_interval = std::chrono::seconds(10);
+    std::chrono::steady_clock::duration stat_interval = std::chrono::seconds(30);
+    std::chrono::steady_clock::duration batch_window = std::chrono::milliseconds(50);
+};
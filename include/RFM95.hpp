@@ -34,6 +34,9 @@
 
 #include "CH341SPI.hpp"
 #include "SPIInterface.hpp"
+#include "SPIBus.hpp"
+#include "SX127xRegisters.hpp"
+#include "Radio.hpp"
 #include <cstdint>
 #include <vector>
 #include <string>
@@ -42,15 +45,24 @@
 #include <memory>
 
 /**
- * @class RFM95
- * @brief Class for handling RFM95 LoRa module
+ * @class RFM95T
+ * @brief Class for handling RFM95 LoRa module over a given SPI bus
  * 
  * This class provides methods to configure and use the RFM95 LoRa module.
  * It includes methods for setting frequency, transmit power, spreading factor,
  * bandwidth, coding rate, preamble length, and other parameters. It also provides
  * methods for sending and receiving data packets, as well as handling IRQ flags.
+ * 
+ * It implements the Radio interface used by the LoRaWAN MAC layer.
+ * 
+ * The SPI bus is a template parameter (see SPIBus.hpp), so register accesses are
+ * bound to the bus implementation at compile time. The driver is explicitly
+ * instantiated for SPIInterfaceBus, CH341Bus and LinuxSPIBus in RFM95.cpp.
+ * 
+ * @tparam Bus SPI bus adapter type
  */
-class RFM95
+template <typename Bus>
+class RFM95T : public Radio
 {
 public:
     // RFM95 Register Addresses
@@ -72,8 +84,10 @@ public:
     static constexpr uint8_t REG_RX_NB_BYTES = 0x13;
     static constexpr uint8_t REG_PKT_SNR_VALUE = 0x19;
     static constexpr uint8_t REG_PKT_RSSI_VALUE = 0x1A;
+    static constexpr uint8_t REG_RSSI_VALUE = 0x1B;
     static constexpr uint8_t REG_MODEM_CONFIG_1 = 0x1D;
     static constexpr uint8_t REG_MODEM_CONFIG_2 = 0x1E;
+    static constexpr uint8_t REG_SYMB_TIMEOUT_LSB = 0x1F;
     static constexpr uint8_t REG_PREAMBLE_MSB = 0x20;
     static constexpr uint8_t REG_PREAMBLE_LSB = 0x21;
     static constexpr uint8_t REG_PAYLOAD_LENGTH = 0x22;
@@ -98,23 +112,25 @@ public:
     static constexpr uint8_t MODE_TX = 0x03;
     static constexpr uint8_t MODE_RX_CONTINUOUS = 0x05;
     static constexpr uint8_t MODE_RX_SINGLE = 0x06;
+    static constexpr uint8_t MODE_CAD = 0x07;
 
     // PA Config
     static constexpr uint8_t PA_BOOST = 0x80;
 
     // IRQ Flags
-    static constexpr uint8_t IRQ_CAD_DONE_MASK = 0x01;
-    static constexpr uint8_t IRQ_CAD_DETECTED_MASK = 0x02;
-    static constexpr uint8_t IRQ_RX_TIMEOUT_MASK = 0x04;
+    static constexpr uint8_t IRQ_CAD_DETECTED_MASK = 0x01;
+    static constexpr uint8_t IRQ_FHSS_CHANGE_MASK = 0x02;
+    static constexpr uint8_t IRQ_CAD_DONE_MASK = 0x04;
     static constexpr uint8_t IRQ_TX_DONE_MASK = 0x08;
     static constexpr uint8_t IRQ_VALID_HEADER_MASK = 0x10;
     static constexpr uint8_t IRQ_PAYLOAD_CRC_ERROR_MASK = 0x20;
     static constexpr uint8_t IRQ_RX_DONE_MASK = 0x40;
-    static constexpr uint8_t IRQ_TX_TIMEOUT_MASK = 0x80;
+    static constexpr uint8_t IRQ_RX_TIMEOUT_MASK = 0x80;
 
     // DIO Mapping
     static constexpr uint8_t DIO0_RX_DONE = 0x00;
     static constexpr uint8_t DIO0_TX_DONE = 0x40;
+    static constexpr uint8_t DIO0_CAD_DONE = 0x80;
     static constexpr uint8_t DIO1_RX_TIMEOUT = 0x00;
     static constexpr uint8_t DIO3_TX_DONE = 0x40; // 01 para DIO3
     static constexpr uint8_t DIO4_RX_DONE = 0x00; // 00 para DIO4
@@ -124,47 +140,50 @@ public:
     /**
      * @brief Constructor
      * 
-     * @param device_index Index of CH341 device to use (default: 0)
+     * @param spi_bus SPI bus adapter
      */
-    RFM95(int device_index = 0);
-
-    /**
-     * @brief Constructor
-     * 
-     * @param spi_interface Unique pointer to SPI interface implementation
-     */
-    RFM95(std::unique_ptr<SPIInterface> spi_interface);
+    explicit RFM95T(Bus spi_bus);
 
     /**
      * @brief Destructor
      */
-    ~RFM95();
+    ~RFM95T() override;
 
     /**
      * @brief Initialize RFM95 module
      * 
      * @return true if successful, false otherwise
      */
-    bool begin();
+    bool begin() override;
 
     /**
      * @brief Close the connection
      */
-    void end();
+    void end() override;
+
+    /**
+     * @brief Apply frequency, modulation and IQ settings
+     * 
+     * Modem configuration fields are merged at run time, so each modem
+     * register is written once.
+     * 
+     * @param profile Settings to apply
+     */
+    void applyProfile(const Profile &profile) override;
 
     /**
      * @brief Set frequency in MHz
      * 
      * @param freq_mhz Frequency in MHz
      */
-    void setFrequency(float freq_mhz);
+    void setFrequency(float freq_mhz) override;
 
     /**
      * @brief Get current frequency in MHz
      * 
      * @return Frequency in MHz
      */
-    float getFrequency();
+    float getFrequency() override;
 
     /**
      * @brief Set transmit power level
@@ -172,77 +191,77 @@ public:
      * @param level Power level in dBm (2-20 for PA_BOOST, 0-15 for RFO)
      * @param use_pa_boost Use PA_BOOST output pin
      */
-    void setTxPower(int level, bool use_pa_boost = true);
+    void setTxPower(int level, bool use_pa_boost = true) override;
 
     /**
      * @brief Get current transmit power level
      * 
      * @return Power level
      */
-    int getTxPower();
+    int getTxPower() override;
 
     /**
      * @brief Set spreading factor (6-12)
      * 
      * @param sf Spreading factor
      */
-    void setSpreadingFactor(int sf);
+    void setSpreadingFactor(int sf) override;
 
     /**
      * @brief Get current spreading factor
      * 
      * @return Spreading factor
      */
-    int getSpreadingFactor();
+    int getSpreadingFactor() override;
 
     /**
      * @brief Set bandwidth in kHz (7.8, 10.4, 15.6, 20.8, 31.25, 41.7, 62.5, 125, 250, 500)
      * 
      * @param bw_khz Bandwidth in kHz
      */
-    void setBandwidth(float bw_khz);
+    void setBandwidth(float bw_khz) override;
 
     /**
      * @brief Get current bandwidth in kHz
      * 
      * @return Bandwidth in kHz
      */
-    float getBandwidth();
+    float getBandwidth() override;
 
     /**
      * @brief Set coding rate denominator (5-8, giving rates of 4/5, 4/6, 4/7, 4/8)
      * 
      * @param denominator Coding rate denominator
      */
-    void setCodingRate(int denominator);
+    void setCodingRate(int denominator) override;
 
     /**
      * @brief Get current coding rate denominator
      * 
      * @return Coding rate denominator
      */
-    int getCodingRate();
+    int getCodingRate() override;
 
     /**
      * @brief Set preamble length (6-65535)
      * 
      * @param length Preamble length
      */
-    void setPreambleLength(int length);
+    void setPreambleLength(int length) override;
 
     /**
      * @brief Get current preamble length
      * 
      * @return Preamble length
      */
-    int getPreambleLength();
+    int getPreambleLength() override;
 
     /**
      * @brief Set IQ inversion (used for LoRaWAN downlinks)
      * 
      * @param invert True to invert IQ, False for normal operation
      */
-    void setInvertIQ(bool invert = false);
+    void setInvertIQ(bool invert = false) override;
 
     /**
      * @brief Check if IQ inversion is enabled
@@ -256,7 +275,7 @@ public:
      * 
      * @param sync_word Sync word
      */
-    void setSyncWord(uint8_t sync_word);
+    void setSyncWord(uint8_t sync_word) override;
 
     /**
      * @brief Get current sync word
@@ -271,7 +290,7 @@ public:
      * @param lna_gain LNA gain
      * @param lna_boost LNA boost
      */
-    void setLNA(int lna_gain = -1, bool lna_boost = true);
+    void setLNA(int lna_gain = -1, bool lna_boost = true) override;
 
     /**
      * @brief Get current LNA settings
@@ -379,7 +398,7 @@ public:
      * @param invert_iq True to send with inverted IQ (LoRaWAN downlinks)
      * @return True if send successful
      */
-    bool send(const std::vector<uint8_t> &data, bool invert_iq = false);
+    bool send(const std::vector<uint8_t> &data, bool invert_iq = false) override;
 
     /**
      * @brief Receive data packet
@@ -388,22 +407,55 @@ public:
      * @param invert_iq True to receive with inverted IQ
      * @return Received data or null vector if timeout or error
      */
-    std::vector<uint8_t> receive(float timeout = 5.0, bool invert_iq = false);
+    std::vector<uint8_t> receive(float timeout = 5.0, bool invert_iq = false) override;
 
     /**
      * @brief Set continuous receive mode
      */
-    void setContinuousReceive();
+    void setContinuousReceive() override;
+
+    /**
+     * @brief Set single receive mode
+     * 
+     * @param symbol_timeout RX timeout in symbols (4-1023)
+     */
+    void setSingleReceive(uint16_t symbol_timeout) override;
+
+    /**
+     * @brief Start channel activity detection (DIO0 mapped to CadDone)
+     */
+    void startCAD() override;
+
+    /**
+     * @brief Get current operating mode
+     * 
+     * @return Operating mode
+     */
+    Mode getMode() override;
+
+    /**
+     * @brief Get IRQ status (RegIrqFlags, same layout as Radio::IRQ_*)
+     * 
+     * @return IRQ flags
+     */
+    uint16_t getIrqStatus() override;
+
+    /**
+     * @brief Clear IRQ flags
+     * 
+     * @param mask Flags to clear
+     */
+    void clearIrqStatus(uint16_t mask = IRQ_ALL) override;
 
     /**
      * @brief Set standby mode
      */
-    void standbyMode();
+    void standbyMode() override;
 
     /**
      * @brief Set sleep mode
      */
-    void sleepMode();
+    void sleepMode() override;
 
     /**
      * @brief Reset RX pointer
@@ -429,21 +481,42 @@ public:
      * 
      * @return Received data
      */
-    std::vector<uint8_t> readPayload();
+    std::vector<uint8_t> readPayload() override;
 
     /**
      * @brief Get current RSSI in dBm
      * 
      * @return RSSI in dBm
      */
-    float getRSSI();
+    float getRSSI() override;
 
     /**
      * @brief Get last packet SNR in dB
      * 
      * @return SNR in dB
      */
-    float getSNR();
+    float getSNR() override;
+
+    /**
+     * @brief Get RSSI and SNR of the last packet with one burst read
+     * 
+     * @return Packet metadata
+     */
+    PacketInfo getPacketInfo() override;
+
+    /**
+     * @brief Sample the instantaneous RSSI (REG_RSSI_VALUE) on a frequency
+     * 
+     * The retune, the switch to RX and the register reads are sent as batched
+     * bus transactions, so a sample costs a few SPI bytes instead of a USB round
+     * trip on the CH341.
+     * 
+     * @param freq_mhz Frequency in MHz
+     * @param samples Receives the samples in dBm
+     * @param count Number of samples
+     * @return True if the transfers were successful
+     */
+    bool sampleRSSI(float freq_mhz, float *samples, size_t count) override;
 
     /**
      * @brief Read a register value
@@ -461,6 +534,74 @@ public:
      */
     void writeRegister(uint8_t address, uint8_t value);
 
+    /**
+     * @brief Read consecutive registers (or the FIFO) in a single burst
+     * 
+     * @param address First register address
+     * @param data Buffer receiving the values
+     * @param length Number of bytes to read
+     * @return True if the transfer was successful
+     */
+    bool readRegisters(uint8_t address, uint8_t *data, size_t length);
+
+    /**
+     * @brief Write consecutive registers (or the FIFO) in a single burst
+     * 
+     * @param address First register address
+     * @param data Values to write
+     * @param length Number of bytes to write (max 255)
+     * @return True if the transfer was successful
+     */
+    bool writeRegisters(uint8_t address, const uint8_t *data, size_t length);
+
+    /**
+     * @brief Access the SPI bus adapter
+     * 
+     * @return SPI bus adapter
+     */
+    Bus &getBus() { return bus; }
+
+    /**
+     * @brief Read a register field
+     *
+     * @tparam F Field type from SX127xRegisters.hpp
+     * @return Field value
+     */
+    template <typename F>
+    uint8_t readField()
+    {
+        return F::decode(readRegister(F::reg));
+    }
+
+    /**
+     * @brief Write a register field
+     *
+     * Fields that cover the whole register are written directly, any other
+     * field uses a read-modify-write cycle.
+     *
+     * @tparam F Field type from SX127xRegisters.hpp
+     * @param value Field value
+     */
+    template <typename F>
+    void writeField(uint8_t value)
+    {
+        applyWrite(F::write(value));
+    }
+
+    /**
+     * @brief Apply a merged sequence of register writes
+     *
+     * @param seq Sequence built with SX127x::merge()
+     */
+    template <size_t N>
+    void applySequence(const SX127x::WriteSequence<N> &seq)
+    {
+        for (size_t i = 0; i < seq.count; i++)
+        {
+            applyWrite(seq.writes[i]);
+        }
+    }
+
     /**
      * @brief Put the module in continuous receive mode
      */
@@ -523,7 +664,7 @@ public:
      * 
      * @return True if test successful
      */
-    bool testCommunication();
+    bool testCommunication() override;
 
     /**
      * @brief Read VERSION register (0x42) directly
@@ -533,7 +674,69 @@ public:
     uint8_t readVersionRegister();
 
 private:
-    std::unique_ptr<SPIInterface> spi; ///< Unique pointer to SPI interface implementation
+    /// RSSI settling time after entering RX
+    static constexpr uint16_t RSSI_SETTLE_US = 1000;
+    /// Interval between RSSI samples
+    static constexpr uint16_t RSSI_SAMPLE_US = 100;
+    /// RSSI reads per batched transaction
+    static constexpr size_t RSSI_BATCH = 32;
+
+    /**
+     * @brief Convert a frequency to the FRF register value
+     *
+     * @param freq_mhz Frequency in MHz
+     * @return 24-bit FRF value
+     */
+    static uint32_t frequencyToFrf(float freq_mhz);
+
+    /**
+     * @brief Map a bandwidth in kHz to the ModemBandwidth field value
+     *
+     * @param bw_khz Bandwidth in kHz
+     * @return Field value (0-9)
+     */
+    static uint8_t bandwidthCode(float bw_khz);
+
+    /**
+     * @brief Apply a single masked register write
+     *
+     * @param write Register write
+     */
+    void applyWrite(const SX127x::RegisterWrite &write)
+    {
+        writeRegister(write.reg, write.isFull() ? write.value : write.apply(readRegister(write.reg)));
+    }
+
+    Bus bus; ///< SPI bus adapter
 };
 
+extern template class RFM95T<SPIInterfaceBus>;
+extern template class RFM95T<CH341Bus>;
+extern template class RFM95T<LinuxSPIBus>;
+
+/**
+ * @class RFM95
+ * @brief RFM95 driver using a runtime selected SPIInterface
+ */
+class RFM95 : public RFM95T<SPIInterfaceBus>
+{
+public:
+    /**
+     * @brief Constructor
+     * 
+     * @param device_index Index of CH341 device to use (default: 0)
+     */
+    RFM95(int device_index = 0);
+
+    /**
+     * @brief Constructor
+     * 
+     * @param spi_interface Unique pointer to SPI interface implementation
+     */
+    RFM95(std::unique_ptr<SPIInterface> spi_interface);
+};
+
+using RFM95CH341 = RFM95T<CH341Bus>;     ///< RFM95 bound to the CH341 adapter
+using RFM95LinuxSPI = RFM95T<LinuxSPIBus>; ///< RFM95 bound to Linux spidev
+
 #endif // RFM95_HPP
\ No newline at end of file
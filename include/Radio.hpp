@@ -0,0 +1,233 @@
+/**
+ * @file Radio.hpp
+ * @brief Abstract LoRa radio used by the LoRaWAN MAC layer
+ *
+ * The MAC layer only talks to this interface, so the same stack runs on the
+ * register based SX127x family (RFM95) and on the command based SX126x family.
+ * IRQ status bits follow the SX127x RegIrqFlags layout; drivers for other chips
+ * translate their own flags to it.
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @class Radio
+ * @brief Interface implemented by every LoRa radio driver
+ */
+class Radio
+{
+public:
+    // IRQ status bits
+    static constexpr uint16_t IRQ_CAD_DETECTED = 0x0001;
+    static constexpr uint16_t IRQ_CAD_DONE = 0x0004;
+    static constexpr uint16_t IRQ_TX_DONE = 0x0008;
+    static constexpr uint16_t IRQ_VALID_HEADER = 0x0010;
+    static constexpr uint16_t IRQ_CRC_ERROR = 0x0020;
+    static constexpr uint16_t IRQ_RX_DONE = 0x0040;
+    static constexpr uint16_t IRQ_RX_TIMEOUT = 0x0080;
+    static constexpr uint16_t IRQ_ALL = 0xFFFF;
+
+    /**
+     * @brief Radio operating mode
+     */
+    enum class Mode
+    {
+        SLEEP,
+        STANDBY,
+        TX,
+        RX_CONTINUOUS,
+        RX_SINGLE,
+        CAD,
+        OTHER
+    };
+
+    /**
+     * @brief LoRa channel and modulation settings applied as a whole
+     */
+    struct Profile
+    {
+        float frequency = 868.1f;  ///< Frequency in MHz
+        int spreading_factor = 7;  ///< Spreading factor (6-12)
+        float bandwidth = 125.0f;  ///< Bandwidth in kHz
+        int coding_rate = 5;       ///< Coding rate denominator (5-8)
+        int preamble_length = 8;   ///< Preamble length in symbols
+        bool invert_iq = false;    ///< IQ inversion (LoRaWAN downlinks)
+    };
+
+    /**
+     * @brief Metadata of the last received packet
+     */
+    struct PacketInfo
+    {
+        float rssi = 0.0f; ///< Packet RSSI in dBm
+        float snr = 0.0f;  ///< Packet SNR in dB
+    };
+
+    virtual ~Radio() = default;
+
+    /**
+     * @brief Initialize the radio
+     *
+     * @return true if successful, false otherwise
+     */
+    virtual bool begin() = 0;
+
+    /**
+     * @brief Close the connection
+     */
+    virtual void end() = 0;
+
+    /**
+     * @brief Test basic SPI communication
+     *
+     * @return True if test successful
+     */
+    virtual bool testCommunication() = 0;
+
+    /**
+     * @brief Apply frequency, modulation and IQ settings in one go
+     *
+     * Drivers override this to group the writes into as few bus transactions as
+     * the chip allows. The default implementation calls the individual setters.
+     *
+     * @param profile Settings to apply
+     */
+    virtual void applyProfile(const Profile &profile)
+    {
+        setFrequency(profile.frequency);
+        setSpreadingFactor(profile.spreading_factor);
+        setBandwidth(profile.bandwidth);
+        setCodingRate(profile.coding_rate);
+        setPreambleLength(profile.preamble_length);
+        setInvertIQ(profile.invert_iq);
+    }
+
+    virtual void setFrequency(float freq_mhz) = 0;
+    virtual float getFrequency() = 0;
+    virtual void setTxPower(int level, bool use_pa_boost = true) = 0;
+    virtual int getTxPower() = 0;
+    virtual void setSpreadingFactor(int sf) = 0;
+    virtual int getSpreadingFactor() = 0;
+    virtual void setBandwidth(float bw_khz) = 0;
+    virtual float getBandwidth() = 0;
+    virtual void setCodingRate(int denominator) = 0;
+    virtual int getCodingRate() = 0;
+    virtual void setPreambleLength(int length) = 0;
+    virtual int getPreambleLength() = 0;
+    virtual void setInvertIQ(bool invert = false) = 0;
+    virtual void setSyncWord(uint8_t sync_word) = 0;
+    virtual void setLNA(int lna_gain = -1, bool lna_boost = true) = 0;
+
+    /**
+     * @brief Send data packet and wait for TX done
+     *
+     * @param data Data to send (max 255 bytes)
+     * @param invert_iq True to send with inverted IQ
+     * @return True if send successful
+     */
+    virtual bool send(const std::vector<uint8_t> &data, bool invert_iq = false) = 0;
+
+    /**
+     * @brief Receive a data packet, blocking
+     *
+     * @param timeout Maximum time to wait for packet in seconds
+     * @param invert_iq True to receive with inverted IQ
+     * @return Received data or empty vector if timeout or error
+     */
+    virtual std::vector<uint8_t> receive(float timeout = 5.0, bool invert_iq = false) = 0;
+
+    /**
+     * @brief Start continuous reception
+     */
+    virtual void setContinuousReceive() = 0;
+
+    /**
+     * @brief Start single reception
+     *
+     * The radio raises IRQ_RX_TIMEOUT and returns to standby if no preamble is
+     * detected within the given number of symbols.
+     *
+     * @param symbol_timeout Timeout in symbols
+     */
+    virtual void setSingleReceive(uint16_t symbol_timeout) = 0;
+
+    /**
+     * @brief Start channel activity detection
+     *
+     * Completion is reported by IRQ_CAD_DONE, activity by IRQ_CAD_DETECTED.
+     */
+    virtual void startCAD() = 0;
+
+    virtual void standbyMode() = 0;
+    virtual void sleepMode() = 0;
+
+    /**
+     * @brief Get current operating mode
+     *
+     * @return Operating mode
+     */
+    virtual Mode getMode() = 0;
+
+    /**
+     * @brief Get IRQ status
+     *
+     * @return IRQ_* bits
+     */
+    virtual uint16_t getIrqStatus() = 0;
+
+    /**
+     * @brief Clear IRQ status bits
+     *
+     * @param mask IRQ_* bits to clear
+     */
+    virtual void clearIrqStatus(uint16_t mask = IRQ_ALL) = 0;
+
+    /**
+     * @brief Read the last received packet
+     *
+     * @return Received data
+     */
+    virtual std::vector<uint8_t> readPayload() = 0;
+
+    virtual float getRSSI() = 0;
+    virtual float getSNR() = 0;
+
+    /**
+     * @brief Sample the instantaneous channel RSSI on a frequency
+     *
+     * Tunes to the frequency, starts reception and takes the samples in as few
+     * bus transactions as the chip allows. The radio is left receiving on that
+     * frequency, so the caller re-applies its profile afterwards.
+     *
+     * @param freq_mhz Frequency in MHz
+     * @param samples Receives the samples in dBm
+     * @param count Number of samples
+     * @return False if unsupported or on bus error
+     */
+    virtual bool sampleRSSI(float freq_mhz, float *samples, size_t count)
+    {
+        (void)freq_mhz;
+        (void)samples;
+        (void)count;
+        return false;
+    }
+
+    /**
+     * @brief Get RSSI and SNR of the last received packet
+     *
+     * @return Packet metadata
+     */
+    virtual PacketInfo getPacketInfo()
+    {
+        PacketInfo info;
+        info.rssi = getRSSI();
+        info.snr = getSNR();
+        return info;
+    }
+};
@@ -0,0 +1,121 @@
+/**
+ * @file RealTime.hpp
+ * @brief Real-time scheduling for the timing-critical threads
+ *
+ * RX1 opens RECEIVE_DELAY1 after TxDone with no slack for a thread that was
+ * preempted. In real-time mode the threads that drive the radio (the MAC
+ * loop, the SPI interrupt threads) run under SCHED_FIFO, optionally pinned to
+ * one CPU, and the process memory is locked so that a page fault cannot
+ * delay them either.
+ *
+ * Threads inherit the policy of the thread that creates them, so the MAC
+ * thread enters real-time mode after it has started the background threads
+ * (logger, capture, I/O executor), which stay under the normal scheduler.
+ *
+ * LatencyStats measures how late the deadlines of a thread are met, so the
+ * effect of the settings can be checked on the target under load.
+ *
+ * Linux only; elsewhere configure() fails and nothing changes.
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @class RealTime
+ * @brief Process-wide real-time settings
+ */
+class RealTime {
+public:
+    /// Real-time settings, see the "realtime" section of config.json
+    struct Settings {
+        bool enabled = false;
+        int priority = 80;                    ///< SCHED_FIFO priority (1-99)
+        int cpu = -1;                         ///< CPU the threads are pinned to, -1 for any
+        bool lock_memory = true;              ///< mlockall() current and future memory
+        size_t prefault_stack = 256 * 1024;   ///< Stack bytes touched by each real-time thread
+    };
+
+    /**
+     * @brief Apply the process-wide settings
+     *
+     * Locks the memory and stops malloc from returning it to the kernel.
+     * Threads are switched later, by enterThread().
+     *
+     * @param settings Settings
+     * @return True if successful or not enabled
+     */
+    static bool configure(const Settings& settings);
+
+    /**
+     * @brief Run the calling thread under the real-time settings
+     *
+     * Sets SCHED_FIFO and the CPU affinity and pre-faults the stack. Does
+     * nothing unless configure() enabled real-time mode.
+     *
+     * @param name Thread name shown by ps and top (15 characters)
+     * @return True if successful or not enabled
+     */
+    static bool enterThread(const char* name);
+
+    /**
+     * @brief Check if real-time mode is enabled
+     */
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+private:
+    static std::atomic<bool> enabled;
+    static Settings current;
+};
+
+/**
+ * @class LatencyStats
+ * @brief Lateness of deadlines: count, mean, 99th percentile and maximum
+ *
+ * One thread records, any thread can read a summary. The percentile comes
+ * from a power-of-two histogram in microseconds, so it is an upper bound
+ * within a factor of two.
+ */
+class LatencyStats {
+public:
+    /// Summary in microseconds
+    struct Summary {
+        uint64_t count = 0;
+        uint64_t mean_us = 0;
+        uint64_t p99_us = 0;
+        uint64_t max_us = 0;
+    };
+
+    /**
+     * @brief Record how late a deadline was met
+     *
+     * @param due Time the thread should have run
+     * @param now Time it ran
+     */
+    void record(std::chrono::steady_clock::time_point due,
+                std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+
+    /**
+     * @brief Lateness since the last reset
+     */
+    Summary summary() const;
+
+    /**
+     * @brief Start a new measurement period
+     */
+    void reset();
+
+private:
+    static constexpr int BUCKETS = 32; ///< Bucket i: lateness below 2^i us
+
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> total_us{0};
+    std::atomic<uint64_t> max_us{0};
+    std::atomic<uint64_t> histogram[BUCKETS] = {};
+};
@@ -0,0 +1,108 @@
+/**
+ * @file SPIBus.hpp
+ * @brief Bus adapters used to instantiate the radio drivers at compile time
+ *
+ * A bus is any type providing open(), close(),
+ * transfer(write_data, write_length, read_data, read_length),
+ * transferBatch(segments, count) and the digitalRead(), digitalWrite() and
+ * pinMode() GPIO calls. Radio drivers are
+ * templates over the bus type, so builds that know their backend can bind the
+ * driver to a concrete SPI implementation and avoid the virtual dispatch and the
+ * temporary vectors of the SPIInterface path.
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+#pragma once
+
+#include "SPIInterface.hpp"
+#include "CH341SPI.hpp"
+#include "LinuxSPI.hpp"
+#include <memory>
+
+/**
+ * @class SPIInterfaceBus
+ * @brief Bus adapter dispatching through the virtual SPIInterface
+ *
+ * Used when the SPI backend is selected at runtime.
+ */
+class SPIInterfaceBus {
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param spi_interface SPI interface implementation
+     */
+    explicit SPIInterfaceBus(std::unique_ptr<SPIInterface> spi_interface)
+        : spi(std::move(spi_interface)) {}
+
+    bool open() { return spi->open(); }
+    void close() { spi->close(); }
+
+    bool transfer(const uint8_t* write_data, size_t write_length, uint8_t* read_data, size_t read_length) {
+        return spi->transfer(write_data, write_length, read_data, read_length);
+    }
+
+    bool transferBatch(const SPISegment* segments, size_t count) {
+        return spi->transferBatch(segments, count);
+    }
+
+    bool digitalRead(uint8_t pin) { return spi->digitalRead(pin); }
+    bool digitalWrite(uint8_t pin, bool value) { return spi->digitalWrite(pin, value); }
+    bool pinMode(uint8_t pin, uint8_t mode) { return spi->pinMode(pin, mode); }
+
+    /**
+     * @brief Access the underlying SPI interface
+     */
+    SPIInterface& device() { return *spi; }
+
+private:
+    std::unique_ptr<SPIInterface> spi; ///< SPI interface implementation
+};
+
+/**
+ * @class DirectSPIBus
+ * @brief Bus adapter bound to a concrete SPI implementation
+ *
+ * Calls are qualified with the concrete type, so they are resolved at compile
+ * time and inline wherever the implementation is visible.
+ *
+ * @tparam Device Concrete SPIInterface implementation
+ */
+template <typename Device>
+class DirectSPIBus {
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param spi_device Concrete SPI implementation
+     */
+    explicit DirectSPIBus(std::unique_ptr<Device> spi_device)
+        : spi(std::move(spi_device)) {}
+
+    bool open() { return spi->Device::open(); }
+    void close() { spi->Device::close(); }
+
+    bool transfer(const uint8_t* write_data, size_t write_length, uint8_t* read_data, size_t read_length) {
+        return spi->Device::transfer(write_data, write_length, read_data, read_length);
+    }
+
+    bool transferBatch(const SPISegment* segments, size_t count) {
+        return spi->Device::transferBatch(segments, count);
+    }
+
+    bool digitalRead(uint8_t pin) { return spi->Device::digitalRead(pin); }
+    bool digitalWrite(uint8_t pin, bool value) { return spi->Device::digitalWrite(pin, value); }
+    bool pinMode(uint8_t pin, uint8_t mode) { return spi->Device::pinMode(pin, mode); }
+
+    /**
+     * @brief Access the underlying SPI implementation
+     */
+    Device& device() { return *spi; }
+
+private:
+    std::unique_ptr<Device> spi; ///< Concrete SPI implementation
+};
+
+using CH341Bus = DirectSPIBus<CH341SPI>;
+using LinuxSPIBus = DirectSPIBus<LinuxSPI>;
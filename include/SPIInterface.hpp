@@ -11,6 +11,24 @@
 #include <memory>
 #include <functional>
 #include <string>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+/**
+ * @brief One chip select assertion within a batched SPI transaction
+ *
+ * The write bytes are clocked out first and then read_length bytes are clocked
+ * in, as for SPIInterface::transfer(). Chip select is released at the end of the
+ * segment and stays released for delay_us before the next segment starts.
+ */
+struct SPISegment {
+    const uint8_t* write_data; ///< Bytes to write
+    size_t write_length;       ///< Number of bytes to write
+    uint8_t* read_data;        ///< Buffer receiving the bytes read after the written ones
+    size_t read_length;        ///< Number of bytes to read
+    uint16_t delay_us;         ///< Guard time after the segment, in microseconds
+};
 
 /**
  * @brief   Abstract interface for SPI communication
@@ -51,6 +69,49 @@ public:
      * @return A vector containing the data read from the SPI device.
      */
     virtual std::vector<uint8_t> transfer(const std::vector<uint8_t>& write_data, size_t read_length = 0) = 0;
+
+    /***
+     * Transfers data over SPI using caller provided buffers.
+     * The write bytes are clocked out first and then read_length bytes are clocked
+     * in, all within a single chip select assertion. No memory is allocated by
+     * implementations that override this method.
+     * The default implementation forwards to the vector based transfer().
+     * @param write_data The data to write to the SPI device.
+     * @param write_length The number of bytes to write.
+     * @param read_data Buffer receiving the data read from the SPI device.
+     * @param read_length The number of bytes to read from the SPI device.
+     * @return True if the transfer was successful, false otherwise.
+     */
+    virtual bool transfer(const uint8_t* write_data, size_t write_length, uint8_t* read_data, size_t read_length) {
+        std::vector<uint8_t> response = transfer(std::vector<uint8_t>(write_data, write_data + write_length), read_length);
+        if (response.size() < read_length) {
+            return false;
+        }
+        std::copy(response.begin(), response.begin() + read_length, read_data);
+        return true;
+    }
+
+    /***
+     * Transfers several segments, each within its own chip select assertion.
+     * Implementations submit the whole batch in as few bus transactions as the
+     * hardware allows. The default implementation issues one transfer() per
+     * segment and sleeps for the requested guard times.
+     * @param segments The segments to transfer, in order.
+     * @param count The number of segments.
+     * @return True if every segment was transferred, false otherwise.
+     */
+    virtual bool transferBatch(const SPISegment* segments, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            const SPISegment& segment = segments[i];
+            if (!transfer(segment.write_data, segment.write_length, segment.read_data, segment.read_length)) {
+                return false;
+            }
+            if (segment.delay_us > 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(segment.delay_us));
+            }
+        }
+        return true;
+    }
     
     /***
      * Writes a digital value to a specified pin.
@@ -0,0 +1,396 @@
+/**
+ * @file SX126x.hpp
+ * @brief Driver for SX1261/SX1262 LoRa transceivers
+ *
+ * The SX126x family is configured with opcodes instead of registers, and the
+ * chip signals on its BUSY pin while it processes a command. Configuration that
+ * spans several commands is queued in a CommandBatch and submitted as a single
+ * batched SPI transaction, with a short guard time between commands instead of
+ * polling BUSY after each one.
+ *
+ * The chip cannot report most of its configuration back, so the driver keeps
+ * the last applied settings and the getters return those.
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+#pragma once
+
+#include "Radio.hpp"
+#include "SPIInterface.hpp"
+#include "SPIBus.hpp"
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+/**
+ * @class SX126xT
+ * @brief SX126x LoRa driver over a given SPI bus
+ *
+ * Explicitly instantiated for SPIInterfaceBus, CH341Bus and LinuxSPIBus in
+ * SX126x.cpp.
+ *
+ * @tparam Bus SPI bus adapter type (see SPIBus.hpp)
+ */
+template <typename Bus>
+class SX126xT : public Radio
+{
+public:
+    // SX126x Opcodes
+    static constexpr uint8_t CMD_SET_SLEEP = 0x84;
+    static constexpr uint8_t CMD_SET_STANDBY = 0x80;
+    static constexpr uint8_t CMD_SET_TX = 0x83;
+    static constexpr uint8_t CMD_SET_RX = 0x82;
+    static constexpr uint8_t CMD_SET_CAD = 0xC5;
+    static constexpr uint8_t CMD_SET_REGULATOR_MODE = 0x96;
+    static constexpr uint8_t CMD_CALIBRATE = 0x89;
+    static constexpr uint8_t CMD_CALIBRATE_IMAGE = 0x98;
+    static constexpr uint8_t CMD_SET_PA_CONFIG = 0x95;
+    static constexpr uint8_t CMD_WRITE_REGISTER = 0x0D;
+    static constexpr uint8_t CMD_READ_REGISTER = 0x1D;
+    static constexpr uint8_t CMD_WRITE_BUFFER = 0x0E;
+    static constexpr uint8_t CMD_READ_BUFFER = 0x1E;
+    static constexpr uint8_t CMD_SET_DIO_IRQ_PARAMS = 0x08;
+    static constexpr uint8_t CMD_GET_IRQ_STATUS = 0x12;
+    static constexpr uint8_t CMD_CLEAR_IRQ_STATUS = 0x02;
+    static constexpr uint8_t CMD_SET_DIO2_AS_RF_SWITCH_CTRL = 0x9D;
+    static constexpr uint8_t CMD_SET_DIO3_AS_TCXO_CTRL = 0x97;
+    static constexpr uint8_t CMD_SET_RF_FREQUENCY = 0x86;
+    static constexpr uint8_t CMD_SET_PACKET_TYPE = 0x8A;
+    static constexpr uint8_t CMD_SET_TX_PARAMS = 0x8E;
+    static constexpr uint8_t CMD_SET_MODULATION_PARAMS = 0x8B;
+    static constexpr uint8_t CMD_SET_PACKET_PARAMS = 0x8C;
+    static constexpr uint8_t CMD_SET_CAD_PARAMS = 0x88;
+    static constexpr uint8_t CMD_SET_BUFFER_BASE_ADDRESS = 0x8F;
+    static constexpr uint8_t CMD_SET_LORA_SYMB_NUM_TIMEOUT = 0xA0;
+    static constexpr uint8_t CMD_GET_STATUS = 0xC0;
+    static constexpr uint8_t CMD_GET_RX_BUFFER_STATUS = 0x13;
+    static constexpr uint8_t CMD_GET_PACKET_STATUS = 0x14;
+    static constexpr uint8_t CMD_GET_RSSI_INST = 0x15;
+    static constexpr uint8_t CMD_CLEAR_DEVICE_ERRORS = 0x07;
+
+    // SX126x Registers
+    static constexpr uint16_t REG_IQ_POLARITY = 0x0736;
+    static constexpr uint16_t REG_SYNC_WORD = 0x0740;
+    static constexpr uint16_t REG_RX_GAIN = 0x08AC;
+    static constexpr uint16_t REG_OCP = 0x08E7;
+
+    // IRQ Flags
+    static constexpr uint16_t IRQ_TX_DONE_MASK = 0x0001;
+    static constexpr uint16_t IRQ_RX_DONE_MASK = 0x0002;
+    static constexpr uint16_t IRQ_PREAMBLE_DETECTED_MASK = 0x0004;
+    static constexpr uint16_t IRQ_HEADER_VALID_MASK = 0x0010;
+    static constexpr uint16_t IRQ_HEADER_ERROR_MASK = 0x0020;
+    static constexpr uint16_t IRQ_CRC_ERROR_MASK = 0x0040;
+    static constexpr uint16_t IRQ_CAD_DONE_MASK = 0x0080;
+    static constexpr uint16_t IRQ_CAD_DETECTED_MASK = 0x0100;
+    static constexpr uint16_t IRQ_TIMEOUT_MASK = 0x0200;
+
+    // Chip modes reported by GetStatus
+    static constexpr uint8_t CHIP_MODE_STDBY_RC = 0x02;
+    static constexpr uint8_t CHIP_MODE_STDBY_XOSC = 0x03;
+    static constexpr uint8_t CHIP_MODE_FS = 0x04;
+    static constexpr uint8_t CHIP_MODE_RX = 0x05;
+    static constexpr uint8_t CHIP_MODE_TX = 0x06;
+
+    /**
+     * @brief Constructor
+     *
+     * @param spi_bus SPI bus adapter
+     * @param busy_pin GPIO connected to BUSY, -1 to rely on fixed delays
+     * @param reset_pin GPIO connected to NRESET, -1 if not wired
+     */
+    explicit SX126xT(Bus spi_bus, int busy_pin = -1, int reset_pin = -1);
+
+    /**
+     * @brief Destructor
+     */
+    ~SX126xT() override;
+
+    /**
+     * @brief Use DIO2 to drive the antenna switch (applied by begin())
+     *
+     * @param enable True if the module's RF switch is wired to DIO2
+     */
+    void setDio2AsRfSwitch(bool enable) { dio2_rf_switch = enable; }
+
+    /**
+     * @brief Power a TCXO from DIO3 (applied by begin())
+     *
+     * @param voltage TCXO supply voltage in volts (1.6-3.3), 0 for a crystal
+     */
+    void setTcxoVoltage(float voltage) { tcxo_voltage = voltage; }
+
+    bool begin() override;
+    void end() override;
+    bool testCommunication() override;
+
+    /**
+     * @brief Apply frequency, modulation and IQ settings
+     *
+     * The radio is put in standby and the settings are sent as one batch.
+     *
+     * @param new_profile Settings to apply
+     */
+    void applyProfile(const Profile &new_profile) override;
+
+    void setFrequency(float freq_mhz) override;
+    float getFrequency() override;
+
+    /**
+     * @brief Set transmit power level
+     *
+     * @param level Power level in dBm (-9 to 22)
+     * @param use_pa_boost Ignored, the SX1262 has a single high power PA
+     */
+    void setTxPower(int level, bool use_pa_boost = true) override;
+    int getTxPower() override;
+
+    void setSpreadingFactor(int sf) override;
+    int getSpreadingFactor() override;
+    void setBandwidth(float bw_khz) override;
+    float getBandwidth() override;
+    void setCodingRate(int denominator) override;
+    int getCodingRate() override;
+    void setPreambleLength(int length) override;
+    int getPreambleLength() override;
+    void setInvertIQ(bool invert = false) override;
+    void setSyncWord(uint8_t sync_word) override;
+
+    /**
+     * @brief Select boosted or power saving RX gain
+     *
+     * @param lna_gain Ignored, gain is always automatic
+     * @param lna_boost True for boosted gain
+     */
+    void setLNA(int lna_gain = -1, bool lna_boost = true) override;
+
+    bool send(const std::vector<uint8_t> &data, bool invert_iq = false) override;
+    std::vector<uint8_t> receive(float timeout = 5.0, bool invert_iq = false) override;
+    void setContinuousReceive() override;
+
+    /**
+     * @brief Set single receive mode
+     *
+     * @param symbol_timeout RX timeout in symbols (max 255)
+     */
+    void setSingleReceive(uint16_t symbol_timeout) override;
+    void startCAD() override;
+    void standbyMode() override;
+
+    /**
+     * @brief Enter sleep mode with warm start (configuration retained)
+     */
+    void sleepMode() override;
+    Mode getMode() override;
+    uint16_t getIrqStatus() override;
+    void clearIrqStatus(uint16_t mask = IRQ_ALL) override;
+    std::vector<uint8_t> readPayload() override;
+    float getRSSI() override;
+    float getSNR() override;
+
+    /**
+     * @brief Get RSSI and SNR of the last packet with one GetPacketStatus
+     *
+     * @return Packet metadata
+     */
+    PacketInfo getPacketInfo() override;
+
+    /**
+     * @brief Sample GetRssiInst on a frequency
+     *
+     * The retune and RX start go out as one command batch and the GetRssiInst
+     * reads as another.
+     *
+     * @param freq_mhz Frequency in MHz
+     * @param samples Receives the samples in dBm
+     * @param count Number of samples
+     * @return True if the transfers were successful
+     */
+    bool sampleRSSI(float freq_mhz, float *samples, size_t count) override;
+
+    /**
+     * @brief Read the status byte
+     *
+     * @return Status (chip mode in bits 6-4, command status in bits 3-1)
+     */
+    uint8_t getStatus();
+
+    /**
+     * @brief Send a command without response
+     *
+     * @param opcode Command opcode
+     * @param params Command parameters
+     * @return True if the transfer was successful
+     */
+    bool command(uint8_t opcode, std::initializer_list<uint8_t> params = {});
+
+    /**
+     * @brief Send a command and read its response
+     *
+     * The status byte clocked out before the response is discarded.
+     *
+     * @param opcode Command opcode
+     * @param params Command parameters
+     * @param data Buffer receiving the response
+     * @param length Response length (max 255)
+     * @return True if the transfer was successful
+     */
+    bool readCommand(uint8_t opcode, std::initializer_list<uint8_t> params, uint8_t *data, size_t length);
+
+    /**
+     * @brief Write consecutive registers
+     *
+     * @param address First register address
+     * @param data Values to write
+     * @param length Number of bytes to write
+     * @return True if the transfer was successful
+     */
+    bool writeRegisters(uint16_t address, const uint8_t *data, size_t length);
+
+    /**
+     * @brief Read consecutive registers
+     *
+     * @param address First register address
+     * @param data Buffer receiving the values
+     * @param length Number of bytes to read (max 255)
+     * @return True if the transfer was successful
+     */
+    bool readRegisters(uint16_t address, uint8_t *data, size_t length);
+
+    /**
+     * @brief Access the SPI bus adapter
+     *
+     * @return SPI bus adapter
+     */
+    Bus &getBus() { return bus; }
+
+private:
+    /// Guard time between batched commands, covers the BUSY period of
+    /// configuration commands
+    static constexpr uint16_t COMMAND_GUARD_US = 30;
+
+    /// Maximum time to wait for BUSY to drop
+    static constexpr int BUSY_TIMEOUT_MS = 100;
+
+    /// RSSI settling time after entering RX
+    static constexpr int RSSI_SETTLE_US = 1000;
+
+    /// Interval between RSSI samples
+    static constexpr uint16_t RSSI_SAMPLE_US = 100;
+
+    /// GetRssiInst reads per batched transaction
+    static constexpr size_t RSSI_BATCH = 32;
+
+    /**
+     * @class CommandBatch
+     * @brief Commands submitted together in one batched SPI transaction
+     */
+    class CommandBatch
+    {
+    public:
+        /**
+         * @brief Queue a command
+         *
+         * @param opcode Command opcode
+         * @param params Command parameters
+         * @param payload Optional data appended after the parameters
+         * @param payload_length Length of the optional data
+         */
+        void add(uint8_t opcode, std::initializer_list<uint8_t> params,
+                 const uint8_t *payload = nullptr, size_t payload_length = 0);
+
+        const SPISegment *segments() const { return segment_list.data(); }
+        size_t size() const { return count; }
+        bool overflow() const { return overflowed; }
+
+    private:
+        std::array<uint8_t, 512> buffer;
+        std::array<SPISegment, 16> segment_list;
+        size_t used = 0;
+        size_t count = 0;
+        bool overflowed = false;
+    };
+
+    /**
+     * @brief Submit a command batch once the chip is ready
+     *
+     * @param batch Queued commands
+     * @return True if the transfer was successful
+     */
+    bool runBatch(const CommandBatch &batch);
+
+    /**
+     * @brief Single chip select transaction once the chip is ready
+     */
+    bool transact(const uint8_t *write_data, size_t write_length, uint8_t *read_data, size_t read_length);
+
+    /**
+     * @brief Wait until BUSY is low
+     *
+     * @param settle_ms Fixed wait used when BUSY is not wired
+     * @return False on timeout
+     */
+    bool waitBusy(int settle_ms = 1);
+
+    /**
+     * @brief Wake the chip from sleep with a chip select pulse
+     */
+    void wakeup();
+
+    /**
+     * @brief Run image calibration when the frequency band changes
+     *
+     * @param freq_mhz Target frequency in MHz
+     */
+    void calibrateImage(float freq_mhz);
+
+    void addRfFrequency(CommandBatch &batch);
+    void addModulationParams(CommandBatch &batch);
+    void addPacketParams(CommandBatch &batch, uint8_t payload_length, bool invert_iq);
+    void addIqPolarity(CommandBatch &batch, bool invert_iq);
+    void addRxSetup(CommandBatch &batch);
+
+    static uint8_t bandwidthCode(float bw_khz);
+    static uint16_t toRadioIrq(uint16_t flags);
+    static uint16_t toChipIrq(uint16_t flags);
+
+    Bus bus;                     ///< SPI bus adapter
+    int busy_pin;                ///< BUSY GPIO, -1 if not wired
+    int reset_pin;               ///< NRESET GPIO, -1 if not wired
+    bool dio2_rf_switch = true;  ///< DIO2 drives the RF switch
+    float tcxo_voltage = 0.0f;   ///< TCXO supply voltage, 0 for a crystal
+
+    Profile profile;             ///< Last applied settings
+    int tx_power = 14;           ///< Last applied TX power in dBm
+    uint8_t sync_word = 0x12;    ///< Last applied sync word
+    uint8_t iq_register = 0x0D;  ///< Value of REG_IQ_POLARITY read at begin()
+    uint8_t image_band = 0;      ///< First byte of the last image calibration, 0 if none
+    Mode mode = Mode::SLEEP;     ///< Last requested mode
+};
+
+extern template class SX126xT<SPIInterfaceBus>;
+extern template class SX126xT<CH341Bus>;
+extern template class SX126xT<LinuxSPIBus>;
+
+/**
+ * @class SX126x
+ * @brief SX126x driver using a runtime selected SPIInterface
+ */
+class SX126x : public SX126xT<SPIInterfaceBus>
+{
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param spi_interface Unique pointer to SPI interface implementation
+     * @param busy_pin GPIO connected to BUSY, -1 to rely on fixed delays
+     * @param reset_pin GPIO connected to NRESET, -1 if not wired
+     */
+    SX126x(std::unique_ptr<SPIInterface> spi_interface, int busy_pin = -1, int reset_pin = -1);
+};
+
+using SX126xCH341 = SX126xT<CH341Bus>;       ///< SX126x bound to the CH341 adapter
+using SX126xLinuxSPI = SX126xT<LinuxSPIBus>; ///< SX126x bound to Linux spidev
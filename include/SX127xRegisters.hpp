@@ -0,0 +1,229 @@
+/**
+ * @file SX127xRegisters.hpp
+ * @brief Compile-time register/field description of the SX127x (RFM95) LoRa modem
+ *
+ * Each bit field of the SX127x register map is described by a Field type that
+ * carries its register address, position, width and volatility. Field writes
+ * can be merged at compile time so that several fields living in the same
+ * register collapse into a single register write, and registers whose bits are
+ * fully covered do not need a read-modify-write cycle at all.
+ *
+ * Example:
+ * @code
+ * // Folded by the compiler into {0x1D, mask 0xFF, value 0x72}
+ * constexpr auto cfg = SX127x::merge(SX127x::ModemBandwidth::write(7),
+ *                                    SX127x::ModemCodingRate::write(1),
+ *                                    SX127x::ModemImplicitHeader::write(0));
+ * rfm.applySequence(cfg);
+ * @endcode
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+
+#ifndef SX127X_REGISTERS_HPP
+#define SX127X_REGISTERS_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+
+namespace SX127x
+{
+    /**
+     * @brief Whether a field may change without the host writing it
+     *
+     * Static fields only change when written by the host, so their last written
+     * value can be cached. Volatile fields (IRQ flags, mode transitions done by
+     * the modem itself, RSSI, FIFO pointers) must always be read from the chip.
+     */
+    enum class Volatility
+    {
+        Static,
+        Volatile
+    };
+
+    /**
+     * @brief A single masked write to one register
+     */
+    struct RegisterWrite
+    {
+        uint8_t reg;   ///< Register address
+        uint8_t mask;  ///< Bits affected by the write
+        uint8_t value; ///< New value of the affected bits (already shifted)
+
+        /**
+         * @brief Check if the write covers the whole register
+         *
+         * @return True if no read-modify-write is needed
+         */
+        constexpr bool isFull() const { return mask == 0xFF; }
+
+        /**
+         * @brief Merge the write into a current register value
+         *
+         * @param current Current register value
+         * @return New register value
+         */
+        constexpr uint8_t apply(uint8_t current) const
+        {
+            return static_cast<uint8_t>((current & ~mask) | (value & mask));
+        }
+    };
+
+    /**
+     * @brief Description of a bit field inside an 8-bit register
+     *
+     * @tparam Reg Register address
+     * @tparam Shift Position of the least significant bit of the field
+     * @tparam Width Number of bits of the field
+     * @tparam V Volatility of the field
+     */
+    template <uint8_t Reg, uint8_t Shift, uint8_t Width, Volatility V = Volatility::Static>
+    struct Field
+    {
+        static_assert(Width >= 1 && Shift + Width <= 8, "Field must fit in an 8-bit register");
+
+        static constexpr uint8_t reg = Reg;
+        static constexpr uint8_t shift = Shift;
+        static constexpr uint8_t width = Width;
+        static constexpr Volatility volatility = V;
+        static constexpr uint8_t mask = static_cast<uint8_t>(((1u << Width) - 1u) << Shift);
+        static constexpr uint8_t max = static_cast<uint8_t>((1u << Width) - 1u);
+
+        /**
+         * @brief Place a field value at its position in the register
+         */
+        static constexpr uint8_t encode(uint8_t value)
+        {
+            return static_cast<uint8_t>((value << Shift) & mask);
+        }
+
+        /**
+         * @brief Extract the field value from a register value
+         */
+        static constexpr uint8_t decode(uint8_t reg_value)
+        {
+            return static_cast<uint8_t>((reg_value & mask) >> Shift);
+        }
+
+        /**
+         * @brief Replace the field inside a register value
+         */
+        static constexpr uint8_t apply(uint8_t reg_value, uint8_t value)
+        {
+            return static_cast<uint8_t>((reg_value & ~mask) | encode(value));
+        }
+
+        /**
+         * @brief Describe a write of this field
+         */
+        static constexpr RegisterWrite write(uint8_t value)
+        {
+            return RegisterWrite{Reg, mask, encode(value)};
+        }
+    };
+
+    /**
+     * @brief Ordered list of merged register writes
+     *
+     * @tparam N Maximum number of registers (number of field writes merged)
+     */
+    template <size_t N>
+    struct WriteSequence
+    {
+        std::array<RegisterWrite, N> writes{}; ///< Merged writes, one per register
+        size_t count = 0;                      ///< Number of valid entries in writes
+    };
+
+    /**
+     * @brief Merge field writes into the minimal list of register writes
+     *
+     * Writes to the same register are combined into a single entry, keeping the
+     * order in which registers first appear. Later writes to the same field win.
+     * When evaluated in a constant expression the whole sequence is folded at
+     * compile time.
+     *
+     * @param writes Field writes, typically produced by Field::write()
+     * @return Sequence with one entry per distinct register
+     */
+    template <typename... Writes>
+    constexpr WriteSequence<sizeof...(Writes)> merge(Writes... writes)
+    {
+        WriteSequence<sizeof...(Writes)> seq{};
+        const RegisterWrite list[] = {writes...};
+
+        for (const auto &w : list)
+        {
+            size_t i = 0;
+            while (i < seq.count && seq.writes[i].reg != w.reg)
+            {
+                i++;
+            }
+            if (i == seq.count)
+            {
+                seq.writes[seq.count++] = RegisterWrite{w.reg, 0, 0};
+            }
+            seq.writes[i].mask = static_cast<uint8_t>(seq.writes[i].mask | w.mask);
+            seq.writes[i].value = static_cast<uint8_t>((seq.writes[i].value & ~w.mask) | w.value);
+        }
+
+        return seq;
+    }
+
+    // RegOpMode (0x01)
+    using OpModeLongRangeMode = Field<0x01, 7, 1>;
+    using OpModeAccessSharedReg = Field<0x01, 6, 1>;
+    using OpModeLowFrequencyMode = Field<0x01, 3, 1>;
+    using OpModeMode = Field<0x01, 0, 3, Volatility::Volatile>;
+
+    // RegPaConfig (0x09)
+    using PaSelect = Field<0x09, 7, 1>;
+    using PaMaxPower = Field<0x09, 4, 3>;
+    using PaOutputPower = Field<0x09, 0, 4>;
+
+    // RegLna (0x0C)
+    using LnaGain = Field<0x0C, 5, 3>;
+    using LnaBoostLf = Field<0x0C, 3, 2>;
+    using LnaBoostHf = Field<0x0C, 0, 2>;
+
+    // RegIrqFlags (0x12)
+    using IrqFlags = Field<0x12, 0, 8, Volatility::Volatile>;
+
+    // RegModemConfig1 (0x1D)
+    using ModemBandwidth = Field<0x1D, 4, 4>;
+    using ModemCodingRate = Field<0x1D, 1, 3>;
+    using ModemImplicitHeader = Field<0x1D, 0, 1>;
+
+    // RegModemConfig2 (0x1E)
+    using ModemSpreadingFactor = Field<0x1E, 4, 4>;
+    using ModemTxContinuous = Field<0x1E, 3, 1>;
+    using ModemRxPayloadCrcOn = Field<0x1E, 2, 1>;
+    using ModemSymbTimeoutMsb = Field<0x1E, 0, 2>;
+
+    // RegModemConfig3 (0x26)
+    using ModemLowDataRateOptimize = Field<0x26, 3, 1>;
+    using ModemAgcAutoOn = Field<0x26, 2, 1>;
+
+    // RegDetectOptimize (0x31)
+    using DetectionOptimize = Field<0x31, 0, 3>;
+
+    // RegInvertIQ (0x33)
+    using InvertIQRx = Field<0x33, 6, 1>;
+    using InvertIQTx = Field<0x33, 0, 1>;
+
+    // RegDioMapping1 (0x40)
+    using Dio0Mapping = Field<0x40, 6, 2>;
+    using Dio1Mapping = Field<0x40, 4, 2>;
+    using Dio2Mapping = Field<0x40, 2, 2>;
+    using Dio3Mapping = Field<0x40, 0, 2>;
+
+    // RegDioMapping2 (0x41)
+    using Dio4Mapping = Field<0x41, 6, 2>;
+    using Dio5Mapping = Field<0x41, 4, 2>;
+
+    // RegPaDac (0x4D)
+    using PaDac = Field<0x4D, 0, 3>;
+}
+
+#endif // SX127X_REGISTERS_HPP
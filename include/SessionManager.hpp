@@ -5,6 +5,8 @@
 #include <vector>
 #include <cstdint>
 
+class IOExecutor;
+
 class SessionManager {
 public:
     struct SessionData {
@@ -18,7 +20,8 @@ public:
         bool joined;
     };
 
-    static bool saveSession(const std::string& filename, const SessionData& data);
+    // With a running executor the file is replaced atomically on its I/O thread
+    static bool saveSession(const std::string& filename, const SessionData& data, IOExecutor* executor = nullptr);
     static bool loadSession(const std::string& filename, SessionData& data);
     static void clearSession(const std::string& filename);
 };
@@ -0,0 +1,182 @@
+/**
+ * @file SessionMirror.hpp
+ * @brief Live replica of the LoRaWAN session in a standby process
+ *
+ * The active process listens on a Unix domain socket and sends its session
+ * state (keys, counters, MAC parameters) to every connected standby whenever
+ * it changes, plus a periodic heartbeat. Before using an FCnt it has not
+ * announced yet, the active process reserves a block of frame counters and
+ * sends the reservation first. A standby that takes over continues from the
+ * reservation, so the FCnt never goes backwards even if the last counter
+ * update was lost with the active process.
+ *
+ * Every message carries the full state, so a standby that connects late or
+ * misses a message is up to date after the next one. An active process that
+ * closes the mirror says goodbye first; a connection that ends without one
+ * only tells the standby to reconnect.
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class IOExecutor;
+
+/**
+ * @class SessionMirror
+ * @brief Session state stream between an active and a standby process
+ */
+class SessionMirror {
+public:
+    /**
+     * @brief Mirrored session state
+     */
+    struct State {
+        std::array<uint8_t, 4> devAddr{};
+        std::array<uint8_t, 16> nwkSKey{};
+        std::array<uint8_t, 16> appSKey{};
+        uint32_t uplinkCounter = 0;   ///< Next uplink FCnt
+        uint32_t downlinkCounter = 0; ///< Last downlink FCnt
+        uint32_t reservedFcnt = 0;    ///< First FCnt the active process has not reserved
+        uint16_t lastDevNonce = 0;
+        uint8_t dataRate = 0;         ///< Uplink data rate
+        int8_t txPower = 14;          ///< Transmit power in dBm
+        uint8_t nbTrans = 1;          ///< Transmissions per uplink
+        uint8_t rx1DrOffset = 0;
+        uint8_t rx2DataRate = 0;
+        bool joined = false;
+
+        /**
+         * @brief FCnt a process taking over this session must start from
+         */
+        uint32_t takeoverFcnt() const { return uplinkCounter > reservedFcnt ? uplinkCounter : reservedFcnt; }
+    };
+
+    SessionMirror() = default;
+    ~SessionMirror();
+
+    SessionMirror(const SessionMirror&) = delete;
+    SessionMirror& operator=(const SessionMirror&) = delete;
+
+    /**
+     * @brief Start mirroring as the active process
+     *
+     * A stale socket file at the path is replaced.
+     *
+     * @param path Path of the Unix socket
+     * @return True if successful
+     */
+    bool listen(const std::string& path);
+
+    /**
+     * @brief Connect to the active process as a standby
+     *
+     * @param path Path of the Unix socket
+     * @return True if connected
+     */
+    bool connect(const std::string& path);
+
+    /**
+     * @brief Close the socket and all connections
+     *
+     * The active side sends a goodbye to its standbys first.
+     */
+    void close();
+
+    /**
+     * @brief Check if the mirror is listening or connected
+     *
+     * @return True if open
+     */
+    bool isOpen() const { return fd >= 0; }
+
+    /**
+     * @brief Send the state to every standby (active side)
+     *
+     * New standbys are accepted first. A standby that cannot take the whole
+     * message without blocking is disconnected. With an executor the sends are
+     * made on its I/O thread unless sync is set; sync waits for the deliveries
+     * already queued and sends in the caller, so the state has reached the
+     * standbys' socket buffers when it returns.
+     *
+     * @param state Current session state
+     * @param sync Send in the caller even with an executor
+     * @return Number of standbys that received the state, -1 if it was queued
+     */
+    int publish(const State& state, bool sync = false);
+
+    /**
+     * @brief Make the socket I/O of publish() on an I/O executor
+     *
+     * @param executor Executor, nullptr to send in the caller
+     */
+    void setExecutor(IOExecutor* executor);
+
+    /**
+     * @brief Read the state updates sent by the active process (standby side)
+     *
+     * @param timeout_ms Maximum time to wait for data
+     * @return False once the connection to the active process is lost
+     */
+    bool poll(int timeout_ms);
+
+    /**
+     * @brief Check if a state has been received (standby side)
+     */
+    bool hasReplica() const { return replicaValid; }
+
+    /**
+     * @brief Last state received (standby side)
+     */
+    const State& replica() const { return replicaState; }
+
+    /**
+     * @brief Check if the active process said goodbye (standby side)
+     */
+    bool activeClosed() const { return goodbyeReceived; }
+
+    /**
+     * @brief Time since the last message from the active process (standby side)
+     */
+    std::chrono::milliseconds silence() const;
+
+private:
+    /// Wire message types
+    enum MessageType : uint32_t {
+        MESSAGE_STATE = 0,   ///< Session state or heartbeat
+        MESSAGE_GOODBYE = 1, ///< The active process is closing the mirror
+    };
+
+    /// Wire message: magic, version, type, sequence and the state
+    struct Packet {
+        char magic[4];
+        uint32_t version;
+        uint32_t type;
+        uint64_t sequence;
+        State state;
+    };
+
+    Packet makePacket(MessageType type, const State& state);
+    void acceptStandbys();
+    int deliver(const Packet& packet);
+
+    int fd = -1;                   ///< Listening socket (active) or connection (standby)
+    bool listening = false;
+    std::string socketPath;
+    std::vector<int> standbys;     ///< Connected standbys (active side, I/O thread with an executor)
+    uint64_t sequence = 0;
+    State published;               ///< Last state published (active side)
+    IOExecutor* executor = nullptr;
+
+    std::vector<uint8_t> rxBuffer; ///< Partial message (standby side)
+    State replicaState;
+    bool replicaValid = false;
+    bool goodbyeReceived = false;
+    std::chrono::steady_clock::time_point lastMessage;
+};
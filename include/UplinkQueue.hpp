@@ -0,0 +1,147 @@
+/**
+ * @file UplinkQueue.hpp
+ * @brief Persistent store-and-forward queue for uplinks
+ *
+ * The queue is a ring of fixed-size slots in a memory-mapped file. Each record
+ * carries a sequence number and a CRC32, so a record torn by a power cut is
+ * detected and skipped when the file is opened again. The file header only
+ * stores the sequence of the oldest record still queued; the newest one is
+ * found by scanning the slots.
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class IOExecutor;
+
+/**
+ * @class UplinkQueue
+ * @brief mmap-backed ring file of pending uplinks
+ */
+class UplinkQueue {
+public:
+    /// Size of one record slot in the file
+    static constexpr size_t SLOT_SIZE = 256;
+    /// Record header: sequence (8), CRC32 (4), port (1), flags (1), length (2)
+    static constexpr size_t RECORD_HEADER_SIZE = 16;
+    /// Largest payload a record can hold
+    static constexpr size_t MAX_PAYLOAD = SLOT_SIZE - RECORD_HEADER_SIZE;
+
+    /**
+     * @brief Queued uplink
+     */
+    struct Entry {
+        uint64_t sequence = 0;        ///< Sequence number, increases by one per record
+        uint8_t port = 1;             ///< FPort
+        bool confirmed = false;       ///< Send as confirmed uplink
+        std::vector<uint8_t> payload; ///< Application payload
+    };
+
+    UplinkQueue() = default;
+    ~UplinkQueue();
+
+    UplinkQueue(const UplinkQueue&) = delete;
+    UplinkQueue& operator=(const UplinkQueue&) = delete;
+
+    /**
+     * @brief Open or create the queue file
+     *
+     * An existing file keeps its capacity; the capacity argument only applies
+     * to new files.
+     *
+     * @param filename Path of the ring file
+     * @param capacity Number of record slots for a new file
+     * @return True if successful
+     */
+    bool open(const std::string& filename, size_t capacity = 1024);
+
+    /**
+     * @brief Flush and unmap the file
+     */
+    void close();
+
+    /**
+     * @brief Check if a queue file is open
+     *
+     * @return True if open
+     */
+    bool isOpen() const { return base != nullptr; }
+
+    /**
+     * @brief Append an uplink
+     *
+     * @param payload Application payload (max MAX_PAYLOAD bytes)
+     * @param port FPort
+     * @param confirmed Send as confirmed uplink
+     * @return False if the queue is full, closed or the payload too large
+     */
+    bool push(const std::vector<uint8_t>& payload, uint8_t port, bool confirmed);
+
+    /**
+     * @brief Read the oldest uplink without removing it
+     *
+     * @param entry Receives the uplink
+     * @return False if the queue is empty
+     */
+    bool peek(Entry& entry) const;
+
+    /**
+     * @brief Remove the oldest uplink
+     *
+     * @return False if the queue is empty
+     */
+    bool pop();
+
+    /**
+     * @brief Hand the syncs of pushed and popped records to an I/O executor
+     *
+     * While the executor runs, a record is flushed by its I/O thread instead
+     * of by msync() in the caller, so it is durable a few milliseconds later.
+     *
+     * @param executor Executor, nullptr to sync in the caller
+     */
+    void setExecutor(IOExecutor* executor);
+
+    /**
+     * @brief Sequence number the next pushed uplink gets
+     */
+    uint64_t nextSequence() const { return tail; }
+
+    /**
+     * @brief Number of queued uplinks
+     */
+    size_t size() const { return static_cast<size_t>(tail - head); }
+
+    /**
+     * @brief Number of record slots
+     */
+    size_t capacity() const { return slots; }
+
+private:
+    /// File header, followed by the slots at offset SLOT_SIZE
+    struct FileHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t slot_count;
+        uint32_t slot_size;
+        uint64_t head;
+    };
+
+    uint8_t* slot(uint64_t sequence) const;
+    bool validRecord(uint64_t sequence) const;
+    void sync(void* address, size_t length);
+
+    uint8_t* base = nullptr;
+    size_t mapped_length = 0;
+    size_t slots = 0;
+    uint64_t head = 0; ///< Sequence of the oldest record
+    uint64_t tail = 0; ///< Sequence of the next record
+    int fd = -1;
+    IOExecutor* executor = nullptr;
+};
@@ -0,0 +1,52 @@
+#!/usr/bin/env python3
+"""Minimal Semtech UDP network server stand-in for testing gateway mode.
+
+Acknowledges PUSH_DATA/PULL_DATA, prints the received rxpk/stat objects and,
+with --downlink, answers every uplink with a downlink scheduled 1 s after it.
+"""
+import argparse
+import base64
+import json
+import os
+import socket
+
+PUSH_DATA, PUSH_ACK, PULL_DATA, PULL_RESP, PULL_ACK, TX_ACK = range(6)
+
+parser = argparse.ArgumentParser(description="Semtech UDP server stub")
+parser.add_argument("--port", type=int, default=1700)
+parser.add_argument("--downlink", help="hex payload sent 1 s after each uplink")
+args = parser.parse_args()
+
+sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+sock.bind(("0.0.0.0", args.port))
+pull_addr = None
+print(f"Listening on UDP port {args.port}")
+
+while True:
+    data, addr = sock.recvfrom(4096)
+    if len(data) < 4 or data[0] != 2:
+        continue
+    token, ident = data[1:3], data[3]
+
+    if ident == PUSH_DATA:
+        sock.sendto(bytes([2]) + token + bytes([PUSH_ACK]), addr)
+        message = json.loads(data[12:])
+        for stat in [message["stat"]] if "stat" in message else []:
+            print("stat:", stat)
+        for rxpk in message.get("rxpk", []):
+            payload = base64.b64decode(rxpk["data"]).hex()
+            print(f"rxpk tmst={rxpk['tmst']} chan={rxpk['chan']} freq={rxpk['freq']} "
+                  f"{rxpk['datr']} rssi={rxpk['rssi']} lsnr={rxpk['lsnr']} data={payload}")
+            if args.downlink and pull_addr:
+                payload = bytes.fromhex(args.downlink)
+                txpk = {"imme": False, "tmst": (rxpk["tmst"] + 1000000) & 0xFFFFFFFF,
+                        "freq": rxpk["freq"], "rfch": 0, "powe": 14, "modu": "LORA",
+                        "datr": rxpk["datr"], "codr": "4/5", "ipol": True,
+                        "size": len(payload), "data": base64.b64encode(payload).decode()}
+                sock.sendto(bytes([2]) + os.urandom(2) + bytes([PULL_RESP]) +
+                            json.dumps({"txpk": txpk}).encode(), pull_addr)
+    elif ident == PULL_DATA:
+        pull_addr = addr
+        sock.sendto(bytes([2]) + token + bytes([PULL_ACK]), addr)
+    elif ident == TX_ACK:
+        print("tx_ack:", data[12:].decode() if len(data) > 12 else "{}")
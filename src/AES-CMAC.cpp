@@ -1,52 +1,57 @@
 #include "AES-CMAC.hpp"
 #include <openssl/evp.h>
+#include <algorithm>
 #include <stdexcept>
 #include <iostream>
 #include <iomanip>
 
 std::array<uint8_t, 16> AESCMAC::calculate(const std::vector<uint8_t>& message, 
                                           const std::array<uint8_t, 16>& key) {
-    // 1. Generar subkeys K1 y K2
-    std::array<uint8_t, 16> k1, k2;
-    generate_subkey(key, k1, k2);
-
-    // 2. Calcular número de bloques
-    size_t n = (message.size() + 15) / 16;
-    bool last_block_complete = (message.size() % 16) == 0;
-
-    // 3. Inicializar X0 a cero
-    std::array<uint8_t, 16> x = {0};
-    std::array<uint8_t, 16> y;
-
-    // 4. Procesar bloques completos excepto el último
-    for(size_t i = 0; i < n-1; i++) {
-        // XOR con el mensaje
-        for(size_t j = 0; j < 16; j++) {
-            y[j] = message[i*16 + j] ^ x[j];
-        }
-        // Cifrar
-        aes_encrypt(y.data(), key.data(), x.data());
+    State state;
+    begin(state, key);
+    return finish(state, key, message.data(), message.size());
+}
+
+void AESCMAC::begin(State& state, const std::array<uint8_t, 16>& key) {
+    // Generar subkeys K1 y K2, X0 a cero
+    generate_subkey(key, state.k1, state.k2);
+    state.x.fill(0);
+}
+
+void AESCMAC::absorb(State& state, const std::array<uint8_t, 16>& key, const uint8_t* block) {
+    // XOR con el bloque y cifrar
+    std::array<uint8_t, 16> y = state.x;
+    xor_block(y.data(), block, 16);
+    aes_encrypt(y.data(), key.data(), state.x.data());
+}
+
+std::array<uint8_t, 16> AESCMAC::finish(const State& state, const std::array<uint8_t, 16>& key,
+                                        const uint8_t* data, size_t length) {
+    State current = state;
+
+    // Procesar bloques completos excepto el último
+    while (length > 16) {
+        absorb(current, key, data);
+        data += 16;
+        length -= 16;
     }
 
-    // 5. Procesar último bloque
-    std::array<uint8_t, 16> last_block = {0};
-    size_t last_block_size = message.size() - (n-1)*16;
-    std::copy(message.end() - last_block_size, message.end(), last_block.begin());
-
-    // Si el último bloque está incompleto, aplicar padding y usar K2
-    if (!last_block_complete) {
-        last_block[last_block_size] = 0x80; // Padding
-        for(size_t i = 0; i < 16; i++) {
-            y[i] = last_block[i] ^ k2[i] ^ x[i];
-        }
-    } else {
+    // Procesar último bloque
+    std::array<uint8_t, 16> y = current.x;
+    if (length == 16) {
         // Si está completo, usar K1
-        for(size_t i = 0; i < 16; i++) {
-            y[i] = last_block[i] ^ k1[i] ^ x[i];
-        }
+        xor_block(y.data(), data, 16);
+        xor_block(y.data(), current.k1.data(), 16);
+    } else {
+        // Si está incompleto, aplicar padding y usar K2
+        std::array<uint8_t, 16> last_block = {0};
+        std::copy(data, data + length, last_block.begin());
+        last_block[length] = 0x80;
+        xor_block(y.data(), last_block.data(), 16);
+        xor_block(y.data(), current.k2.data(), 16);
     }
 
-    // 6. Último cifrado
+    // Último cifrado
     std::array<uint8_t, 16> cmac;
     aes_encrypt(y.data(), key.data(), cmac.data());
 
@@ -0,0 +1,178 @@
+/**
+ * @file AESBatch.cpp
+ * @brief Implementation of batched AES-128
+ *
+ * With AES-NI, the blocks are processed in groups of LANES: the first round of
+ * every block in the group, then the second, and so on, so each AESENC can
+ * issue while the previous ones are still in the pipeline. Without it, runs of
+ * blocks under the same key are passed to OpenSSL as one ECB call, which uses
+ * its own interleaved code for the CPU (AES-NI, ARMv8 Crypto Extensions or
+ * bit-sliced software).
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+#include "AESBatch.hpp"
+
+#include <openssl/evp.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define AESBATCH_AESNI 1
+#include <cpuid.h>
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+namespace
+{
+#ifdef AESBATCH_AESNI
+    __attribute__((target("aes,sse2"))) inline __m128i expandStep(__m128i key, __m128i assist)
+    {
+        assist = _mm_shuffle_epi32(assist, 0xFF);
+        key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+        key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+        key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+        return _mm_xor_si128(key, assist);
+    }
+
+    __attribute__((target("aes,sse2"))) void expandAESNI(const uint8_t *key, uint8_t (*round_keys)[16])
+    {
+        __m128i rk[11];
+        rk[0] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(key));
+        // The round constant must be an immediate
+        rk[1] = expandStep(rk[0], _mm_aeskeygenassist_si128(rk[0], 0x01));
+        rk[2] = expandStep(rk[1], _mm_aeskeygenassist_si128(rk[1], 0x02));
+        rk[3] = expandStep(rk[2], _mm_aeskeygenassist_si128(rk[2], 0x04));
+        rk[4] = expandStep(rk[3], _mm_aeskeygenassist_si128(rk[3], 0x08));
+        rk[5] = expandStep(rk[4], _mm_aeskeygenassist_si128(rk[4], 0x10));
+        rk[6] = expandStep(rk[5], _mm_aeskeygenassist_si128(rk[5], 0x20));
+        rk[7] = expandStep(rk[6], _mm_aeskeygenassist_si128(rk[6], 0x40));
+        rk[8] = expandStep(rk[7], _mm_aeskeygenassist_si128(rk[7], 0x80));
+        rk[9] = expandStep(rk[8], _mm_aeskeygenassist_si128(rk[8], 0x1B));
+        rk[10] = expandStep(rk[9], _mm_aeskeygenassist_si128(rk[9], 0x36));
+        for (int i = 0; i < 11; i++)
+            _mm_store_si128(reinterpret_cast<__m128i *>(round_keys[i]), rk[i]);
+    }
+
+    __attribute__((target("aes,sse2"))) void encryptAESNI(const AESBatch::Block *blocks, size_t count)
+    {
+        for (size_t base = 0; base < count; base += AESBatch::LANES)
+        {
+            size_t lanes = std::min(AESBatch::LANES, count - base);
+            const AESBatch::Block *group = blocks + base;
+            __m128i state[AESBatch::LANES];
+
+            for (size_t j = 0; j < lanes; j++)
+            {
+                state[j] = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(group[j].input)),
+                                         _mm_load_si128(reinterpret_cast<const __m128i *>(group[j].key->round_keys[0])));
+            }
+            for (int round = 1; round < 10; round++)
+            {
+                for (size_t j = 0; j < lanes; j++)
+                {
+                    state[j] = _mm_aesenc_si128(state[j],
+                                                _mm_load_si128(reinterpret_cast<const __m128i *>(group[j].key->round_keys[round])));
+                }
+            }
+            for (size_t j = 0; j < lanes; j++)
+            {
+                state[j] = _mm_aesenclast_si128(state[j],
+                                                _mm_load_si128(reinterpret_cast<const __m128i *>(group[j].key->round_keys[10])));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(group[j].output), state[j]);
+            }
+        }
+    }
+#endif
+
+    void encryptOpenSSL(const AESBatch::Block *blocks, size_t count)
+    {
+        EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+        if (!ctx)
+        {
+            throw std::runtime_error("Error creating EVP context");
+        }
+
+        uint8_t buffer[AESBatch::LANES * 16];
+        const AESBatch::Key *current = nullptr;
+        size_t i = 0;
+        while (i < count)
+        {
+            if (blocks[i].key != current)
+            {
+                current = blocks[i].key;
+                if (EVP_EncryptInit_ex(ctx, EVP_aes_128_ecb(), nullptr, current->key.data(), nullptr) != 1 ||
+                    EVP_CIPHER_CTX_set_padding(ctx, 0) != 1)
+                {
+                    EVP_CIPHER_CTX_free(ctx);
+                    throw std::runtime_error("Error in AES encryption");
+                }
+            }
+
+            // Gather a run of blocks under this key into one ECB call
+            size_t run = 0;
+            while (i + run < count && run < AESBatch::LANES && blocks[i + run].key == current)
+            {
+                std::memcpy(buffer + run * 16, blocks[i + run].input, 16);
+                run++;
+            }
+
+            int outlen;
+            if (EVP_EncryptUpdate(ctx, buffer, &outlen, buffer, static_cast<int>(run * 16)) != 1)
+            {
+                EVP_CIPHER_CTX_free(ctx);
+                throw std::runtime_error("Error in AES encryption");
+            }
+            for (size_t j = 0; j < run; j++)
+            {
+                std::memcpy(blocks[i + j].output, buffer + j * 16, 16);
+            }
+            i += run;
+        }
+
+        EVP_CIPHER_CTX_free(ctx);
+    }
+}
+
+bool AESBatch::accelerated()
+{
+#ifdef AESBATCH_AESNI
+    static const bool aesni = []() {
+        unsigned int eax, ebx, ecx, edx;
+        return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_AES) && (edx & bit_SSE2);
+    }();
+    return aesni;
+#else
+    return false;
+#endif
+}
+
+void AESBatch::expand(const std::array<uint8_t, 16> &key, Key &out)
+{
+    out.key = key;
+#ifdef AESBATCH_AESNI
+    if (accelerated())
+    {
+        expandAESNI(key.data(), out.round_keys);
+    }
+#endif
+}
+
+void AESBatch::encrypt(const Block *blocks, size_t count)
+{
+    if (count == 0)
+        return;
+
+#ifdef AESBATCH_AESNI
+    if (accelerated())
+    {
+        encryptAESNI(blocks, count);
+        return;
+    }
+#endif
+    encryptOpenSSL(blocks, count);
+}
@@ -0,0 +1,300 @@
+/**
+ * @file AirtimeLedger.cpp
+ * @brief Implementation of the persistent airtime ledger
+ *
+ * Record layout (32 bytes): time_ms (8), sequence (4), frequency in kHz (4),
+ * air time in microseconds (4), sub-band (1), reserved (7), check word (4).
+ * The check word is written last and folds the other fields, so a record torn
+ * by a power cut is ignored. The write position is not stored; it follows the
+ * record with the highest sequence found when the file is opened.
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+#include "AirtimeLedger.hpp"
+#include "IOExecutor.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const char LEDGER_MAGIC[4] = {'L', 'W', 'A', 'L'};
+    constexpr uint32_t LEDGER_VERSION = 1;
+
+    // Record field offsets
+    constexpr size_t REC_TIME = 0;
+    constexpr size_t REC_SEQUENCE = 8;
+    constexpr size_t REC_FREQUENCY = 12;
+    constexpr size_t REC_AIRTIME = 16;
+    constexpr size_t REC_SUBBAND = 20;
+    constexpr size_t REC_CHECK = 28;
+
+    uint32_t checkWord(int64_t time_ms, uint32_t sequence, uint32_t frequency_khz, uint32_t airtime_us, uint8_t subband)
+    {
+        uint64_t time = static_cast<uint64_t>(time_ms);
+        return static_cast<uint32_t>(time) ^ static_cast<uint32_t>(time >> 32) ^ (sequence * 0x9E3779B1u) ^
+               (frequency_khz * 2654435761u) ^ (airtime_us * 40503u) ^ (subband << 24) ^ 0x4C57414Cu;
+    }
+}
+
+AirtimeLedger::~AirtimeLedger()
+{
+    close();
+}
+
+bool AirtimeLedger::open(const std::string &filename, size_t capacity)
+{
+    static_assert(sizeof(FileHeader) <= HEADER_SIZE, "file header too large");
+    close();
+
+#ifndef _WIN32
+    if (capacity == 0)
+    {
+        std::cerr << "Airtime ledger capacity must be greater than zero" << std::endl;
+        return false;
+    }
+
+    fd = ::open(filename.c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd < 0)
+    {
+        std::cerr << "Cannot open airtime ledger " << filename << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        std::cerr << "Cannot stat airtime ledger " << filename << ": " << strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+
+    FileHeader header{};
+    bool created = st.st_size == 0;
+    if (created)
+    {
+        std::memcpy(header.magic, LEDGER_MAGIC, sizeof(header.magic));
+        header.version = LEDGER_VERSION;
+        header.record_count = static_cast<uint32_t>(capacity);
+        header.record_size = RECORD_SIZE;
+    }
+    else if (pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+             std::memcmp(header.magic, LEDGER_MAGIC, sizeof(header.magic)) != 0 ||
+             header.version != LEDGER_VERSION || header.record_size != RECORD_SIZE || header.record_count == 0)
+    {
+        std::cerr << "Airtime ledger " << filename << " has an unknown format" << std::endl;
+        close();
+        return false;
+    }
+
+    slots = header.record_count;
+    mapped_length = HEADER_SIZE + slots * RECORD_SIZE;
+    if (static_cast<size_t>(st.st_size) < mapped_length && ftruncate(fd, mapped_length) != 0)
+    {
+        std::cerr << "Cannot resize airtime ledger " << filename << ": " << strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+
+    void *map = mmap(nullptr, mapped_length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        std::cerr << "Cannot map airtime ledger " << filename << ": " << strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+    base = static_cast<uint8_t *>(map);
+
+    if (created)
+    {
+        std::memcpy(base, &header, sizeof(header));
+        msync(base, HEADER_SIZE, MS_SYNC);
+    }
+
+    // Continue after the newest valid record
+    next = 0;
+    sequence = 0;
+    for (size_t i = 0; i < slots; i++)
+    {
+        Record entry;
+        uint32_t stored_sequence;
+        if (readRecord(i, entry, &stored_sequence) && stored_sequence >= sequence)
+        {
+            sequence = stored_sequence + 1;
+            next = (i + 1) % slots;
+        }
+    }
+
+    return true;
+#else
+    (void)filename;
+    (void)capacity;
+    std::cerr << "Airtime ledger is not supported on this platform" << std::endl;
+    return false;
+#endif
+}
+
+void AirtimeLedger::close()
+{
+#ifndef _WIN32
+    // Background syncs still use the descriptor
+    if (executor)
+        executor->flush();
+    if (base)
+    {
+        msync(base, mapped_length, MS_SYNC);
+        munmap(base, mapped_length);
+    }
+    if (fd >= 0)
+        ::close(fd);
+#endif
+    base = nullptr;
+    fd = -1;
+    mapped_length = 0;
+    slots = 0;
+    next = 0;
+    sequence = 0;
+}
+
+bool AirtimeLedger::append(float frequency, float airtime_ms)
+{
+    if (!base)
+        return false;
+
+    int64_t time_ms = nowMs();
+    uint32_t frequency_khz = static_cast<uint32_t>(frequency * 1000.0f + 0.5f);
+    uint32_t airtime_us = static_cast<uint32_t>(std::max(airtime_ms, 0.0f) * 1000.0f + 0.5f);
+    uint8_t subband = subBand(frequency);
+    uint32_t check = 0;
+
+    uint8_t *rec = record(next);
+    std::memcpy(rec + REC_CHECK, &check, sizeof(check));
+    std::memcpy(rec + REC_TIME, &time_ms, sizeof(time_ms));
+    std::memcpy(rec + REC_SEQUENCE, &sequence, sizeof(sequence));
+    std::memcpy(rec + REC_FREQUENCY, &frequency_khz, sizeof(frequency_khz));
+    std::memcpy(rec + REC_AIRTIME, &airtime_us, sizeof(airtime_us));
+    std::memset(rec + REC_SUBBAND, 0, REC_CHECK - REC_SUBBAND);
+    rec[REC_SUBBAND] = subband;
+
+    check = checkWord(time_ms, sequence, frequency_khz, airtime_us, subband);
+    std::memcpy(rec + REC_CHECK, &check, sizeof(check));
+
+#ifndef _WIN32
+    // Without an executor the record is durable before the transmission it
+    // accounts for; with one it is synced on the I/O thread within
+    // milliseconds. msync() needs a page aligned address.
+    if (!executor || !executor->sync(fd, static_cast<uint64_t>(rec - base), RECORD_SIZE))
+    {
+        static const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        uintptr_t start = reinterpret_cast<uintptr_t>(rec) & ~(page - 1);
+        msync(reinterpret_cast<void *>(start), reinterpret_cast<uintptr_t>(rec) + RECORD_SIZE - start, MS_SYNC);
+    }
+#endif
+
+    next = (next + 1) % slots;
+    sequence++;
+    return true;
+}
+
+void AirtimeLedger::setExecutor(IOExecutor *io)
+{
+    if (executor)
+        executor->flush();
+    executor = io;
+}
+
+std::vector<AirtimeLedger::Record> AirtimeLedger::recent(std::chrono::milliseconds window) const
+{
+    std::vector<Record> records;
+    if (!base)
+        return records;
+
+    int64_t now = nowMs();
+    int64_t since = now - window.count();
+
+    // Walk from the oldest slot so the result is in write order
+    for (size_t n = 0; n < slots; n++)
+    {
+        Record entry;
+        if (!readRecord((next + n) % slots, entry))
+            continue;
+
+        entry.time_ms = std::min(entry.time_ms, now);
+        if (entry.time_ms >= since)
+            records.push_back(entry);
+    }
+    return records;
+}
+
+float AirtimeLedger::airtime(uint8_t subband, std::chrono::milliseconds window) const
+{
+    float total = 0.0f;
+    for (const auto &entry : recent(window))
+    {
+        if (entry.subband == subband)
+            total += entry.airtime_ms;
+    }
+    return total;
+}
+
+uint8_t AirtimeLedger::subBand(float frequency)
+{
+    // Compare in kHz, channel frequencies built by adding float steps are not exact
+    long khz = std::lround(frequency * 1000.0f);
+    if (khz >= 863000 && khz < 865000)
+        return 0;
+    if (khz >= 865000 && khz < 868000)
+        return 1;
+    if (khz >= 868000 && khz <= 868600)
+        return 2;
+    if (khz >= 868700 && khz <= 869200)
+        return 3;
+    if (khz >= 869400 && khz <= 869650)
+        return 4;
+    if (khz >= 869700 && khz <= 870000)
+        return 5;
+    return NO_SUBBAND;
+}
+
+bool AirtimeLedger::readRecord(size_t index, Record &out, uint32_t *sequence_out) const
+{
+    const uint8_t *rec = record(index);
+    int64_t time_ms;
+    uint32_t stored_sequence, frequency_khz, airtime_us, check;
+    std::memcpy(&time_ms, rec + REC_TIME, sizeof(time_ms));
+    std::memcpy(&stored_sequence, rec + REC_SEQUENCE, sizeof(stored_sequence));
+    std::memcpy(&frequency_khz, rec + REC_FREQUENCY, sizeof(frequency_khz));
+    std::memcpy(&airtime_us, rec + REC_AIRTIME, sizeof(airtime_us));
+    std::memcpy(&check, rec + REC_CHECK, sizeof(check));
+
+    // Unused slots are all zero and have time_ms == 0
+    if (time_ms <= 0 || check != checkWord(time_ms, stored_sequence, frequency_khz, airtime_us, rec[REC_SUBBAND]))
+        return false;
+
+    if (sequence_out)
+        *sequence_out = stored_sequence;
+
+    out.time_ms = time_ms;
+    out.frequency = frequency_khz / 1000.0f;
+    out.airtime_ms = airtime_us / 1000.0f;
+    out.subband = rec[REC_SUBBAND];
+    return true;
+}
+
+int64_t AirtimeLedger::nowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
@@ -12,10 +12,12 @@
 
 #include "CH341SPI.hpp"
 #include "CH341Config.hpp"
-#include <iostream>
+#include "Logger.hpp"
+#include "RealTime.hpp"
 #include <chrono>
 #include <thread>
 #include <vector>
+#include <algorithm>
 
 CH341SPI::CH341SPI(int device_index, bool lsb_first)
     : device(nullptr),
@@ -29,25 +31,21 @@ CH341SPI::CH341SPI(int device_index, bool lsb_first)
     int ret = libusb_init(&context);
     if (ret != 0)
     {
-        std::cerr << "Failed to initialize libusb: " << libusb_error_name(ret) << std::endl;
+        LOG_ERROR("Failed to initialize libusb: " << libusb_error_name(ret));
     }
 }
 
 CH341SPI::~CH341SPI()
 {
-    // Stop interrupt thread if running
-    if (threadRunning)
+    // Stops the interrupt thread and closes the device
+    close();
+
+    if (interruptTransfer)
     {
-        threadRunning = false;
-        if (interruptThread.joinable())
-        {
-            interruptThread.join();
-        }
+        libusb_free_transfer(interruptTransfer);
+        interruptTransfer = nullptr;
     }
 
-    // Ensure device is closed
-    close();
-
     // Free libusb context
     if (context)
     {
@@ -60,7 +58,7 @@ bool CH341SPI::open()
 {
     if (!context)
     {
-        std::cerr << "LibUSB not initialized" << std::endl;
+        LOG_ERROR("LibUSB not initialized");
         return false;
     }
 
@@ -71,7 +69,7 @@ bool CH341SPI::open()
         ssize_t count = libusb_get_device_list(context, &device_list);
         if (count < 0)
         {
-            std::cerr << "Failed to get device list: " << libusb_error_name(count) << std::endl;
+            LOG_ERROR("Failed to get device list: " << libusb_error_name(count));
             return false;
         }
 
@@ -95,15 +93,15 @@ bool CH341SPI::open()
 
         if (ch341_devices.empty())
         {
-            std::cerr << "No CH341 devices found" << std::endl;
+            LOG_ERROR("No CH341 devices found");
             libusb_free_device_list(device_list, 1);
             return false;
         }
 
         if (device_index >= static_cast<int>(ch341_devices.size()))
         {
-            std::cerr << "Device index " << device_index << " out of range, only "
-                      << ch341_devices.size() << " devices found" << std::endl;
+            LOG_ERROR("Device index " << device_index << " out of range, only "
+                      << ch341_devices.size() << " devices found");
             libusb_free_device_list(device_list, 1);
             return false;
         }
@@ -114,7 +112,7 @@ bool CH341SPI::open()
 
         if (ret != 0)
         {
-            std::cerr << "Failed to open device: " << libusb_error_name(ret) << std::endl;
+            LOG_ERROR("Failed to open device: " << libusb_error_name(ret));
             return false;
         }
 
@@ -122,7 +120,7 @@ bool CH341SPI::open()
         ret = libusb_set_configuration(device, 1);
         if (ret != 0)
         {
-            std::cerr << "Failed to set configuration: " << libusb_error_name(ret) << std::endl;
+            LOG_ERROR("Failed to set configuration: " << libusb_error_name(ret));
             libusb_close(device);
             device = nullptr;
             return false;
@@ -132,12 +130,14 @@ bool CH341SPI::open()
         ret = libusb_claim_interface(device, 0);
         if (ret != 0)
         {
-            std::cerr << "Failed to claim interface: " << libusb_error_name(ret) << std::endl;
+            LOG_ERROR("Failed to claim interface: " << libusb_error_name(ret));
             libusb_close(device);
             device = nullptr;
             return false;
         }
 
+        allocateBuffers();
+
         // Configure SPI mode
         if (!configStream())
         {
@@ -155,9 +155,10 @@ bool CH341SPI::open()
     }
     catch (const std::exception &e)
     {
-        std::cerr << "Exception in open: " << e.what() << std::endl;
+        LOG_ERROR("Exception in open: " << e.what());
         if (device)
         {
+            freeBuffers();
             libusb_close(device);
             device = nullptr;
         }
@@ -167,22 +168,80 @@ bool CH341SPI::open()
 
 void CH341SPI::close()
 {
+    // Transfers in flight use the device handle
+    enableInterrupt(false);
+
     if (device)
     {
         try
         {
             enablePins(false);
+            freeBuffers();
             libusb_release_interface(device, 0);
             libusb_close(device);
         }
         catch (const std::exception &e)
         {
-            std::cerr << "Exception in close: " << e.what() << std::endl;
+            LOG_ERROR("Exception in close: " << e.what());
         }
         device = nullptr;
     }
 }
 
+void CH341SPI::allocateBuffers()
+{
+    const size_t length = CH341Config::USB_BUFFER_LENGTH;
+    usb_dev_mem = false;
+
+#if defined(LIBUSB_API_VERSION) && LIBUSB_API_VERSION >= 0x01000105
+    // Pages mapped from usbfs: the kernel uses them directly instead of
+    // copying every URB through its own buffer. NULL where unsupported.
+    usb_tx = libusb_dev_mem_alloc(device, length);
+    if (usb_tx)
+    {
+        usb_rx = libusb_dev_mem_alloc(device, length);
+        if (usb_rx)
+        {
+            usb_dev_mem = true;
+            return;
+        }
+        libusb_dev_mem_free(device, usb_tx, length);
+        usb_tx = nullptr;
+    }
+#endif
+
+    if (!heap_buffers)
+        heap_buffers.reset(new uint8_t[2 * length]);
+    usb_tx = heap_buffers.get();
+    usb_rx = heap_buffers.get() + length;
+}
+
+void CH341SPI::freeBuffers()
+{
+#if defined(LIBUSB_API_VERSION) && LIBUSB_API_VERSION >= 0x01000105
+    if (usb_dev_mem)
+    {
+        libusb_dev_mem_free(device, usb_tx, CH341Config::USB_BUFFER_LENGTH);
+        libusb_dev_mem_free(device, usb_rx, CH341Config::USB_BUFFER_LENGTH);
+    }
+#endif
+    usb_dev_mem = false;
+    usb_tx = nullptr;
+    usb_rx = nullptr;
+}
+
+int CH341SPI::sendCommand(int length)
+{
+    int transferred = 0;
+    int ret = libusb_bulk_transfer(device, CH341Config::BULK_WRITE_EP,
+                                   usb_tx, length, &transferred,
+                                   CH341Config::USB_TIMEOUT);
+
+    if (ret == 0 && transferred != length)
+        ret = LIBUSB_ERROR_IO;
+    return ret;
+}
+
 bool CH341SPI::configStream()
 {
     if (!device)
@@ -191,19 +250,14 @@ bool CH341SPI::configStream()
     try
     {
         // Configure for 100KHz (slower for stability)
-        uint8_t cmd[3] = {
-            CH341Config::CMD_I2C_STREAM,
-            CH341Config::CMD_I2C_STM_SET | 0x01, // 100KHz
-            CH341Config::CMD_I2C_STM_END};
-
-        int transferred = 0;
-        int ret = libusb_bulk_transfer(device, CH341Config::BULK_WRITE_EP,
-                                       cmd, sizeof(cmd), &transferred,
-                                       CH341Config::USB_TIMEOUT);
+        usb_tx[0] = CH341Config::CMD_I2C_STREAM;
+        usb_tx[1] = CH341Config::CMD_I2C_STM_SET | 0x01; // 100KHz
+        usb_tx[2] = CH341Config::CMD_I2C_STM_END;
 
-        if (ret != 0 || transferred != sizeof(cmd))
+        int ret = sendCommand(3);
+        if (ret != 0)
         {
-            std::cerr << "Error configuring stream: " << libusb_error_name(ret) << std::endl;
+            LOG_ERROR("Error configuring stream: " << libusb_error_name(ret));
             return false;
         }
 
@@ -211,7 +265,7 @@ bool CH341SPI::configStream()
     }
     catch (const std::exception &e)
     {
-        std::cerr << "Exception in configStream: " << e.what() << std::endl;
+        LOG_ERROR("Exception in configStream: " << e.what());
         return false;
     }
 }
@@ -224,23 +278,17 @@ bool CH341SPI::enablePins(bool enable)
     try
     {
         // Prepare command buffer
-        uint8_t cmd[6] = {
-            CH341Config::CMD_UIO_STREAM,
-            CH341Config::CMD_UIO_STM_OUT | 0x37,                   // CS high
-            CH341Config::CMD_UIO_STM_OUT | 0x37,                   // CS high
-            CH341Config::CMD_UIO_STM_OUT | 0x37,                   // CS high
-            static_cast<uint8_t>(CH341Config::CMD_UIO_STM_DIR | (enable ? 0x3F : 0x00)), // Set direction
-            CH341Config::CMD_UIO_STM_END                           // End stream
-        };
-
-        int transferred = 0;
-        int ret = libusb_bulk_transfer(device, CH341Config::BULK_WRITE_EP,
-                                       cmd, sizeof(cmd), &transferred,
-                                       CH341Config::USB_TIMEOUT);
-
-        if (ret != 0 || transferred != sizeof(cmd))
+        usb_tx[0] = CH341Config::CMD_UIO_STREAM;
+        usb_tx[1] = CH341Config::CMD_UIO_STM_OUT | 0x37;                   // CS high
+        usb_tx[2] = CH341Config::CMD_UIO_STM_OUT | 0x37;                   // CS high
+        usb_tx[3] = CH341Config::CMD_UIO_STM_OUT | 0x37;                   // CS high
+        usb_tx[4] = CH341Config::CMD_UIO_STM_DIR | (enable ? 0x3F : 0x00); // Set direction
+        usb_tx[5] = CH341Config::CMD_UIO_STM_END;                          // End stream
+
+        int ret = sendCommand(6);
+        if (ret != 0)
         {
-            std::cerr << "Error setting pins: " << libusb_error_name(ret) << std::endl;
+            LOG_ERROR("Error setting pins: " << libusb_error_name(ret));
             return false;
         }
 
@@ -251,7 +299,7 @@ bool CH341SPI::enablePins(bool enable)
     }
     catch (const std::exception &e)
     {
-        std::cerr << "Exception in enablePins: " << e.what() << std::endl;
+        LOG_ERROR("Exception in enablePins: " << e.what());
         return false;
     }
 }
@@ -272,118 +320,168 @@ uint8_t CH341SPI::swapBits(uint8_t byte)
 
 std::vector<uint8_t> CH341SPI::transfer(const std::vector<uint8_t> &write_data, size_t read_length)
 {
-    std::vector<uint8_t> result;
+    std::vector<uint8_t> result(read_length);
 
-    if (!device)
+    if (!transfer(write_data.data(), write_data.size(), result.data(), read_length))
     {
-        return result; // Empty result indicates error
+        return std::vector<uint8_t>(); // Empty result indicates error
     }
 
-    try
-    {
-        // CS low
-        uint8_t cs_low[3] = {
-            CH341Config::CMD_UIO_STREAM,
-            CH341Config::CMD_UIO_STM_OUT | 0x36,
-            CH341Config::CMD_UIO_STM_END};
-
-        int transferred = 0;
-        int ret = libusb_bulk_transfer(device, CH341Config::BULK_WRITE_EP,
-                                       cs_low, sizeof(cs_low), &transferred,
-                                       CH341Config::USB_TIMEOUT);
-
-        if (ret != 0)
-        {
-            std::cerr << "Error setting CS low: " << libusb_error_name(ret) << std::endl;
-            return result;
-        }
-
-        // Transfer byte by byte, as in the Python implementation
-        for (size_t i = 0; i < write_data.size(); i++)
-        {
-            // Send one byte at a time
-            uint8_t cmd[2] = {CH341Config::CMD_SPI_STREAM, lsb_first ? swapBits(write_data[i]) : write_data[i]};
+    return result;
+}
 
-            ret = libusb_bulk_transfer(device, CH341Config::BULK_WRITE_EP,
-                                       cmd, sizeof(cmd), &transferred,
-                                       CH341Config::USB_TIMEOUT);
+bool CH341SPI::transfer(const uint8_t *write_data, size_t write_length, uint8_t *read_data, size_t read_length)
+{
+    // CS is released by the pulse at the start of the next transfer, as for
+    // flashrom's CH341A driver, which saves a USB round trip per transaction.
+    const SPISegment segment = {write_data, write_length, read_data, read_length, 0};
+    return transferStream(&segment, 1, false);
+}
 
-            if (ret != 0)
-            {
-                std::cerr << "Error in SPI write: " << libusb_error_name(ret) << std::endl;
-                return result;
-            }
+bool CH341SPI::transferBatch(const SPISegment *segments, size_t count)
+{
+    // Devices that act on the rising edge of CS need it released at the end
+    return transferStream(segments, count, true);
+}
 
-            // Read the response for this byte
-            uint8_t response_byte;
-            ret = libusb_bulk_transfer(device, CH341Config::BULK_READ_EP,
-                                       &response_byte, 1, &transferred,
-                                       CH341Config::USB_TIMEOUT);
+uint8_t *CH341SPI::appendCSPacket(uint8_t *ptr, uint16_t delay_us, bool assert_cs)
+{
+    // One UIO stream packet: CS high, an optional guard delay and CS low again.
+    // The rest of the packet is zero padding, so the SPI stream commands that
+    // follow start on a packet boundary.
+    uint8_t *packet = ptr;
+    *ptr++ = CH341Config::CMD_UIO_STREAM;
+    *ptr++ = CH341Config::CMD_UIO_STM_OUT | 0x37; // CS high
+    *ptr++ = CH341Config::CMD_UIO_STM_OUT | 0x37; // Delay
+    *ptr++ = CH341Config::CMD_UIO_STM_OUT | 0x37; // Delay
+
+    // Each delay command waits up to 63 us, longer guards are clamped to the
+    // room left in the packet
+    uint8_t *delay_end = packet + CH341Config::PACKET_LENGTH - 2;
+    while (delay_us > 0 && ptr < delay_end)
+    {
+        const uint8_t step = static_cast<uint8_t>(std::min<uint16_t>(delay_us, CH341Config::UIO_STM_US_MAX));
+        *ptr++ = CH341Config::CMD_UIO_STM_US | step;
+        delay_us -= step;
+    }
 
-            if (ret != 0)
-            {
-                std::cerr << "Error in SPI read: " << libusb_error_name(ret) << std::endl;
-                return result;
-            }
+    if (assert_cs)
+    {
+        *ptr++ = CH341Config::CMD_UIO_STM_OUT | 0x36; // CS low
+    }
+    *ptr = CH341Config::CMD_UIO_STM_END;
+    return packet + CH341Config::PACKET_LENGTH;
+}
 
-            // Discard this response byte (echo of command byte)
-            // This is a workaround for the CH341 SPI adapter
-        }
+bool CH341SPI::transferStream(const SPISegment *segments, size_t count, bool release_cs)
+{
+    if (!device)
+    {
+        return false;
+    }
 
-        // Now read the requested bytes
-        for (size_t i = 0; i < read_length; i++)
-        {
-            // Send dummy byte (0xFF)
-            uint8_t cmd[2] = {CH341Config::CMD_SPI_STREAM, 0xFF};
+    // Each USB packet carries one SPI stream command followed by up to 31 data bytes
+    const size_t packet_payload = CH341Config::PACKET_LENGTH - 1;
 
-            ret = libusb_bulk_transfer(device, CH341Config::BULK_WRITE_EP,
-                                       cmd, sizeof(cmd), &transferred,
-                                       CH341Config::USB_TIMEOUT);
+    size_t stream_length = release_cs ? CH341Config::PACKET_LENGTH : 0;
+    size_t total_length = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const size_t length = segments[i].write_length + segments[i].read_length;
+        const size_t packets = (length + packet_payload - 1) / packet_payload;
+        stream_length += CH341Config::PACKET_LENGTH + packets + length;
+        total_length += length;
+    }
+    if (total_length == 0)
+    {
+        return true;
+    }
 
-            if (ret != 0)
-            {
-                std::cerr << "Error in SPI read byte: " << libusb_error_name(ret) << std::endl;
-                return result;
-            }
+    // Every segment starts with a CS pulse packet carrying the guard delay of
+    // the previous segment, followed by its data packets: written bytes first,
+    // then 0xFF while clocking in the response. The stream is built in the
+    // persistent buffer unless it is too long for it.
+    uint8_t *tx = usb_tx;
+    if (stream_length > CH341Config::USB_BUFFER_LENGTH)
+    {
+        tx_stream.resize(stream_length);
+        tx = tx_stream.data();
+    }
+    std::fill(tx, tx + stream_length, 0);
+    uint8_t *ptr = tx;
+    uint16_t pending_delay = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const SPISegment &segment = segments[i];
+        const size_t length = segment.write_length + segment.read_length;
+        const size_t packets = (length + packet_payload - 1) / packet_payload;
 
-            // Leer la respuesta
-            uint8_t response_byte;
-            ret = libusb_bulk_transfer(device, CH341Config::BULK_READ_EP,
-                                       &response_byte, 1, &transferred,
-                                       CH341Config::USB_TIMEOUT);
+        ptr = appendCSPacket(ptr, pending_delay, true);
+        pending_delay = segment.delay_us;
 
-            if (ret != 0)
+        size_t offset = 0;
+        for (size_t packet = 0; packet < packets; packet++)
+        {
+            const size_t chunk = std::min(packet_payload, length - offset);
+            *ptr++ = CH341Config::CMD_SPI_STREAM;
+            for (size_t j = 0; j < chunk; j++, offset++)
             {
-                std::cerr << "Error in SPI read byte: " << libusb_error_name(ret) << std::endl;
-                return result;
+                uint8_t byte = offset < segment.write_length ? segment.write_data[offset] : 0xFF;
+                *ptr++ = lsb_first ? swapBits(byte) : byte;
             }
-
-            // Process and send the response byte
-            result.push_back(lsb_first ? swapBits(response_byte) : response_byte);
         }
+    }
+    if (release_cs)
+    {
+        appendCSPacket(ptr, pending_delay, false);
+    }
 
-        // CS high
-        uint8_t cs_high[3] = {
-            CH341Config::CMD_UIO_STREAM,
-            CH341Config::CMD_UIO_STM_OUT | 0x37,
-            CH341Config::CMD_UIO_STM_END};
-
-        ret = libusb_bulk_transfer(device, CH341Config::BULK_WRITE_EP,
-                                   cs_high, sizeof(cs_high), &transferred,
+    int transferred = 0;
+    int ret = libusb_bulk_transfer(device, CH341Config::BULK_WRITE_EP,
+                                   tx, static_cast<int>(stream_length), &transferred,
                                    CH341Config::USB_TIMEOUT);
 
-        if (ret != 0)
+    if (ret != 0 || transferred != static_cast<int>(stream_length))
+    {
+        LOG_ERROR("Error in SPI write: " << libusb_error_name(ret));
+        return false;
+    }
+
+    // The adapter returns one byte per clocked byte, one short packet per SPI command
+    uint8_t *rx = usb_rx;
+    if (total_length > CH341Config::USB_BUFFER_LENGTH)
+    {
+        rx_stream.resize(total_length);
+        rx = rx_stream.data();
+    }
+    size_t received = 0;
+    while (received < total_length)
+    {
+        ret = libusb_bulk_transfer(device, CH341Config::BULK_READ_EP,
+                                   rx + received, static_cast<int>(total_length - received),
+                                   &transferred, CH341Config::USB_TIMEOUT);
+
+        if (ret != 0 || transferred <= 0)
         {
-            std::cerr << "Error setting CS high: " << libusb_error_name(ret) << std::endl;
+            LOG_ERROR("Error in SPI read: " << libusb_error_name(ret));
+            return false;
         }
-
-        return result;
+        received += transferred;
     }
-    catch (const std::exception &e)
+
+    // Discard the bytes clocked while writing and keep the requested ones
+    for (size_t i = 0; i < count; i++)
     {
-        std::cerr << "Exception in spiTransfer: " << e.what() << std::endl;
-        return std::vector<uint8_t>();
+        const SPISegment &segment = segments[i];
+        for (size_t j = 0; j < segment.read_length; j++)
+        {
+            uint8_t byte = rx[segment.write_length + j];
+            segment.read_data[j] = lsb_first ? swapBits(byte) : byte;
+        }
+        rx += segment.write_length + segment.read_length;
     }
+
+    return true;
 }
 
 bool CH341SPI::digitalWrite(uint8_t pin, bool value)
@@ -404,18 +502,12 @@ bool CH341SPI::digitalWrite(uint8_t pin, bool value)
     }
 
     // Send the GPIO command to the CH341
-    uint8_t cmd[4] = {
-        CH341Config::CMD_UIO_STREAM,
-        static_cast<uint8_t>(CH341Config::CMD_UIO_STM_OUT | _gpio_output),
-        static_cast<uint8_t>(CH341Config::CMD_UIO_STM_DIR | _gpio_direction),
-        CH341Config::CMD_UIO_STM_END};
-
-    int transferred = 0;
-    int ret = libusb_bulk_transfer(device, CH341Config::BULK_WRITE_EP,
-                                   cmd, sizeof(cmd), &transferred,
-                                   CH341Config::USB_TIMEOUT);
+    usb_tx[0] = CH341Config::CMD_UIO_STREAM;
+    usb_tx[1] = CH341Config::CMD_UIO_STM_OUT | _gpio_output;
+    usb_tx[2] = CH341Config::CMD_UIO_STM_DIR | _gpio_direction;
+    usb_tx[3] = CH341Config::CMD_UIO_STM_END;
 
-    return (ret == 0);
+    return sendCommand(4) == 0;
 }
 
 bool CH341SPI::digitalRead(uint8_t pin)
@@ -427,44 +519,31 @@ bool CH341SPI::digitalRead(uint8_t pin)
     _gpio_direction &= ~pin;
 
     // Send the command to configure the direction
-    uint8_t dir_cmd[3] = {
-        CH341Config::CMD_UIO_STREAM,
-        static_cast<uint8_t>(CH341Config::CMD_UIO_STM_DIR | _gpio_direction),
-        CH341Config::CMD_UIO_STM_END
-    };
-
-    int transferred = 0;
-    int ret = libusb_bulk_transfer(device, CH341Config::BULK_WRITE_EP,
-                                   dir_cmd, sizeof(dir_cmd), &transferred,
-                                   CH341Config::USB_TIMEOUT);
+    usb_tx[0] = CH341Config::CMD_UIO_STREAM;
+    usb_tx[1] = CH341Config::CMD_UIO_STM_DIR | _gpio_direction;
+    usb_tx[2] = CH341Config::CMD_UIO_STM_END;
 
-    if (ret != 0)
+    if (sendCommand(3) != 0)
         return false;
 
     // Command to read the state of the pins
-    uint8_t read_cmd[2] = {
-        CH341Config::CMD_UIO_STREAM | 0x80, // Command for reading
-        CH341Config::CMD_UIO_STM_END
-    };
+    usb_tx[0] = CH341Config::CMD_UIO_STREAM | 0x80; // Command for reading
+    usb_tx[1] = CH341Config::CMD_UIO_STM_END;
 
-    ret = libusb_bulk_transfer(device, CH341Config::BULK_WRITE_EP,
-                               read_cmd, sizeof(read_cmd), &transferred,
-                               CH341Config::USB_TIMEOUT);
-
-    if (ret != 0)
+    if (sendCommand(2) != 0)
         return false;
 
     // Read the response
-    uint8_t gpio_value;
-    ret = libusb_bulk_transfer(device, CH341Config::BULK_READ_EP,
-                               &gpio_value, 1, &transferred,
-                               CH341Config::USB_TIMEOUT);
+    int transferred = 0;
+    int ret = libusb_bulk_transfer(device, CH341Config::BULK_READ_EP,
+                                   usb_rx, 1, &transferred,
+                                   CH341Config::USB_TIMEOUT);
 
     if (ret != 0 || transferred != 1)
         return false;
 
     // Verify if the specific pin is high
-    return (gpio_value & pin) != 0;
+    return (usb_rx[0] & pin) != 0;
 }
 
 bool CH341SPI::pinMode(uint8_t pin, uint8_t mode)
@@ -482,17 +561,17 @@ bool CH341SPI::pinMode(uint8_t pin, uint8_t mode)
     }
 
     // Send the command to configure the direction
-    uint8_t cmd[3] = {
-        static_cast<uint8_t>(CH341Config::CMD_UIO_STREAM),
-        static_cast<uint8_t>(CH341Config::CMD_UIO_STM_DIR | _gpio_direction),
-        CH341Config::CMD_UIO_STM_END};
+    usb_tx[0] = CH341Config::CMD_UIO_STREAM;
+    usb_tx[1] = CH341Config::CMD_UIO_STM_DIR | _gpio_direction;
+    usb_tx[2] = CH341Config::CMD_UIO_STM_END;
 
-    int transferred = 0;
-    int ret = libusb_bulk_transfer(device, CH341Config::BULK_WRITE_EP,
-                                   cmd, sizeof(cmd), &transferred,
-                                   CH341Config::USB_TIMEOUT);
+    return sendCommand(3) == 0;
+}
 
-    return (ret == 0);
+bool CH341SPI::configureInterrupt(uint8_t pin, bool enable)
+{
+    (void)pin;
+    return enableInterrupt(enable);
 }
 
 bool CH341SPI::setInterruptCallback(InterruptCallback callback)
@@ -501,13 +580,73 @@ bool CH341SPI::setInterruptCallback(InterruptCallback callback)
     return true;
 }
 
+bool CH341SPI::submitInterruptTransfer()
+{
+    libusb_fill_interrupt_transfer(interruptTransfer, device, CH341Config::INTERRUPT_EP,
+                                   interruptReport, CH341Config::INTERRUPT_REPORT_LENGTH,
+                                   &CH341SPI::interruptTransferDone, this, 0);
+    int ret = libusb_submit_transfer(interruptTransfer);
+    if (ret != 0)
+    {
+        LOG_ERROR("Failed to submit interrupt transfer: " << libusb_error_name(ret));
+        return false;
+    }
+    interruptPending = true;
+    return true;
+}
+
+void LIBUSB_CALL CH341SPI::interruptTransferDone(libusb_transfer *transfer)
+{
+    CH341SPI *self = static_cast<CH341SPI *>(transfer->user_data);
+
+    if (transfer->status == LIBUSB_TRANSFER_COMPLETED)
+    {
+        // Each report is one rising edge of INT#, detected by the adapter
+        if (transfer->actual_length > 0 && self->interruptCallback)
+        {
+            self->interruptCallback();
+        }
+        if (self->threadRunning)
+        {
+            int ret = libusb_submit_transfer(transfer);
+            if (ret == 0)
+            {
+                return;
+            }
+            LOG_ERROR("Failed to resubmit interrupt transfer: " << libusb_error_name(ret));
+        }
+    }
+    else if (transfer->status != LIBUSB_TRANSFER_CANCELLED)
+    {
+        LOG_ERROR("Interrupt transfer failed (status " << transfer->status << ")");
+    }
+    self->interruptPending = false;
+}
+
 bool CH341SPI::enableInterrupt(bool enable)
 {
     if (enable && !interruptEnabled)
     {
-        interruptEnabled = true;
+        if (!device)
+        {
+            LOG_ERROR("CH341 not open");
+            return false;
+        }
+
+        // Prefer the interrupt endpoint, poll INT# if the adapter lacks it
+        if (!interruptTransfer)
+        {
+            interruptTransfer = libusb_alloc_transfer(0);
+        }
         threadRunning = true;
-        // Create a new thread to monitor the INT# pin
+        if (!interruptTransfer || !submitInterruptTransfer())
+        {
+            LOG_WARNING("CH341 interrupt endpoint unavailable, polling INT#");
+        }
+
+        interruptEnabled = true;
+        interruptLevel = false;
+        // Create a new thread to handle the INT# events
         interruptThread = std::thread(&CH341SPI::interruptMonitoringThread, this);
         return true;
     }
@@ -515,6 +654,13 @@ bool CH341SPI::enableInterrupt(bool enable)
     {
         interruptEnabled = false;
         threadRunning = false;
+        // The event thread keeps running until the cancellation completes. This
+        // cancel misses a transfer its callback is resubmitting, the event
+        // thread cancels that one itself.
+        if (interruptPending)
+        {
+            libusb_cancel_transfer(interruptTransfer);
+        }
         if (interruptThread.joinable())
         {
             interruptThread.join();
@@ -526,7 +672,37 @@ bool CH341SPI::enableInterrupt(bool enable)
 
 void CH341SPI::interruptMonitoringThread()
 {
-    // Vector to store the state of the interrupt register
+    RealTime::enterThread("ch341-irq");
+
+    if (interruptPending)
+    {
+        // Events of this adapter's own context: the interrupt transfer, and
+        // the bulk transfers of other threads while they wait
+        bool cancelled = false;
+        while (interruptPending)
+        {
+            // Callbacks run on this thread, so between two calls the transfer
+            // is not being resubmitted and the cancellation cannot be lost
+            if (!threadRunning && !cancelled)
+            {
+                int ret = libusb_cancel_transfer(interruptTransfer);
+                cancelled = ret == 0 || ret == LIBUSB_ERROR_NOT_FOUND;
+            }
+            timeval timeout = {0, 100000};
+            libusb_handle_events_timeout_completed(context, &timeout, nullptr);
+        }
+        if (!threadRunning)
+        {
+            return;
+        }
+
+        // The transfer failed or could not be resubmitted, keep serving
+        // INT# by polling for as long as the interrupt stays enabled
+        LOG_WARNING("CH341 interrupt endpoint lost, polling INT#");
+        interruptLevel = false;
+    }
+
+    // Command to read the state of the pins
     uint8_t cmd[2] = {CH341Config::CMD_UIO_STREAM | 0x80, CH341Config::CMD_UIO_STM_END};
 
     while (threadRunning)
@@ -552,9 +728,8 @@ void CH341SPI::interruptMonitoringThread()
                 // Note: You may need to adjust this logic based on how it's connected
                 bool interruptTriggered = ((pinState & 0x40) == 0); // Active low
 
-                static bool lastState = false;
-                // Detect state change (falling edge)
-                if (interruptTriggered && !lastState)
+                // Detect state change (falling edge), per adapter
+                if (interruptTriggered && !interruptLevel)
                 {
                     // Call the callback if set
                     if (interruptCallback)
@@ -562,11 +737,11 @@ void CH341SPI::interruptMonitoringThread()
                         interruptCallback();
                     }
                 }
-                lastState = interruptTriggered;
+                interruptLevel = interruptTriggered;
             }
         }
 
         // Sleep for a short time to avoid saturating the bus
         std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
-}
\ No newline at end of file
+}
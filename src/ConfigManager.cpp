@@ -141,14 +141,20 @@ cJSON* ConfigManager::getNestedItem(const std::string& path) {
     
     cJSON* current = root;
     
-    for (size_t i = 0; i < parts.size() - 1; ++i) {
-        current = cJSON_GetObjectItem(current, parts[i].c_str());
+    for (const auto& part : parts) {
+        // Numeric parts index into arrays, e.g. "gateway.radios.0.frequency"
+        if (cJSON_IsArray(current) && !part.empty() &&
+            part.find_first_not_of("0123456789") == std::string::npos) {
+            current = cJSON_GetArrayItem(current, std::stoi(part));
+        } else {
+            current = cJSON_GetObjectItem(current, part.c_str());
+        }
         if (current == nullptr) {
             return nullptr;
         }
     }
     
-    return cJSON_GetObjectItem(current, parts.back().c_str());
+    return current;
 }
 
 std::string ConfigManager::getNestedString(const std::string& path, const std::string& defaultValue) {
@@ -169,6 +175,24 @@ int ConfigManager::getNestedInt(const std::string& path, int defaultValue) {
     return item->valueint;
 }
 
+double ConfigManager::getNestedDouble(const std::string& path, double defaultValue) {
+    cJSON* item = getNestedItem(path);
+    if (item == nullptr || !cJSON_IsNumber(item)) {
+        return defaultValue;
+    }
+    
+    return item->valuedouble;
+}
+
+int ConfigManager::getNestedArraySize(const std::string& path) {
+    cJSON* item = getNestedItem(path);
+    if (item == nullptr || !cJSON_IsArray(item)) {
+        return 0;
+    }
+    
+    return cJSON_GetArraySize(item);
+}
+
 bool ConfigManager::getNestedBool(const std::string& path, bool defaultValue) {
     cJSON* item = getNestedItem(path);
     if (item == nullptr || !cJSON_IsBool(item)) {
@@ -0,0 +1,139 @@
+/**
+ * @file EventNotifier.cpp
+ * @brief Implementation of the pollable event descriptor
+ *
+ * The timer uses CLOCK_MONOTONIC with absolute expirations, the clock behind
+ * std::chrono::steady_clock on Linux, so deadlines computed by the MAC layer
+ * are passed through without conversion.
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+#include "EventNotifier.hpp"
+#include "Logger.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+EventNotifier::~EventNotifier()
+{
+    close();
+}
+
+#ifdef __linux__
+
+bool EventNotifier::open()
+{
+    if (epollFd >= 0)
+        return true;
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || timerFd < 0 || wakeFd < 0)
+    {
+        LOG_ERROR("Cannot create event descriptors: " << strerror(errno));
+        close();
+        return false;
+    }
+
+    for (int fd : {timerFd, wakeFd})
+    {
+        epoll_event event;
+        std::memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0)
+        {
+            LOG_ERROR("Cannot add event descriptor: " << strerror(errno));
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void EventNotifier::close()
+{
+    for (int *fd : {&epollFd, &timerFd, &wakeFd})
+    {
+        if (*fd >= 0)
+            ::close(*fd);
+        *fd = -1;
+    }
+}
+
+void EventNotifier::arm(std::chrono::steady_clock::time_point deadline)
+{
+    if (timerFd < 0)
+        return;
+
+    itimerspec spec;
+    std::memset(&spec, 0, sizeof(spec));
+    if (deadline != std::chrono::steady_clock::time_point::max())
+    {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+        // An all-zero it_value disarms, a deadline already past fires at once
+        if (ns <= 0)
+            ns = 1;
+        spec.it_value.tv_sec = static_cast<time_t>(ns / 1000000000);
+        spec.it_value.tv_nsec = static_cast<long>(ns % 1000000000);
+    }
+    timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+void EventNotifier::notify()
+{
+    if (wakeFd < 0)
+        return;
+
+    uint64_t one = 1;
+    ssize_t written = write(wakeFd, &one, sizeof(one));
+    (void)written; // EAGAIN only when the counter is saturated, already readable
+}
+
+void EventNotifier::consume()
+{
+    uint64_t value;
+    ssize_t n;
+    if (timerFd >= 0)
+        n = read(timerFd, &value, sizeof(value));
+    if (wakeFd >= 0)
+        n = read(wakeFd, &value, sizeof(value));
+    (void)n;
+}
+
+#else
+
+bool EventNotifier::open()
+{
+    LOG_ERROR("Event descriptors are not supported on this platform");
+    return false;
+}
+
+void EventNotifier::close()
+{
+}
+
+void EventNotifier::arm(std::chrono::steady_clock::time_point deadline)
+{
+    (void)deadline;
+}
+
+void EventNotifier::notify()
+{
+}
+
+void EventNotifier::consume()
+{
+}
+
+#endif
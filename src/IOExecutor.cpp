@@ -0,0 +1,705 @@
+/**
+ * @file IOExecutor.cpp
+ * @brief Implementation of the I/O executor
+ *
+ * Callers append operations to a queue under a mutex and return; the I/O
+ * thread wakes every IO_PERIOD_MS, or at once for flush(), and swaps the
+ * queue out. Operations on the same descriptor are linked (IOSQE_IO_LINK) so
+ * they run in the order they were queued; operations on different
+ * descriptors run in parallel. A write that needs a sync is linked to its
+ * fsync. The batch is submitted and waited for with one io_uring_enter().
+ *
+ * A call() splits the batch: what was queued before it completes first.
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+#include "IOExecutor.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define IOEXECUTOR_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+namespace
+{
+    constexpr int IO_PERIOD_MS = 10;
+
+    // Result of an operation the ring has not completed
+    constexpr int NO_RESULT = INT_MIN;
+}
+
+struct IOExecutor::Op
+{
+    enum Type
+    {
+        WRITE,
+        SYNC,
+        SEND,
+        REPLACE,
+        CALL
+    };
+
+    Type type = WRITE;
+    int fd = -1;
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    bool datasync = false;
+    std::vector<uint8_t> data;
+    std::string path;          ///< REPLACE: file to replace, fd is the temporary file
+    std::function<void()> task;
+    Completion done;
+    int result = NO_RESULT;
+};
+
+#ifdef IOEXECUTOR_IO_URING
+
+struct IOExecutor::Ring
+{
+    int fd = -1;
+    unsigned entries = 0;
+
+    void *sqMap = MAP_FAILED;
+    size_t sqMapSize = 0;
+    void *cqMap = MAP_FAILED;
+    size_t cqMapSize = 0;
+    io_uring_sqe *sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+    size_t sqesSize = 0;
+
+    unsigned *sqTail = nullptr;
+    unsigned *sqMask = nullptr;
+    unsigned *sqArray = nullptr;
+    unsigned *cqHead = nullptr;
+    unsigned *cqTail = nullptr;
+    unsigned *cqMask = nullptr;
+    io_uring_cqe *cqes = nullptr;
+
+    unsigned queuedSqes = 0;   ///< Filled but not yet published to the kernel
+
+    ~Ring()
+    {
+        if (sqes != MAP_FAILED)
+            munmap(sqes, sqesSize);
+        if (cqMap != MAP_FAILED && cqMap != sqMap)
+            munmap(cqMap, cqMapSize);
+        if (sqMap != MAP_FAILED)
+            munmap(sqMap, sqMapSize);
+        if (fd >= 0)
+            ::close(fd);
+    }
+
+    bool setup(unsigned depth)
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd = static_cast<int>(syscall(__NR_io_uring_setup, depth, &params));
+        if (fd < 0)
+            return false;
+        entries = params.sq_entries;
+
+        sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+            sqMapSize = cqMapSize = std::max(sqMapSize, cqMapSize);
+
+        sqMap = mmap(nullptr, sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqMap == MAP_FAILED)
+            return false;
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+            cqMap = sqMap;
+        else
+        {
+            cqMap = mmap(nullptr, cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (cqMap == MAP_FAILED)
+                return false;
+        }
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe *>(
+            mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED)
+            return false;
+
+        uint8_t *sq = static_cast<uint8_t *>(sqMap);
+        uint8_t *cq = static_cast<uint8_t *>(cqMap);
+        sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        sqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    /// Next free SQE, cleared; nullptr once `entries` are queued
+    io_uring_sqe *next(uint64_t user_data)
+    {
+        if (queuedSqes >= entries)
+            return nullptr;
+        unsigned tail = *sqTail + queuedSqes;
+        unsigned index = tail & *sqMask;
+        io_uring_sqe *sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->user_data = user_data;
+        sqArray[index] = index;
+        queuedSqes++;
+        return sqe;
+    }
+
+    /// Publish the queued SQEs, wait for all their completions and pass each to handle()
+    template <typename Handler>
+    bool submitAndWait(Handler handle)
+    {
+        unsigned count = queuedSqes;
+        queuedSqes = 0;
+        __atomic_store_n(sqTail, *sqTail + count, __ATOMIC_RELEASE);
+
+        unsigned submitted = 0;
+        unsigned reaped = 0;
+        while (reaped < count)
+        {
+            unsigned head = *cqHead;
+            unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+            for (; head != tail; head++, reaped++)
+            {
+                const io_uring_cqe &cqe = cqes[head & *cqMask];
+                handle(cqe.user_data, cqe.res);
+            }
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+            if (reaped >= count)
+                break;
+
+            // The kernel does not wait when it could not submit everything
+            long ret = syscall(__NR_io_uring_enter, fd, count - submitted, count - reaped,
+                               IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (ret < 0)
+            {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                    continue;
+                return false;
+            }
+            submitted += static_cast<unsigned>(ret);
+        }
+        return true;
+    }
+};
+
+#else
+
+struct IOExecutor::Ring
+{
+};
+
+#endif
+
+IOExecutor::IOExecutor() = default;
+
+IOExecutor::~IOExecutor()
+{
+    stop();
+}
+
+bool IOExecutor::start(unsigned queue_depth)
+{
+    if (running)
+        return true;
+
+#ifndef _WIN32
+#ifdef IOEXECUTOR_IO_URING
+    ring.reset(new Ring());
+    if (!ring->setup(std::max(queue_depth, 2u)))
+    {
+        LOG_WARNING("io_uring not available (" << strerror(errno) << "), I/O thread uses plain system calls");
+        ring.reset();
+    }
+#else
+    (void)queue_depth;
+#endif
+    ringActive = ring != nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = false;
+        running = true;
+    }
+    worker = std::thread(&IOExecutor::workerLoop, this);
+    return true;
+#else
+    (void)queue_depth;
+    LOG_ERROR("I/O executor is not supported on this platform");
+    return false;
+#endif
+}
+
+void IOExecutor::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running)
+            return;
+        // Nothing new is accepted, the worker completes what is queued
+        running = false;
+        stopping = true;
+    }
+    wake.notify_one();
+    if (worker.joinable())
+        worker.join();
+    idle.notify_all();
+
+    ring.reset();
+    ringActive = false;
+}
+
+bool IOExecutor::write(int fd, uint64_t offset, std::vector<uint8_t> data, bool datasync, Completion done)
+{
+    Op op;
+    op.type = Op::WRITE;
+    op.fd = fd;
+    op.offset = offset;
+    op.data = std::move(data);
+    op.datasync = datasync;
+    op.done = std::move(done);
+    return enqueue(std::move(op));
+}
+
+bool IOExecutor::sync(int fd, uint64_t offset, uint64_t length, Completion done)
+{
+    Op op;
+    op.type = Op::SYNC;
+    op.fd = fd;
+    op.offset = offset;
+    op.length = length;
+    op.done = std::move(done);
+    return enqueue(std::move(op));
+}
+
+bool IOExecutor::send(int fd, std::vector<uint8_t> data, Completion done)
+{
+    Op op;
+    op.type = Op::SEND;
+    op.fd = fd;
+    op.data = std::move(data);
+    op.done = std::move(done);
+    return enqueue(std::move(op));
+}
+
+bool IOExecutor::replaceFile(const std::string &path, std::string contents, Completion done)
+{
+    Op op;
+    op.type = Op::REPLACE;
+    op.path = path;
+    op.data.assign(contents.begin(), contents.end());
+    op.done = std::move(done);
+    return enqueue(std::move(op));
+}
+
+bool IOExecutor::call(std::function<void()> task)
+{
+    Op op;
+    op.type = Op::CALL;
+    op.task = std::move(task);
+    return enqueue(std::move(op));
+}
+
+void IOExecutor::flush()
+{
+    // A task waiting for itself would never return
+    if (std::this_thread::get_id() == worker.get_id())
+        return;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    uint64_t target = queued;
+    if (completed >= target)
+        return;
+
+    flushWaiters++;
+    wake.notify_one();
+    idle.wait(lock, [this, target] { return completed >= target; });
+    flushWaiters--;
+}
+
+bool IOExecutor::enqueue(Op &&op)
+{
+    // No notify: the I/O thread picks the operation up on its next pass, so
+    // the caller makes no system call
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!running)
+        return false;
+    pending.push_back(std::move(op));
+    queued++;
+    return true;
+}
+
+void IOExecutor::workerLoop()
+{
+    while (true)
+    {
+        std::vector<Op> batch;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (pending.empty() && !stopping)
+            {
+                wake.wait_for(lock, std::chrono::milliseconds(IO_PERIOD_MS),
+                              [this] { return stopping.load() || (flushWaiters > 0 && !pending.empty()); });
+            }
+            batch.swap(pending);
+            if (batch.empty() && stopping)
+                break;
+        }
+        if (batch.empty())
+            continue;
+
+        execute(batch);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            completed += batch.size();
+        }
+        idle.notify_all();
+    }
+}
+
+void IOExecutor::execute(std::vector<Op> &batch)
+{
+    std::vector<Op *> io;
+    auto runIo = [this, &io] {
+        if (io.empty())
+            return;
+
+        // Replacements of the same file would share path.tmp, only the last
+        // one is carried out and the earlier ones complete with its result
+        std::vector<Op *> run;
+        std::vector<std::pair<Op *, Op *>> superseded;
+        for (size_t i = 0; i < io.size(); i++)
+        {
+            Op *later = nullptr;
+            if (io[i]->type == Op::REPLACE)
+            {
+                for (size_t j = i + 1; j < io.size() && !later; j++)
+                {
+                    if (io[j]->type == Op::REPLACE && io[j]->path == io[i]->path)
+                        later = io[j];
+                }
+            }
+            if (later)
+                superseded.emplace_back(io[i], later);
+            else
+                run.push_back(io[i]);
+        }
+
+        if (ringActive)
+            executeRing(run);
+        else
+        {
+            for (Op *op : run)
+                executeDirect(*op);
+        }
+        // Chains of superseded replacements resolve back to front
+        for (auto it = superseded.rbegin(); it != superseded.rend(); ++it)
+            it->first->result = it->second->result;
+        for (Op *op : io)
+            finish(*op);
+        io.clear();
+    };
+
+    for (Op &op : batch)
+    {
+        if (op.type != Op::CALL)
+        {
+            io.push_back(&op);
+            continue;
+        }
+        runIo();
+        if (op.task)
+            op.task();
+        operationCount++;
+    }
+    runIo();
+}
+
+#ifdef IOEXECUTOR_IO_URING
+
+void IOExecutor::executeRing(const std::vector<Op *> &queuedOps)
+{
+    std::vector<Op *> ops(queuedOps);
+
+    // Temporary files of the replacements
+    for (Op *op : ops)
+    {
+        if (op->type != Op::REPLACE)
+            continue;
+        op->fd = ::open((op->path + ".tmp").c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (op->fd < 0)
+            op->result = -errno;
+    }
+
+    // Operations on one descriptor are contiguous and keep their order
+    std::stable_sort(ops.begin(), ops.end(), [](const Op *a, const Op *b) { return a->fd < b->fd; });
+
+    // user_data: operation index, low bit set for the sync that follows a write.
+    // A sync cancelled because its write failed or wrote short keeps the
+    // write's result; the sync is made again below.
+    std::vector<char> syncCancelled(ops.size(), 0);
+    auto handle = [&ops, &syncCancelled](uint64_t user_data, int res) {
+        size_t index = user_data >> 1;
+        Op &op = *ops[index];
+        if ((user_data & 1) == 0)
+            op.result = res;
+        else if (res == -ECANCELED)
+            syncCancelled[index] = 1;
+        else if (res < 0 && op.result >= 0)
+            op.result = res;
+    };
+
+    batchCount++;
+    io_uring_sqe *lastSqe = nullptr;
+    int lastFd = -1;
+    bool ok = true;
+    for (size_t i = 0; i < ops.size() && ok; i++)
+    {
+        Op &op = *ops[i];
+        if (op.result != NO_RESULT)
+            continue;
+
+        bool withSync = op.type == Op::REPLACE || (op.type == Op::WRITE && op.datasync);
+        if (ring->queuedSqes + (withSync ? 2 : 1) > ring->entries)
+        {
+            // Ring full: everything submitted so far completes before the rest
+            ok = ring->submitAndWait(handle);
+            batchCount++;
+            lastSqe = nullptr;
+        }
+        if (lastSqe && lastFd == op.fd)
+            lastSqe->flags |= IOSQE_IO_LINK;
+
+        io_uring_sqe *sqe = ring->next(static_cast<uint64_t>(i) << 1);
+        sqe->fd = op.fd;
+        switch (op.type)
+        {
+        case Op::WRITE:
+        case Op::REPLACE:
+            sqe->opcode = IORING_OP_WRITE;
+            sqe->off = op.offset;
+            sqe->addr = reinterpret_cast<uint64_t>(op.data.data());
+            sqe->len = static_cast<uint32_t>(op.data.size());
+            break;
+        case Op::SEND:
+            sqe->opcode = IORING_OP_SEND;
+            sqe->addr = reinterpret_cast<uint64_t>(op.data.data());
+            sqe->len = static_cast<uint32_t>(op.data.size());
+            sqe->msg_flags = MSG_NOSIGNAL | MSG_DONTWAIT;
+            break;
+        default:
+            sqe->opcode = IORING_OP_FSYNC;
+            sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+            sqe->off = op.offset;
+            sqe->len = op.length <= UINT32_MAX ? static_cast<uint32_t>(op.length) : 0;
+            break;
+        }
+
+        if (withSync)
+        {
+            sqe->flags |= IOSQE_IO_LINK;
+            sqe = ring->next((static_cast<uint64_t>(i) << 1) | 1);
+            sqe->opcode = IORING_OP_FSYNC;
+            sqe->fd = op.fd;
+            // The rename of a replacement also needs the size on disk
+            sqe->fsync_flags = op.type == Op::REPLACE ? 0 : IORING_FSYNC_DATASYNC;
+        }
+        lastSqe = sqe;
+        lastFd = op.fd;
+    }
+    if (ok && ring->queuedSqes > 0)
+        ok = ring->submitAndWait(handle);
+
+    if (!ok)
+    {
+        LOG_ERROR("io_uring failed (" << strerror(errno) << "), I/O thread falls back to plain system calls");
+        ring.reset();
+        ringActive = false;
+    }
+
+    // Operations the ring did not complete, did not support (old kernels
+    // reject unknown opcodes with EINVAL) or wrote short are finished with
+    // plain system calls, in order per descriptor. A failed or short
+    // operation cancels the ones linked after it on the same descriptor;
+    // those are made again too.
+    int brokenFd = -1;
+    for (size_t i = 0; i < ops.size(); i++)
+    {
+        Op *op = ops[i];
+        bool retry = op->result == NO_RESULT || op->result == -EINVAL ||
+                     (op->result == -ECANCELED && op->fd == brokenFd);
+        if (retry)
+        {
+            if (op->type == Op::REPLACE && op->fd >= 0)
+                ::close(op->fd);
+            if (op->type == Op::REPLACE)
+                op->fd = -1;
+            executeDirect(*op);
+            brokenFd = op->fd;
+            continue;
+        }
+
+        bool wrote = op->type == Op::WRITE || op->type == Op::REPLACE || op->type == Op::SEND;
+        if (op->result < 0 || (wrote && static_cast<size_t>(op->result) < op->data.size()))
+            brokenFd = op->fd;
+
+        if ((op->type == Op::WRITE || op->type == Op::REPLACE) && op->result >= 0 &&
+            static_cast<size_t>(op->result) < op->data.size())
+        {
+            Op rest;
+            rest.type = Op::WRITE;
+            rest.fd = op->fd;
+            rest.offset = op->offset + op->result;
+            rest.data.assign(op->data.begin() + op->result, op->data.end());
+            rest.datasync = true;
+            executeDirect(rest);
+            op->result = rest.result < 0 ? rest.result : op->result + rest.result;
+        }
+        else if (syncCancelled[i] && op->result >= 0)
+        {
+            Op sync;
+            sync.type = Op::SYNC;
+            sync.fd = op->fd;
+            executeDirect(sync);
+            if (sync.result < 0)
+                op->result = sync.result;
+        }
+
+        if (op->type == Op::REPLACE)
+        {
+            if (op->result >= 0 && ::rename((op->path + ".tmp").c_str(), op->path.c_str()) != 0)
+                op->result = -errno;
+            if (op->result < 0)
+                ::unlink((op->path + ".tmp").c_str());
+            if (op->fd >= 0)
+                ::close(op->fd);
+        }
+    }
+}
+
+#else
+
+void IOExecutor::executeRing(const std::vector<Op *> &ops)
+{
+    for (Op *op : ops)
+        executeDirect(*op);
+}
+
+#endif
+
+#ifndef _WIN32
+
+void IOExecutor::executeDirect(Op &op)
+{
+    auto writeAll = [](int fd, const std::vector<uint8_t> &data, uint64_t offset) {
+        size_t written = 0;
+        while (written < data.size())
+        {
+            ssize_t n = pwrite(fd, data.data() + written, data.size() - written, static_cast<off_t>(offset + written));
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+                return -errno;
+            written += static_cast<size_t>(n);
+        }
+        return static_cast<int>(written);
+    };
+    auto dataSync = [](int fd) {
+#ifdef __linux__
+        return fdatasync(fd) == 0 ? 0 : -errno;
+#else
+        return fsync(fd) == 0 ? 0 : -errno;
+#endif
+    };
+
+    switch (op.type)
+    {
+    case Op::WRITE:
+        op.result = writeAll(op.fd, op.data, op.offset);
+        if (op.result >= 0 && op.datasync)
+        {
+            int synced = dataSync(op.fd);
+            if (synced < 0)
+                op.result = synced;
+        }
+        break;
+
+    case Op::SYNC:
+        op.result = dataSync(op.fd);
+        break;
+
+    case Op::SEND:
+    {
+        ssize_t n;
+        do
+            n = ::send(op.fd, op.data.data(), op.data.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        while (n < 0 && errno == EINTR);
+        op.result = n < 0 ? -errno : static_cast<int>(n);
+        break;
+    }
+
+    case Op::REPLACE:
+    {
+        std::string temporary = op.path + ".tmp";
+        int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (fd < 0)
+        {
+            op.result = -errno;
+            break;
+        }
+        op.result = writeAll(fd, op.data, 0);
+        if (op.result >= 0 && fsync(fd) != 0)
+            op.result = -errno;
+        ::close(fd);
+        if (op.result >= 0 && ::rename(temporary.c_str(), op.path.c_str()) != 0)
+            op.result = -errno;
+        if (op.result < 0)
+            ::unlink(temporary.c_str());
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+#else
+
+void IOExecutor::executeDirect(Op &op)
+{
+    op.result = -ENOSYS;
+}
+
+#endif
+
+void IOExecutor::finish(Op &op)
+{
+    operationCount++;
+    if (op.result < 0 && op.type != Op::SEND)
+    {
+        LOG_ERROR("Background " << (op.type == Op::REPLACE ? "save of " + op.path : std::string("file I/O"))
+                                << " failed: " << strerror(-op.result));
+    }
+    if (op.done)
+        op.done(op.result);
+}
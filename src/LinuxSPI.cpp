@@ -1,4 +1,6 @@
 #include "LinuxSPI.hpp"
+#include "Logger.hpp"
+#include "RealTime.hpp"
 #include <fcntl.h>
 #include <unistd.h>
 #ifdef __linux__
@@ -6,12 +8,21 @@
 #include <linux/gpio.h>
 #include <sys/ioctl.h>
 #endif
-#include <fstream>
-#include <iostream>
-#include <sstream>
+#include <cerrno>
 #include <cstring>
-#include <map>
 #include <algorithm>
+#include <chrono>
+
+#if defined(__linux__) && defined(GPIO_V2_GET_LINE_IOCTL)
+#define LINUXSPI_GPIO_CDEV 1
+#include <poll.h>
+
+namespace
+{
+    const char *const GPIO_CONSUMER = "LoRaWANCH341";
+    constexpr int INTERRUPT_POLL_MS = 100;
+}
+#endif
 
 LinuxSPI::LinuxSPI(const std::string& device, uint32_t speed, uint8_t mode)
     : device_path(device),
@@ -21,11 +32,8 @@ LinuxSPI::LinuxSPI(const std::string& device, uint32_t speed, uint8_t mode)
       interrupt_running(false),
       interrupt_pin(-1)
 {
-#ifdef __linux__
-    gpio_export_path = "/sys/class/gpio/export";
-    gpio_unexport_path = "/sys/class/gpio/unexport";
-#else
-    std::cerr << "Warning: LinuxSPI implementation is only available on Linux systems." << std::endl;
+#ifndef __linux__
+    LOG_WARNING("LinuxSPI implementation is only available on Linux systems.");
 #endif
 }
 
@@ -38,13 +46,13 @@ bool LinuxSPI::open() {
     // Open SPI device
     fd = ::open(device_path.c_str(), O_RDWR);
     if (fd < 0) {
-        std::cerr << "Error: Could not open SPI device: " << device_path << std::endl;
+        LOG_ERROR("Could not open SPI device: " << device_path);
         return false;
     }
 
     // Configure SPI mode
     if (ioctl(fd, SPI_IOC_WR_MODE, &spi_mode) < 0) {
-        std::cerr << "Error: Could not configure SPI mode" << std::endl;
+        LOG_ERROR("Could not configure SPI mode");
         ::close(fd);
         fd = -1;
         return false;
@@ -53,7 +61,7 @@ bool LinuxSPI::open() {
     // Configure bits per word (8 bits)
     uint8_t bits = 8;
     if (ioctl(fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0) {
-        std::cerr << "Error: Could not configure bits per word" << std::endl;
+        LOG_ERROR("Could not configure bits per word");
         ::close(fd);
         fd = -1;
         return false;
@@ -61,7 +69,7 @@ bool LinuxSPI::open() {
 
     // Configure SPI speed
     if (ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed_hz) < 0) {
-        std::cerr << "Error: Could not configure SPI speed" << std::endl;
+        LOG_ERROR("Could not configure SPI speed");
         ::close(fd);
         fd = -1;
         return false;
@@ -69,7 +77,7 @@ bool LinuxSPI::open() {
 
     return true;
 #else
-    std::cerr << "Error: Linux SPI not supported on this platform" << std::endl;
+    LOG_ERROR("Linux SPI not supported on this platform");
     return false;
 #endif
 }
@@ -85,218 +93,408 @@ void LinuxSPI::close() {
         fd = -1;
     }
 
-    // Unexport all used GPIO pins
-    for (const auto& pin_entry : gpio_pin_paths) {
-        unexportGPIO(pin_entry.first);
+    // Release the GPIO lines
+    if (gpio_request_fd >= 0) {
+        ::close(gpio_request_fd);
+        gpio_request_fd = -1;
     }
-    gpio_pin_paths.clear();
+    gpio_requested = 0;
+    gpio_lines.clear();
 #endif
 }
 
 std::vector<uint8_t> LinuxSPI::transfer(const std::vector<uint8_t>& write_data, size_t read_length) {
-#ifdef __linux__
-    if (fd < 0) {
-        return {};
-    }
-
-    size_t total_length = std::max(write_data.size(), read_length);
-    if (total_length == 0) {
-        return {};
-    }
+    std::vector<uint8_t> rx_buffer(read_length, 0);
 
-    // Prepare output buffer
-    std::vector<uint8_t> tx_buffer(total_length, 0);
-    std::copy(write_data.begin(), write_data.end(), tx_buffer.begin());
-
-    // Prepare input buffer
-    std::vector<uint8_t> rx_buffer(total_length, 0);
-
-    // Configure SPI transfer structure
-    struct spi_ioc_transfer tr = {
-        .tx_buf = (unsigned long)tx_buffer.data(),
-        .rx_buf = (unsigned long)rx_buffer.data(),
-        .len = static_cast<uint32_t>(total_length),
-        .speed_hz = speed_hz,
-        .delay_usecs = 0,
-        .bits_per_word = 8,
-        .cs_change = 0,
-        .tx_nbits = 0,
-        .rx_nbits = 0,
-        .pad = 0
-    };
-
-    // Execute SPI transfer
-    if (ioctl(fd, SPI_IOC_MESSAGE(1), &tr) < 0) {
-        std::cerr << "Error: SPI transfer failed" << std::endl;
+    if (!transfer(write_data.data(), write_data.size(), rx_buffer.data(), read_length)) {
         return {};
     }
 
-    // Return received data
+    // Return the bytes clocked in after the written ones
     return rx_buffer;
-#else
-    // On non-Linux platforms, return an empty vector
-    std::cerr << "Error: Linux SPI not supported on this platform" << std::endl;
-    return {};
-#endif
 }
 
-bool LinuxSPI::exportGPIO(uint8_t pin) {
+bool LinuxSPI::transferBatch(const SPISegment* segments, size_t count) {
 #ifdef __linux__
-    std::ofstream exportFile(gpio_export_path);
-    if (!exportFile.is_open()) {
-        std::cerr << "Error: Unable to open GPIO export file" << std::endl;
+    if (fd < 0) {
         return false;
     }
 
-    exportFile << pin;
-    exportFile.close();
-
-    // Wait a moment for the system to create the files
-    usleep(100000); // 100ms
-
-    exportFile << pin;
-    exportFile.close();
-
+    // Two entries per segment (write and read phase), well below the spidev
+    // message size limit
+    constexpr size_t MAX_SEGMENTS = 64;
+    struct spi_ioc_transfer tr[2 * MAX_SEGMENTS];
+
+    // spidev waits delay_usecs before it releases chip select, so a guard
+    // time inside a message would run with NSS asserted. A segment with a
+    // guard ends the message instead and the wait happens after it.
+    size_t done = 0;
+    while (done < count) {
+        std::memset(tr, 0, sizeof(tr));
+        unsigned int entries = 0;
+        size_t used = 0;
+        uint16_t guard_us = 0;
+
+        while (used < MAX_SEGMENTS && done + used < count) {
+            const SPISegment& segment = segments[done + used];
+            used++;
+            const unsigned int first = entries;
+
+            if (segment.write_length > 0) {
+                tr[entries].tx_buf = reinterpret_cast<uintptr_t>(segment.write_data);
+                tr[entries].len = static_cast<uint32_t>(segment.write_length);
+                tr[entries].speed_hz = speed_hz;
+                tr[entries].bits_per_word = 8;
+                entries++;
+            }
+            if (segment.read_length > 0) {
+                tr[entries].rx_buf = reinterpret_cast<uintptr_t>(segment.read_data);
+                tr[entries].len = static_cast<uint32_t>(segment.read_length);
+                tr[entries].speed_hz = speed_hz;
+                tr[entries].bits_per_word = 8;
+                entries++;
+            }
+            if (entries == first) {
+                continue;
+            }
 
-    usleep(100000); // 100ms
+            // Release chip select after the segment
+            tr[entries - 1].cs_change = 1;
+            if (segment.delay_us > 0) {
+                guard_us = segment.delay_us;
+                break;
+            }
+        }
 
+        if (entries > 0) {
+            // On the last transfer cs_change would keep chip select asserted, the
+            // driver releases it at the end of the message anyway
+            tr[entries - 1].cs_change = 0;
 
-    std::stringstream ss;
-    ss << "/sys/class/gpio/gpio" << static_cast<int>(pin);
-    gpio_pin_paths[pin] = ss.str();
+            if (ioctl(fd, SPI_IOC_MESSAGE(entries), tr) < 0) {
+                reportTransferError();
+                return false;
+            }
+        }
+        done += used;
 
+        if (guard_us > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(guard_us));
+        }
+    }
     return true;
 #else
+    reportTransferError();
     return false;
 #endif
 }
 
-bool LinuxSPI::unexportGPIO(uint8_t pin) {
+void LinuxSPI::reportTransferError() {
 #ifdef __linux__
-    std::ofstream unexportFile(gpio_unexport_path);
-    if (!unexportFile.is_open()) {
-        std::cerr << "Error: Unable to open GPIO unexport file" << std::endl;
-        return false;
-    }
+    LOG_ERROR("SPI transfer failed");
+#else
+    LOG_ERROR("Linux SPI not supported on this platform");
+#endif
+}
 
-    unexportFile << pin;
-    unexportFile.close();
+#ifdef LINUXSPI_GPIO_CDEV
 
-    // Remove pin's path from the map
-    gpio_pin_paths.erase(pin);
+int LinuxSPI::lineIndex(uint8_t pin) const {
+    for (size_t i = 0; i < gpio_lines.size(); i++) {
+        if (gpio_lines[i].pin == pin) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+bool LinuxSPI::lineConfig(size_t count, gpio_v2_line_config& config) const {
+    // Lines with the same flags share one attribute, the output values take another
+    std::memset(&config, 0, sizeof(config));
+    config.flags = GPIO_V2_LINE_FLAG_INPUT;
+    uint64_t outputs = 0;
+    uint64_t high = 0;
+    for (size_t i = 0; i < count; i++) {
+        const uint64_t bit = uint64_t(1) << i;
+        unsigned int a = 0;
+        while (a < config.num_attrs && config.attrs[a].attr.flags != gpio_lines[i].flags) {
+            a++;
+        }
+        if (a == config.num_attrs) {
+            if (a == GPIO_V2_LINE_NUM_ATTRS_MAX - 1) {
+                LOG_ERROR("Too many different GPIO line configurations");
+                return false;
+            }
+            config.attrs[a].attr.id = GPIO_V2_LINE_ATTR_ID_FLAGS;
+            config.attrs[a].attr.flags = gpio_lines[i].flags;
+            config.num_attrs++;
+        }
+        config.attrs[a].mask |= bit;
 
+        if (gpio_lines[i].flags & GPIO_V2_LINE_FLAG_OUTPUT) {
+            outputs |= bit;
+            if (gpio_lines[i].value) {
+                high |= bit;
+            }
+        }
+    }
+    if (outputs) {
+        // Outputs keep their level across a new request
+        gpio_v2_line_config_attribute& values = config.attrs[config.num_attrs++];
+        values.attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+        values.attr.values = high;
+        values.mask = outputs;
+    }
     return true;
-#else
-    return false;
-#endif
 }
 
-bool LinuxSPI::setGPIODirection(uint8_t pin, const std::string& direction) {
-#ifdef __linux__
-    // Verify if pin is exported
-    if (gpio_pin_paths.find(pin) == gpio_pin_paths.end()) {
-        if (!exportGPIO(pin)) {
+int LinuxSPI::openLineRequest(size_t count) {
+    gpio_v2_line_request request;
+    std::memset(&request, 0, sizeof(request));
+    if (!lineConfig(count, request.config)) {
+        return -1;
+    }
+    for (size_t i = 0; i < count; i++) {
+        request.offsets[i] = gpio_lines[i].pin;
+    }
+    std::strncpy(request.consumer, GPIO_CONSUMER, sizeof(request.consumer) - 1);
+    request.num_lines = static_cast<uint32_t>(count);
+
+    int chip = ::open(gpio_chip_path.c_str(), O_RDWR | O_CLOEXEC);
+    if (chip < 0) {
+        LOG_ERROR("Unable to open GPIO chip " << gpio_chip_path << ": " << strerror(errno));
+        return -1;
+    }
+
+    int result = ioctl(chip, GPIO_V2_GET_LINE_IOCTL, &request);
+    int error = errno;
+    ::close(chip);
+    if (result < 0) {
+        LOG_ERROR("Unable to request GPIO lines on " << gpio_chip_path << ": " << strerror(error));
+        return -1;
+    }
+    return request.fd;
+}
+
+bool LinuxSPI::requestLines() {
+    if (gpio_lines.size() > GPIO_V2_LINES_MAX) {
+        LOG_ERROR("Too many GPIO lines");
+        return false;
+    }
+
+    // Same lines: reconfigure the request in place, the handle stays valid
+    if (gpio_request_fd >= 0 && gpio_requested == gpio_lines.size()) {
+        gpio_v2_line_config config;
+        if (!lineConfig(gpio_lines.size(), config)) {
+            return false;
+        }
+        if (ioctl(gpio_request_fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &config) < 0) {
+            LOG_ERROR("Unable to configure GPIO lines: " << strerror(errno));
             return false;
         }
+        return true;
     }
 
-    // Open direction file
-    std::string direction_path = gpio_pin_paths[pin] + "/direction";
-    std::ofstream directionFile(direction_path);
-    if (!directionFile.is_open()) {
-        std::cerr << "Error: Unable to open GPIO direction file for pin " 
-                  << static_cast<int>(pin) << std::endl;
-        return false;
+    // A line was added: request the whole set again, with the interrupt
+    // thread stopped while its descriptor is replaced
+    bool restart = interrupt_running;
+    if (restart) {
+        interrupt_running = false;
+        interrupt_thread.join();
     }
 
-    directionFile << direction;
-    directionFile.close();
+    // The lines held now are part of the new set, release them first
+    size_t previous = gpio_requested;
+    if (gpio_request_fd >= 0) {
+        ::close(gpio_request_fd);
+        gpio_request_fd = -1;
+        gpio_requested = 0;
+    }
 
-    return true;
-#else
-    return false;
-#endif
+    bool ok = true;
+    int fd = openLineRequest(gpio_lines.size());
+    size_t requested = gpio_lines.size();
+    if (fd < 0) {
+        // Take the previous lines back (the added one is last), so that a
+        // busy pin does not leave the pins already in use unconfigured
+        ok = false;
+        requested = previous;
+        fd = previous > 0 ? openLineRequest(previous) : -1;
+        if (previous > 0 && fd < 0) {
+            LOG_ERROR("Unable to request the previous GPIO lines again");
+        }
+    }
+    if (fd >= 0) {
+        gpio_request_fd = fd;
+        gpio_requested = requested;
+    }
+
+    if (restart && gpio_request_fd >= 0) {
+        interrupt_running = true;
+        interrupt_thread = std::thread(&LinuxSPI::interruptThread, this);
+    }
+    return ok;
 }
 
-bool LinuxSPI::writeGPIOValue(uint8_t pin, bool value) {
-#ifdef __linux__
-    // Verify if pin is exported
-    if (gpio_pin_paths.find(pin) == gpio_pin_paths.end()) {
-        std::cerr << "Error: Pin " << static_cast<int>(pin) << " not exported" << std::endl;
-        return false;
+bool LinuxSPI::setLineFlags(uint8_t pin, uint64_t flags) {
+    int index = lineIndex(pin);
+    if (index < 0) {
+        GPIOLine line;
+        line.pin = pin;
+        line.flags = flags;
+        line.value = false;
+        gpio_lines.push_back(line);
+        if (!requestLines()) {
+            gpio_lines.pop_back();
+            return false;
+        }
+        return true;
     }
 
-    // Open value file
-    std::string value_path = gpio_pin_paths[pin] + "/value";
-    std::ofstream valueFile(value_path);
-    if (!valueFile.is_open()) {
-        std::cerr << "Error: Unable to open GPIO value file for pin " << static_cast<int>(pin) << std::endl;
+    uint64_t previous = gpio_lines[index].flags;
+    gpio_lines[index].flags = flags;
+    if (!requestLines()) {
+        gpio_lines[index].flags = previous;
         return false;
     }
-
-    valueFile << (value ? "1" : "0");
-    valueFile.close();
-
     return true;
-#else
-    return false;
-#endif
 }
 
-bool LinuxSPI::readGPIOValue(uint8_t pin) {
-#ifdef __linux__
-    // Verify if pin is exported
-    if (gpio_pin_paths.find(pin) == gpio_pin_paths.end()) {
-        std::cerr << "Error: Pin " << static_cast<int>(pin) << " not exported" << std::endl;
+bool LinuxSPI::digitalWriteMany(const uint8_t* pins, const bool* values, size_t count) {
+    gpio_v2_line_values lines;
+    std::memset(&lines, 0, sizeof(lines));
+    for (size_t i = 0; i < count; i++) {
+        int index = lineIndex(pins[i]);
+        if (index < 0 || !(gpio_lines[index].flags & GPIO_V2_LINE_FLAG_OUTPUT)) {
+            LOG_ERROR("Pin " << static_cast<int>(pins[i]) << " not configured as output");
+            return false;
+        }
+        lines.mask |= uint64_t(1) << index;
+        if (values[i]) {
+            lines.bits |= uint64_t(1) << index;
+        }
+    }
+    if (ioctl(gpio_request_fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &lines) < 0) {
+        LOG_ERROR("Unable to set GPIO values: " << strerror(errno));
         return false;
     }
 
-    // Open value file
-    std::string value_path = gpio_pin_paths[pin] + "/value";
-    std::ifstream valueFile(value_path);
-    if (!valueFile.is_open()) {
-        std::cerr << "Error: Unable to open GPIO value file for pin " << static_cast<int>(pin) << std::endl;
+    for (size_t i = 0; i < count; i++) {
+        gpio_lines[lineIndex(pins[i])].value = values[i];
+    }
+    return true;
+}
+
+bool LinuxSPI::digitalReadMany(const uint8_t* pins, bool* values, size_t count) {
+    gpio_v2_line_values lines;
+    std::memset(&lines, 0, sizeof(lines));
+    for (size_t i = 0; i < count; i++) {
+        int index = lineIndex(pins[i]);
+        if (index < 0) {
+            LOG_ERROR("Pin " << static_cast<int>(pins[i]) << " not configured");
+            return false;
+        }
+        lines.mask |= uint64_t(1) << index;
+    }
+    if (ioctl(gpio_request_fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &lines) < 0) {
+        LOG_ERROR("Unable to read GPIO values: " << strerror(errno));
         return false;
     }
 
-    char value;
-    valueFile >> value;
-    valueFile.close();
+    for (size_t i = 0; i < count; i++) {
+        values[i] = (lines.bits >> lineIndex(pins[i])) & 1;
+    }
+    return true;
+}
 
-    return (value == '1');
 #else
+
+bool LinuxSPI::setLineFlags(uint8_t pin, uint64_t flags) {
+    (void)pin;
+    (void)flags;
+    LOG_ERROR("GPIO character device not supported on this platform");
+    return false;
+}
+
+bool LinuxSPI::digitalWriteMany(const uint8_t* pins, const bool* values, size_t count) {
+    (void)pins;
+    (void)values;
+    (void)count;
+    return false;
+}
+
+bool LinuxSPI::digitalReadMany(const uint8_t* pins, bool* values, size_t count) {
+    (void)pins;
+    (void)values;
+    (void)count;
     return false;
+}
+
 #endif
+
+void LinuxSPI::setGPIOChip(const std::string& path) {
+    gpio_chip_path = path;
 }
 
 bool LinuxSPI::digitalWrite(uint8_t pin, bool value) {
-    return writeGPIOValue(pin, value);
+    return digitalWriteMany(&pin, &value, 1);
 }
 
 bool LinuxSPI::digitalRead(uint8_t pin) {
-    return readGPIOValue(pin);
+    bool value = false;
+    digitalReadMany(&pin, &value, 1);
+    return value;
 }
 
 bool LinuxSPI::pinMode(uint8_t pin, uint8_t mode) {
-    std::string direction;
+#ifdef LINUXSPI_GPIO_CDEV
+    uint64_t flags;
     switch (mode) {
         case INPUT:
-            direction = "in";
+            flags = GPIO_V2_LINE_FLAG_INPUT;
             break;
         case OUTPUT:
-            direction = "out";
+            flags = GPIO_V2_LINE_FLAG_OUTPUT;
             break;
         case INPUT_PULLUP:
-            // In Linux, pull-ups are configured differently
-            // here we simulate configuring as a normal input
-            direction = "in";
+            flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_BIAS_PULL_UP;
             break;
         default:
-            std::cerr << "Error: Invalid pin mode" << std::endl;
+            LOG_ERROR("Invalid pin mode");
             return false;
     }
 
-    return setGPIODirection(pin, direction);
+    // The interrupt line keeps its edge detection
+    int index = lineIndex(pin);
+    if (index >= 0 && !(flags & GPIO_V2_LINE_FLAG_OUTPUT)) {
+        flags |= gpio_lines[index].flags & GPIO_V2_LINE_FLAG_EDGE_RISING;
+    }
+    return setLineFlags(pin, flags);
+#else
+    (void)mode;
+    return setLineFlags(pin, 0);
+#endif
+}
+
+bool LinuxSPI::configureInterrupt(uint8_t pin, bool enable) {
+    if (!enable) {
+        if (interrupt_pin == pin) {
+            enableInterrupt(false);
+            interrupt_pin = -1;
+        }
+        return true;
+    }
+
+    if (interrupt_pin >= 0 && interrupt_pin != pin) {
+        enableInterrupt(false);
+    }
+#ifdef LINUXSPI_GPIO_CDEV
+    if (lineIndex(pin) < 0 && !pinMode(pin, INPUT)) {
+        return false;
+    }
+#endif
+    interrupt_pin = pin;
+    return true;
 }
 
 bool LinuxSPI::setInterruptCallback(InterruptCallback callback) {
@@ -305,29 +503,25 @@ bool LinuxSPI::setInterruptCallback(InterruptCallback callback) {
 }
 
 bool LinuxSPI::enableInterrupt(bool enable) {
-#ifdef __linux__
+#ifdef LINUXSPI_GPIO_CDEV
     if (enable && !interrupt_running) {
         // Verify that we have a callback and a pin configured
         if (!interruptCallback || interrupt_pin < 0) {
-            std::cerr << "Error: Callback or interrupt pin not configured" << std::endl;
+            LOG_ERROR("Callback or interrupt pin not configured");
             return false;
         }
 
-        // Verify that the pin is configured as input
-        if (gpio_pin_paths.find(interrupt_pin) == gpio_pin_paths.end()) {
-            std::cerr << "Error: Interrupt pin not configured as GPIO" << std::endl;
+        int index = lineIndex(static_cast<uint8_t>(interrupt_pin));
+        if (index < 0 || (gpio_lines[index].flags & GPIO_V2_LINE_FLAG_OUTPUT)) {
+            LOG_ERROR("Interrupt pin not configured as input");
             return false;
         }
 
-        // Configure edge for interrupts
-        std::string edge_path = gpio_pin_paths[interrupt_pin] + "/edge";
-        std::ofstream edgeFile(edge_path);
-        if (!edgeFile.is_open()) {
-            std::cerr << "Error: Unable to configure edge for interrupts" << std::endl;
+        // Rising edges are queued by the kernel on the line request
+        if (!(gpio_lines[index].flags & GPIO_V2_LINE_FLAG_EDGE_RISING) &&
+            !setLineFlags(static_cast<uint8_t>(interrupt_pin), gpio_lines[index].flags | GPIO_V2_LINE_FLAG_EDGE_RISING)) {
             return false;
         }
-        edgeFile << "rising";  // Could be configurable
-        edgeFile.close();
 
         // Start monitoring thread
         interrupt_running = true;
@@ -339,35 +533,47 @@ bool LinuxSPI::enableInterrupt(bool enable) {
         if (interrupt_thread.joinable()) {
             interrupt_thread.join();
         }
+
+        int index = lineIndex(static_cast<uint8_t>(interrupt_pin));
+        if (index >= 0 && gpio_request_fd >= 0) {
+            setLineFlags(static_cast<uint8_t>(interrupt_pin), gpio_lines[index].flags & ~uint64_t(GPIO_V2_LINE_FLAG_EDGE_RISING));
+        }
         return true;
     }
     
     return true;  // If already in the desired state
 #else
-    return false;
+    return !enable;
 #endif
 }
 
 void LinuxSPI::interruptThread() {
-#ifdef __linux__
-    std::string value_path = gpio_pin_paths[interrupt_pin] + "/value";
-    
+#ifdef LINUXSPI_GPIO_CDEV
+    RealTime::enterThread("spi-irq");
+
     while (interrupt_running) {
-        // Ideally, we would use poll() or epoll() to wait for interrupts
-        // efficiently, but for simplicity, we use polling
-        
-        if (readGPIOValue(interrupt_pin)) {
-            // Call the callback
-            if (interruptCallback) {
+        // Sleep in the kernel until an edge, waking periodically to notice
+        // enableInterrupt(false)
+        pollfd pfd = {gpio_request_fd, POLLIN, 0};
+        if (poll(&pfd, 1, INTERRUPT_POLL_MS) <= 0) {
+            continue;
+        }
+
+        gpio_v2_line_event events[16];
+        ssize_t n = read(gpio_request_fd, events, sizeof(events));
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            LOG_ERROR("Unable to read GPIO events: " << strerror(errno));
+            break;
+        }
+
+        for (size_t i = 0; i < static_cast<size_t>(n) / sizeof(events[0]); i++) {
+            if (events[i].offset == static_cast<uint32_t>(interrupt_pin) && interruptCallback) {
                 interruptCallback();
             }
-            
-            // Wait a bit to avoid bouncing
-            usleep(50000);  // 50ms
         }
-        
-        // Wait a short time before checking again
-        usleep(10000);  // 10ms
     }
 #endif
 }
@@ -6,10 +6,8 @@
  * initializing the LoRaWAN stack, joining a network, sending and receiving messages, and
  * handling various LoRaWAN protocol features such as ADR (Adaptive Data Rate) and MAC commands.
  * 
- * The implementation uses the RFM95 radio module and supports both CH341SPI and Linux SPI interfaces.
- * 
- * @note This implementation is designed for use with the RFM95 radio module and may require
- * modifications to work with other radio modules.
+ * The implementation drives the radio through the Radio interface (RFM95 or SX126x) and supports
+ * both CH341SPI and Linux SPI interfaces.
  * 
  * @dependencies
  * - OpenSSL (for AES encryption)
@@ -52,15 +50,39 @@
  * - void LoRaWAN::setNwkSKey(const std::string& nwkSKey): Set the network session key.
  * - void LoRaWAN::setAppSKey(const std::string& appSKey): Set the application session key.
  * - bool LoRaWAN::join(JoinMode mode, unsigned long timeout): Join a LoRaWAN network.
+ * - bool LoRaWAN::startJoin(std::function<void(bool)> done): Start an OTAA join without blocking.
+ * - bool LoRaWAN::isJoining() const: Check if a non-blocking join is in progress.
  * - std::vector<uint8_t> LoRaWAN::encryptPayload(const std::vector<uint8_t>& payload, uint8_t port): Encrypt the payload.
  * - std::vector<uint8_t> LoRaWAN::decryptPayload(const std::vector<uint8_t>& payload, uint8_t port): Decrypt the payload.
  * - float LoRaWAN::calculateTimeOnAir(size_t payload_size): Calculate the time on air for a given payload size.
  * - bool LoRaWAN::checkDutyCycle(float frequency, size_t payload_size): Check if the duty cycle allows transmission.
  * - float LoRaWAN::getDutyCycleUsage(int channel): Get the duty cycle usage for a specific channel.
  * - void LoRaWAN::resetDutyCycle(): Reset the duty cycle usage.
+ * - bool LoRaWAN::enableAirtimeLedger(const std::string& filename, size_t capacity): Persist transmissions for duty-cycle accounting.
+ * - float LoRaWAN::getSubBandAirtime(float frequency, int window_s) const: Get the air time used in a sub-band.
+ * - bool LoRaWAN::enableSessionMirror(const std::string& socket_path): Mirror the session to standby processes.
+ * - SessionMirror::State LoRaWAN::getSessionState() const: Get the mirrored session state.
+ * - void LoRaWAN::resumeSession(const SessionMirror::State& state): Take over a session mirrored from another process.
+ * - bool LoRaWAN::enableCapture(const std::string& path, size_t max_bytes, int max_files): Capture all frames to a LoRaTap pcap file.
+ * - void LoRaWAN::disableCapture(): Stop capturing frames.
+ * - bool LoRaWAN::enableAsyncIO(unsigned queue_depth): Batch persistence, capture and mirror I/O on a background thread.
+ * - void LoRaWAN::disableAsyncIO(): Go back to synchronous I/O.
  * - bool LoRaWAN::send(const std::vector<uint8_t>& data, uint8_t port, bool confirmed, bool force_duty_cycle): Send a message.
- * - void LoRaWAN::update(): Update the LoRaWAN state and handle received messages.
+ * - bool LoRaWAN::send(const std::vector<uint8_t>& data, uint8_t port, const SendOptions& options): Send a message with per-message options.
+ * - bool LoRaWAN::send(const std::vector<uint8_t>& data, uint8_t port, const SendOptions& options, std::function<void(bool)> done): Send a message and get its outcome from update().
+ * - void LoRaWAN::setTxPolicy(TxPolicy policy): Set the per-message data rate and power policy.
+ * - TxPolicyDecision LoRaWAN::airtimeTxPolicy(const TxPolicyInput& input): Fastest data rate meeting a delivery target.
+ * - void LoRaWAN::requestDeviceTime(): Request the network time with the next uplink.
+ * - bool LoRaWAN::getNetworkTime(int64_t& gps_ms) const: Get the network time from DeviceTimeAns.
+ * - std::chrono::steady_clock::time_point LoRaWAN::nextUplinkSlot(int period_s, int jitter_ms) const: Get the next uplink slot of this device.
+ * - LatencyStats::Summary LoRaWAN::getWindowLateness() const: Get how late the receive windows were opened.
+ * - std::chrono::milliseconds LoRaWAN::update(): Update the LoRaWAN state and get the time until the next deadline.
+ * - int LoRaWAN::getEventFd(): Get a descriptor that is readable when the stack needs servicing.
+ * - void LoRaWAN::processEvents(): Handle what is due and re-arm the event descriptor.
+ * - void LoRaWAN::notifyEvent(): Make the event descriptor readable now.
+ * - void LoRaWAN::setIrqWakeup(bool enable): Rely on notifyEvent() from the DIO interrupt instead of polling.
  * - bool LoRaWAN::receive(Message& message, unsigned long timeout): Receive a message.
+ * - void LoRaWAN::receiveNext(std::chrono::milliseconds timeout, std::function<void(bool, const Message&)> done): Get the next downlink from update().
  * - void LoRaWAN::onReceive(std::function<void(const Message&)> callback): Set a callback for received messages.
  * - void LoRaWAN::onJoin(std::function<void(bool)> callback): Set a callback for join events.
  * - void LoRaWAN::setRegion(int region): Set the LoRaWAN region.
@@ -74,6 +96,17 @@
  * - void LoRaWAN::setSingleChannel(bool enable, float freq_mhz, int sf, int bw, int cr, int power, int preamble): Enable or disable single channel mode.
  * - bool LoRaWAN::getSingleChannel() const: Check if single channel mode is enabled.
  * - float LoRaWAN::getSingleChannelFrequency() const: Get the frequency for single channel mode.
+ * - std::vector<ChannelNoise> LoRaWAN::surveyChannels(size_t samples_per_channel): Measure the noise floor of the channel plan.
+ * - void LoRaWAN::setBackgroundSurvey(bool enable, int interval_s, size_t samples_per_channel): Survey channels during Class A idle time.
+ * - const std::vector<ChannelNoise>& LoRaWAN::getChannelNoise() const: Get the last survey results.
+ * - ChannelQuality LoRaWAN::getChannelQuality(int channel) const: Get the delivery statistics of a channel.
+ * - void LoRaWAN::setAdaptiveNbTrans(bool enable): Tune unconfirmed repetitions from the observed loss.
+ * - uint8_t LoRaWAN::getNbTrans() const: Get the number of transmissions of unconfirmed frames.
+ * - bool LoRaWAN::enableUplinkQueue(const std::string& filename, size_t capacity): Queue uplinks in a file while offline.
+ * - bool LoRaWAN::queueUplink(const std::vector<uint8_t>& data, uint8_t port, bool confirmed): Add a message to the uplink queue.
+ * - size_t LoRaWAN::getQueuedUplinks() const: Get the number of queued uplinks.
+ * - void LoRaWAN::setBackfillInterval(int ms): Set the minimum time between queued uplinks.
+ * - void LoRaWAN::setDownlinkDrain(bool enable): Fetch FPending downlinks with empty uplinks.
  * - void LoRaWAN::setTxPower(int8_t power): Set the transmission power.
  * - int LoRaWAN::getRSSI() const: Get the RSSI (Received Signal Strength Indicator).
  * - int LoRaWAN::getSNR() const: Get the SNR (Signal-to-Noise Ratio).
@@ -124,6 +157,8 @@
  * 
  * @section Structs
  * - struct Message: Structure representing a LoRaWAN message.
+ * - struct ChannelNoise: Noise floor statistics of one channel.
+ * - struct ChannelQuality: Delivery statistics of one channel used for channel selection.
  * 
  * @section Authors
  * - Sergio Pérez (Original Author)
@@ -140,7 +175,14 @@
 #include "LoRaWAN.hpp"
 #include "RFM95.hpp"
 #include "AES-CMAC.hpp"
+#include "AESBatch.hpp"
+#include "AirtimeLedger.hpp"
+#include "EventNotifier.hpp"
+#include "IOExecutor.hpp"
+#include "Logger.hpp"
+#include "PacketCapture.hpp"
 #include "SessionManager.hpp"
+#include "UplinkQueue.hpp"
 #include <iostream>
 #include <thread>
 #include <chrono>
@@ -148,29 +190,96 @@
 #include <mutex>
 #include <array>
 #include <deque>
+#include <map>
 #include <bitset>
+#include <tuple>
 
+// Radio used by the default constructor. RFM_USE_CH341 and RFM_USE_LINUX_SPI
+// bind the RFM95 driver to that backend at compile time.
+static std::unique_ptr<Radio> createDefaultRadio()
+{
 #if defined(RFM_USE_CH341)
-// With CH341SPI
-auto ch341_spi = SPIFactory::createCH341SPI(0, true);
-auto rfm = RFM95(std::move(ch341_spi));
+    return std::make_unique<RFM95CH341>(CH341Bus(std::make_unique<CH341SPI>(0, true)));
+#elif defined(RFM_USE_LINUX_SPI)
+    return std::make_unique<RFM95LinuxSPI>(LinuxSPIBus(std::make_unique<LinuxSPI>("/dev/spidev0.0", 1000000)));
 #else
-#if defined(RFM_USE_LINUX_SPI)
-// With Linux SPI
-auto linux_spi = SPIFactory::createLinuxSPI("/dev/spidev0.0", 1000000);
-auto rfm = RFM95(std::move(linux_spi));
-#endif // defined(RFM_USE_LINUX_SPI)
-#endif // defined(RFM_USE_CH341)
+    return std::make_unique<RFM95>(SPIFactory::createCH341SPI(0));
+#endif
+}
+
+// 64-bit FNV-1a hash, spreads DevEUIs evenly over the uplink slots
+static uint64_t fnv1a64(const uint8_t* data, size_t length)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+// LoRa time on air in ms of a frame, bw in Hz
+static float airtimeFor(size_t payload_size, int sf, float bw, int cr, int preamble)
+{
+    // Calculate the number of symbols in preamble
+    int preambleSymbols = preamble + 4.25;
+    
+    // Calculate symbol duration (ms)
+    double symbolDuration = std::pow(2.0, static_cast<double>(sf)) / bw;
+    
+    // Calculate size in bits with overhead and encoding
+    size_t packet_size = payload_size + 13; // Data + LoRaWAN overhead
+    double payloadSymbols = 8 + std::max(std::ceil((8 * packet_size - 4 * sf + 28 + 16) / (4 * sf)) * (cr + 4), 0.0);
+    
+    // Total time in ms = (preamble + payload) * symbol duration
+    return (preambleSymbols + payloadSymbols) * symbolDuration * 1000;
+}
+
+// Uplink crypto block: A_i (0x01, last = i) or B0 (0x49, last = message length)
+// type | 4 x 0x00 | Dir | DevAddr | FCnt | 0x00 | last
+static std::array<uint8_t, 16> uplinkBlock(uint8_t type, const std::array<uint8_t, 4>& devAddr, uint32_t fcnt, uint8_t last)
+{
+    std::array<uint8_t, 16> block = {0};
+    block[0] = type;
+    block[5] = 0x00; // Dir = 0 for uplink
+    std::copy(devAddr.begin(), devAddr.end(), block.begin() + 6);
+    for (int i = 0; i < 4; i++) {
+        block[10 + i] = (fcnt >> (8 * i)) & 0xFF;
+    }
+    block[15] = last;
+    return block;
+}
+
+// AES-CTR keystream of an uplink FRMPayload, all A_i blocks in one batch
+static std::vector<uint8_t> uplinkKeystream(const std::array<uint8_t, 16>& key, const std::array<uint8_t, 4>& devAddr,
+                                            uint32_t fcnt, size_t length)
+{
+    AESBatch::Key expanded;
+    AESBatch::expand(key, expanded);
+
+    size_t count = (length + 15) / 16;
+    std::vector<std::array<uint8_t, 16>> blocks(count);
+    std::vector<uint8_t> keystream(count * 16);
+    std::vector<AESBatch::Block> batch(count);
+    for (size_t i = 0; i < count; i++) {
+        blocks[i] = uplinkBlock(0x01, devAddr, fcnt, static_cast<uint8_t>(i + 1));
+        batch[i] = {&expanded, blocks[i].data(), keystream.data() + i * 16};
+    }
+    AESBatch::encrypt(batch.data(), batch.size());
+
+    keystream.resize(length);
+    return keystream;
+}
 
 bool LoRaWAN::isVerbose = false;
 
 // Debug helper for conditional output
-#define DEBUG_PRINT(x) do { if(LoRaWAN::getVerbose()) { std::cout << x; } } while(0)
-#define DEBUG_PRINTLN(x) do { if(LoRaWAN::getVerbose()) { std::cout << x << std::endl; } } while(0)
-#define DEBUG_HEX(x) do { if(LoRaWAN::getVerbose()) { std::cout << std::hex << (x) << std::dec; } } while(0)
+#define DEBUG_PRINT(x) do { if(LoRaWAN::getVerbose()) { Logger::debugStream() << x; Logger::instance().flushDebug(); } } while(0)
+#define DEBUG_PRINTLN(x) do { if(LoRaWAN::getVerbose()) { Logger::debugStream() << x << '\n'; Logger::instance().flushDebug(); } } while(0)
+#define DEBUG_HEX(x) do { if(LoRaWAN::getVerbose()) { Logger::debugStream() << std::hex << (x) << std::dec; Logger::instance().flushDebug(); } } while(0)
 
 struct LoRaWAN::Impl {
-    std::unique_ptr<RFM95> rfm;
+    std::unique_ptr<Radio> radio;
     std::queue<Message> rxQueue;
     std::mutex queueMutex;
     
@@ -198,6 +307,114 @@ struct LoRaWAN::Impl {
 
     std::vector<uint16_t> usedNonces;
 
+    // Channel survey
+    std::vector<ChannelNoise> channelNoise;
+    bool surveyEnabled = false;
+    std::chrono::seconds surveyInterval{60};
+    size_t surveySamples = 32;
+    std::chrono::steady_clock::time_point lastSurvey;
+
+    // Channel quality model, the last uplink channel waits for its outcome
+    std::array<ChannelQuality, MAX_CHANNELS> channelQuality;
+    int outcomeChannel = -1;
+    bool outcomeConfirmed = false;
+
+    // ChMask of the last accepted LinkADRReq, bit i enables channel i
+    uint16_t channelMask = 0xFFFF;
+
+    // Retransmission engine: the last frame is sent again unchanged (same FCnt)
+    std::vector<uint8_t> retxFrame;
+    int retxRemaining = 0;
+    bool retxConfirmed = false;
+    std::chrono::steady_clock::time_point retxDue;
+    bool adaptiveNbTrans = false;
+    float lossRate = 0.0f;
+
+    // Per-message data rate: policy, choice for the current frame (-1 = ADR)
+    // and the parameters of the last uplink, which RX1 follows
+    TxPolicy txPolicy;
+    int frameDr = -1;
+    int framePower = 0;
+    int uplinkSf = 9;
+    float uplinkBw = 125.0f;
+    int uplinkDr = 3;
+
+    // Uplink SNR at the gateway from the last LinkCheckAns
+    float uplinkSnr = 0.0f;
+    bool uplinkSnrValid = false;
+
+    // Network time from DeviceTimeAns: GPS time at the end of the uplink
+    bool networkTimeValid = false;
+    int64_t networkTimeMs = 0;
+    std::chrono::steady_clock::time_point networkTimeRef;
+
+    // Downlink drain: FPending was set in the last downlink
+    bool downlinkDrain = true;
+    bool framePending = false;
+    std::chrono::steady_clock::time_point nextDrain;
+
+    // Background I/O for the components below, outlives them
+    IOExecutor ioExecutor;
+
+    // Transmissions of the last hours, the duty-cycle state is rebuilt from it
+    AirtimeLedger airtimeLedger;
+
+    // Store-and-forward queue, drained in order from update()
+    UplinkQueue uplinkQueue;
+    bool drainingQueue = false;
+    std::chrono::milliseconds backfillInterval{0};
+    std::chrono::steady_clock::time_point nextBackfill;
+
+    // Hot-standby mirror: last state sent and the first FCnt not yet reserved
+    SessionMirror sessionMirror;
+    SessionMirror::State mirroredState;
+    bool mirroredStateValid = false;
+    uint32_t reservedFcnt = 0;
+    std::chrono::steady_clock::time_point lastMirror;
+
+    // pcap capture of every frame sent and received
+    PacketCapture packetCapture;
+
+    // Lateness of the RX1/RX2 openings, the scheduling latency that matters
+    LatencyStats windowLateness;
+
+    // Pollable descriptor for external event loops
+    EventNotifier events;
+    bool irqWakeup = false;
+
+    // Non-blocking operations: join accept windows of startJoin(), the
+    // confirmed frame sent with a callback, receiveNext() requests and the
+    // completions run at the end of update()
+    enum JoinPhase { JOIN_IDLE, JOIN_WAIT_RX1, JOIN_RX1, JOIN_WAIT_RX2, JOIN_RX2 };
+    JoinPhase joinPhase = JOIN_IDLE;
+    std::chrono::steady_clock::time_point joinTxEnd;
+    std::chrono::steady_clock::time_point joinWindowStart;
+    std::function<void(bool)> joinDone;
+    std::function<void(bool)> sendDone;
+    std::map<uint64_t, std::function<void(bool)>> queuedSendDone; // by queue sequence
+    struct ReceiveWaiter {
+        std::chrono::steady_clock::time_point deadline;
+        std::function<void(bool, const Message&)> done;
+    };
+    std::deque<ReceiveWaiter> receiveWaiters;
+    std::vector<std::function<void()>> completions;
+
+    // Uplink crypto precomputed while idle for FCnt precomputedFcnt: AppSKey
+    // keystream and the MIC state after B0, indexed by frame length. Only
+    // valid while the FCnt, DevAddr and session keys still match.
+    bool precomputed = false;
+    uint32_t precomputedFcnt = 0;
+    std::array<uint8_t, 4> precomputedDevAddr;
+    std::array<uint8_t, 16> precomputedAppSKey;
+    std::array<uint8_t, 16> precomputedNwkSKey;
+    std::vector<uint8_t> precomputedKeystream;
+    std::vector<AESCMAC::State> precomputedMic;
+
+    bool precomputedValid() const {
+        return precomputed && precomputedFcnt == uplinkCounter && precomputedDevAddr == devAddr &&
+               precomputedAppSKey == appSKey && precomputedNwkSKey == nwkSKey;
+    }
+
     std::string sessionFile = "lorawan_session.json";
     
     bool saveSessionData() {
@@ -211,10 +428,11 @@ struct LoRaWAN::Impl {
         data.usedNonces = usedNonces;
         data.joined = true;
         
-        return SessionManager::saveSession(sessionFile, data);
+        return SessionManager::saveSession(sessionFile, data, &ioExecutor);
     }
 
     bool loadSessionData() {
+        ioExecutor.flush();
         SessionManager::SessionData data;
         if (SessionManager::loadSession(sessionFile, data)) {
             devAddr = data.devAddr;
@@ -229,8 +447,8 @@ struct LoRaWAN::Impl {
         return false;
     }
 
-    Impl(std::unique_ptr<SPIInterface> spi_interface) {
-        rfm = std::make_unique<RFM95>(std::move(spi_interface));
+    Impl(std::unique_ptr<Radio> radio_driver) {
+        radio = std::move(radio_driver);
         uplinkCounter = 0;
         downlinkCounter = 0;
         dataRate = 0;
@@ -242,6 +460,12 @@ struct LoRaWAN::Impl {
         devAddr.fill(0);
         nwkSKey.fill(0);
         appSKey.fill(0);
+
+        // Unused until enableAsyncIO() starts the executor
+        airtimeLedger.setExecutor(&ioExecutor);
+        uplinkQueue.setExecutor(&ioExecutor);
+        sessionMirror.setExecutor(&ioExecutor);
+        packetCapture.setExecutor(&ioExecutor);
     }
 
     // Function to build Join Request packet
@@ -487,9 +711,10 @@ struct LoRaWAN::Impl {
         dataRate = (dlSettings >> 4) & 0x0F;
         txPower = dlSettings & 0x0F;
         
-        // Reset counters
+        // Reset counters and the channel mask of the previous session
         uplinkCounter = 0;
         downlinkCounter = 0;
+        channelMask = 0xFFFF;
 
         DEBUG_PRINTLN("Join Accept processed successfully");
         DEBUG_PRINT("DevAddr: ");
@@ -589,35 +814,26 @@ struct LoRaWAN::Impl {
     }
 };
 
-LoRaWAN::LoRaWAN() : 
-    pimpl(new Impl(SPIFactory::createCH341SPI(0))), // Uses CH341SPI by default
-    joined(false),
-    currentClass(DeviceClass::CLASS_A),
-    joinMode(JoinMode::OTAA),
-    adrEnabled(false), // Initialize ADR disabled
-    adrAckCounter(0)   // Initialize ADR counter
+LoRaWAN::LoRaWAN() : LoRaWAN(createDefaultRadio())
 {
-    // Initialize duty cycle records
-    auto now = std::chrono::steady_clock::now();
-    for(int i = 0; i < MAX_CHANNELS; i++) {
-        lastChannelUse[i] = now - std::chrono::hours(24); // Start as 24 hours ago
-        channelAirTime[i] = 0.0f;
-    }
-    
-    // Configure channel frequencies for the selected region
-    for (int i = 0; i < MAX_CHANNELS; i++) {
-        channelFrequencies[i] = (i < 8) ? BASE_FREQ[lora_region] + i * CHANNEL_STEP[lora_region] : 0.0f;
-    }
 }
 
-LoRaWAN::LoRaWAN(std::unique_ptr<SPIInterface> spi_interface) : 
-    pimpl(new Impl(std::move(spi_interface))), // Uses the provided interface
+LoRaWAN::LoRaWAN(std::unique_ptr<SPIInterface> spi_interface) :
+    LoRaWAN(std::unique_ptr<Radio>(std::make_unique<RFM95>(std::move(spi_interface))))
+{
+}
+
+LoRaWAN::LoRaWAN(std::unique_ptr<Radio> radio) : 
+    pimpl(new Impl(std::move(radio))), // Uses the provided radio
     joined(false),
     currentClass(DeviceClass::CLASS_A),
     joinMode(JoinMode::OTAA),
     adrEnabled(false), // Initialize ADR disabled
     adrAckCounter(0)   // Initialize ADR counter
 {
+    // Single transmission until LinkADRReq sets NbTrans
+    current_nbRep = 1;
+
     // Initialize duty cycle records
     auto now = std::chrono::steady_clock::now();
     for(int i = 0; i < MAX_CHANNELS; i++) {
@@ -634,33 +850,33 @@ LoRaWAN::LoRaWAN(std::unique_ptr<SPIInterface> spi_interface) :
 LoRaWAN::~LoRaWAN() = default;
 
 bool LoRaWAN::init(int deviceIndex) {
-    if (!pimpl->rfm->begin()) {
-        DEBUG_PRINTLN("Failed to initialize RFM95");
+    if (!pimpl->radio->begin()) {
+        DEBUG_PRINTLN("Failed to initialize radio");
         return false;
     }
     // Realizar prueba de comunicación
-    if (!pimpl->rfm->testCommunication()) {
-        DEBUG_PRINTLN("RFM95 communication failed");
+    if (!pimpl->radio->testCommunication()) {
+        DEBUG_PRINTLN("Radio communication failed");
         return false;
     }
     // Configurar el módulo para LoRaWAN
-    pimpl->rfm->setFrequency(BASE_FREQ[lora_region]);
+    pimpl->radio->setFrequency(BASE_FREQ[lora_region]);
     current_channel = 0;
-    pimpl->rfm->setTxPower(14, true);
+    pimpl->radio->setTxPower(14, true);
     current_power = 14;
-    pimpl->rfm->setSpreadingFactor(9);
+    pimpl->radio->setSpreadingFactor(9);
     current_sf = 9;
-    pimpl->rfm->setBandwidth(125.0);
+    pimpl->radio->setBandwidth(125.0);
     current_bw = 125;
-    pimpl->rfm->setCodingRate(5);
+    pimpl->radio->setCodingRate(5);
     current_cr = 5;
-    pimpl->rfm->setPreambleLength(8);
+    pimpl->radio->setPreambleLength(8);
     current_preamble = 8;
-    pimpl->rfm->setSyncWord(0x34); // LoRaWAN sync word
+    pimpl->radio->setSyncWord(0x34); // LoRaWAN sync word
     current_sync_word = 0x34;
-    pimpl->rfm->setLNA(0x23, true);
+    pimpl->radio->setLNA(0x23, true);
     current_lna = 0x23;
-    pimpl->rfm->setInvertIQ(false);
+    pimpl->radio->setInvertIQ(false);
     updateDataRateFromSF();
     return true;
 }
@@ -673,17 +889,18 @@ void LoRaWAN::setDeviceClass(DeviceClass deviceClass) {
         DEBUG_PRINTLN("Configuring Class C mode (continuous reception at 869.525 MHz)");
         
         // Configure radio for RX2 window
-        pimpl->rfm->standbyMode();
-        pimpl->rfm->setFrequency(869.525); // RX2 frequency for EU868
+        pimpl->radio->standbyMode();
+        pimpl->radio->setFrequency(869.525); // RX2 frequency for EU868
         
-        pimpl->rfm->setSpreadingFactor(9);
-        pimpl->rfm->setBandwidth(125.0);
-        pimpl->rfm->setInvertIQ(true);  // Invert IQ for downlink
-        pimpl->rfm->setLNA(1, true);
+        pimpl->radio->setSpreadingFactor(9);
+        pimpl->radio->setBandwidth(125.0);
+        pimpl->radio->setInvertIQ(true);  // Invert IQ for downlink
+        pimpl->radio->setLNA(1, true);
         
         // Start continuous reception
-        pimpl->rfm->setContinuousReceive();
+        pimpl->radio->setContinuousReceive();
     }
+    notifyEvent();
 }
 
 void LoRaWAN::setDevEUI(const std::string& devEUI) {
@@ -697,12 +914,12 @@ void LoRaWAN::setDevEUI(const std::string& devEUI) {
     
     // Debug: show DevEUI as stored
     if (LoRaWAN::getVerbose()) {
-        std::cout << "DevEUI stored: ";
+        DEBUG_PRINT("DevEUI stored: ");
         for(int i = 0; i < 8; i++) {
-            std::cout << std::hex << std::setw(2) << std::setfill('0') 
-                      << static_cast<int>(pimpl->devEUI[i]) << " ";
+            DEBUG_PRINT(std::hex << std::setw(2) << std::setfill('0')
+                        << static_cast<int>(pimpl->devEUI[i]) << " " << std::dec);
         }
-        std::cout << std::dec << std::endl;
+        DEBUG_PRINTLN("");
     }
 }
 
@@ -717,12 +934,12 @@ void LoRaWAN::setAppEUI(const std::string& appEUI) {
     
     // Debug: show AppEUI as stored
     if (LoRaWAN::getVerbose()) {
-        std::cout << "AppEUI stored: ";
+        DEBUG_PRINT("AppEUI stored: ");
         for(int i = 0; i < 8; i++) {
-            std::cout << std::hex << std::setw(2) << std::setfill('0') 
-                      << static_cast<int>(pimpl->appEUI[i]) << " ";
+            DEBUG_PRINT(std::hex << std::setw(2) << std::setfill('0')
+                        << static_cast<int>(pimpl->appEUI[i]) << " " << std::dec);
         }
-        std::cout << std::dec << std::endl;
+        DEBUG_PRINTLN("");
     }
 }
 
@@ -737,12 +954,12 @@ void LoRaWAN::setAppKey(const std::string& appKey) {
     
     // Debug: show AppKey as stored
     if (LoRaWAN::getVerbose()) {
-        std::cout << "AppKey stored: ";
+        DEBUG_PRINT("AppKey stored: ");
         for(int i = 0; i < 16; i++) {
-            std::cout << std::hex << std::setw(2) << std::setfill('0') 
-                      << static_cast<int>(pimpl->appKey[i]) << " ";
+            DEBUG_PRINT(std::hex << std::setw(2) << std::setfill('0')
+                        << static_cast<int>(pimpl->appKey[i]) << " " << std::dec);
         }
-        std::cout << std::dec << std::endl;
+        DEBUG_PRINTLN("");
     }
 }
 
@@ -758,10 +975,72 @@ void LoRaWAN::setAppSKey(const std::string& appSKey) {
     std::copy(appSKey.begin(), appSKey.end(), pimpl->appSKey.begin());
 }
 
+// Join Request on a random default channel at SF9/125 kHz, blocking until TxDone
+bool LoRaWAN::sendJoinRequest()
+{
+    // Configure radio for Join Request
+    pimpl->radio->standbyMode();  // Standby mode before configuring
+    current_channel = one_channel_gateway ? 0 : rand() % 8;
+    pimpl->radio->setFrequency(channelFrequencies[current_channel]);
+    pimpl->radio->setTxPower(MAX_POWER[lora_region], true);
+    current_power = MAX_POWER[lora_region];
+    pimpl->radio->setSpreadingFactor(9);
+    current_sf = 9;
+    pimpl->radio->setBandwidth(125.0);
+    current_bw = 125;
+    pimpl->radio->setCodingRate(5);
+    current_cr = 5;
+    pimpl->radio->setPreambleLength(8);
+    current_preamble = 8;
+    pimpl->radio->setInvertIQ(false);
+    pimpl->radio->setSyncWord(0x34);
+    current_sync_word = 0x34;
+    pimpl->radio->setLNA(0x23, true);
+    current_lna = 0x23;
+    updateDataRateFromSF();
+
+    // Clear interrupt flags
+    pimpl->radio->clearIrqStatus();
+
+    // Prepare and send Join Request
+    auto joinRequest = pimpl->buildJoinRequest();
+    publishSessionState(false);
+    if (!pimpl->radio->send(joinRequest)) {
+        DEBUG_PRINTLN("Failed to send Join Request");
+        return false;
+    }
+    if (pimpl->packetCapture.isOpen()) {
+        Radio::Profile tx;
+        tx.frequency = pimpl->radio->getFrequency();
+        tx.spreading_factor = current_sf;
+        tx.bandwidth = current_bw;
+        pimpl->packetCapture.record(joinRequest, tx, nullptr);
+    }
+    registerAirtime(pimpl->radio->getFrequency(), calculateTimeOnAir(joinRequest.size()));
+    pimpl->joinTxEnd = std::chrono::steady_clock::now();
+    return true;
+}
+
+bool LoRaWAN::acceptJoin(std::vector<uint8_t>& response)
+{
+    if (!pimpl->processJoinAccept(response)) {
+        return false;
+    }
+
+    joined = true;
+    notifyEvent();
+    if (joinCallback) {
+        joinCallback(true);
+    }
+    pimpl->saveSessionData();
+    return true;
+}
+
 bool LoRaWAN::join(JoinMode mode, unsigned long timeout) {
     // Try to load existing session first ONLY if a reset wasn't forced
     if (!joined && pimpl->loadSessionData()) {
         joined = true;
+        notifyEvent();
         DEBUG_PRINTLN("Restored previous session");
         return true;
     }
@@ -771,48 +1050,20 @@ bool LoRaWAN::join(JoinMode mode, unsigned long timeout) {
     joinMode = mode;
     
     if (mode == JoinMode::OTAA) {
-        // Configure radio for Join Request
-        pimpl->rfm->standbyMode();  // Standby mode before configuring
-        pimpl->rfm->setFrequency(one_channel_gateway ? channelFrequencies[0] : channelFrequencies[rand() % 8]);
-        current_channel = pimpl->rfm->getFrequency();
-        pimpl->rfm->setTxPower(MAX_POWER[lora_region], true);
-        current_power = MAX_POWER[lora_region];
-        pimpl->rfm->setSpreadingFactor(9);
-        current_sf = 9;
-        pimpl->rfm->setBandwidth(125.0);
-        current_bw = 125;
-        pimpl->rfm->setCodingRate(5);
-        current_cr = 5;
-        pimpl->rfm->setPreambleLength(8);
-        current_preamble = 8;
-        pimpl->rfm->setInvertIQ(false);
-        pimpl->rfm->setSyncWord(0x34);
-        current_sync_word = 0x34;
-        pimpl->rfm->setLNA(0x23, true);
-        current_lna = 0x23;
-        updateDataRateFromSF();
-
-        // Clear interrupt flags
-        pimpl->rfm->clearIRQFlags();
-
-        // Prepare and send Join Request
-        auto joinRequest = pimpl->buildJoinRequest();
-        
-        if (!pimpl->rfm->send(joinRequest)) {
-            DEBUG_PRINTLN("Failed to send Join Request");
+        if (!sendJoinRequest()) {
             return false;
         }
 
         // Configure RX1
-        pimpl->rfm->standbyMode();
-        pimpl->rfm->setFrequency(channelFrequencies[current_channel]);
-        pimpl->rfm->setSpreadingFactor(current_sf);
-        pimpl->rfm->setBandwidth(current_bw);
-        pimpl->rfm->setInvertIQ(true);
-        pimpl->rfm->setLNA(current_lna, true);
+        pimpl->radio->standbyMode();
+        pimpl->radio->setFrequency(channelFrequencies[current_channel]);
+        pimpl->radio->setSpreadingFactor(current_sf);
+        pimpl->radio->setBandwidth(current_bw);
+        pimpl->radio->setInvertIQ(true);
+        pimpl->radio->setLNA(current_lna, true);
         
         // Start continuous receive
-        pimpl->rfm->setContinuousReceive();
+        pimpl->radio->setContinuousReceive();
         
         // Configure RX1
         DEBUG_PRINTLN("Opening RX1 window...");
@@ -822,77 +1073,63 @@ bool LoRaWAN::join(JoinMode mode, unsigned long timeout) {
         while (std::chrono::duration_cast<std::chrono::milliseconds>(
             std::chrono::steady_clock::now() - start).count() < (RECEIVE_DELAY1 + WINDOW_DURATION)) {
 
-            uint8_t flags = pimpl->rfm->getIRQFlags();
-            if (flags & RFM95::IRQ_RX_DONE_MASK) {
-                if (flags & RFM95::IRQ_PAYLOAD_CRC_ERROR_MASK) {
+            uint16_t flags = pimpl->radio->getIrqStatus();
+            if (flags & Radio::IRQ_RX_DONE) {
+                if (flags & Radio::IRQ_CRC_ERROR) {
                     DEBUG_PRINTLN("CRC error in RX1 window");
                 } else {
-                    auto response = pimpl->rfm->readPayload();
+                    auto response = pimpl->radio->readPayload();
                     if (!response.empty()) {
                         received = true;
-                        if (pimpl->processJoinAccept(response)) {
-                            joined = true;
-                            if (joinCallback) {
-                                joinCallback(true);
-                            }
-                            // If the join was successful, save session
-                            if (joined) {
-                                pimpl->saveSessionData();
-                            }
+                        captureDownlink(response);
+                        if (acceptJoin(response)) {
                             return true;
                         }
                     }
                 }
-                pimpl->rfm->clearIRQFlagRxDone();
+                pimpl->radio->clearIrqStatus(Radio::IRQ_RX_DONE);
                 break;
             }
 
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            sleepWithHeartbeat(std::chrono::milliseconds(10));
         }
 
         if (!received) {
             // Second RX window (RX2)
             DEBUG_PRINTLN("Opening RX2 window...");
             
-            pimpl->rfm->standbyMode();
-            pimpl->rfm->setFrequency(869.525);
-            pimpl->rfm->setSpreadingFactor(12);
-            pimpl->rfm->setBandwidth(125.0);
-            pimpl->rfm->setInvertIQ(true);
-            pimpl->rfm->setLNA(1, true);
+            pimpl->radio->standbyMode();
+            pimpl->radio->setFrequency(869.525);
+            pimpl->radio->setSpreadingFactor(12);
+            pimpl->radio->setBandwidth(125.0);
+            pimpl->radio->setInvertIQ(true);
+            pimpl->radio->setLNA(1, true);
             
             // Clear flags before RX2
-            pimpl->rfm->clearIRQFlags();
-            pimpl->rfm->setContinuousReceive();
+            pimpl->radio->clearIrqStatus();
+            pimpl->radio->setContinuousReceive();
             
             while (std::chrono::duration_cast<std::chrono::milliseconds>(
                 std::chrono::steady_clock::now() - start).count() < RECEIVE_DELAY1 + RECEIVE_DELAY2 + WINDOW_DURATION) {
                 
-                uint8_t flags = pimpl->rfm->getIRQFlags();
-                if (flags & RFM95::IRQ_RX_DONE_MASK) {
-                    if (flags & RFM95::IRQ_PAYLOAD_CRC_ERROR_MASK) {
+                uint16_t flags = pimpl->radio->getIrqStatus();
+                if (flags & Radio::IRQ_RX_DONE) {
+                    if (flags & Radio::IRQ_CRC_ERROR) {
                         DEBUG_PRINTLN("CRC error in RX2 window");
                     } else {
-                        auto response = pimpl->rfm->readPayload();
+                        auto response = pimpl->radio->readPayload();
                         if (!response.empty()) {
-                            if (pimpl->processJoinAccept(response)) {
-                                joined = true;
-                                if (joinCallback) {
-                                    joinCallback(true);
-                                }
-                                // If the join was successful, save session
-                                if (joined) {
-                                    pimpl->saveSessionData();
-                                }
+                            captureDownlink(response);
+                            if (acceptJoin(response)) {
                                 return true;
                             }
                         }
                     }
-                    pimpl->rfm->clearIRQFlagRxDone();
+                    pimpl->radio->clearIrqStatus(Radio::IRQ_RX_DONE);
                     break;
                 }
                 
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                sleepWithHeartbeat(std::chrono::milliseconds(10));
             }
         }
         
@@ -905,6 +1142,142 @@ bool LoRaWAN::join(JoinMode mode, unsigned long timeout) {
     return joined;
 }
 
+bool LoRaWAN::startJoin(std::function<void(bool)> done) {
+    if (pimpl->joinPhase != Impl::JOIN_IDLE) {
+        DEBUG_PRINTLN("Join already in progress");
+        return false;
+    }
+
+    if (!joined && pimpl->loadSessionData()) {
+        joined = true;
+        DEBUG_PRINTLN("Restored previous session");
+        if (done) {
+            deferCompletion([done] { done(true); });
+        }
+        return true;
+    }
+
+    DEBUG_PRINTLN("Starting OTAA join...");
+    joinMode = JoinMode::OTAA;
+    if (!sendJoinRequest()) {
+        return false;
+    }
+
+    pimpl->joinPhase = Impl::JOIN_WAIT_RX1;
+    pimpl->joinDone = std::move(done);
+    notifyEvent();
+    return true;
+}
+
+bool LoRaWAN::isJoining() const {
+    return pimpl->joinPhase != Impl::JOIN_IDLE;
+}
+
+void LoRaWAN::updateJoin() {
+    auto now = std::chrono::steady_clock::now();
+
+    switch (pimpl->joinPhase) {
+    case Impl::JOIN_WAIT_RX1:
+        if (now < pimpl->joinTxEnd + std::chrono::milliseconds(JOIN_ACCEPT_DELAY1)) {
+            return;
+        }
+        pimpl->windowLateness.record(pimpl->joinTxEnd + std::chrono::milliseconds(JOIN_ACCEPT_DELAY1), now);
+
+        // RX1 uses the channel and data rate of the Join Request
+        DEBUG_PRINTLN("Opening join RX1 window...");
+        pimpl->radio->standbyMode();
+        pimpl->radio->setFrequency(channelFrequencies[current_channel]);
+        pimpl->radio->setSpreadingFactor(current_sf);
+        pimpl->radio->setBandwidth(current_bw);
+        pimpl->radio->setInvertIQ(true);
+        pimpl->radio->setLNA(current_lna, true);
+        pimpl->radio->clearIrqStatus();
+        pimpl->radio->setContinuousReceive();
+        pimpl->joinPhase = Impl::JOIN_RX1;
+        pimpl->joinWindowStart = now;
+        return;
+
+    case Impl::JOIN_WAIT_RX2:
+        if (now < pimpl->joinTxEnd + std::chrono::milliseconds(JOIN_ACCEPT_DELAY2)) {
+            return;
+        }
+        pimpl->windowLateness.record(pimpl->joinTxEnd + std::chrono::milliseconds(JOIN_ACCEPT_DELAY2), now);
+        DEBUG_PRINTLN("Opening join RX2 window...");
+        pimpl->radio->standbyMode();
+        pimpl->radio->setFrequency(RX2_FREQ[lora_region]);
+        pimpl->radio->setSpreadingFactor(RX2_SF[lora_region]);
+        pimpl->radio->setBandwidth(RX2_BW[lora_region]);
+        pimpl->radio->setInvertIQ(true);
+        pimpl->radio->setLNA(current_lna, true);
+        pimpl->radio->clearIrqStatus();
+        pimpl->radio->setContinuousReceive();
+        pimpl->joinPhase = Impl::JOIN_RX2;
+        pimpl->joinWindowStart = now;
+        return;
+
+    case Impl::JOIN_RX1:
+    case Impl::JOIN_RX2:
+        break;
+
+    default:
+        return;
+    }
+
+    uint16_t flags = pimpl->radio->getIrqStatus();
+    if (flags & Radio::IRQ_RX_DONE) {
+        if (flags & Radio::IRQ_CRC_ERROR) {
+            DEBUG_PRINTLN("CRC error in join accept window");
+        } else {
+            auto response = pimpl->radio->readPayload();
+            if (!response.empty()) {
+                captureDownlink(response);
+                if (acceptJoin(response)) {
+                    finishJoin(true);
+                    return;
+                }
+            }
+        }
+        // Not our Join Accept, keep listening until the window closes
+        pimpl->radio->clearIrqStatus(Radio::IRQ_RX_DONE);
+        pimpl->radio->setContinuousReceive();
+    }
+
+    if (now < pimpl->joinWindowStart + std::chrono::milliseconds(WINDOW_DURATION)) {
+        return;
+    }
+
+    pimpl->radio->standbyMode();
+    if (pimpl->joinPhase == Impl::JOIN_RX1) {
+        pimpl->joinPhase = Impl::JOIN_WAIT_RX2;
+    } else {
+        DEBUG_PRINTLN("No Join Accept received");
+        finishJoin(false);
+    }
+}
+
+void LoRaWAN::finishJoin(bool ok) {
+    pimpl->joinPhase = Impl::JOIN_IDLE;
+    auto done = std::move(pimpl->joinDone);
+    pimpl->joinDone = nullptr;
+    if (done) {
+        deferCompletion([done, ok] { done(ok); });
+    }
+}
+
+void LoRaWAN::deferCompletion(std::function<void()> completion) {
+    pimpl->completions.push_back(std::move(completion));
+    notifyEvent();
+}
+
+void LoRaWAN::runCompletions() {
+    // Completions queued by these callbacks run on the next update()
+    std::vector<std::function<void()>> ready;
+    ready.swap(pimpl->completions);
+    for (auto& completion : ready) {
+        completion();
+    }
+}
+
 std::vector<uint8_t> LoRaWAN::encryptPayload(const std::vector<uint8_t> &payload, uint8_t port)
 {
     // If there is no payload, return an empty vector
@@ -936,48 +1309,23 @@ std::vector<uint8_t> LoRaWAN::encryptPayload(const std::vector<uint8_t> &payload
         DEBUG_PRINTLN(std::dec);
     }
 
-    // Prepare block A for encryption
-    std::array<uint8_t, 16> block_a;
-    block_a.fill(0); // Initialize everything to 0
-
-    block_a[0] = 0x00; // 0 for uplinks according to LoRaWAN specification
-
-    // DevAddr in network order (big-endian)
-    block_a[1] = pimpl->devAddr[0]; // MSB
-    block_a[2] = pimpl->devAddr[1];
-    block_a[3] = pimpl->devAddr[2];
-    block_a[4] = pimpl->devAddr[3]; // LSB
-
-    // FCnt in little-endian
-    block_a[5] = pimpl->uplinkCounter & 0xFF;        // LSB
-    block_a[6] = (pimpl->uplinkCounter >> 8) & 0xFF; // MSB
-    block_a[7] = 0;                                  // MSB always 0 for 16-bit FCnt
-    block_a[8] = 0;                                  // MSB always 0 for 16-bit FCnt
-
-    // Fill and block counter
-    // bytes 9-14 are already 0 due to fill(0)
-    block_a[15] = 0x01; // Block counter 1
-
-    // For debug, show the original block A
-    if (getVerbose())
+    // Keystream blocks A_i, precomputed while idle for the AppSKey
+    std::vector<uint8_t> keystream;
+    if (port != 0 && pimpl->precomputedValid() && pimpl->precomputedKeystream.size() >= payload.size())
     {
-        DEBUG_PRINT("Original Block A: ");
-        for (const auto &b : block_a)
-        {
-            DEBUG_PRINT(std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(b) << " ");
-        }
-        DEBUG_PRINTLN(std::dec);
+        DEBUG_PRINTLN("Using precomputed keystream for FCnt " << pimpl->uplinkCounter);
+        keystream.assign(pimpl->precomputedKeystream.begin(), pimpl->precomputedKeystream.begin() + payload.size());
+    }
+    else
+    {
+        keystream = uplinkKeystream(key, pimpl->devAddr, pimpl->uplinkCounter, payload.size());
     }
 
-    // Encrypt block A with the key to obtain the pad
-    std::array<uint8_t, 16> a_encrypted;
-    AESCMAC::aes_encrypt(block_a.data(), key.data(), a_encrypted.data());
-
-    // XOR between the payload and the first bytes of A
+    // XOR between the payload and the keystream
     std::vector<uint8_t> encrypted(payload.size());
     for (size_t i = 0; i < payload.size(); i++)
     {
-        encrypted[i] = payload[i] ^ a_encrypted[i];
+        encrypted[i] = payload[i] ^ keystream[i];
     }
 
     // For debug, show the encrypted payload
@@ -1097,31 +1445,22 @@ std::vector<uint8_t> LoRaWAN::decryptPayload(const std::vector<uint8_t> &payload
 
 float LoRaWAN::calculateTimeOnAir(size_t payload_size) {
     // Extract current parameters
-    int sf = pimpl->rfm->getSpreadingFactor();  // Changed . to ->
-    float bw = pimpl->rfm->getBandwidth() * 1000; // Convert from kHz to Hz
-    int cr = pimpl->rfm->getCodingRate();
-    
-    // Calculate the number of symbols in preamble
-    int preambleSymbols = pimpl->rfm->getPreambleLength() + 4.25;
-    
-    // Calculate symbol duration (ms)
-    double symbolDuration = std::pow(2.0, static_cast<double>(sf)) / bw;
-    
-    // Calculate size in bits with overhead and encoding
-    size_t packet_size = payload_size + 13; // Data + LoRaWAN overhead
-    double payloadSymbols = 8 + std::max(std::ceil((8 * packet_size - 4 * sf + 28 + 16) / (4 * sf)) * (cr + 4), 0.0);
+    int sf = pimpl->radio->getSpreadingFactor();  // Changed . to ->
+    float bw = pimpl->radio->getBandwidth() * 1000; // Convert from kHz to Hz
+    int cr = pimpl->radio->getCodingRate();
     
-    // Total time in ms = (preamble + payload) * symbol duration
-    float timeOnAir = (preambleSymbols + payloadSymbols) * symbolDuration * 1000;
+    float timeOnAir = airtimeFor(payload_size, sf, bw, cr, pimpl->radio->getPreambleLength());
     
     DEBUG_PRINTLN("Calculated time on air: " << timeOnAir << " ms");
     DEBUG_PRINTLN("Parameters: SF=" << sf << ", BW=" << (bw/1000) << "kHz, CR=4/" << cr);
-    DEBUG_PRINTLN("Symbols: preamble=" << preambleSymbols << ", payload=" << payloadSymbols);
-    DEBUG_PRINTLN("Symbol duration: " << (symbolDuration*1000) << " ms");
     
     return timeOnAir;
 }
 
+float LoRaWAN::timeOnAir(size_t payload_size, int sf, float bw) const {
+    return airtimeFor(payload_size, sf, bw * 1000, current_cr, current_preamble);
+}
+
 bool LoRaWAN::checkDutyCycle(float frequency, size_t payload_size) {
     // Identify the channel based on frequency
     int channel = -1;
@@ -1160,12 +1499,21 @@ bool LoRaWAN::checkDutyCycle(float frequency, size_t payload_size) {
     }
     
     // Register channel usage
-    lastChannelUse[channel] = now;
-    channelAirTime[channel] += airTime;
+    registerAirtime(frequency, airTime);
     
     return true;
 }
 
+void LoRaWAN::registerAirtime(float frequency, float air_time_ms) {
+    int channel = std::max(getChannelFromFrequency(frequency), 0);
+    lastChannelUse[channel] = std::chrono::steady_clock::now();
+    channelAirTime[channel] += air_time_ms;
+
+    if (pimpl->airtimeLedger.isOpen() && !pimpl->airtimeLedger.append(frequency, air_time_ms)) {
+        LOG_ERROR("Failed to record transmission in the airtime ledger");
+    }
+}
+
 float LoRaWAN::getDutyCycleUsage(int channel) {
     if(channel < 0 || channel >= MAX_CHANNELS) {
         return 0.0f; // Invalid channel
@@ -1191,10 +1539,167 @@ void LoRaWAN::resetDutyCycle() {
         lastChannelUse[i] = now - std::chrono::hours(24); // Start as if it were 24 hours ago
         channelAirTime[i] = 0.0f;
     }
+
+    // Replay the last hour of the ledger, including transmissions before a restart
+    if (pimpl->airtimeLedger.isOpen()) {
+        auto wallNow = std::chrono::system_clock::now();
+        for (const auto& record : pimpl->airtimeLedger.recent(std::chrono::hours(1))) {
+            auto age = wallNow - std::chrono::system_clock::time_point(std::chrono::milliseconds(record.time_ms));
+            auto used = now - std::chrono::duration_cast<std::chrono::steady_clock::duration>(age);
+            int channel = std::max(getChannelFromFrequency(record.frequency), 0);
+            lastChannelUse[channel] = std::max(lastChannelUse[channel], used);
+            channelAirTime[channel] += record.airtime_ms;
+        }
+    }
+}
+
+bool LoRaWAN::enableAirtimeLedger(const std::string& filename, size_t capacity) {
+    if (!pimpl->airtimeLedger.open(filename, capacity)) {
+        return false;
+    }
+
+    resetDutyCycle();
+    DEBUG_PRINTLN("Airtime ledger " << filename << ": "
+                  << pimpl->airtimeLedger.recent(std::chrono::hours(1)).size()
+                  << " transmissions in the last hour");
+    return true;
+}
+
+float LoRaWAN::getSubBandAirtime(float frequency, int window_s) const {
+    return pimpl->airtimeLedger.airtime(AirtimeLedger::subBand(frequency), std::chrono::seconds(window_s));
+}
+
+bool LoRaWAN::enableSessionMirror(const std::string& socket_path) {
+    if (!pimpl->sessionMirror.listen(socket_path)) {
+        return false;
+    }
+    // Nothing sent so far is covered by a reservation
+    pimpl->reservedFcnt = pimpl->uplinkCounter;
+    pimpl->mirroredStateValid = false;
+    DEBUG_PRINTLN("Session mirror listening on " << socket_path);
+    return true;
+}
+
+SessionMirror::State LoRaWAN::getSessionState() const {
+    SessionMirror::State state;
+    state.devAddr = pimpl->devAddr;
+    state.nwkSKey = pimpl->nwkSKey;
+    state.appSKey = pimpl->appSKey;
+    state.uplinkCounter = pimpl->uplinkCounter;
+    state.downlinkCounter = pimpl->downlinkCounter;
+    state.reservedFcnt = pimpl->reservedFcnt;
+    state.lastDevNonce = pimpl->lastDevNonce;
+    state.dataRate = current_dr;
+    state.txPower = static_cast<int8_t>(pimpl->radio->getTxPower());
+    state.nbTrans = current_nbRep;
+    state.rx1DrOffset = rx1DrOffset;
+    state.rx2DataRate = rx2DataRate;
+    state.joined = joined;
+    return state;
+}
+
+void LoRaWAN::resumeSession(const SessionMirror::State& state) {
+    pimpl->devAddr = state.devAddr;
+    pimpl->nwkSKey = state.nwkSKey;
+    pimpl->appSKey = state.appSKey;
+    pimpl->uplinkCounter = state.takeoverFcnt();
+    pimpl->downlinkCounter = state.downlinkCounter;
+    pimpl->lastDevNonce = state.lastDevNonce;
+    pimpl->reservedFcnt = pimpl->uplinkCounter;
+
+    // MAC parameters negotiated by the previous process
+    int sf = current_sf;
+    float bw = current_bw;
+    dataRateToSF(state.dataRate, sf, bw);
+    pimpl->radio->setSpreadingFactor(sf);
+    current_sf = sf;
+    pimpl->radio->setBandwidth(bw);
+    current_bw = bw;
+    pimpl->radio->setTxPower(state.txPower, true);
+    pimpl->txPower = state.txPower;
+    updateDataRateFromSF();
+    current_nbRep = state.nbTrans;
+    rx1DrOffset = state.rx1DrOffset;
+    rx2DataRate = state.rx2DataRate;
+
+    joined = state.joined;
+    notifyEvent();
+    if (joined) {
+        pimpl->saveSessionData();
+    }
+    DEBUG_PRINTLN("Resumed mirrored session, FCnt " << pimpl->uplinkCounter
+                  << " (last reported " << state.uplinkCounter << ")");
+}
+
+bool LoRaWAN::enableCapture(const std::string& path, size_t max_bytes, int max_files) {
+    if (!pimpl->packetCapture.open(path, max_bytes, max_files)) {
+        return false;
+    }
+    DEBUG_PRINTLN("Capturing frames to " << path);
+    return true;
+}
+
+void LoRaWAN::disableCapture() {
+    pimpl->packetCapture.close();
+}
+
+bool LoRaWAN::enableAsyncIO(unsigned queue_depth) {
+    if (!pimpl->ioExecutor.start(queue_depth)) {
+        return false;
+    }
+    DEBUG_PRINTLN("Asynchronous I/O enabled ("
+                  << (pimpl->ioExecutor.usesIoUring() ? "io_uring" : "system calls") << ")");
+    return true;
+}
+
+void LoRaWAN::disableAsyncIO() {
+    pimpl->ioExecutor.stop();
 }
 
 bool LoRaWAN::send(const std::vector<uint8_t>& data, uint8_t port, bool confirmed, bool force_duty_cycle) {
-    if (!joined) return false;
+    SendOptions options;
+    options.confirmed = confirmed;
+    options.force_duty_cycle = force_duty_cycle;
+    return send(data, port, options);
+}
+
+bool LoRaWAN::send(const std::vector<uint8_t>& data, uint8_t port, const SendOptions& options,
+                   std::function<void(bool)> done) {
+    if (!done) {
+        return send(data, port, options);
+    }
+
+    // A queued message completes once the drain has sent it
+    if (queuesUplink(data)) {
+        uint64_t sequence = pimpl->uplinkQueue.nextSequence();
+        if (!queueUplink(data, port, options.confirmed)) {
+            return false;
+        }
+        pimpl->queuedSendDone[sequence] = std::move(done);
+        return true;
+    }
+
+    if (!send(data, port, options)) {
+        return false;
+    }
+    awaitSendOutcome(options.confirmed, std::move(done));
+    return true;
+}
+
+bool LoRaWAN::queuesUplink(const std::vector<uint8_t>& data) const {
+    // Offline, or older messages still queued: keep the order and store it
+    return pimpl->uplinkQueue.isOpen() && !pimpl->drainingQueue && !data.empty() &&
+           (!joined || pimpl->uplinkQueue.size() > 0);
+}
+
+bool LoRaWAN::send(const std::vector<uint8_t>& data, uint8_t port, const SendOptions& options) {
+    bool confirmed = options.confirmed;
+
+    if (queuesUplink(data)) {
+        return queueUplink(data, port, confirmed);
+    }
+
+    if (!joined || isJoining()) return false;
 
     // If there's already a confirmation pending, don't allow another confirmed message
     if (confirmed && confirmState == ConfirmationState::WAITING_ACK) {
@@ -1214,53 +1719,65 @@ bool LoRaWAN::send(const std::vector<uint8_t>& data, uint8_t port, bool confirme
     }
     DEBUG_PRINT(std::dec << std::endl);
 
-    // Configure radio for uplink
-    pimpl->rfm->standbyMode();
-    
-    // If a single-channel gateway, use that frequency
-    if (one_channel_gateway) {
-        pimpl->rfm->setFrequency(one_channel_freq);
-        pimpl->rfm->setSpreadingFactor(one_channel_sf);
-        pimpl->rfm->setBandwidth(one_channel_bw);
-        pimpl->rfm->setCodingRate(one_channel_cr);
-        pimpl->rfm->setPreambleLength(one_channel_preamble);
-        pimpl->rfm->setInvertIQ(false);
-        pimpl->rfm->setSyncWord(0x34);
-        updateDataRateFromSF();
-    } else {
-        // Select channel based on best duty cycle availability
-        float lowestUsage = 100.0f;
-        int bestChannel = 0;
-        // Find the channel with the lowest duty cycle usage
-        for (int i = 0; i < 8; i++) {  // Only the first 8 channels
-            float usage = getDutyCycleUsage(i);
-            if (usage < lowestUsage && channelFrequencies[i] > 0) {
-                lowestUsage = usage;
-                bestChannel = i;
-            }
-        }
-        pimpl->rfm->setFrequency(channelFrequencies[bestChannel]);
-        pimpl->rfm->setSpreadingFactor(current_sf);
-        pimpl->rfm->setBandwidth(current_bw);
-        pimpl->rfm->setCodingRate(current_cr);
-        pimpl->rfm->setPreambleLength(current_preamble);
-        pimpl->rfm->setInvertIQ(false);
-        pimpl->rfm->setSyncWord(0x34);
-
-        DEBUG_PRINTLN("Selected channel " << bestChannel << " with frequency " 
-                   << channelFrequencies[bestChannel] << " MHz (usage: " << lowestUsage << "%)");
+    // A new frame (with a new FCnt) ends the pending confirmed one, also when
+    // its last attempt is still waiting for the ACK and nothing is left to retry
+    if (confirmState == ConfirmationState::WAITING_ACK) {
+        DEBUG_PRINTLN("Abandoning the pending confirmed message");
+        resetConfirmationState();
     }
+    pimpl->retxRemaining = 0;
 
-    // Store current parameters for use in RX1 window
-    current_channel = getChannelFromFrequency(pimpl->rfm->getFrequency());
-    current_sf = pimpl->rfm->getSpreadingFactor();
-    current_bw = pimpl->rfm->getBandwidth();
-    current_cr = pimpl->rfm->getCodingRate();
-    current_preamble = pimpl->rfm->getPreambleLength();
+    reserveFrameCounter();
+    std::vector<uint8_t> packet = buildUplink(data, port, confirmed, ackbit);
+    selectDataRate(packet.size(), options);
+    bool result = transmitFrame(packet, options.force_duty_cycle, false);
 
-    // Debug session keys
-    DEBUG_PRINT("Using NwkSKey: ");
-    for(const auto& byte : pimpl->nwkSKey) {
+    if (result) {
+        // Increment counter and save session
+        pimpl->uplinkCounter++;
+
+        // Increment ADR counter if enabled
+        if (adrEnabled) {
+            adrAckCounter++;
+            
+            // Reduce DR (increase SF) if we haven't received a response in a while
+            if (adrAckCounter > ADR_ACK_LIMIT + ADR_ACK_DELAY) {
+                updateTxParamsForADR();
+            }
+        }
+        
+        pimpl->saveSessionData();
+        publishSessionState(false);
+
+        // Confirmed frames are retried until acknowledged, unconfirmed ones
+        // are repeated NbTrans times, always with the same FCnt
+        pimpl->retxFrame = packet;
+        pimpl->retxConfirmed = confirmed;
+        pimpl->retxRemaining = confirmed ? MAX_RETRIES - 1 : getNbTrans() - 1;
+        pimpl->retxDue = std::chrono::steady_clock::time_point::max();
+    }
+
+    // If we had to ACK a message and have sent it, reset
+    if (ackbit && result)
+    {
+        resetConfirmationState();
+    }
+
+    // If it's a confirmed message and was sent successfully, update the state
+    if (confirmed && result)
+    {
+        confirmState = ConfirmationState::WAITING_ACK;
+        confirmRetries = 1;
+        DEBUG_PRINTLN("Confirmed message sent, waiting for ACK. Attempt: " << confirmRetries);
+    }
+
+    return result;
+}
+
+std::vector<uint8_t> LoRaWAN::buildUplink(const std::vector<uint8_t>& data, uint8_t port, bool confirmed, bool ackbit) {
+    // Debug session keys
+    DEBUG_PRINT("Using NwkSKey: ");
+    for(const auto& byte : pimpl->nwkSKey) {
         DEBUG_PRINT(std::hex << std::setw(2) << std::setfill('0') 
                  << static_cast<int>(byte) << " ");
     }
@@ -1357,8 +1874,10 @@ bool LoRaWAN::send(const std::vector<uint8_t>& data, uint8_t port, bool confirme
         pendingMACResponses.erase(pendingMACResponses.begin(), pendingMACResponses.begin() + mac_size);
     }
 
-    // 4. FPort (1 byte)
-    packet.push_back(port);
+    // 4. FPort (1 byte), absent when there is no FRMPayload (ACK or MAC-only frame)
+    if (!data.empty()) {
+        packet.push_back(port);
+    }
     
     // 5. FRMPayload (encrypted)
     auto encrypted = encryptPayload(data, port);
@@ -1376,9 +1895,12 @@ bool LoRaWAN::send(const std::vector<uint8_t>& data, uint8_t port, bool confirme
     DEBUG_PRINTLN("  FCtrl: " << std::hex << static_cast<int>(packet[5]));
     DEBUG_PRINTLN("  FCnt: " << std::hex << static_cast<int>(packet[6]) << " " 
              << static_cast<int>(packet[7]));
-    DEBUG_PRINTLN("  FPort: " << std::hex << static_cast<int>(packet[8]));
+    size_t payloadStart = packet.size() - encrypted.size();
+    if (!data.empty()) {
+        DEBUG_PRINTLN("  FPort: " << std::hex << static_cast<int>(packet[payloadStart - 1]));
+    }
     DEBUG_PRINT("  Encrypted Payload: ");
-    for(size_t i = 9; i < packet.size(); i++) {
+    for(size_t i = payloadStart; i < packet.size(); i++) {
         DEBUG_PRINT(std::hex << std::setw(2) << std::setfill('0') 
                 << static_cast<int>(packet[i]) << " ");
     }
@@ -1386,22 +1908,7 @@ bool LoRaWAN::send(const std::vector<uint8_t>& data, uint8_t port, bool confirme
     
     // CCalculation of MIC according to spec 4.4
     // B0 block exactly as defined by the specification
-    std::array<uint8_t, 16> b0;
-    std::fill(b0.begin(), b0.end(), 0);
-    b0[0] = 0x49;  // Block code for MIC
-    // bytes 1-4 are 0x00 (reserved)
-    b0[5] = 0x00;  // Dir = 0 for uplink
-    
-    // DevAddr (4 bytes, little-endian)
-    std::copy(pimpl->devAddr.begin(), pimpl->devAddr.end(), b0.begin() + 6);
-    
-    // FCnt (4 bytes, little-endian, the upper 2 bytes are 0)
-    b0[10] = pimpl->uplinkCounter & 0xFF;
-    b0[11] = (pimpl->uplinkCounter >> 8) & 0xFF;
-    // bytes 12-13 are 0x00 (FCntMSB = 0)
-    
-    // byte 14 is 0x00 (always 0 for small messages)
-    b0[15] = static_cast<uint8_t>(packet.size());  // Length of the message
+    auto b0 = uplinkBlock(0x49, pimpl->devAddr, pimpl->uplinkCounter, static_cast<uint8_t>(packet.size()));
 
     // Debug of the B0 block
     DEBUG_PRINT("B0 block for MIC: ");
@@ -1411,27 +1918,79 @@ bool LoRaWAN::send(const std::vector<uint8_t>& data, uint8_t port, bool confirme
     }
     DEBUG_PRINT(std::dec << std::endl);
 
-    // Build the block for CMAC
-    std::vector<uint8_t> cmacData;
-    cmacData.insert(cmacData.end(), b0.begin(), b0.end());
-    cmacData.insert(cmacData.end(), packet.begin(), packet.end());
-    
-    // Calculate CMAC with NwkSKey
-    auto cmac = AESCMAC::calculate(cmacData, pimpl->nwkSKey);
+    // Calculate CMAC with NwkSKey, continuing from the precomputed state after B0
+    AESCMAC::State micState;
+    if (pimpl->precomputedValid() && packet.size() < pimpl->precomputedMic.size()) {
+        micState = pimpl->precomputedMic[packet.size()];
+    } else {
+        AESCMAC::begin(micState, pimpl->nwkSKey);
+        AESCMAC::absorb(micState, pimpl->nwkSKey, b0.data());
+    }
+    auto cmac = AESCMAC::finish(micState, pimpl->nwkSKey, packet.data(), packet.size());
     
     // Add the first 4 bytes as MIC
     packet.insert(packet.end(), cmac.begin(), cmac.begin() + 4);
+
+    return packet;
+}
+
+bool LoRaWAN::transmitFrame(const std::vector<uint8_t>& frame, bool force_duty_cycle, bool retransmission) {
+    // Configure radio for uplink
+    pimpl->radio->standbyMode();
     
-    // Calculate the size of the packet to estimate air time
-    size_t packetSize = data.size() + 13; // Data + overhead LoRaWAN
+    // If a single-channel gateway, use that frequency
+    if (one_channel_gateway) {
+        pimpl->radio->setFrequency(one_channel_freq);
+        pimpl->radio->setSpreadingFactor(one_channel_sf);
+        pimpl->radio->setBandwidth(one_channel_bw);
+        pimpl->radio->setCodingRate(one_channel_cr);
+        pimpl->radio->setPreambleLength(one_channel_preamble);
+        pimpl->radio->setInvertIQ(false);
+        pimpl->radio->setSyncWord(0x34);
+        updateDataRateFromSF();
+    } else {
+        // Select channel based on delivery statistics and duty cycle availability
+        int bestChannel = selectChannel(frame.size(), retransmission ? current_channel : -1);
+
+        // The policy may override the ADR data rate for this frame
+        int sf = current_sf;
+        float bw = current_bw;
+        if (pimpl->frameDr >= 0) {
+            dataRateToSF(pimpl->frameDr, sf, bw);
+        }
+        pimpl->radio->setFrequency(channelFrequencies[bestChannel]);
+        pimpl->radio->setSpreadingFactor(sf);
+        pimpl->radio->setBandwidth(bw);
+        pimpl->radio->setCodingRate(current_cr);
+        pimpl->radio->setPreambleLength(current_preamble);
+        pimpl->radio->setInvertIQ(false);
+        pimpl->radio->setSyncWord(0x34);
+
+        DEBUG_PRINTLN("Selected channel " << bestChannel << " with frequency " 
+                   << channelFrequencies[bestChannel] << " MHz (usage: " << getDutyCycleUsage(bestChannel)
+                   << "%, delivery: " << pimpl->channelQuality[bestChannel].delivery << ")");
+    }
+
+    // Store current parameters for use in RX1 window, current_sf/current_bw
+    // keep the ADR data rate
+    current_channel = getChannelFromFrequency(pimpl->radio->getFrequency());
+    pimpl->uplinkSf = pimpl->radio->getSpreadingFactor();
+    pimpl->uplinkBw = pimpl->radio->getBandwidth();
+    pimpl->uplinkDr = (!one_channel_gateway && pimpl->frameDr >= 0) ? pimpl->frameDr : current_dr;
+    current_cr = pimpl->radio->getCodingRate();
+    current_preamble = pimpl->radio->getPreambleLength();
+
+    // Size of the frame to estimate air time
+    size_t packetSize = frame.size();
     
     // Verify duty cycle if not forced
-    float frequency = 868.1; // For one-channel gateway, we always use this frequency
+    float frequency = one_channel_gateway ? one_channel_freq : channelFrequencies[std::max(current_channel, 0)];
     
-    if (!force_duty_cycle && !checkDutyCycle(frequency, packetSize)) {
+    bool accounted = !force_duty_cycle && checkDutyCycle(frequency, packetSize);
+    if (!force_duty_cycle && !accounted) {
         DEBUG_PRINTLN("Duty cycle restriction active, delaying transmission");
         // Wait the necessary time
-        int channel = 0; // Single channel gateway always uses channel 0
+        int channel = std::max(getChannelFromFrequency(frequency), 0);
         auto now = std::chrono::steady_clock::now();
         auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
             now - lastChannelUse[channel]).count();
@@ -1442,75 +2001,91 @@ bool LoRaWAN::send(const std::vector<uint8_t>& data, uint8_t port, bool confirme
         if (elapsed < minWaitTime) {
             unsigned long wait_ms = static_cast<unsigned long>(minWaitTime - elapsed);
             DEBUG_PRINTLN("Waiting " << wait_ms << " ms for duty cycle...");
-            std::this_thread::sleep_for(std::chrono::milliseconds(wait_ms));
+            sleepWithHeartbeat(std::chrono::milliseconds(wait_ms));
         }
     }
     
     // Debug radio parameters for verification
     DEBUG_PRINTLN("Radio parameters:");
-    DEBUG_PRINTLN("  Frequency: " << pimpl->rfm->getFrequency() << " MHz");
-    DEBUG_PRINTLN("  SF: " << pimpl->rfm->getSpreadingFactor());
-    DEBUG_PRINTLN("  BW: " << pimpl->rfm->getBandwidth() << " kHz");
-    DEBUG_PRINTLN("  CR: 4/" << pimpl->rfm->getCodingRate());
-    DEBUG_PRINTLN("  Power: " << pimpl->rfm->getTxPower() << " dBm");
+    DEBUG_PRINTLN("  Frequency: " << pimpl->radio->getFrequency() << " MHz");
+    DEBUG_PRINTLN("  SF: " << pimpl->radio->getSpreadingFactor());
+    DEBUG_PRINTLN("  BW: " << pimpl->radio->getBandwidth() << " kHz");
+    DEBUG_PRINTLN("  CR: 4/" << pimpl->radio->getCodingRate());
+    DEBUG_PRINTLN("  Power: " << pimpl->radio->getTxPower() << " dBm");
     DEBUG_PRINTLN("Sending packet...");
     
     // Ensure the packet is sent correctly by checking radio status
-    pimpl->rfm->clearIRQFlags();
-    uint8_t opMode = pimpl->rfm->readRegister(RFM95::REG_OP_MODE);
-    DEBUG_PRINTLN("Mode before TX: 0x" << std::hex << (int)opMode << std::dec);
+    pimpl->radio->clearIrqStatus();
+    Radio::Mode opMode = pimpl->radio->getMode();
+    DEBUG_PRINTLN("Mode before TX: " << static_cast<int>(opMode));
     
-    // Transmit the packet
-    bool result = pimpl->rfm->send(packet);
+    // Per-frame power from the policy, ADR power restored afterwards
+    int adrPower = pimpl->radio->getTxPower();
+    bool powerOverride = !one_channel_gateway && pimpl->frameDr >= 0 && pimpl->framePower != adrPower;
+    if (powerOverride) {
+        pimpl->radio->setTxPower(pimpl->framePower, true);
+    }
+
+    // Transmit the packet; the standbys hear from us just before it blocks
+    publishSessionState(false);
+    bool result = pimpl->radio->send(frame);
+
+    if (powerOverride) {
+        pimpl->radio->setTxPower(adrPower, true);
+    }
     
     // Check result even if the flag isn't updated
     if (result) {
         DEBUG_PRINTLN("Packet sending completed");
-        pimpl->rfm->standbyMode();
-        // Increment counter and save session
-        pimpl->uplinkCounter++;
+
+        if (pimpl->packetCapture.isOpen()) {
+            Radio::Profile tx;
+            tx.frequency = frequency;
+            tx.spreading_factor = pimpl->uplinkSf;
+            tx.bandwidth = pimpl->uplinkBw;
+            pimpl->packetCapture.record(frame, tx, nullptr);
+        }
+        pimpl->radio->standbyMode();
+
+        // Forced or delayed transmissions were not registered by checkDutyCycle
+        if (!accounted) {
+            registerAirtime(frequency, calculateTimeOnAir(packetSize));
+        }
 
         // Save the timestamp of the last uplink
         pimpl->txEndTime = std::chrono::steady_clock::now();
-        setupRxWindows(); // Configure RX1 and RX2 windows
 
-        // Increment ADR counter if enabled
-        if (adrEnabled) {
-            adrAckCounter++;
-            
-            // Reduce DR (increase SF) if we haven't received a response in a while
-            if (adrAckCounter > ADR_ACK_LIMIT + ADR_ACK_DELAY) {
-                updateTxParamsForADR();
-            }
+        // The RX windows of this uplink decide its delivery outcome
+        pimpl->outcomeChannel = one_channel_gateway ? -1 : current_channel;
+        pimpl->outcomeConfirmed = (frame[0] & 0xE0) == 0x80; // Confirmed Data Up
+        if (pimpl->outcomeChannel >= 0) {
+            pimpl->channelQuality[pimpl->outcomeChannel].uplinks++;
         }
-        
-        pimpl->saveSessionData();
-        // // Wait 6 seconds to comply with duty cycle (1% on 868.1 MHz)
-        // DEBUG_PRINTLN("Waiting 6 seconds for duty cycle...");
-        // std::this_thread::sleep_for(std::chrono::seconds(6));
-        
+        setupRxWindows(); // Configure RX1 and RX2 windows
+        notifyEvent();    // The event loop re-arms for RX1
+
         // Return to continuous reception mode with appropriate configuration based on class
         if (currentClass == DeviceClass::CLASS_C) {
             DEBUG_PRINTLN("Configuring continuous reception at RX2 (869.525 MHz, Class C)");
-            pimpl->rfm->standbyMode();
-            pimpl->rfm->setFrequency(RX2_FREQ[lora_region]);
-            pimpl->rfm->setSpreadingFactor(RX2_SF[lora_region]);
-            pimpl->rfm->setBandwidth(RX2_BW[lora_region]);
-            pimpl->rfm->setCodingRate(RX2_CR[lora_region]);
-            pimpl->rfm->setPreambleLength(RX2_PREAMBLE[lora_region]);
-            pimpl->rfm->setInvertIQ(true);      // Inverted IQ for downlink
-            pimpl->rfm->setContinuousReceive();
+            pimpl->radio->standbyMode();
+            pimpl->radio->setFrequency(RX2_FREQ[lora_region]);
+            pimpl->radio->setSpreadingFactor(RX2_SF[lora_region]);
+            pimpl->radio->setBandwidth(RX2_BW[lora_region]);
+            pimpl->radio->setCodingRate(RX2_CR[lora_region]);
+            pimpl->radio->setPreambleLength(RX2_PREAMBLE[lora_region]);
+            pimpl->radio->setInvertIQ(true);      // Inverted IQ for downlink
+            pimpl->radio->setContinuousReceive();
         } else {
             // For Class A, configure RX1 normally
-            pimpl->rfm->setFrequency(channelFrequencies[current_channel]);
-            pimpl->rfm->setSpreadingFactor(current_sf);
-            pimpl->rfm->setBandwidth(current_bw);
-            pimpl->rfm->setCodingRate(current_cr);
-            pimpl->rfm->setPreambleLength(current_preamble);
-            pimpl->rfm->setInvertIQ(false);
-            pimpl->rfm->setContinuousReceive();
+            pimpl->radio->setFrequency(channelFrequencies[current_channel]);
+            pimpl->radio->setSpreadingFactor(pimpl->uplinkSf);
+            pimpl->radio->setBandwidth(pimpl->uplinkBw);
+            pimpl->radio->setCodingRate(current_cr);
+            pimpl->radio->setPreambleLength(current_preamble);
+            pimpl->radio->setInvertIQ(false);
+            pimpl->radio->setContinuousReceive();
             DEBUG_PRINTLN("Returning to standby mode (Class A)");
-            pimpl->rfm->standbyMode();
+            pimpl->radio->standbyMode();
         }
     } else {
         DEBUG_PRINTLN("Error sending packet");
@@ -1521,95 +2096,127 @@ bool LoRaWAN::send(const std::vector<uint8_t>& data, uint8_t port, bool confirme
         // For Class C, return to continuous listening on RX2
         if (currentClass == DeviceClass::CLASS_C)
         {
-            pimpl->rfm->standbyMode();
-            pimpl->rfm->setFrequency(RX2_FREQ[lora_region]);
-            pimpl->rfm->setSpreadingFactor(RX2_SF[lora_region]);
-            pimpl->rfm->setBandwidth(RX2_BW[lora_region]);
-            pimpl->rfm->setCodingRate(RX2_CR[lora_region]);
-            pimpl->rfm->setPreambleLength(RX2_PREAMBLE[lora_region]);
-            pimpl->rfm->setInvertIQ(true);
-            pimpl->rfm->setContinuousReceive();
+            pimpl->radio->standbyMode();
+            pimpl->radio->setFrequency(RX2_FREQ[lora_region]);
+            pimpl->radio->setSpreadingFactor(RX2_SF[lora_region]);
+            pimpl->radio->setBandwidth(RX2_BW[lora_region]);
+            pimpl->radio->setCodingRate(RX2_CR[lora_region]);
+            pimpl->radio->setPreambleLength(RX2_PREAMBLE[lora_region]);
+            pimpl->radio->setInvertIQ(true);
+            pimpl->radio->setContinuousReceive();
         }
     }
 
-    // If it's a confirmed message and was sent successfully, update the state
-    if (confirmed && result)
-    {
-        confirmState = ConfirmationState::WAITING_ACK;
-        confirmRetries++;
-        lastConfirmAttempt = std::chrono::steady_clock::now();
-        pendingAck = data;
-        ackPort = port;
-        DEBUG_PRINTLN("Confirmed message sent, waiting for ACK. Attempt: " << confirmRetries);
-    }
-
-    // If we had to ACK a message and have sent it, reset
-    if (ackbit && result)
-    {
-        resetConfirmationState();
-    }
-
     return result;
 }
 
-void LoRaWAN::update() {
-    if (!joined) return;
+std::chrono::milliseconds LoRaWAN::update() {
+    // Rounded up, a caller sleeping this long must not wake before the deadline
+    auto timeToNextEvent = [this] {
+        auto next = nextEventTime();
+        if (next == std::chrono::steady_clock::time_point::max()) {
+            return std::chrono::milliseconds::max();
+        }
+        auto wait = std::chrono::ceil<std::chrono::milliseconds>(next - std::chrono::steady_clock::now());
+        return std::max(wait, std::chrono::milliseconds(0));
+    };
+
+    // Join accept windows of startJoin(); nothing else runs until it ends
+    updateJoin();
+    if (!joined || isJoining()) {
+        expireReceiveWaiters();
+        runCompletions();
+        return timeToNextEvent();
+    }
 
     // Manage reception windows
     updateRxWindows();
 
-    // Manage pending confirmations
-    handleConfirmation();
+    // Retry confirmed frames and repeat unconfirmed ones
+    updateRetransmissions();
+
+    // Fetch downlinks the network still has queued and deliver pending ACKs
+    updateDownlinkDrain();
+
+    // Backfill uplinks stored while offline
+    drainUplinkQueue();
+
+    // Keep the standbys' replica current
+    publishSessionState(false);
+
+    // Prepare the crypto of the next uplink outside the TX path
+    if (pimpl->rxState == RX_IDLE || pimpl->rxState == RX_CONTINUOUS) {
+        precomputeUplink();
+    }
+
+    // Survey the channel plan while a Class A device has nothing else to do
+    if (pimpl->surveyEnabled && currentClass == DeviceClass::CLASS_A && pimpl->rxState == RX_IDLE &&
+        std::chrono::steady_clock::now() - pimpl->lastSurvey >= pimpl->surveyInterval) {
+        surveyChannels(pimpl->surveySamples);
+    }
 
     // Check if the class has changed or we need to restart continuous listening
-    uint8_t opMode = pimpl->rfm->readRegister(RFM95::REG_OP_MODE);
+    Radio::Mode opMode = pimpl->radio->getMode();
 
     // Only reconfigure if we're not already in continuous RX mode
-    if ((opMode & 0x07) != RFM95::MODE_RX_CONTINUOUS &&
+    if (opMode != Radio::Mode::RX_CONTINUOUS &&
         pimpl->rxState != RX_WINDOW_1 && pimpl->rxState != RX_WINDOW_2) {
         // If we're in Class C, always listen on RX2
         if (currentClass == DeviceClass::CLASS_C) {
             // Configure for RX2
-            pimpl->rfm->standbyMode();
-            pimpl->rfm->setFrequency(RX2_FREQ[lora_region]);
-            pimpl->rfm->setSpreadingFactor(RX2_SF[lora_region]);
-            pimpl->rfm->setBandwidth(RX2_BW[lora_region]);
-            pimpl->rfm->setCodingRate(RX2_CR[lora_region]);
-            pimpl->rfm->setPreambleLength(RX2_PREAMBLE[lora_region]);
-            pimpl->rfm->setInvertIQ(true);  // Invert IQ for downlink
-            pimpl->rfm->setContinuousReceive();
+            Radio::Profile rx2;
+            rx2.frequency = RX2_FREQ[lora_region];
+            rx2.spreading_factor = RX2_SF[lora_region];
+            rx2.bandwidth = RX2_BW[lora_region];
+            rx2.coding_rate = RX2_CR[lora_region];
+            rx2.preamble_length = RX2_PREAMBLE[lora_region];
+            rx2.invert_iq = true;  // Invert IQ for downlink
+            pimpl->radio->standbyMode();
+            pimpl->radio->applyProfile(rx2);
+            pimpl->radio->setContinuousReceive();
             pimpl->rxState = RX_CONTINUOUS;
             DEBUG_PRINTLN("Radio reconfigured for continuous RX2 at " << RX2_FREQ[lora_region] << " MHz (SF" << RX2_SF[lora_region] << ")");
         } else {
             // For Class A, configure at the main frequency
-            pimpl->rfm->standbyMode();
-            pimpl->rfm->setFrequency(channelFrequencies[current_channel]);
-            pimpl->rfm->setSpreadingFactor(current_sf);
-            pimpl->rfm->setBandwidth(current_bw);
-            pimpl->rfm->setCodingRate(current_cr);
-            pimpl->rfm->setPreambleLength(current_preamble);
-            pimpl->rfm->setInvertIQ(true);
-            pimpl->rfm->setContinuousReceive();
+            Radio::Profile rx;
+            rx.frequency = channelFrequencies[current_channel];
+            rx.spreading_factor = pimpl->uplinkSf;
+            rx.bandwidth = pimpl->uplinkBw;
+            rx.coding_rate = current_cr;
+            rx.preamble_length = current_preamble;
+            rx.invert_iq = true;
+            pimpl->radio->standbyMode();
+            pimpl->radio->applyProfile(rx);
+            pimpl->radio->setContinuousReceive();
             DEBUG_PRINTLN("Returning to standby mode (Class A)");
         }
     }
 
     // Check if there is received data by checking IRQ flags
-    uint8_t flags = pimpl->rfm->getIRQFlags();
+    uint16_t flags = pimpl->radio->getIrqStatus();
     
-    if (flags & RFM95::IRQ_RX_DONE_MASK) {
+    if (flags & Radio::IRQ_RX_DONE) {
         DEBUG_PRINTLN("Packet reception detected!");
         
+        // RX1 shares the uplink channel, its CRC errors point at interference there
+        if (pimpl->rxState == RX_WINDOW_1 && pimpl->outcomeChannel >= 0) {
+            ChannelQuality& quality = pimpl->channelQuality[pimpl->outcomeChannel];
+            bool crcError = (flags & Radio::IRQ_CRC_ERROR) != 0;
+            quality.crcErrorRate += QUALITY_ALPHA * ((crcError ? 1.0f : 0.0f) - quality.crcErrorRate);
+        }
+
         // Check if there's a CRC error
-        if (flags & RFM95::IRQ_PAYLOAD_CRC_ERROR_MASK) {
+        if (flags & Radio::IRQ_CRC_ERROR) {
             DEBUG_PRINTLN("CRC error in received packet");
         } else {
             // Show detailed information about the packet
-            int rssi = pimpl->rfm->getRSSI();
-            float snr = pimpl->rfm->getSNR();
+            Radio::PacketInfo info = pimpl->radio->getPacketInfo();
+            int rssi = info.rssi;
+            float snr = info.snr;
             
-            auto payload = pimpl->rfm->readPayload();
+            auto payload = pimpl->radio->readPayload();
             if (!payload.empty()) {
+                captureDownlink(payload, &info);
                 DEBUG_PRINTLN("Packet received: " << payload.size() << " bytes, RSSI: " 
                           << rssi << " dBm, SNR: " << snr << " dB");
                 DEBUG_PRINT("Hex: ");
@@ -1636,12 +2243,25 @@ void LoRaWAN::update() {
                             // Collect statistics for ADR
                             pimpl->addSnrSample(snr);
                             pimpl->addRssiSample(rssi);
+
+                            // A downlink in RX1/RX2 means the last uplink got through,
+                            // so unconfirmed repetitions stop
+                            if (pimpl->rxState == RX_WINDOW_1 || pimpl->rxState == RX_WINDOW_2) {
+                                recordDownlinkOutcome(true);
+                                if (!pimpl->retxConfirmed) {
+                                    pimpl->retxRemaining = 0;
+                                }
+                            }
                             
                             // Use handleReceivedMessage to process the message
                             handleReceivedMessage(payload, msg);
                             
-                            // Notify via callback
-                            if (receiveCallback) {
+                            // Pending receiveNext() requests come first, then the callback
+                            if (!pimpl->receiveWaiters.empty()) {
+                                auto done = std::move(pimpl->receiveWaiters.front().done);
+                                pimpl->receiveWaiters.pop_front();
+                                deferCompletion([done, msg] { done(true, msg); });
+                            } else if (receiveCallback) {
                                 receiveCallback(msg);
                             } else {
                                 // Save in the queue
@@ -1710,16 +2330,47 @@ void LoRaWAN::update() {
         }
         
         // Clear flag and reconfigure to continue receiving
-        pimpl->rfm->clearIRQFlagRxDone();
-        pimpl->rfm->setContinuousReceive();
+        pimpl->radio->clearIrqStatus(Radio::IRQ_RX_DONE);
+        pimpl->radio->setContinuousReceive();
+    }
+
+    expireReceiveWaiters();
+    runCompletions();
+    return timeToNextEvent();
+}
+
+int LoRaWAN::getEventFd() {
+    if (pimpl->events.fd() < 0) {
+        if (!pimpl->events.open()) {
+            return -1;
+        }
+        pimpl->events.arm(nextEventTime());
     }
+    return pimpl->events.fd();
+}
+
+void LoRaWAN::processEvents() {
+    pimpl->events.consume();
+    update();
+    pimpl->events.arm(nextEventTime());
+}
+
+void LoRaWAN::notifyEvent() {
+    pimpl->events.notify();
+}
+
+void LoRaWAN::setIrqWakeup(bool enable) {
+    pimpl->irqWakeup = enable;
+    notifyEvent();
 }
 
 bool LoRaWAN::receive(Message& message, unsigned long timeout) {
     if (!joined) return false;
 
-    auto data = pimpl->rfm->receive(timeout / 1000.0);
+    auto data = pimpl->radio->receive(timeout / 1000.0);
     if (!data.empty()) {
+        captureDownlink(data);
+
         // Extraer información del encabezado
         message.port = data[8];
         message.confirmed = (data[0] & 0x20) != 0;
@@ -1734,6 +2385,44 @@ bool LoRaWAN::receive(Message& message, unsigned long timeout) {
     return false;
 }
 
+void LoRaWAN::receiveNext(std::chrono::milliseconds timeout, std::function<void(bool, const Message&)> done) {
+    if (!done) return;
+
+    {
+        std::lock_guard<std::mutex> lock(pimpl->queueMutex);
+        if (!pimpl->rxQueue.empty()) {
+            Message message = pimpl->rxQueue.front();
+            pimpl->rxQueue.pop();
+            deferCompletion([done, message] { done(true, message); });
+            return;
+        }
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    Impl::ReceiveWaiter waiter;
+    waiter.deadline = timeout >= std::chrono::duration_cast<std::chrono::milliseconds>(
+                                     std::chrono::steady_clock::time_point::max() - now)
+                          ? std::chrono::steady_clock::time_point::max()
+                          : now + timeout;
+    waiter.done = std::move(done);
+    pimpl->receiveWaiters.push_back(std::move(waiter));
+    notifyEvent();
+}
+
+void LoRaWAN::expireReceiveWaiters() {
+    auto now = std::chrono::steady_clock::now();
+    auto& waiters = pimpl->receiveWaiters;
+    for (auto it = waiters.begin(); it != waiters.end();) {
+        if (it->deadline > now) {
+            ++it;
+            continue;
+        }
+        auto done = std::move(it->done);
+        deferCompletion([done] { done(false, Message()); });
+        it = waiters.erase(it);
+    }
+}
+
 void LoRaWAN::onReceive(std::function<void(const Message&)> callback) {
     receiveCallback = callback;
 }
@@ -1745,7 +2434,7 @@ void LoRaWAN::onJoin(std::function<void(bool)> callback) {
 void LoRaWAN::setRegion(int region) {
     if (region >= 0 && region < REGIONS) {
         lora_region = region;
-        pimpl->rfm->setFrequency(BASE_FREQ[region]);
+        pimpl->radio->setFrequency(BASE_FREQ[region]);
         current_channel = 0; // Canal 0 por defecto
         
         // Actualizar canales según la región
@@ -1760,14 +2449,14 @@ int LoRaWAN::getRegion() const {
 }
 
 float LoRaWAN::getFrequency() const {
-    return pimpl->rfm->getFrequency();
+    return pimpl->radio->getFrequency();
 }
 
 void LoRaWAN::setFrequency(float freq_mhz) {
     // Verificar si la frecuencia está en un canal permitido
     int channel = getChannelFromFrequency(freq_mhz);
     if (channel >= 0) {
-        pimpl->rfm->setFrequency(freq_mhz);
+        pimpl->radio->setFrequency(freq_mhz);
     } else {
         DEBUG_PRINTLN("Invalid frequency or not allowed on any channel");
     }
@@ -1798,7 +2487,7 @@ void LoRaWAN::setChannel(uint8_t channel) {
     if (channel < MAX_CHANNELS && channelFrequencies[channel] > 0) {
         pimpl->channel = channel;
         // Set the corresponding frequency in the radio
-        pimpl->rfm->setFrequency(channelFrequencies[channel]);
+        pimpl->radio->setFrequency(channelFrequencies[channel]);
     } else {
         DEBUG_PRINTLN("Invalid or disabled channel: " << channel);
     }
@@ -1828,21 +2517,196 @@ float LoRaWAN::getSingleChannelFrequency() const {
     return one_channel_freq;
 }
 
+std::vector<LoRaWAN::ChannelNoise> LoRaWAN::surveyChannels(size_t samples_per_channel) {
+    pimpl->lastSurvey = std::chrono::steady_clock::now();
+    if (samples_per_channel == 0) {
+        return pimpl->channelNoise;
+    }
+
+    std::vector<float> frequencies;
+    for (int i = 0; i < MAX_CHANNELS; i++) {
+        if (channelFrequencies[i] > 0) {
+            frequencies.push_back(channelFrequencies[i]);
+        }
+    }
+    frequencies.push_back(RX2_FREQ[lora_region]);
+
+    std::vector<ChannelNoise> results;
+    std::vector<float> samples(samples_per_channel);
+    auto start = std::chrono::steady_clock::now();
+
+    for (float frequency : frequencies) {
+        if (!pimpl->radio->sampleRSSI(frequency, samples.data(), samples.size())) {
+            DEBUG_PRINTLN("Channel survey not supported by the radio or failed at " << frequency << " MHz");
+            results.clear();
+            break;
+        }
+
+        std::sort(samples.begin(), samples.end());
+        ChannelNoise noise;
+        noise.frequency = frequency;
+        noise.samples = samples.size();
+        noise.min = samples.front();
+        float sum = 0.0f;
+        for (float sample : samples) {
+            sum += sample;
+        }
+        noise.mean = sum / samples.size();
+        size_t p95_index = static_cast<size_t>(std::ceil(samples.size() * 0.95)) - 1;
+        noise.p95 = samples[std::min(p95_index, samples.size() - 1)];
+        results.push_back(noise);
+    }
+
+    // Leave the radio idle, update() reconfigures reception
+    pimpl->radio->standbyMode();
+
+    if (!results.empty()) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        DEBUG_PRINTLN("Channel survey: " << results.size() << " channels in " << elapsed / 1000.0 << " ms");
+        for (const auto& noise : results) {
+            DEBUG_PRINTLN("  " << noise.frequency << " MHz: min " << noise.min << " dBm, mean "
+                          << noise.mean << " dBm, p95 " << noise.p95 << " dBm");
+        }
+        pimpl->channelNoise = results;
+
+        // Feed the noise floor into the channel quality model
+        for (const auto& noise : results) {
+            int channel = getChannelFromFrequency(noise.frequency);
+            if (channel >= 0) {
+                pimpl->channelQuality[channel].noiseFloor = noise.p95;
+            }
+        }
+    }
+    return results;
+}
+
+void LoRaWAN::setBackgroundSurvey(bool enable, int interval_s, size_t samples_per_channel) {
+    pimpl->surveyEnabled = enable;
+    pimpl->surveyInterval = std::chrono::seconds(interval_s);
+    pimpl->surveySamples = samples_per_channel;
+}
+
+const std::vector<LoRaWAN::ChannelNoise>& LoRaWAN::getChannelNoise() const {
+    return pimpl->channelNoise;
+}
+
+LoRaWAN::ChannelQuality LoRaWAN::getChannelQuality(int channel) const {
+    if (channel < 0 || channel >= MAX_CHANNELS) {
+        return ChannelQuality();
+    }
+    return pimpl->channelQuality[channel];
+}
+
+int LoRaWAN::selectChannel(size_t payload_size, int exclude) {
+    // Airtime at the data rate of this uplink, the radio may still hold the last RX settings
+    float airTime = timeOnAir(payload_size, current_sf, current_bw);
+
+    // Noise is weighted relative to the quietest surveyed channel
+    float quietest = 0.0f;
+    for (int i = 0; i < MAX_CHANNELS; i++) {
+        float noise = pimpl->channelQuality[i].noiseFloor;
+        if (isChannelEnabled(i) && noise < 0.0f && (quietest == 0.0f || noise < quietest)) {
+            quietest = noise;
+        }
+    }
+
+    std::vector<int> candidates;
+    std::vector<float> weights;
+    float total = 0.0f;
+    for (int i = 0; i < MAX_CHANNELS; i++) {
+        if (!isChannelEnabled(i) || i == exclude || !isChannelAvailable(i, airTime)) {
+            continue;
+        }
+
+        const ChannelQuality& quality = pimpl->channelQuality[i];
+        // A small floor keeps bad channels probed so they can recover
+        float weight = 0.05f + quality.delivery;
+        weight *= 1.0f - 0.5f * quality.crcErrorRate;
+        if (quality.noiseFloor < 0.0f && quietest < 0.0f) {
+            // -6 dB of extra noise halves the weight
+            weight *= std::max(0.1f, std::pow(10.0f, -(quality.noiseFloor - quietest) / 20.0f));
+        }
+
+        candidates.push_back(i);
+        weights.push_back(weight);
+        total += weight;
+    }
+
+    if (candidates.empty() && exclude >= 0) {
+        // The excluded channel is the only one left
+        return selectChannel(payload_size);
+    }
+
+    if (candidates.empty()) {
+        // Nothing is free, fall back to the least used enabled channel
+        float lowestUsage = 100.0f;
+        int bestChannel = 0;
+        for (int i = 0; i < MAX_CHANNELS; i++) {
+            float usage = getDutyCycleUsage(i);
+            if (usage < lowestUsage && isChannelEnabled(i)) {
+                lowestUsage = usage;
+                bestChannel = i;
+            }
+        }
+        return bestChannel;
+    }
+
+    float pick = total * (std::rand() / (RAND_MAX + 1.0f));
+    for (size_t i = 0; i < candidates.size(); i++) {
+        if (pick < weights[i]) {
+            return candidates[i];
+        }
+        pick -= weights[i];
+    }
+    return candidates.back();
+}
+
+bool LoRaWAN::isChannelEnabled(int channel) const {
+    return channelFrequencies[channel] > 0 && (pimpl->channelMask & (1u << channel)) != 0;
+}
+
+bool LoRaWAN::isChannelAvailable(int channel, float air_time_ms) const {
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - lastChannelUse[channel]).count();
+
+    // Same 1% rule as checkDutyCycle
+    return elapsed >= (air_time_ms / 0.01f) - air_time_ms;
+}
+
+void LoRaWAN::recordDownlinkOutcome(bool delivered) {
+    if (pimpl->outcomeChannel < 0) {
+        return;
+    }
+
+    // Confirmed uplinks always expect a downlink, they measure the loss rate
+    if (pimpl->outcomeConfirmed) {
+        pimpl->lossRate += QUALITY_ALPHA * ((delivered ? 0.0f : 1.0f) - pimpl->lossRate);
+    }
+
+    ChannelQuality& quality = pimpl->channelQuality[pimpl->outcomeChannel];
+    quality.delivery += QUALITY_ALPHA * ((delivered ? 1.0f : 0.0f) - quality.delivery);
+    if (delivered) {
+        quality.downlinks++;
+    }
+    pimpl->outcomeChannel = -1;
+}
+
 void LoRaWAN::setTxPower(int8_t power) {
     // Limit between 2 dBm and the maximum allowed by the region
     if (power < 2) power = 2; // Most LoRa modules do not go below 2 dBm
     if (power > MAX_POWER[lora_region]) power = MAX_POWER[lora_region];
     
     pimpl->txPower = power;
-    pimpl->rfm->setTxPower(power, true); // true = PA_BOOST
+    pimpl->radio->setTxPower(power, true); // true = PA_BOOST
 }
 
 int LoRaWAN::getRSSI() const {
-    return pimpl->rfm->getRSSI();
+    return pimpl->radio->getRSSI();
 }
 
 int LoRaWAN::getSNR() const {
-    return pimpl->rfm->getSNR();
+    return pimpl->radio->getSNR();
 }
 
 uint32_t LoRaWAN::getFrameCounter() const {
@@ -1854,11 +2718,11 @@ void LoRaWAN::setFrameCounter(uint32_t counter) {
 }
 
 void LoRaWAN::wake() {
-    pimpl->rfm->standbyMode();
+    pimpl->radio->standbyMode();
 }
 
 void LoRaWAN::sleep() {
-    pimpl->rfm->sleepMode();
+    pimpl->radio->sleepMode();
 }
 
 bool LoRaWAN::validateKeys() const {
@@ -1872,7 +2736,7 @@ bool LoRaWAN::validateKeys() const {
     }
     if (!validDevAddr) {
         DEBUG_PRINTLN("ABP validation failed: DevAddr is all zeros");
-        std::cerr << "Error: Invalid DevAddr for ABP" << std::endl;
+        LOG_ERROR("Invalid DevAddr for ABP");
         return false;
     }
     
@@ -1886,7 +2750,7 @@ bool LoRaWAN::validateKeys() const {
     }
     if (!validNwkSKey) {
         DEBUG_PRINTLN("ABP validation failed: NwkSKey is all zeros");
-        std::cerr << "Error: Invalid NwkSKey for ABP" << std::endl;
+        LOG_ERROR("Invalid NwkSKey for ABP");
         return false;
     }
     
@@ -1900,7 +2764,7 @@ bool LoRaWAN::validateKeys() const {
     }
     if (!validAppSKey) {
         DEBUG_PRINTLN("ABP validation failed: AppSKey is all zeros");
-        std::cerr << "Error: Invalid AppSKey for ABP" << std::endl;
+        LOG_ERROR("Invalid AppSKey for ABP");
         return false;
     }
     
@@ -1936,7 +2800,10 @@ void LoRaWAN::resetSession()
     pimpl->downlinkCounter = 0;
     joined = false;
 
-    // Delete session file if it exists
+    pimpl->channelMask = 0xFFFF;
+
+    // Delete session file if it exists, after a save still queued
+    pimpl->ioExecutor.flush();
     SessionManager::clearSession(pimpl->sessionFile);
 
     // Reset DevNonces
@@ -1955,29 +2822,11 @@ void LoRaWAN::applyADRSettings(uint8_t dataRate, uint8_t txPower, const std::vec
     // Map DR to SF/BW based on the region
     int sf = 9; // Default value
     float bw = 125.0f;
+    dataRateToSF(dataRate, sf, bw);
 
-    // Determine SF and BW based on the region and DR
-    switch (lora_region) {
-        case REGION_EU868:
-            if (dataRate < 6) {
-                sf = 12 - dataRate;
-                bw = 125.0f;
-            }
-            else if (dataRate == 6) {
-                sf = 7;
-                bw = 250.0f;
-            }
-            else { // DR7
-                sf = 7;
-                bw = 125.0f;
-            }
-            break;
-            
-        // Add other regions as necessary
-        default:
-            // Generic mapping for other regions
-            sf = dataRate <= 6 ? (12 - dataRate) : 7;
-            bw = dataRate == 6 ? 250.0 : 125.0;
+    // ChMask as carried by LinkADRReq, little endian
+    if (channelMask.size() >= 2) {
+        pimpl->channelMask = static_cast<uint16_t>(channelMask[0] | (channelMask[1] << 8));
     }
 
     // Determine power based on the region
@@ -1998,11 +2847,11 @@ void LoRaWAN::applyADRSettings(uint8_t dataRate, uint8_t txPower, const std::vec
     if (power > MAX_POWER[lora_region]) power = MAX_POWER[lora_region];
     
     // Apply settings to the radio using the pimpl (this is done in LoRaWAN.cpp)
-    pimpl->rfm->setSpreadingFactor(sf);
+    pimpl->radio->setSpreadingFactor(sf);
     current_sf = sf;
-    pimpl->rfm->setBandwidth(bw);
+    pimpl->radio->setBandwidth(bw);
     current_bw = bw;
-    pimpl->rfm->setTxPower(power, true);
+    pimpl->radio->setTxPower(power, true);
     pimpl->txPower = power;
     updateDataRateFromSF();
     DEBUG_PRINTLN("ADR settings applied: DataRate=" << static_cast<int>(dataRate) << ", TxPower=" << power);
@@ -2069,7 +2918,7 @@ void LoRaWAN::processMACCommands(const std::vector<uint8_t> &commands, std::vect
                 response.push_back(battery);
 
                 // Add signal margin (-32...31 dB)
-                float snr = pimpl->rfm->getSNR();
+                float snr = pimpl->radio->getSNR();
                 int8_t margin = static_cast<int8_t>(std::max(-32.0f, std::min(31.0f, snr)));
                 response.push_back(static_cast<uint8_t>(margin));
 
@@ -2087,7 +2936,12 @@ void LoRaWAN::processMACCommands(const std::vector<uint8_t> &commands, std::vect
                 DEBUG_PRINTLN("Received LINK_CHECK_ANS: Margin=" << static_cast<int>(margin)
                                                                  << " dB, GW Count=" << static_cast<int>(gwCount));
 
-                // Here you could store these values or notify via a callback
+                // The margin is above the demodulation floor of the uplink's SF
+                if (gwCount > 0 && pimpl->uplinkSf >= 7 && pimpl->uplinkSf <= 12)
+                {
+                    pimpl->uplinkSnr = margin + REQUIRED_SNR[pimpl->uplinkSf - 7];
+                    pimpl->uplinkSnrValid = true;
+                }
             }
             break;
 
@@ -2179,6 +3033,25 @@ void LoRaWAN::processMACCommands(const std::vector<uint8_t> &commands, std::vect
             }
             break;
 
+        case MAC_DEVICE_TIME_ANS:
+            if (index + 5 <= commands.size())
+            {
+                // Seconds since the GPS epoch (4 bytes) and 1/256 s fractions,
+                // valid at the end of the uplink that carried the request
+                uint32_t seconds = commands[index] | (commands[index + 1] << 8) |
+                                   (commands[index + 2] << 16) | (static_cast<uint32_t>(commands[index + 3]) << 24);
+                uint8_t fraction = commands[index + 4];
+                index += 5;
+
+                pimpl->networkTimeMs = static_cast<int64_t>(seconds) * 1000 + (fraction * 1000) / 256;
+                pimpl->networkTimeRef = pimpl->txEndTime;
+                pimpl->networkTimeValid = true;
+
+                DEBUG_PRINTLN("Received DEVICE_TIME_ANS: GPS time " << seconds << "." << std::setw(3)
+                                                                   << std::setfill('0') << (fraction * 1000) / 256 << " s");
+            }
+            break;
+
         default:
             // Skip unrecognized commands
             DEBUG_PRINTLN("Unrecognized MAC command: 0x" << std::hex << static_cast<int>(cmd));
@@ -2335,6 +3208,25 @@ void LoRaWAN::processLinkADRReq(const std::vector<uint8_t> &cmd, size_t index, s
         // Other regions as needed
     }
 
+    // ChMask covers channels 0-15, ChMaskCntl 1-4 of EU868 are folded into it above
+    bool applyChannelMask = validChannelMask && (lora_region == REGION_EU868 || chmaskcntl == 0);
+    if (applyChannelMask)
+    {
+        bool anyEnabled = false;
+        for (int i = 0; i < MAX_CHANNELS; i++)
+        {
+            if ((chmask & (1u << i)) && channelFrequencies[i] > 0)
+            {
+                anyEnabled = true;
+            }
+        }
+        if (!anyEnabled)
+        {
+            validChannelMask = false;
+            DEBUG_PRINTLN("ChMask enables no defined channel");
+        }
+    }
+
     if (!validChannelMask)
     {
         status &= ~0x01; // Channel mask not accepted
@@ -2435,41 +3327,24 @@ void LoRaWAN::processLinkADRReq(const std::vector<uint8_t> &cmd, size_t index, s
         DEBUG_PRINTLN("  Power: " << (MAX_POWER[lora_region] - 2 * txpower) << "dBm");
 
         // Apply configuration to the radio
-        pimpl->rfm->setSpreadingFactor(sf);
+        pimpl->radio->setSpreadingFactor(sf);
         current_sf = sf;
-        pimpl->rfm->setBandwidth(bw);
+        pimpl->radio->setBandwidth(bw);
         current_bw = bw;
-        pimpl->rfm->setTxPower(power, true);
+        pimpl->radio->setTxPower(power, true);
         pimpl->txPower = power;
         updateDataRateFromSF(); // Update DR from SF
 
-        // Apply channel mask if valid
-        if (validChannelMask)
+        // Apply channel mask if valid. Masked channels keep their frequency,
+        // selectChannel() skips them until a later ChMask enables them again.
+        if (applyChannelMask)
         {
-            // For EU868 with ChMaskCntl=0, apply directly the ChMask
-            if (lora_region == REGION_EU868 && chmaskcntl == 0)
-            {
-                for (int i = 0; i < 16; i++)
-                {
-                    if (i < 8)
-                    { // We only have 8 channels in EU868
-                        // If the bit is enabled, activate the channel
-                        bool enabled = (chmask & (1 << i)) != 0;
-                        if (enabled)
-                        {
-                            channelFrequencies[i] = BASE_FREQ[lora_region] + i * CHANNEL_STEP[lora_region];
-                        }
-                        else
-                        {
-                            channelFrequencies[i] = 0; // Disable channel
-                        }
-                    }
-                }
-            }
-
-            // For other region/ChMaskCntl combinations, implement as needed
+            pimpl->channelMask = chmask;
+            DEBUG_PRINTLN("Channel mask set to 0x" << std::hex << chmask << std::dec);
         }
 
+        // For other region/ChMaskCntl combinations, implement as needed
+
         DEBUG_PRINTLN("Final status of ADR command: " << std::bitset<3>(status).to_string());
 
         // Apply the number of repetitions (nbRep)
@@ -2504,8 +3379,8 @@ void LoRaWAN::sendADRStatistics()
     std::vector<uint8_t> data;
 
     // Collect statistical data
-    float avgSnr = pimpl->rfm->getSNR();
-    int avgRssi = pimpl->rfm->getRSSI();
+    float avgSnr = pimpl->radio->getSNR();
+    int avgRssi = pimpl->radio->getRSSI();
 
     // Custom packet with statistics (port 2)
     data.push_back(0x01); // Type of statistical message
@@ -2527,13 +3402,13 @@ void LoRaWAN::sendADRStatistics()
 void LoRaWAN::updateTxParamsForADR()
 {
     // Get current SF and power
-    int currentSF = pimpl->rfm->getSpreadingFactor();
+    int currentSF = pimpl->radio->getSpreadingFactor();
 
     // Increment SF (reduce DR) to improve range
     if (currentSF < 12)
     {
         currentSF++;
-        pimpl->rfm->setSpreadingFactor(currentSF);
+        pimpl->radio->setSpreadingFactor(currentSF);
         current_sf = currentSF;
         DEBUG_PRINTLN("ADR: Increasing SF to " << currentSF << " due to lack of response");
     }
@@ -2542,7 +3417,7 @@ void LoRaWAN::updateTxParamsForADR()
     if (current_power < 14)
     {
         current_power += 2;
-        pimpl->rfm->setTxPower(current_power, true);
+        pimpl->radio->setTxPower(current_power, true);
         DEBUG_PRINTLN("ADR: Increasing TX power to " << current_power << " dBm");
     }
 
@@ -2568,11 +3443,10 @@ void LoRaWAN::openRX1Window()
     DEBUG_PRINTLN("Opening RX1 window on frequency " << channelFrequencies[current_channel] << " MHz");
 
     // Configure radio for RX1: same frequency, adjust SF based on rx1DrOffset
-    pimpl->rfm->standbyMode();
-    pimpl->rfm->setFrequency(channelFrequencies[current_channel]);
+    pimpl->radio->standbyMode();
 
     // Calculate SF for RX1 based on the offset
-    int rx1_sf = current_sf;
+    int rx1_sf = pimpl->uplinkSf;
 
     // Apply the RX1 offset based on region
     int rx1_dr = 0;
@@ -2581,7 +3455,7 @@ void LoRaWAN::openRX1Window()
     case REGION_EU868:
         // For EU868, downlink DR = uplink_dr - rx1_dr_offset
         // (limited to the valid DR range)
-        rx1_dr = std::max(0, std::min(7, current_dr - rx1DrOffset));
+        rx1_dr = std::max(0, std::min(7, pimpl->uplinkDr - rx1DrOffset));
 
         // Convert DR to SF
         if (rx1_dr < 6)
@@ -2607,17 +3481,20 @@ void LoRaWAN::openRX1Window()
 
     default:
         // Generic implementation if no specific rule
-        rx1_sf = current_sf;
+        rx1_sf = pimpl->uplinkSf;
         break;
     }
 
     // Apply RX1 configuration
-    pimpl->rfm->setSpreadingFactor(rx1_sf);
-    pimpl->rfm->setBandwidth(current_bw);
-    pimpl->rfm->setCodingRate(current_cr);
-    pimpl->rfm->setPreambleLength(current_preamble);
-    pimpl->rfm->setInvertIQ(true); // Always invert IQ for downlink
-    pimpl->rfm->setContinuousReceive();
+    Radio::Profile rx1;
+    rx1.frequency = channelFrequencies[current_channel];
+    rx1.spreading_factor = rx1_sf;
+    rx1.bandwidth = pimpl->uplinkBw;
+    rx1.coding_rate = current_cr;
+    rx1.preamble_length = current_preamble;
+    rx1.invert_iq = true; // Always invert IQ for downlink
+    pimpl->radio->applyProfile(rx1);
+    pimpl->radio->setContinuousReceive();
 
     // Update state
     pimpl->rxState = RX_WINDOW_1;
@@ -2635,8 +3512,7 @@ void LoRaWAN::openRX2Window()
     DEBUG_PRINTLN("Opening RX2 window on frequency " << RX2_FREQ[lora_region] << " MHz");
 
     // Configure radio for RX2: frequency and SF determined by rx2DataRate if configured
-    pimpl->rfm->standbyMode();
-    pimpl->rfm->setFrequency(RX2_FREQ[lora_region]);
+    pimpl->radio->standbyMode();
 
     // Determine SF for RX2 based on rx2DataRate (if configured via RX_PARAM_SETUP_REQ)
     int rx2_sf = RX2_SF[lora_region];   // Default value for the region
@@ -2675,12 +3551,15 @@ void LoRaWAN::openRX2Window()
     }
 
     // Apply RX2 configuration
-    pimpl->rfm->setSpreadingFactor(rx2_sf);
-    pimpl->rfm->setBandwidth(rx2_bw);
-    pimpl->rfm->setCodingRate(RX2_CR[lora_region]);
-    pimpl->rfm->setPreambleLength(RX2_PREAMBLE[lora_region]);
-    pimpl->rfm->setInvertIQ(true); // Always invert IQ for downlink
-    pimpl->rfm->setContinuousReceive();
+    Radio::Profile rx2;
+    rx2.frequency = RX2_FREQ[lora_region];
+    rx2.spreading_factor = rx2_sf;
+    rx2.bandwidth = rx2_bw;
+    rx2.coding_rate = RX2_CR[lora_region];
+    rx2.preamble_length = RX2_PREAMBLE[lora_region];
+    rx2.invert_iq = true; // Always invert IQ for downlink
+    pimpl->radio->applyProfile(rx2);
+    pimpl->radio->setContinuousReceive();
 
     // Update state
     pimpl->rxState = RX_WINDOW_2;
@@ -2706,24 +3585,25 @@ void LoRaWAN::updateRxWindows() {
         case RX_WAIT_1:
             // Comprobar si es hora de abrir la ventana RX1
             if (elapsedSinceTx >= RECEIVE_DELAY1) {
+                pimpl->windowLateness.record(pimpl->txEndTime + std::chrono::milliseconds(RECEIVE_DELAY1), now);
                 DEBUG_PRINTLN("Opening RX1 window on frequency " << channelFrequencies[current_channel] << " MHz after " << elapsedSinceTx << " ms (should be " << RECEIVE_DELAY1 << " ms)");
 
                 // Configure radio for RX1: same frequency, adjust SF based on rx1DrOffset
-                pimpl->rfm->standbyMode();
-                pimpl->rfm->setFrequency(channelFrequencies[current_channel]);
+                pimpl->radio->standbyMode();
+                pimpl->radio->setFrequency(channelFrequencies[current_channel]);
                 
                 // Calculate SF for RX1 based on the offset
-                int rx1_sf = current_sf;
+                int rx1_sf = pimpl->uplinkSf;
                 if (rx1DrOffset > 0) {
                     rx1_sf = std::min(rx1_sf + rx1DrOffset, 12); // Adjust SF based on offset
                 }
                 
-                pimpl->rfm->setSpreadingFactor(rx1_sf);
-                pimpl->rfm->setBandwidth(current_bw);
-                pimpl->rfm->setCodingRate(current_cr);
-                pimpl->rfm->setPreambleLength(current_preamble);
-                pimpl->rfm->setInvertIQ(true);  // Always invert IQ for downlink
-                pimpl->rfm->setContinuousReceive();
+                pimpl->radio->setSpreadingFactor(rx1_sf);
+                pimpl->radio->setBandwidth(pimpl->uplinkBw);
+                pimpl->radio->setCodingRate(current_cr);
+                pimpl->radio->setPreambleLength(current_preamble);
+                pimpl->radio->setInvertIQ(true);  // Always invert IQ for downlink
+                pimpl->radio->setContinuousReceive();
                 
                 // Update state
                 pimpl->rxState = RX_WINDOW_1;
@@ -2747,6 +3627,7 @@ void LoRaWAN::updateRxWindows() {
                                  << std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count());
                 } else {
                     // If RX2 time has passed, open directly
+                    pimpl->windowLateness.record(pimpl->txEndTime + std::chrono::milliseconds(RECEIVE_DELAY2), now);
                     openRX2Window();
                 }
             }
@@ -2755,6 +3636,7 @@ void LoRaWAN::updateRxWindows() {
         case RX_WAIT_2:
             // Check if it's time to open the RX2 window
             if (elapsedSinceTx >= RECEIVE_DELAY2) {
+                pimpl->windowLateness.record(pimpl->txEndTime + std::chrono::milliseconds(RECEIVE_DELAY2), now);
                 DEBUG_PRINTLN("Opening RX2 window after " << elapsedSinceTx << " ms (should be " << RECEIVE_DELAY2 << " ms)");
                 openRX2Window();
             }
@@ -2765,6 +3647,27 @@ void LoRaWAN::updateRxWindows() {
             if (std::chrono::duration_cast<std::chrono::milliseconds>(
                 now - pimpl->rxWindowStart).count() >= WINDOW_DURATION) {
                 
+                // Without a downlink, a confirmed uplink was not acknowledged
+                if (pimpl->outcomeConfirmed) {
+                    recordDownlinkOutcome(false);
+                }
+                pimpl->outcomeChannel = -1;
+
+                // Schedule the next transmission of the frame, confirmed frames
+                // wait ACK_TIMEOUT (randomised 1-3 s) after RX2
+                if (pimpl->retxRemaining > 0) {
+                    int delay_ms = 0;
+                    if (pimpl->retxConfirmed) {
+                        delay_ms = ACK_TIMEOUT_MIN_MS + std::rand() % (ACK_TIMEOUT_MAX_MS - ACK_TIMEOUT_MIN_MS + 1);
+                    }
+                    pimpl->retxDue = now + std::chrono::milliseconds(delay_ms);
+                    DEBUG_PRINTLN("Next transmission of the frame in " << delay_ms << " ms");
+                } else if (pimpl->retxConfirmed && confirmState == ConfirmationState::WAITING_ACK) {
+                    DEBUG_PRINTLN("Maximum number of retries reached (" << static_cast<int>(MAX_RETRIES)
+                                  << "). Message not confirmed.");
+                    resetConfirmationState();
+                }
+
                 // RX2 window closed, revert to appropriate mode based on the class
                 if (currentClass == DeviceClass::CLASS_C) {
                     // For Class C, maintain continuous reception on RX2
@@ -2775,7 +3678,7 @@ void LoRaWAN::updateRxWindows() {
                     // No configuration changes, we are already in RX2
                 } else {
                     // For Class A, revert to standby until next TX
-                    pimpl->rfm->standbyMode();
+                    pimpl->radio->standbyMode();
                     pimpl->rxState = RX_IDLE;
                     DEBUG_PRINTLN("RX2 window closed, standby mode until next TX (Class A) Timestamp: "
                                  << std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count());
@@ -2792,53 +3695,653 @@ void LoRaWAN::updateRxWindows() {
     }
 }
 
-// MMethod to handle confirmations
-void LoRaWAN::handleConfirmation()
+// Retransmission engine, driven from update()
+void LoRaWAN::updateRetransmissions()
 {
-    // If we're not waiting for ACK, do nothing
-    if (confirmState != ConfirmationState::WAITING_ACK)
+    if (pimpl->retxRemaining <= 0)
+    {
+        return;
+    }
+
+    // Only between RX windows, the due time is set when RX2 closes
+    if (pimpl->rxState != RX_IDLE && pimpl->rxState != RX_CONTINUOUS)
+    {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now < pimpl->retxDue)
+    {
+        return;
+    }
+
+    // Wait for a channel whose duty cycle allows the frame instead of blocking
+    float airTime = calculateTimeOnAir(pimpl->retxFrame.size());
+    if (!anyChannelAvailable(airTime))
+    {
+        pimpl->retxDue = channelReleaseTime(airTime);
+        return;
+    }
+
+    pimpl->retxRemaining--;
+    if (pimpl->retxConfirmed)
+    {
+        confirmRetries++;
+        DEBUG_PRINTLN("No ACK received, retransmitting confirmed frame: " << confirmRetries << "/" << MAX_RETRIES);
+    }
+    else
+    {
+        DEBUG_PRINTLN("Repeating unconfirmed frame (NbTrans), " << pimpl->retxRemaining << " repetitions left");
+    }
+
+    if (transmitFrame(pimpl->retxFrame, false, true))
+    {
+        pimpl->retxDue = std::chrono::steady_clock::time_point::max();
+    }
+    else
+    {
+        DEBUG_PRINTLN("Error retransmitting frame");
+        pimpl->retxDue = now + std::chrono::milliseconds(RETX_BACKOFF_MS);
+        if (pimpl->retxRemaining == 0 && pimpl->retxConfirmed)
+        {
+            resetConfirmationState();
+        }
+    }
+}
+
+void LoRaWAN::setDownlinkDrain(bool enable)
+{
+    pimpl->downlinkDrain = enable;
+}
+
+// Class A only: Class C devices hear downlinks on RX2 at any time and send
+// their ACKs as soon as a confirmed downlink arrives
+void LoRaWAN::updateDownlinkDrain()
+{
+    bool ackNeeded = confirmState == ConfirmationState::ACK_PENDING;
+    if (!pimpl->downlinkDrain || currentClass != DeviceClass::CLASS_A || (!pimpl->framePending && !ackNeeded))
+    {
+        return;
+    }
+
+    // Pending retransmissions open RX windows and carry the ACK anyway
+    if (pimpl->rxState != RX_IDLE || pimpl->retxRemaining > 0 ||
+        confirmState == ConfirmationState::WAITING_ACK)
     {
         return;
     }
 
-    // Check if enough time has passed to retry
     auto now = std::chrono::steady_clock::now();
-    auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - lastConfirmAttempt).count();
+    if (now < pimpl->nextDrain)
+    {
+        return;
+    }
+
+    // Empty frame without FPort, plus whatever MAC answers fit in FOpts
+    size_t frameSize = FRAME_OVERHEAD - 1 + std::min(pendingMACResponses.size(), static_cast<size_t>(15));
+    float airTime = calculateTimeOnAir(frameSize);
+    if (!anyChannelAvailable(airTime))
+    {
+        pimpl->nextDrain = channelReleaseTime(airTime);
+        return;
+    }
 
-    // Retry every 5 seconds
-    if (elapsed >= 5 && confirmRetries < MAX_RETRIES)
+    DEBUG_PRINTLN("Draining downlinks: sending empty uplink ("
+                  << (pimpl->framePending ? "FPending" : "ACK") << ")");
+
+    // The next downlink sets FPending again if the network has more queued
+    bool framePending = pimpl->framePending;
+    pimpl->framePending = false;
+    if (!send(std::vector<uint8_t>(), 0, false))
     {
-        DEBUG_PRINTLN("No ACK received, retrying confirmed send: "
-                      << (confirmRetries + 1) << "/" << MAX_RETRIES);
+        DEBUG_PRINTLN("Error sending empty uplink");
+        pimpl->framePending = framePending;
+        pimpl->nextDrain = now + std::chrono::milliseconds(RETX_BACKOFF_MS);
+    }
+}
 
-        // Before resending, temporarily change the state to allow the new send
-        ConfirmationState oldState = confirmState;
-        confirmState = ConfirmationState::NONE;
+bool LoRaWAN::anyChannelAvailable(float air_time_ms) const
+{
+    if (one_channel_gateway)
+    {
+        return isChannelAvailable(std::max(getChannelFromFrequency(one_channel_freq), 0), air_time_ms);
+    }
 
-        // Save a local copy of pendingAck and ackPort
-        std::vector<uint8_t> localPendingAck = pendingAck;
-        uint8_t localAckPort = ackPort;
+    for (int i = 0; i < MAX_CHANNELS; i++)
+    {
+        if (isChannelEnabled(i) && isChannelAvailable(i, air_time_ms))
+        {
+            return true;
+        }
+    }
+    return false;
+}
 
-        // Resend the same message that is pending
-        bool result = send(localPendingAck, localAckPort, true);
+float LoRaWAN::dutyCycleWait(float air_time_ms) const
+{
+    // Same 1% rule as isChannelAvailable
+    auto now = std::chrono::steady_clock::now();
+    float offTime = (air_time_ms / 0.01f) - air_time_ms;
+    float wait = -1.0f;
+    for (int i = 0; i < MAX_CHANNELS; i++)
+    {
+        if (!isChannelEnabled(i))
+        {
+            continue;
+        }
+        if (one_channel_gateway && i != std::max(getChannelFromFrequency(one_channel_freq), 0))
+        {
+            continue;
+        }
 
-        if (!result)
+        float elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - lastChannelUse[i]).count();
+        float channelWait = std::max(0.0f, offTime - elapsed);
+        if (wait < 0.0f || channelWait < wait)
         {
-            DEBUG_PRINTLN("Error resending confirmed message");
-            // If the send failed, restore the previous state to try again later
-            confirmState = oldState;
+            wait = channelWait;
         }
-        // No need to restore the state if the send was successful,
-        // because send() already set the state correctly
     }
-    else if (confirmRetries >= MAX_RETRIES)
+    return std::max(wait, 0.0f);
+}
+
+std::chrono::steady_clock::time_point LoRaWAN::channelReleaseTime(float air_time_ms) const
+{
+    // Rounded up, waking a millisecond early would find the channel still busy
+    auto wait = std::chrono::milliseconds(static_cast<int64_t>(std::ceil(dutyCycleWait(air_time_ms))) + 1);
+    return std::chrono::steady_clock::now() + wait;
+}
+
+void LoRaWAN::setTxPolicy(TxPolicy policy)
+{
+    pimpl->txPolicy = policy;
+}
+
+void LoRaWAN::selectDataRate(size_t frame_size, const SendOptions& options)
+{
+    pimpl->frameDr = -1;
+    if (!pimpl->txPolicy || one_channel_gateway)
+    {
+        return;
+    }
+
+    TxPolicyInput input;
+    input.frame_size = frame_size;
+    input.deadline_ms = options.deadline_ms;
+    input.priority = options.priority;
+    input.target_delivery = options.target_delivery;
+    input.adr_dr = std::min<uint8_t>(current_dr, MAX_LORA_DR);
+    input.power = static_cast<int8_t>(pimpl->radio->getTxPower());
+    input.max_power = static_cast<int8_t>(MAX_POWER[lora_region]);
+    input.nb_trans = options.confirmed ? 1 : getNbTrans();
+
+    // ADR decides the fastest data rate the network allows, the device may
+    // still fall back to slower ones
+    input.max_dr = adrEnabled ? input.adr_dr : MAX_LORA_DR;
+    input.min_dr = 0;
+    while (input.min_dr < input.max_dr && frame_size > MAX_MAC_PAYLOAD[input.min_dr] + 5)
     {
-        DEBUG_PRINTLN("Maximum number of retries reached (" << MAX_RETRIES
-                                                            << "). Message not confirmed.");
+        input.min_dr++;
+    }
 
-        // Reset the confirmation state
-        resetConfirmationState();
+    // Uplink SNR from LinkCheckAns, otherwise the average downlink SNR
+    float snr = 0.0f;
+    if (pimpl->uplinkSnrValid)
+    {
+        snr = pimpl->uplinkSnr;
+        input.margin_known = true;
+    }
+    else if (!pimpl->snrHistory.empty())
+    {
+        snr = pimpl->getAverageSnr();
+        input.margin_known = true;
+    }
+
+    for (int dr = input.min_dr; dr <= input.max_dr; dr++)
+    {
+        int sf;
+        float bw;
+        dataRateToSF(dr, sf, bw);
+        input.airtime_ms[dr] = timeOnAir(frame_size, sf, bw);
+        input.wait_ms[dr] = dutyCycleWait(input.airtime_ms[dr]);
+        input.link_margin[dr] = snr - REQUIRED_SNR[std::min(std::max(sf, 7), 12) - 7];
+    }
+
+    TxPolicyDecision decision = pimpl->txPolicy(input);
+    pimpl->frameDr = std::min<int>(std::max<int>(decision.dr, input.min_dr), input.max_dr);
+    pimpl->framePower = std::min<int>(std::max<int>(decision.power, 2), MAX_POWER[lora_region]);
+
+    DEBUG_PRINTLN("TX policy: DR" << pimpl->frameDr << " (ADR DR" << static_cast<int>(input.adr_dr) << "), "
+                  << pimpl->framePower << " dBm, " << input.airtime_ms[pimpl->frameDr] << " ms on air");
+}
+
+LoRaWAN::TxPolicyDecision LoRaWAN::airtimeTxPolicy(const TxPolicyInput& input)
+{
+    TxPolicyDecision decision;
+    decision.dr = input.adr_dr;
+    decision.power = input.power;
+    if (!input.margin_known)
+    {
+        return decision;
     }
+
+    // Fastest first; the margin is a normal estimate, NbTrans copies are independent
+    float bestDelivery = -1.0f;
+    for (int dr = input.max_dr; dr >= input.min_dr; dr--)
+    {
+        if (input.deadline_ms > 0 && input.wait_ms[dr] + input.airtime_ms[dr] > input.deadline_ms)
+        {
+            continue;
+        }
+
+        float single = 0.5f * std::erfc(-input.link_margin[dr] / (LINK_FADE_SIGMA_DB * std::sqrt(2.0f)));
+        float delivery = 1.0f - std::pow(1.0f - single, static_cast<float>(input.nb_trans));
+        if (delivery >= input.target_delivery)
+        {
+            decision.dr = dr;
+            return decision;
+        }
+        if (delivery > bestDelivery)
+        {
+            bestDelivery = delivery;
+            decision.dr = dr;
+        }
+    }
+
+    // No data rate meets the deadline: the fastest one ends soonest
+    if (bestDelivery < 0.0f)
+    {
+        decision.dr = input.max_dr;
+    }
+
+    // Below target: urgent frames buy the missing margin with power
+    if (input.priority > 0)
+    {
+        decision.power = input.max_power;
+    }
+    return decision;
+}
+
+void LoRaWAN::dataRateToSF(uint8_t dataRate, int& sf, float& bw) const
+{
+    switch (lora_region) {
+        case REGION_EU868:
+            if (dataRate < 6) {
+                sf = 12 - dataRate;
+                bw = 125.0f;
+            }
+            else if (dataRate == 6) {
+                sf = 7;
+                bw = 250.0f;
+            }
+            else { // DR7
+                sf = 7;
+                bw = 125.0f;
+            }
+            break;
+
+        // Add other regions as necessary
+        default:
+            // Generic mapping for other regions
+            sf = dataRate <= 6 ? (12 - dataRate) : 7;
+            bw = dataRate == 6 ? 250.0f : 125.0f;
+    }
+}
+
+bool LoRaWAN::enableUplinkQueue(const std::string& filename, size_t capacity)
+{
+    if (!pimpl->uplinkQueue.open(filename, capacity))
+    {
+        return false;
+    }
+
+    DEBUG_PRINTLN("Uplink queue " << filename << ": " << pimpl->uplinkQueue.size() << "/"
+                  << pimpl->uplinkQueue.capacity() << " messages pending");
+    return true;
+}
+
+bool LoRaWAN::queueUplink(const std::vector<uint8_t>& data, uint8_t port, bool confirmed)
+{
+    if (!pimpl->uplinkQueue.push(data, port, confirmed))
+    {
+        LOG_ERROR("Uplink queue is full or disabled, message not stored");
+        return false;
+    }
+
+    DEBUG_PRINTLN("Uplink queued, " << pimpl->uplinkQueue.size() << " pending");
+    notifyEvent();
+    return true;
+}
+
+size_t LoRaWAN::getQueuedUplinks() const
+{
+    return pimpl->uplinkQueue.size();
+}
+
+void LoRaWAN::setBackfillInterval(int ms)
+{
+    pimpl->backfillInterval = std::chrono::milliseconds(std::max(ms, 0));
+}
+
+// Queued uplinks get a fresh FCnt when they are sent, one at a time and only
+// when no other uplink is in flight
+void LoRaWAN::drainUplinkQueue()
+{
+    if (pimpl->uplinkQueue.size() == 0)
+    {
+        return;
+    }
+
+    if (pimpl->rxState != RX_IDLE && pimpl->rxState != RX_CONTINUOUS)
+    {
+        return;
+    }
+
+    if (pimpl->retxRemaining > 0 || confirmState == ConfirmationState::WAITING_ACK)
+    {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now < pimpl->nextBackfill)
+    {
+        return;
+    }
+
+    UplinkQueue::Entry entry;
+    if (!pimpl->uplinkQueue.peek(entry))
+    {
+        return;
+    }
+
+    // Never wait for the duty cycle here, update() must not block
+    float airTime = calculateTimeOnAir(entry.payload.size() + FRAME_OVERHEAD);
+    if (!anyChannelAvailable(airTime))
+    {
+        pimpl->nextBackfill = channelReleaseTime(airTime);
+        return;
+    }
+
+    DEBUG_PRINTLN("Sending queued uplink #" << entry.sequence << ", " << pimpl->uplinkQueue.size() - 1 << " left");
+
+    pimpl->drainingQueue = true;
+    bool sent = send(entry.payload, entry.port, entry.confirmed);
+    pimpl->drainingQueue = false;
+
+    if (sent)
+    {
+        pimpl->uplinkQueue.pop();
+        pimpl->nextBackfill = now + pimpl->backfillInterval;
+
+        auto waiting = pimpl->queuedSendDone.find(entry.sequence);
+        if (waiting != pimpl->queuedSendDone.end())
+        {
+            auto done = std::move(waiting->second);
+            pimpl->queuedSendDone.erase(waiting);
+            awaitSendOutcome(entry.confirmed, std::move(done));
+        }
+    }
+    else
+    {
+        pimpl->nextBackfill = now + std::chrono::milliseconds(RETX_BACKOFF_MS);
+    }
+}
+
+// Neither the FRMPayload keystream nor B0 depend on the payload, only on the
+// keys, DevAddr, FCnt and (B0) the frame length. Computing them for the next
+// FCnt leaves send() with the XOR and the CMAC blocks of the frame itself.
+void LoRaWAN::precomputeUplink()
+{
+    // Largest FRMPayload and frame (MHDR + MACPayload) at the current data rate
+    size_t maxMacPayload = MAX_MAC_PAYLOAD[std::min<int>(current_dr, MAX_LORA_DR)];
+    size_t maxPayload = maxMacPayload - 8;
+    size_t maxFrame = 1 + maxMacPayload;
+
+    if (pimpl->precomputedValid() && pimpl->precomputedKeystream.size() >= maxPayload &&
+        pimpl->precomputedMic.size() > maxFrame)
+    {
+        return;
+    }
+
+    AESBatch::Key appKey, nwkKey;
+    AESBatch::expand(pimpl->appSKey, appKey);
+    AESBatch::expand(pimpl->nwkSKey, nwkKey);
+
+    // CMAC over B0 alone starts from a zero chaining value, so the state after
+    // B0 is AES(NwkSKey, B0). MHDR + FHDR is the shortest frame.
+    AESCMAC::State keyState;
+    AESCMAC::begin(keyState, pimpl->nwkSKey);
+    pimpl->precomputedMic.assign(maxFrame + 1, keyState);
+    size_t keystreamBlocks = (maxPayload + 15) / 16;
+    pimpl->precomputedKeystream.resize(keystreamBlocks * 16);
+
+    // Keystream blocks and every B0 are independent, encrypt them as one batch
+    std::vector<std::array<uint8_t, 16>> blocks;
+    std::vector<AESBatch::Block> batch;
+    blocks.reserve(keystreamBlocks + maxFrame);
+    for (size_t i = 0; i < keystreamBlocks; i++)
+    {
+        blocks.push_back(uplinkBlock(0x01, pimpl->devAddr, pimpl->uplinkCounter, static_cast<uint8_t>(i + 1)));
+        batch.push_back({&appKey, blocks.back().data(), pimpl->precomputedKeystream.data() + i * 16});
+    }
+    for (size_t length = 8; length <= maxFrame; length++)
+    {
+        blocks.push_back(uplinkBlock(0x49, pimpl->devAddr, pimpl->uplinkCounter, static_cast<uint8_t>(length)));
+        batch.push_back({&nwkKey, blocks.back().data(), pimpl->precomputedMic[length].x.data()});
+    }
+    AESBatch::encrypt(batch.data(), batch.size());
+    pimpl->precomputedKeystream.resize(maxPayload);
+
+    pimpl->precomputedFcnt = pimpl->uplinkCounter;
+    pimpl->precomputedDevAddr = pimpl->devAddr;
+    pimpl->precomputedAppSKey = pimpl->appSKey;
+    pimpl->precomputedNwkSKey = pimpl->nwkSKey;
+    pimpl->precomputed = true;
+
+    DEBUG_PRINTLN("Precomputed uplink crypto for FCnt " << pimpl->uplinkCounter << " (payload up to "
+                  << maxPayload << " bytes)");
+}
+
+// Mirrors the checks of update() and the helpers it calls
+std::chrono::steady_clock::time_point LoRaWAN::nextEventTime() const
+{
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point next = Clock::time_point::max();
+    auto now = Clock::now();
+    auto at = [&next](Clock::time_point time) { next = std::min(next, time); };
+
+    if (!pimpl->completions.empty())
+    {
+        at(now);
+    }
+    for (const auto &waiter : pimpl->receiveWaiters)
+    {
+        at(waiter.deadline);
+    }
+
+    switch (pimpl->joinPhase)
+    {
+    case Impl::JOIN_WAIT_RX1:
+        at(pimpl->joinTxEnd + std::chrono::milliseconds(JOIN_ACCEPT_DELAY1));
+        break;
+    case Impl::JOIN_WAIT_RX2:
+        at(pimpl->joinTxEnd + std::chrono::milliseconds(JOIN_ACCEPT_DELAY2));
+        break;
+    case Impl::JOIN_RX1:
+    case Impl::JOIN_RX2:
+        at(pimpl->joinWindowStart + std::chrono::milliseconds(WINDOW_DURATION));
+        if (!pimpl->irqWakeup)
+        {
+            at(now + std::chrono::milliseconds(RX_POLL_MS));
+        }
+        break;
+    default:
+        break;
+    }
+
+    if (!joined || pimpl->joinPhase != Impl::JOIN_IDLE)
+    {
+        return next;
+    }
+
+    switch (pimpl->rxState)
+    {
+    case RX_WAIT_1:
+        at(pimpl->txEndTime + std::chrono::milliseconds(RECEIVE_DELAY1));
+        break;
+    case RX_WAIT_2:
+        at(pimpl->txEndTime + std::chrono::milliseconds(RECEIVE_DELAY2));
+        break;
+    case RX_WINDOW_1:
+    case RX_WINDOW_2:
+        at(pimpl->rxWindowStart + std::chrono::milliseconds(WINDOW_DURATION));
+        break;
+    default:
+        break;
+    }
+
+    // Received frames are only seen by reading the IRQ flags
+    bool listening = pimpl->rxState == RX_WINDOW_1 || pimpl->rxState == RX_WINDOW_2 ||
+                     pimpl->rxState == RX_CONTINUOUS || currentClass == DeviceClass::CLASS_C;
+    if (listening && !pimpl->irqWakeup)
+    {
+        at(now + std::chrono::milliseconds(RX_POLL_MS));
+    }
+
+    bool betweenWindows = pimpl->rxState == RX_IDLE || pimpl->rxState == RX_CONTINUOUS;
+    bool inFlight = pimpl->retxRemaining > 0 || confirmState == ConfirmationState::WAITING_ACK;
+    if (betweenWindows && pimpl->retxRemaining > 0)
+    {
+        at(pimpl->retxDue);
+    }
+    if (betweenWindows && !inFlight && pimpl->uplinkQueue.size() > 0)
+    {
+        at(pimpl->nextBackfill);
+    }
+    if (pimpl->downlinkDrain && currentClass == DeviceClass::CLASS_A && pimpl->rxState == RX_IDLE && !inFlight &&
+        (pimpl->framePending || confirmState == ConfirmationState::ACK_PENDING))
+    {
+        at(pimpl->nextDrain);
+    }
+    if (betweenWindows && !pimpl->precomputedValid())
+    {
+        at(now);
+    }
+    if (pimpl->sessionMirror.isOpen())
+    {
+        at(pimpl->lastMirror + std::chrono::milliseconds(MIRROR_HEARTBEAT_MS));
+    }
+    if (pimpl->surveyEnabled && currentClass == DeviceClass::CLASS_A && pimpl->rxState == RX_IDLE)
+    {
+        at(pimpl->lastSurvey + pimpl->surveyInterval);
+    }
+
+    return next;
+}
+
+// A standby that takes over starts at the reserved limit, so the reservation
+// must reach it before any FCnt of the block is put on air
+void LoRaWAN::reserveFrameCounter()
+{
+    if (!pimpl->sessionMirror.isOpen() || pimpl->uplinkCounter < pimpl->reservedFcnt)
+    {
+        return;
+    }
+
+    pimpl->reservedFcnt = pimpl->uplinkCounter + MIRROR_FCNT_BLOCK;
+    publishSessionState(true);
+    DEBUG_PRINTLN("Reserved FCnt up to " << pimpl->reservedFcnt - 1 << " with the standbys");
+}
+
+void LoRaWAN::publishSessionState(bool force)
+{
+    if (!pimpl->sessionMirror.isOpen())
+    {
+        return;
+    }
+
+    SessionMirror::State state = getSessionState();
+    const SessionMirror::State& last = pimpl->mirroredState;
+    bool changed = !pimpl->mirroredStateValid ||
+                   std::tie(state.devAddr, state.nwkSKey, state.appSKey, state.uplinkCounter, state.downlinkCounter,
+                            state.reservedFcnt, state.lastDevNonce, state.dataRate, state.txPower, state.nbTrans,
+                            state.rx1DrOffset, state.rx2DataRate, state.joined) !=
+                   std::tie(last.devAddr, last.nwkSKey, last.appSKey, last.uplinkCounter, last.downlinkCounter,
+                            last.reservedFcnt, last.lastDevNonce, last.dataRate, last.txPower, last.nbTrans,
+                            last.rx1DrOffset, last.rx2DataRate, last.joined);
+
+    auto now = std::chrono::steady_clock::now();
+    if (!force && !changed && now - pimpl->lastMirror < std::chrono::milliseconds(MIRROR_HEARTBEAT_MS))
+    {
+        return;
+    }
+
+    // A forced publish carries an FCnt reservation: it must reach the
+    // standbys before send() puts the first FCnt of the block on air
+    pimpl->sessionMirror.publish(state, force);
+    pimpl->mirroredState = state;
+    pimpl->mirroredStateValid = true;
+    pimpl->lastMirror = now;
+}
+
+// Blocking waits keep the heartbeats going, so a standby only sees silence
+// from a process that is really stuck
+void LoRaWAN::sleepWithHeartbeat(std::chrono::milliseconds duration)
+{
+    auto heartbeat = std::chrono::milliseconds(MIRROR_HEARTBEAT_MS);
+    auto end = std::chrono::steady_clock::now() + duration;
+    while (true)
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (pimpl->sessionMirror.isOpen() && now - pimpl->lastMirror >= heartbeat)
+        {
+            publishSessionState(false);
+        }
+        auto left = end - now;
+        if (left <= std::chrono::steady_clock::duration::zero())
+        {
+            break;
+        }
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(left, heartbeat));
+    }
+}
+
+void LoRaWAN::captureDownlink(const std::vector<uint8_t>& frame, const Radio::PacketInfo* info)
+{
+    if (!pimpl->packetCapture.isOpen())
+    {
+        return;
+    }
+
+    // Read back from the radio, the receive paths set it up in different ways
+    Radio::Profile profile;
+    profile.frequency = pimpl->radio->getFrequency();
+    profile.spreading_factor = pimpl->radio->getSpreadingFactor();
+    profile.bandwidth = pimpl->radio->getBandwidth();
+    Radio::PacketInfo packet = info ? *info : pimpl->radio->getPacketInfo();
+    pimpl->packetCapture.record(frame, profile, &packet);
+}
+
+void LoRaWAN::setAdaptiveNbTrans(bool enable)
+{
+    pimpl->adaptiveNbTrans = enable;
+}
+
+uint8_t LoRaWAN::getNbTrans() const
+{
+    int nbTrans = std::max<int>(1, current_nbRep);
+
+    if (pimpl->adaptiveNbTrans && pimpl->lossRate > 0.0f)
+    {
+        // Repetitions needed to reach the target delivery probability at the observed loss
+        int needed = MAX_ADAPTIVE_NBTRANS;
+        if (pimpl->lossRate < 1.0f)
+        {
+            needed = static_cast<int>(std::ceil(std::log(1.0f - TARGET_DELIVERY) / std::log(pimpl->lossRate)));
+        }
+        nbTrans = std::max(nbTrans, std::min(needed, MAX_ADAPTIVE_NBTRANS));
+    }
+
+    return static_cast<uint8_t>(std::min(nbTrans, 15));
 }
 
 // Método para enviar un ACK
@@ -2871,14 +4374,46 @@ void LoRaWAN::sendAck()
     confirmState = oldState;
 }
 
+void LoRaWAN::awaitSendOutcome(bool confirmed, std::function<void(bool)> done)
+{
+    // A confirmed frame completes with its ACK, an unconfirmed one once sent
+    if (confirmed)
+    {
+        pimpl->sendDone = std::move(done);
+    }
+    else
+    {
+        deferCompletion([done] { done(true); });
+    }
+}
+
+void LoRaWAN::completeSend(bool delivered)
+{
+    if (!pimpl->sendDone)
+    {
+        return;
+    }
+
+    auto done = std::move(pimpl->sendDone);
+    pimpl->sendDone = nullptr;
+    deferCompletion([done, delivered] { done(delivered); });
+}
+
 // Método para resetear el estado de confirmación
 void LoRaWAN::resetConfirmationState()
 {
     DEBUG_PRINTLN("Resetting confirmation state");
+
+    // An acknowledged or abandoned confirmed frame is not retried any more
+    if (confirmState == ConfirmationState::WAITING_ACK && pimpl->retxConfirmed) {
+        pimpl->retxRemaining = 0;
+    }
+    if (confirmState == ConfirmationState::WAITING_ACK) {
+        completeSend(false);
+    }
+
     confirmState = ConfirmationState::NONE;
     confirmRetries = 0;
-    pendingAck.clear();
-    ackPort = 0;
     needsAck = false;
     // Do not reset lastFcntDown, it helps us track server responses
 }
@@ -2943,6 +4478,7 @@ void LoRaWAN::handleReceivedMessage(const std::vector<uint8_t> &payload, Message
     if (isAck && confirmState == ConfirmationState::WAITING_ACK)
     {
         DEBUG_PRINTLN("ACK received for pending confirmed message");
+        completeSend(true);
         resetConfirmationState();
     }
 
@@ -3007,11 +4543,15 @@ void LoRaWAN::handleReceivedMessage(const std::vector<uint8_t> &payload, Message
     uint8_t fctrl = payload[5];
     isAck = (fctrl & 0x20) != 0;  // Bit 5 = ACK
     
+    pimpl->framePending = (fctrl & 0x10) != 0;  // Bit 4 = FPending
+    
     DEBUG_PRINTLN("FCtrl: 0x" << std::hex << (int)fctrl << std::dec 
-                 << " (ACK=" << (isAck ? "Yes" : "No") << ")");
+                 << " (ACK=" << (isAck ? "Yes" : "No")
+                 << ", FPending=" << (pimpl->framePending ? "Yes" : "No") << ")");
 
     if (isAck && confirmState == ConfirmationState::WAITING_ACK) {
         DEBUG_PRINTLN("ACK received for pending confirmed message");
+        completeSend(true);
         resetConfirmationState();
     }
 }
@@ -3027,6 +4567,7 @@ bool LoRaWAN::processJoinAccept(const std::vector<uint8_t> &data)
     if (result)
     {
         joined = true;
+        notifyEvent();
         DEBUG_PRINTLN("Join Accept processed successfully");
     }
     else
@@ -3066,13 +4607,122 @@ void LoRaWAN::requestLinkCheck()
     }
 }
 
+void LoRaWAN::requestDeviceTime()
+{
+    if (!joined)
+    {
+        DEBUG_PRINTLN("Error: Cannot request DeviceTime without being joined to the network");
+        return;
+    }
+
+    if (isMACCommandPending(MAC_DEVICE_TIME_REQ))
+    {
+        return;
+    }
+
+    if (pendingMACResponses.size() < 15)
+    {
+        pendingMACResponses.push_back(MAC_DEVICE_TIME_REQ);
+        DEBUG_PRINTLN("DeviceTimeReq scheduled for next uplink");
+    }
+    else
+    {
+        DEBUG_PRINTLN("Error: No space in FOpts to add DeviceTimeReq");
+    }
+}
+
+bool LoRaWAN::isMACCommandPending(uint8_t cid) const
+{
+    size_t index = 0;
+    while (index < pendingMACResponses.size())
+    {
+        uint8_t pending = pendingMACResponses[index];
+        if (pending == cid)
+        {
+            return true;
+        }
+
+        // Payload length of the uplink commands this stack sends
+        size_t length;
+        switch (pending)
+        {
+        case MAC_LINK_CHECK_REQ:
+        case MAC_DUTY_CYCLE_ANS:
+        case MAC_RX_TIMING_SETUP_ANS:
+        case MAC_TX_PARAM_SETUP_ANS:
+        case MAC_DEVICE_TIME_REQ:
+            length = 0;
+            break;
+        case MAC_LINK_ADR_ANS:
+        case MAC_RX_PARAM_SETUP_ANS:
+        case MAC_NEW_CHANNEL_ANS:
+        case MAC_DL_CHANNEL_ANS:
+            length = 1;
+            break;
+        case MAC_DEV_STATUS_ANS:
+            length = 2;
+            break;
+        default:
+            // Unknown length, the rest cannot be parsed
+            return false;
+        }
+        index += 1 + length;
+    }
+    return false;
+}
+
+bool LoRaWAN::getNetworkTime(int64_t& gps_ms) const
+{
+    if (!pimpl->networkTimeValid)
+    {
+        return false;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - pimpl->networkTimeRef).count();
+    gps_ms = pimpl->networkTimeMs + elapsed;
+    return true;
+}
+
+LatencyStats::Summary LoRaWAN::getWindowLateness() const {
+    return pimpl->windowLateness.summary();
+}
+
+std::chrono::steady_clock::time_point LoRaWAN::nextUplinkSlot(int period_s, int jitter_ms) const
+{
+    auto now = std::chrono::steady_clock::now();
+    int64_t period = static_cast<int64_t>(std::max(period_s, 1)) * 1000;
+
+    // Network time if known, otherwise the local clock on the same (GPS) epoch
+    int64_t time_ms;
+    if (!getNetworkTime(time_ms))
+    {
+        time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::system_clock::now().time_since_epoch()).count() -
+                  (GPS_EPOCH_OFFSET_S - GPS_LEAP_SECONDS) * 1000;
+    }
+
+    // Fixed offset of this device within every period
+    int64_t offset = static_cast<int64_t>(fnv1a64(pimpl->devEUI.data(), pimpl->devEUI.size()) % period);
+    int64_t slot = (time_ms - offset) / period * period + offset;
+    if (slot <= time_ms)
+    {
+        slot += period;
+    }
+
+    int64_t jitter = jitter_ms > 0 ? std::rand() % (jitter_ms + 1) : 0;
+    DEBUG_PRINTLN("Next uplink slot in " << (slot - time_ms + jitter) << " ms (offset " << offset
+                                         << " ms in a " << period << " ms period)");
+    return now + std::chrono::milliseconds(slot - time_ms + jitter);
+}
+
 void LoRaWAN::updateDataRateFromSF()
 {
     // For EU868
     if (lora_region == REGION_EU868)
     {
-        int sf = pimpl->rfm->getSpreadingFactor();
-        float bw = pimpl->rfm->getBandwidth();
+        int sf = pimpl->radio->getSpreadingFactor();
+        float bw = pimpl->radio->getBandwidth();
 
         if (bw == 125.0f)
         {
@@ -0,0 +1,404 @@
+/**
+ * @file Logger.cpp
+ * @brief Implementation of the asynchronous logger
+ *
+ * Every thread that logs owns a single-producer/single-consumer ring of
+ * RING_SLOTS records. The producer fills the slot at head and publishes it by
+ * advancing head; the writer thread copies slots up to head and advances
+ * tail. A full ring drops the message and counts it. The writer wakes every
+ * WRITER_PERIOD_MS, merges the records of all rings in the order they were
+ * logged and writes them in one go.
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr size_t RING_SLOTS = 256;
+    constexpr size_t TEXT_SIZE = 1000;
+    constexpr int WRITER_PERIOD_MS = 10;
+    const char *const JOURNAL_SOCKET = "/run/systemd/journal/socket";
+    const char *const JOURNAL_IDENTIFIER = "LoRaWANCH341";
+
+    struct Record
+    {
+        uint64_t sequence;
+        int64_t time_ms;
+        uint32_t suppressed;
+        uint16_t length;
+        Logger::Level level;
+        char text[TEXT_SIZE];
+    };
+
+    int64_t wallClockMs()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    }
+
+    const char *levelName(Logger::Level level)
+    {
+        switch (level)
+        {
+        case Logger::Level::Debug:
+            return "DEBUG";
+        case Logger::Level::Info:
+            return "INFO";
+        case Logger::Level::Warning:
+            return "WARN";
+        default:
+            return "ERROR";
+        }
+    }
+
+    // syslog priorities
+    int journalPriority(Logger::Level level)
+    {
+        switch (level)
+        {
+        case Logger::Level::Debug:
+            return 7;
+        case Logger::Level::Info:
+            return 6;
+        case Logger::Level::Warning:
+            return 4;
+        default:
+            return 3;
+        }
+    }
+}
+
+struct Logger::Ring
+{
+    Record slots[RING_SLOTS];
+    std::atomic<size_t> head{0}; ///< Next slot the owner thread writes
+    std::atomic<size_t> tail{0}; ///< Next slot the writer thread reads
+    std::atomic<uint64_t> dropped{0};
+};
+
+Logger &Logger::instance()
+{
+    static Logger logger;
+    return logger;
+}
+
+Logger::~Logger()
+{
+    stop();
+}
+
+bool Logger::start(Sink destination, const std::string &path)
+{
+    stop();
+
+    sink = destination;
+    if (sink == Sink::File)
+    {
+        file = std::fopen(path.c_str(), "a");
+        if (!file)
+        {
+            std::cerr << "Cannot open log file " << path << std::endl;
+            return false;
+        }
+    }
+    else if (sink == Sink::Journald)
+    {
+#ifndef _WIN32
+        journal = socket(AF_UNIX, SOCK_DGRAM, 0);
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, JOURNAL_SOCKET, sizeof(addr.sun_path) - 1);
+        if (journal < 0 || connect(journal, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+        {
+            std::cerr << "Cannot connect to journald at " << JOURNAL_SOCKET << std::endl;
+            if (journal >= 0)
+                ::close(journal);
+            journal = -1;
+            return false;
+        }
+#else
+        std::cerr << "journald is not supported on this platform" << std::endl;
+        return false;
+#endif
+    }
+
+    stopping = false;
+    running = true;
+    writer = std::thread(&Logger::writerLoop, this);
+    return true;
+}
+
+void Logger::stop()
+{
+    if (!running)
+        return;
+
+    // New messages go out synchronously, the writer empties the rings
+    running = false;
+    stopping = true;
+    wake.notify_one();
+    if (writer.joinable())
+        writer.join();
+
+    if (file)
+        std::fclose(file);
+    file = nullptr;
+#ifndef _WIN32
+    if (journal >= 0)
+        ::close(journal);
+#endif
+    journal = -1;
+}
+
+void Logger::setRateLimit(uint32_t burst, std::chrono::milliseconds window)
+{
+    rateBurst = burst;
+    rateWindowMs = window.count();
+}
+
+bool Logger::admit(RateLimit &limit, uint32_t &suppressed)
+{
+    int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count();
+
+    // The thread that rolls the window over reports what the last one suppressed
+    int64_t start = limit.window_start.load(std::memory_order_relaxed);
+    if (now - start >= rateWindowMs.load(std::memory_order_relaxed) &&
+        limit.window_start.compare_exchange_strong(start, now, std::memory_order_relaxed))
+    {
+        limit.count.store(0, std::memory_order_relaxed);
+        suppressed = limit.suppressed.exchange(0, std::memory_order_relaxed);
+    }
+
+    if (limit.count.fetch_add(1, std::memory_order_relaxed) < rateBurst.load(std::memory_order_relaxed))
+        return true;
+
+    limit.suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void Logger::log(Level level, const std::string &message, uint32_t suppressed)
+{
+    if (!running)
+    {
+        // Synchronous until the writer is started
+        std::ostream &out = level >= Level::Warning ? std::cerr : std::cout;
+        out << message;
+        if (suppressed > 0)
+            out << " (" << suppressed << " similar messages suppressed)";
+        out << std::endl;
+        return;
+    }
+
+    Ring &ring = localRing();
+    size_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) >= RING_SLOTS)
+    {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Record &record = ring.slots[head % RING_SLOTS];
+    record.sequence = sequence.fetch_add(1, std::memory_order_relaxed);
+    record.time_ms = wallClockMs();
+    record.suppressed = suppressed;
+    record.level = level;
+    record.length = static_cast<uint16_t>(std::min(message.size(), TEXT_SIZE));
+    std::memcpy(record.text, message.data(), record.length);
+
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+void Logger::flushDebug()
+{
+    std::ostringstream &stream = debugStream();
+    std::string pending = stream.str();
+    size_t end = pending.rfind('\n');
+    if (end == std::string::npos)
+        return;
+
+    if (enabled(Level::Debug))
+    {
+        size_t start = 0;
+        while (start <= end)
+        {
+            size_t newline = pending.find('\n', start);
+            log(Level::Debug, pending.substr(start, newline - start));
+            start = newline + 1;
+        }
+    }
+
+    // Keep the unfinished line, the stream's format flags are left as they are
+    stream.str(pending.substr(end + 1));
+    stream.seekp(0, std::ios_base::end);
+}
+
+std::ostringstream &Logger::lineStream()
+{
+    thread_local std::ostringstream stream;
+    stream.str(std::string());
+    stream.clear();
+    return stream;
+}
+
+std::ostringstream &Logger::debugStream()
+{
+    thread_local std::ostringstream stream;
+    return stream;
+}
+
+bool Logger::parseLevel(const std::string &name, Level &level)
+{
+    if (name == "debug")
+        level = Level::Debug;
+    else if (name == "info")
+        level = Level::Info;
+    else if (name == "warning")
+        level = Level::Warning;
+    else if (name == "error")
+        level = Level::Error;
+    else
+        return false;
+    return true;
+}
+
+Logger::Ring &Logger::localRing()
+{
+    // Registered once per thread; the logger keeps the ring after the thread
+    // exits until the writer has emptied it
+    thread_local std::shared_ptr<Ring> ring;
+    if (!ring)
+    {
+        ring = std::make_shared<Ring>();
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        rings.push_back(ring);
+    }
+    return *ring;
+}
+
+void Logger::writerLoop()
+{
+    while (true)
+    {
+        bool last = stopping.load();
+        size_t written = drain();
+        if (last && written == 0)
+            break;
+
+        if (written == 0)
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wake.wait_for(lock, std::chrono::milliseconds(WRITER_PERIOD_MS), [this] { return stopping.load(); });
+        }
+    }
+}
+
+size_t Logger::drain()
+{
+    std::vector<std::shared_ptr<Ring>> active;
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        // Forget rings of threads that exited once they are empty
+        rings.erase(std::remove_if(rings.begin(), rings.end(),
+                                   [](const std::shared_ptr<Ring> &ring) {
+                                       return ring.use_count() == 1 &&
+                                              ring->tail.load() == ring->head.load();
+                                   }),
+                    rings.end());
+        active = rings;
+    }
+
+    std::vector<Record> batch;
+    uint64_t dropped = 0;
+    for (auto &ring : active)
+    {
+        size_t tail = ring->tail.load(std::memory_order_relaxed);
+        size_t head = ring->head.load(std::memory_order_acquire);
+        for (; tail != head; tail++)
+        {
+            const Record &record = ring->slots[tail % RING_SLOTS];
+            batch.emplace_back();
+            Record &copy = batch.back();
+            copy.sequence = record.sequence;
+            copy.time_ms = record.time_ms;
+            copy.suppressed = record.suppressed;
+            copy.level = record.level;
+            copy.length = record.length;
+            std::memcpy(copy.text, record.text, record.length);
+        }
+        ring->tail.store(tail, std::memory_order_release);
+        dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+    }
+
+    std::sort(batch.begin(), batch.end(),
+              [](const Record &a, const Record &b) { return a.sequence < b.sequence; });
+    for (const auto &record : batch)
+        write(record.level, record.time_ms, record.text, record.length, record.suppressed);
+
+    if (dropped > 0)
+    {
+        droppedTotal += dropped;
+        std::string message = std::to_string(dropped) + " log messages dropped (ring full)";
+        write(Level::Warning, wallClockMs(), message.data(), message.size(), 0);
+    }
+
+    if (file)
+        std::fflush(file);
+    else if (sink == Sink::Console)
+    {
+        std::fflush(stdout);
+        std::fflush(stderr);
+    }
+
+    return batch.size() + (dropped > 0 ? 1 : 0);
+}
+
+void Logger::write(Level level, int64_t time_ms, const char *text, size_t length, uint32_t suppressed)
+{
+    std::string message(text, length);
+    if (suppressed > 0)
+        message += " (" + std::to_string(suppressed) + " similar messages suppressed)";
+
+    if (sink == Sink::Journald)
+    {
+#ifndef _WIN32
+        // One line per entry, the native protocol needs no escaping then
+        std::replace(message.begin(), message.end(), '\n', ' ');
+        std::string entry = "PRIORITY=" + std::to_string(journalPriority(level)) +
+                            "\nSYSLOG_IDENTIFIER=" + JOURNAL_IDENTIFIER + "\nMESSAGE=" + message + "\n";
+        send(journal, entry.data(), entry.size(), MSG_NOSIGNAL);
+#endif
+        return;
+    }
+
+    // Wall-clock timestamp with milliseconds
+    char stamp[32];
+    std::time_t seconds = static_cast<std::time_t>(time_ms / 1000);
+    std::tm local;
+#ifndef _WIN32
+    localtime_r(&seconds, &local);
+#else
+    localtime_s(&local, &seconds);
+#endif
+    size_t n = std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+    std::snprintf(stamp + n, sizeof(stamp) - n, ".%03d", static_cast<int>(time_ms % 1000));
+
+    std::FILE *out = file ? file : (level >= Level::Warning ? stderr : stdout);
+    std::fprintf(out, "%s %-5s %s\n", stamp, levelName(level), message.c_str());
+}
@@ -0,0 +1,333 @@
+/**
+ * @file PacketCapture.cpp
+ * @brief Implementation of the pcap capture
+ *
+ * The ring is a bounded multi-producer queue: a producer claims a slot by
+ * advancing enqueuePos and publishes it through the slot's sequence number,
+ * the writer thread releases it the same way. A full ring drops the frame and
+ * counts it. The writer wakes every WRITER_PERIOD_MS, encodes the pending
+ * frames as pcap records and writes them in one go.
+ *
+ * Record layout: pcap record header, LoRaTap v0 header (15 bytes, big endian),
+ * PHYPayload.
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+#include "PacketCapture.hpp"
+#include "IOExecutor.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+namespace
+{
+    constexpr size_t RING_SLOTS = 1024;
+    constexpr size_t MAX_FRAME = 255;
+    constexpr int WRITER_PERIOD_MS = 100;
+
+    constexpr uint32_t PCAP_MAGIC = 0xa1b2c3d4; // Microsecond timestamps
+    constexpr uint32_t LINKTYPE_LORATAP = 270;
+    constexpr size_t PCAP_HEADER_SIZE = 24;
+    constexpr size_t RECORD_HEADER_SIZE = 16;
+    constexpr size_t LORATAP_HEADER_SIZE = 15;
+    constexpr uint8_t LORAWAN_SYNC_WORD = 0x34;
+
+    void put16(std::vector<uint8_t> &out, uint16_t value)
+    {
+        out.insert(out.end(), reinterpret_cast<const uint8_t *>(&value), reinterpret_cast<const uint8_t *>(&value) + 2);
+    }
+
+    void put32(std::vector<uint8_t> &out, uint32_t value)
+    {
+        out.insert(out.end(), reinterpret_cast<const uint8_t *>(&value), reinterpret_cast<const uint8_t *>(&value) + 4);
+    }
+
+    void putBigEndian32(std::vector<uint8_t> &out, uint32_t value)
+    {
+        out.push_back(static_cast<uint8_t>(value >> 24));
+        out.push_back(static_cast<uint8_t>(value >> 16));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    // LoRaTap RSSI: dBm + 139
+    uint8_t encodeRssi(float rssi)
+    {
+        return static_cast<uint8_t>(std::max(0.0f, std::min(255.0f, std::round(rssi + 139.0f))));
+    }
+
+    // LoRaTap SNR: signed, in quarters of a dB
+    uint8_t encodeSnr(float snr)
+    {
+        float quarters = std::max(-128.0f, std::min(127.0f, std::round(snr * 4.0f)));
+        return static_cast<uint8_t>(static_cast<int8_t>(quarters));
+    }
+}
+
+struct PacketCapture::Slot
+{
+    std::atomic<size_t> sequence{0};
+    int64_t time_us;
+    uint32_t frequency_hz;
+    uint8_t bandwidth;  ///< Multiples of 125 kHz
+    uint8_t spreading_factor;
+    uint8_t rssi;
+    uint8_t snr;
+    uint8_t length;
+    uint8_t payload[MAX_FRAME];
+};
+
+PacketCapture::PacketCapture() = default;
+
+PacketCapture::~PacketCapture()
+{
+    close();
+}
+
+bool PacketCapture::open(const std::string &path, size_t max_bytes, int max_files)
+{
+    close();
+
+    filePath = path;
+    maxBytes = std::max(max_bytes, PCAP_HEADER_SIZE + RECORD_HEADER_SIZE + LORATAP_HEADER_SIZE + MAX_FRAME);
+    maxFiles = std::max(max_files, 1);
+
+    // Keep the capture of a previous run
+    rotateFiles();
+    if (!openFile())
+        return false;
+
+    // Slots stay allocated after close(), a late record() may still touch them
+    if (!slots)
+        slots.reset(new Slot[RING_SLOTS]);
+    for (size_t i = 0; i < RING_SLOTS; i++)
+        slots[i].sequence.store(enqueuePos.load() + i, std::memory_order_relaxed);
+    dequeuePos = enqueuePos.load();
+
+    stopping = false;
+    running = true;
+    writer = std::thread(&PacketCapture::writerLoop, this);
+    return true;
+}
+
+void PacketCapture::close()
+{
+    if (!running)
+        return;
+
+    running = false;
+    stopping = true;
+    wake.notify_one();
+    if (writer.joinable())
+        writer.join();
+
+    closeFile();
+}
+
+bool PacketCapture::record(const std::vector<uint8_t> &frame, const Radio::Profile &profile, const Radio::PacketInfo *info)
+{
+    if (!running.load(std::memory_order_relaxed))
+        return false;
+
+    // Claim a slot
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true)
+    {
+        slot = &slots[pos % RING_SLOTS];
+        auto diff = static_cast<std::ptrdiff_t>(slot->sequence.load(std::memory_order_acquire) - pos);
+        if (diff == 0)
+        {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            // The writer has not released this slot yet
+            droppedPending.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else
+        {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::system_clock::now().time_since_epoch())
+                        .count();
+    // Channels are on a 100 Hz grid, drop the float error of the MHz value
+    slot->frequency_hz = static_cast<uint32_t>(std::lround(profile.frequency * 1e4) * 100);
+    slot->bandwidth = static_cast<uint8_t>(std::lround(profile.bandwidth / 125.0f));
+    slot->spreading_factor = static_cast<uint8_t>(profile.spreading_factor);
+    slot->rssi = info ? encodeRssi(info->rssi) : 0;
+    slot->snr = info ? encodeSnr(info->snr) : 0;
+    slot->length = static_cast<uint8_t>(std::min(frame.size(), MAX_FRAME));
+    std::memcpy(slot->payload, frame.data(), slot->length);
+
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+void PacketCapture::writerLoop()
+{
+    while (true)
+    {
+        bool last = stopping.load();
+        size_t written = drain();
+        if (last && written == 0)
+            break;
+
+        if (written == 0)
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wake.wait_for(lock, std::chrono::milliseconds(WRITER_PERIOD_MS), [this] { return stopping.load(); });
+        }
+    }
+}
+
+size_t PacketCapture::drain()
+{
+    size_t count = 0;
+    while (true)
+    {
+        Slot &slot = slots[dequeuePos % RING_SLOTS];
+        if (slot.sequence.load(std::memory_order_acquire) != dequeuePos + 1)
+            break;
+
+        size_t length = LORATAP_HEADER_SIZE + slot.length;
+        size_t size = RECORD_HEADER_SIZE + length;
+        if (fileBytes + buffer.size() + size > maxBytes)
+        {
+            writeBuffer();
+            rotateFiles();
+            openFile();
+        }
+
+        // pcap record header, host byte order like the file header
+        put32(buffer, static_cast<uint32_t>(slot.time_us / 1000000));
+        put32(buffer, static_cast<uint32_t>(slot.time_us % 1000000));
+        put32(buffer, static_cast<uint32_t>(length));
+        put32(buffer, static_cast<uint32_t>(length));
+
+        // LoRaTap v0: version, padding, header length, channel, RSSI, SNR, sync word
+        buffer.push_back(0);
+        buffer.push_back(0);
+        buffer.push_back(0);
+        buffer.push_back(static_cast<uint8_t>(LORATAP_HEADER_SIZE));
+        putBigEndian32(buffer, slot.frequency_hz);
+        buffer.push_back(slot.bandwidth);
+        buffer.push_back(slot.spreading_factor);
+        buffer.push_back(slot.rssi); // Packet RSSI
+        buffer.push_back(0);         // Max and current RSSI are not measured
+        buffer.push_back(0);
+        buffer.push_back(slot.snr);
+        buffer.push_back(LORAWAN_SYNC_WORD);
+        buffer.insert(buffer.end(), slot.payload, slot.payload + slot.length);
+
+        slot.sequence.store(dequeuePos + RING_SLOTS, std::memory_order_release);
+        dequeuePos++;
+        count++;
+    }
+
+    writeBuffer();
+
+    uint64_t dropped = droppedPending.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0)
+    {
+        droppedTotal += dropped;
+        LOG_WARNING(dropped << " frames not captured (ring full)");
+    }
+
+    return count;
+}
+
+void PacketCapture::writeBuffer()
+{
+    if (!buffer.empty() && file)
+    {
+        bool queued = false;
+#ifndef _WIN32
+        // Positioned write, the stdio stream position is not used
+        IOExecutor *io = executor.load(std::memory_order_acquire);
+        queued = io && io->write(fileno(file), fileBytes, buffer);
+#endif
+        if (!queued)
+        {
+            std::fseek(file, static_cast<long>(fileBytes), SEEK_SET);
+            if (std::fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size())
+                LOG_ERROR("Failed to write capture file " << filePath);
+            std::fflush(file);
+        }
+        fileBytes += buffer.size();
+    }
+    buffer.clear();
+}
+
+void PacketCapture::setExecutor(IOExecutor *io)
+{
+    IOExecutor *previous = executor.exchange(io);
+    if (previous)
+        previous->flush();
+}
+
+void PacketCapture::closeFile()
+{
+    // Writes still queued use the descriptor
+    if (IOExecutor *io = executor.load(std::memory_order_acquire))
+        io->flush();
+    if (file)
+        std::fclose(file);
+    file = nullptr;
+}
+
+bool PacketCapture::openFile()
+{
+    closeFile();
+
+    fileBytes = 0;
+    file = std::fopen(filePath.c_str(), "wb");
+    if (!file)
+    {
+        LOG_ERROR("Cannot open capture file " << filePath);
+        return false;
+    }
+
+    std::vector<uint8_t> header;
+    put32(header, PCAP_MAGIC);
+    put16(header, 2); // Version 2.4
+    put16(header, 4);
+    put32(header, 0); // Timestamps in UTC
+    put32(header, 0);
+    put32(header, 65535);
+    put32(header, LINKTYPE_LORATAP);
+    std::fwrite(header.data(), 1, header.size(), file);
+    std::fflush(file);
+    fileBytes = header.size();
+    return true;
+}
+
+void PacketCapture::rotateFiles()
+{
+    closeFile();
+
+    if (maxFiles == 1)
+    {
+        std::remove(filePath.c_str());
+        return;
+    }
+
+    // path.(n-2) -> path.(n-1), ..., path -> path.1; the oldest is overwritten
+    for (int i = maxFiles - 1; i >= 1; i--)
+    {
+        std::string from = i == 1 ? filePath : filePath + "." + std::to_string(i - 1);
+        std::string to = filePath + "." + std::to_string(i);
+        std::remove(to.c_str());
+        std::rename(from.c_str(), to.c_str());
+    }
+}
@@ -0,0 +1,570 @@
+/**
+ * @file PacketForwarder.cpp
+ * @brief Implementation of the Semtech UDP packet forwarder
+ *
+ * Upstream: radios are polled for RX_DONE, each frame gets a microsecond
+ * timestamp from a monotonic clock started in begin() and is queued. Frames are
+ * flushed as one PUSH_DATA when MAX_BATCH frames are pending or the batch window
+ * of the oldest one expires, so a burst on several channels costs one datagram.
+ *
+ * Downstream: PULL_RESP downlinks are kept in a queue ordered by timestamp. When
+ * the head is within TX_PREPARE_US the TX radio is switched to the downlink
+ * profile ahead of time, so only the payload upload remains on the critical path
+ * when the timestamp arrives.
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+#include "PacketForwarder.hpp"
+
+#include <algorithm>
+#include <cjson/cJSON.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <random>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const char BASE64_CHARS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    std::string base64Encode(const std::vector<uint8_t> &data)
+    {
+        std::string out;
+        out.reserve(((data.size() + 2) / 3) * 4);
+        for (size_t i = 0; i < data.size(); i += 3)
+        {
+            uint32_t chunk = data[i] << 16;
+            if (i + 1 < data.size())
+                chunk |= data[i + 1] << 8;
+            if (i + 2 < data.size())
+                chunk |= data[i + 2];
+
+            out += BASE64_CHARS[(chunk >> 18) & 0x3F];
+            out += BASE64_CHARS[(chunk >> 12) & 0x3F];
+            out += (i + 1 < data.size()) ? BASE64_CHARS[(chunk >> 6) & 0x3F] : '=';
+            out += (i + 2 < data.size()) ? BASE64_CHARS[chunk & 0x3F] : '=';
+        }
+        return out;
+    }
+
+    bool base64Decode(const std::string &in, std::vector<uint8_t> &out)
+    {
+        out.clear();
+        uint32_t chunk = 0;
+        int bits = 0;
+        for (char c : in)
+        {
+            if (c == '=')
+                break;
+            const char *pos = std::strchr(BASE64_CHARS, c);
+            if (pos == nullptr || c == '\0')
+                return false;
+            chunk = (chunk << 6) | static_cast<uint32_t>(pos - BASE64_CHARS);
+            bits += 6;
+            if (bits >= 8)
+            {
+                bits -= 8;
+                out.push_back(static_cast<uint8_t>((chunk >> bits) & 0xFF));
+            }
+        }
+        return true;
+    }
+
+    // Parse "SF7BW125" into spreading factor and bandwidth
+    bool parseDatarate(const char *datr, Radio::Profile &profile)
+    {
+        int sf = 0;
+        int bw = 0;
+        if (datr == nullptr || std::sscanf(datr, "SF%dBW%d", &sf, &bw) != 2)
+            return false;
+        if (sf < 6 || sf > 12)
+            return false;
+        profile.spreading_factor = sf;
+        profile.bandwidth = static_cast<float>(bw);
+        return true;
+    }
+
+    uint16_t randomToken()
+    {
+        static std::mt19937 generator(std::random_device{}());
+        return static_cast<uint16_t>(generator() & 0xFFFF);
+    }
+
+    double roundFrequency(float freq_mhz)
+    {
+        return std::round(static_cast<double>(freq_mhz) * 1e6) / 1e6;
+    }
+}
+
+PacketForwarder::PacketForwarder(const std::string &gateway_eui, const std::string &server,
+                                 uint16_t port_up, uint16_t port_down)
+    : server_host(server), server_port_up(port_up), server_port_down(port_down)
+{
+    eui.fill(0);
+    if (gateway_eui.length() != 16)
+    {
+        std::cerr << "Invalid gateway EUI length, expected 16 hex characters" << std::endl;
+        return;
+    }
+    for (size_t i = 0; i < eui.size(); i++)
+    {
+        eui[i] = static_cast<uint8_t>(std::stoul(gateway_eui.substr(i * 2, 2), nullptr, 16));
+    }
+}
+
+PacketForwarder::~PacketForwarder()
+{
+    end();
+}
+
+size_t PacketForwarder::addRadio(std::unique_ptr<Radio> radio, const Radio::Profile &profile)
+{
+    channels.push_back(Channel{std::move(radio), profile});
+    return channels.size() - 1;
+}
+
+uint32_t PacketForwarder::timestamp() const
+{
+    auto elapsed = std::chrono::steady_clock::now() - epoch;
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+}
+
+bool PacketForwarder::begin()
+{
+#ifdef _WIN32
+    std::cerr << "Gateway mode is not supported on Windows" << std::endl;
+    return false;
+#else
+    if (channels.empty())
+    {
+        std::cerr << "No radios configured for the packet forwarder" << std::endl;
+        return false;
+    }
+    if (tx_radio >= channels.size())
+    {
+        std::cerr << "Invalid TX radio index " << tx_radio << std::endl;
+        return false;
+    }
+
+    for (size_t i = 0; i < channels.size(); i++)
+    {
+        if (!channels[i].radio->begin())
+        {
+            std::cerr << "Failed to initialize radio " << i << std::endl;
+            return false;
+        }
+        // Public LoRaWAN network
+        channels[i].radio->setSyncWord(0x34);
+    }
+
+    struct addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    auto open_socket = [&](uint16_t port) -> int {
+        struct addrinfo *result = nullptr;
+        std::string service = std::to_string(port);
+        if (getaddrinfo(server_host.c_str(), service.c_str(), &hints, &result) != 0 || result == nullptr)
+        {
+            std::cerr << "Failed to resolve " << server_host << std::endl;
+            return -1;
+        }
+
+        int fd = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+        if (fd >= 0 && connect(fd, result->ai_addr, result->ai_addrlen) != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(result);
+
+        if (fd < 0)
+        {
+            std::cerr << "Failed to open UDP socket to " << server_host << ":" << port << std::endl;
+            return -1;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        return fd;
+    };
+
+    sock_up = open_socket(server_port_up);
+    sock_down = open_socket(server_port_down);
+    if (sock_up < 0 || sock_down < 0)
+    {
+        end();
+        return false;
+    }
+
+    epoch = std::chrono::steady_clock::now();
+    last_stat = epoch;
+    for (auto &channel : channels)
+    {
+        startReceive(channel);
+    }
+
+    sendPullData();
+    std::cout << "Packet forwarder started with " << channels.size() << " radio(s), server "
+              << server_host << ":" << server_port_up << "/" << server_port_down << std::endl;
+    return true;
+#endif
+}
+
+void PacketForwarder::end()
+{
+#ifndef _WIN32
+    if (sock_up >= 0)
+    {
+        close(sock_up);
+        sock_up = -1;
+    }
+    if (sock_down >= 0)
+    {
+        close(sock_down);
+        sock_down = -1;
+    }
+#endif
+    for (auto &channel : channels)
+    {
+        channel.radio->sleepMode();
+    }
+    tx_queue.clear();
+    pending_rx.clear();
+}
+
+void PacketForwarder::update()
+{
+    if (sock_up < 0 || sock_down < 0)
+        return;
+
+    pollRadios();
+    receiveDownstream();
+    processTxQueue();
+    flushUplinks(false);
+
+    if (std::chrono::steady_clock::now() - last_pull >= keepalive_interval)
+    {
+        sendPullData();
+    }
+}
+
+void PacketForwarder::startReceive(Channel &channel)
+{
+    channel.radio->standbyMode();
+    channel.radio->applyProfile(channel.profile);
+    channel.radio->clearIrqStatus();
+    channel.radio->setContinuousReceive();
+}
+
+void PacketForwarder::pollRadios()
+{
+    for (size_t i = 0; i < channels.size(); i++)
+    {
+        Radio &radio = *channels[i].radio;
+        uint16_t irq = radio.getIrqStatus();
+        if (!(irq & Radio::IRQ_RX_DONE))
+            continue;
+
+        // Timestamp as close to the IRQ as possible, the rest of the reads
+        // do not matter for downlink timing
+        RxPacket packet;
+        packet.tmst = timestamp();
+        packet.time = std::chrono::system_clock::now();
+        packet.channel = i;
+        packet.crc_ok = !(irq & Radio::IRQ_CRC_ERROR);
+        packet.info = radio.getPacketInfo();
+        packet.data = radio.readPayload();
+        radio.clearIrqStatus();
+
+        stats.rxnb++;
+        if (packet.crc_ok)
+            stats.rxok++;
+
+        if (packet.data.empty())
+            continue;
+
+        if (pending_rx.empty())
+            first_pending = std::chrono::steady_clock::now();
+        pending_rx.push_back(std::move(packet));
+    }
+}
+
+void PacketForwarder::flushUplinks(bool force_stat)
+{
+    auto now = std::chrono::steady_clock::now();
+    bool send_rx = !pending_rx.empty() &&
+                   (pending_rx.size() >= MAX_BATCH || now - first_pending >= batch_window);
+    bool send_stat = force_stat || now - last_stat >= stat_interval;
+    if (!send_rx && !send_stat)
+        return;
+
+    cJSON *root = cJSON_CreateObject();
+
+    if (send_rx)
+    {
+        cJSON *rxpk = cJSON_AddArrayToObject(root, "rxpk");
+        for (const auto &packet : pending_rx)
+        {
+            const Radio::Profile &profile = channels[packet.channel].profile;
+            cJSON *item = cJSON_CreateObject();
+
+            std::time_t seconds = std::chrono::system_clock::to_time_t(packet.time);
+            auto micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                              packet.time.time_since_epoch()).count() % 1000000;
+            char time_str[40];
+            std::strftime(time_str, sizeof(time_str), "%Y-%m-%dT%H:%M:%S", std::gmtime(&seconds));
+            char iso_str[64];
+            std::snprintf(iso_str, sizeof(iso_str), "%s.%06ldZ", time_str, static_cast<long>(micros));
+
+            char datr[16];
+            std::snprintf(datr, sizeof(datr), "SF%dBW%d", profile.spreading_factor,
+                          static_cast<int>(profile.bandwidth));
+            char codr[8];
+            std::snprintf(codr, sizeof(codr), "4/%d", profile.coding_rate);
+
+            cJSON_AddNumberToObject(item, "tmst", packet.tmst);
+            cJSON_AddStringToObject(item, "time", iso_str);
+            cJSON_AddNumberToObject(item, "chan", static_cast<double>(packet.channel));
+            cJSON_AddNumberToObject(item, "rfch", static_cast<double>(packet.channel));
+            cJSON_AddNumberToObject(item, "freq", roundFrequency(profile.frequency));
+            cJSON_AddNumberToObject(item, "stat", packet.crc_ok ? 1 : -1);
+            cJSON_AddStringToObject(item, "modu", "LORA");
+            cJSON_AddStringToObject(item, "datr", datr);
+            cJSON_AddStringToObject(item, "codr", codr);
+            cJSON_AddNumberToObject(item, "rssi", std::round(packet.info.rssi));
+            cJSON_AddNumberToObject(item, "lsnr", std::round(packet.info.snr * 10.0f) / 10.0);
+            cJSON_AddNumberToObject(item, "size", static_cast<double>(packet.data.size()));
+            cJSON_AddStringToObject(item, "data", base64Encode(packet.data).c_str());
+            cJSON_AddItemToArray(rxpk, item);
+        }
+        stats.rxfw += static_cast<uint32_t>(pending_rx.size());
+        pending_rx.clear();
+    }
+
+    if (send_stat)
+    {
+        std::time_t seconds = std::time(nullptr);
+        char time_str[32];
+        std::strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S GMT", std::gmtime(&seconds));
+
+        cJSON *stat = cJSON_AddObjectToObject(root, "stat");
+        cJSON_AddStringToObject(stat, "time", time_str);
+        cJSON_AddNumberToObject(stat, "rxnb", stats.rxnb);
+        cJSON_AddNumberToObject(stat, "rxok", stats.rxok);
+        cJSON_AddNumberToObject(stat, "rxfw", stats.rxfw);
+        cJSON_AddNumberToObject(stat, "ackr",
+                                stats.pushes ? 100.0 * stats.acks / stats.pushes : 0.0);
+        cJSON_AddNumberToObject(stat, "dwnb", stats.dwnb);
+        cJSON_AddNumberToObject(stat, "txnb", stats.txnb);
+        last_stat = now;
+    }
+
+    char *json = cJSON_PrintUnformatted(root);
+    if (json != nullptr)
+    {
+        if (sendDatagram(sock_up, PUSH_DATA, randomToken(), json))
+            stats.pushes++;
+        cJSON_free(json);
+    }
+    cJSON_Delete(root);
+}
+
+bool PacketForwarder::sendDatagram(int fd, uint8_t identifier, uint16_t token, const std::string &json)
+{
+#ifdef _WIN32
+    return false;
+#else
+    std::vector<uint8_t> datagram;
+    datagram.reserve(12 + json.size());
+    datagram.push_back(PROTOCOL_VERSION);
+    datagram.push_back(static_cast<uint8_t>(token >> 8));
+    datagram.push_back(static_cast<uint8_t>(token & 0xFF));
+    datagram.push_back(identifier);
+    datagram.insert(datagram.end(), eui.begin(), eui.end());
+    datagram.insert(datagram.end(), json.begin(), json.end());
+
+    ssize_t sent = ::send(fd, datagram.data(), datagram.size(), 0);
+    if (sent != static_cast<ssize_t>(datagram.size()))
+    {
+        std::cerr << "Failed to send datagram 0x" << std::hex << static_cast<int>(identifier)
+                  << std::dec << " to server" << std::endl;
+        return false;
+    }
+    return true;
+#endif
+}
+
+void PacketForwarder::sendPullData()
+{
+    sendDatagram(sock_down, PULL_DATA, randomToken(), std::string());
+    last_pull = std::chrono::steady_clock::now();
+}
+
+void PacketForwarder::sendTxAck(uint16_t token, const char *error)
+{
+    std::string json = std::string("{\"txpk_ack\":{\"error\":\"") + error + "\"}}";
+    sendDatagram(sock_down, TX_ACK, token, json);
+}
+
+void PacketForwarder::receiveDownstream()
+{
+#ifndef _WIN32
+    uint8_t buffer[2048];
+    for (int fd : {sock_up, sock_down})
+    {
+        while (true)
+        {
+            ssize_t length = recv(fd, buffer, sizeof(buffer) - 1, 0);
+            if (length < 0)
+                break;
+            if (length < 4 || buffer[0] != PROTOCOL_VERSION)
+                continue;
+
+            switch (buffer[3])
+            {
+            case PUSH_ACK:
+                stats.acks++;
+                break;
+            case PULL_ACK:
+                break;
+            case PULL_RESP:
+                handlePullResp(buffer, static_cast<size_t>(length));
+                break;
+            default:
+                break;
+            }
+        }
+    }
+#endif
+}
+
+void PacketForwarder::handlePullResp(const uint8_t *data, size_t length)
+{
+    uint16_t token = static_cast<uint16_t>((data[1] << 8) | data[2]);
+    std::string json(reinterpret_cast<const char *>(data + 4), length - 4);
+    stats.dwnb++;
+
+    cJSON *root = cJSON_Parse(json.c_str());
+    cJSON *txpk = root ? cJSON_GetObjectItem(root, "txpk") : nullptr;
+    if (txpk == nullptr)
+    {
+        std::cerr << "Invalid PULL_RESP payload" << std::endl;
+        cJSON_Delete(root);
+        return;
+    }
+
+    TxPacket packet;
+    packet.profile = channels[tx_radio].profile;
+    packet.immediate = cJSON_IsTrue(cJSON_GetObjectItem(txpk, "imme"));
+    packet.tmst = 0;
+    packet.power = 14;
+
+    cJSON *item = cJSON_GetObjectItem(txpk, "tmst");
+    if (cJSON_IsNumber(item))
+        packet.tmst = static_cast<uint32_t>(item->valuedouble);
+    item = cJSON_GetObjectItem(txpk, "freq");
+    if (cJSON_IsNumber(item))
+        packet.profile.frequency = static_cast<float>(item->valuedouble);
+    item = cJSON_GetObjectItem(txpk, "powe");
+    if (cJSON_IsNumber(item))
+        packet.power = item->valueint;
+    item = cJSON_GetObjectItem(txpk, "codr");
+    int cr = 0;
+    if (cJSON_IsString(item) && std::sscanf(item->valuestring, "4/%d", &cr) == 1)
+        packet.profile.coding_rate = cr;
+    item = cJSON_GetObjectItem(txpk, "prea");
+    if (cJSON_IsNumber(item))
+        packet.profile.preamble_length = item->valueint;
+    packet.profile.invert_iq = cJSON_IsTrue(cJSON_GetObjectItem(txpk, "ipol"));
+
+    item = cJSON_GetObjectItem(txpk, "datr");
+    bool valid = cJSON_IsString(item) && parseDatarate(item->valuestring, packet.profile);
+    item = cJSON_GetObjectItem(txpk, "data");
+    valid = valid && cJSON_IsString(item) && base64Decode(item->valuestring, packet.data) &&
+            !packet.data.empty() && packet.data.size() <= 255;
+    cJSON_Delete(root);
+
+    if (!valid)
+    {
+        std::cerr << "Unsupported downlink in PULL_RESP" << std::endl;
+        return;
+    }
+
+    if (!packet.immediate)
+    {
+        int32_t ahead = static_cast<int32_t>(packet.tmst - timestamp());
+        if (ahead < TX_LEAD_US)
+        {
+            sendTxAck(token, "TOO_LATE");
+            return;
+        }
+        if (ahead > TX_MAX_AHEAD_US)
+        {
+            sendTxAck(token, "TOO_EARLY");
+            return;
+        }
+    }
+
+    // Keep the queue ordered by timestamp, immediate packets go first
+    uint32_t now = timestamp();
+    auto position = std::find_if(tx_queue.begin(), tx_queue.end(), [&](const TxPacket &queued) {
+        if (packet.immediate)
+            return !queued.immediate;
+        return !queued.immediate &&
+               static_cast<int32_t>(queued.tmst - now) > static_cast<int32_t>(packet.tmst - now);
+    });
+    tx_queue.insert(position, std::move(packet));
+    sendTxAck(token, "NONE");
+}
+
+void PacketForwarder::processTxQueue()
+{
+    if (tx_queue.empty())
+        return;
+
+    TxPacket &head = tx_queue.front();
+    if (!head.immediate && static_cast<int32_t>(head.tmst - timestamp()) > TX_PREPARE_US)
+        return;
+
+    TxPacket packet = std::move(head);
+    tx_queue.pop_front();
+
+    Channel &channel = channels[tx_radio];
+    Radio &radio = *channel.radio;
+
+    radio.standbyMode();
+    radio.applyProfile(packet.profile);
+    radio.setTxPower(packet.power);
+
+    if (!packet.immediate)
+    {
+        int32_t wait_us = static_cast<int32_t>(packet.tmst - timestamp()) - TX_LEAD_US;
+        if (wait_us < -TX_LEAD_US)
+        {
+            std::cerr << "Downlink missed its slot by " << -wait_us << " us, dropped" << std::endl;
+            startReceive(channel);
+            return;
+        }
+        if (wait_us > 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(wait_us));
+    }
+
+    if (radio.send(packet.data, packet.profile.invert_iq))
+        stats.txnb++;
+    else
+        std::cerr << "Downlink transmission failed" << std::endl;
+
+    startReceive(channel);
+}
@@ -19,32 +19,31 @@
 
 #include "RFM95.hpp"
 #include "SPIInterface.hpp"
+#include "Logger.hpp"
 #include <iostream>
 #include <iomanip>
 #include <chrono>
 #include <thread>
 #include <algorithm>
+#include <array>
 
-RFM95::RFM95(std::unique_ptr<SPIInterface> spi_interface)
-    : spi(std::move(spi_interface))
-{
-    // ...initialization code...
-}
-
-RFM95::RFM95(int device_index)
-    : spi(SPIFactory::createCH341SPI(device_index))
+template <typename Bus>
+RFM95T<Bus>::RFM95T(Bus spi_bus)
+    : bus(std::move(spi_bus))
 {
     // ...initialization code...
 }
 
-RFM95::~RFM95()
+template <typename Bus>
+RFM95T<Bus>::~RFM95T()
 {
     end();
 }
 
-bool RFM95::begin()
+template <typename Bus>
+bool RFM95T<Bus>::begin()
 {
-    if (!spi->open())
+    if (!bus.open())
     {
         return false;
     }
@@ -69,13 +68,24 @@ bool RFM95::begin()
     writeRegister(REG_FIFO_TX_BASE_ADDR, 0);
     writeRegister(REG_FIFO_RX_BASE_ADDR, 0);
 
-    // Set modem config
-    writeRegister(REG_MODEM_CONFIG_1, 0x72);
-    writeRegister(REG_MODEM_CONFIG_2, 0x70);
+    // Set modem config: 125 kHz, 4/5, explicit header, SF7, CRC off, AGC on
+    static constexpr auto modem_config = SX127x::merge(
+        SX127x::ModemBandwidth::write(7),
+        SX127x::ModemCodingRate::write(1),
+        SX127x::ModemImplicitHeader::write(0),
+        SX127x::ModemSpreadingFactor::write(7),
+        SX127x::ModemTxContinuous::write(0),
+        SX127x::ModemRxPayloadCrcOn::write(0),
+        SX127x::ModemSymbTimeoutMsb::write(0));
+    applySequence(modem_config);
     writeRegister(REG_MODEM_CONFIG_3, 0x04);
 
-    // Set transmit power
-    writeRegister(REG_PA_CONFIG, 0x8F);
+    // Set transmit power: PA_BOOST, +17 dBm
+    static constexpr auto pa_config = SX127x::merge(
+        SX127x::PaSelect::write(1),
+        SX127x::PaMaxPower::write(0),
+        SX127x::PaOutputPower::write(15));
+    applySequence(pa_config);
     writeRegister(REG_PA_DAC, 0x87);
 
     // Set LNA
@@ -91,30 +101,70 @@ bool RFM95::begin()
     return true;
 }
 
-void RFM95::end()
+template <typename Bus>
+void RFM95T<Bus>::end()
+{
+    bus.close();
+}
+
+template <typename Bus>
+void RFM95T<Bus>::applyProfile(const Profile &profile)
 {
-    spi->close();
+    setFrequency(profile.frequency);
+
+    const int sf = std::max(6, std::min(profile.spreading_factor, 12));
+    const int cr = std::max(5, std::min(profile.coding_rate, 8));
+
+    if (sf == 6)
+    {
+        writeRegister(REG_DETECTION_OPTIMIZE, 0xC5);
+        writeRegister(REG_DETECTION_THRESHOLD, 0x0C);
+    }
+    else
+    {
+        writeRegister(REG_DETECTION_OPTIMIZE, 0xC3);
+        writeRegister(REG_DETECTION_THRESHOLD, 0x0A);
+    }
+
+    // Low data rate optimization is mandatory for symbols of 16 ms and longer
+    const bool ldro = (1 << sf) / profile.bandwidth >= 16.0f;
+
+    applySequence(SX127x::merge(SX127x::ModemBandwidth::write(bandwidthCode(profile.bandwidth)),
+                                SX127x::ModemCodingRate::write(cr - 4),
+                                SX127x::ModemSpreadingFactor::write(sf),
+                                SX127x::ModemLowDataRateOptimize::write(ldro ? 1 : 0)));
+
+    setPreambleLength(profile.preamble_length);
+    setInvertIQ(profile.invert_iq);
 }
 
-void RFM95::setFrequency(float freq_mhz)
+template <typename Bus>
+void RFM95T<Bus>::setFrequency(float freq_mhz)
 {
-    uint32_t frf = static_cast<uint32_t>((freq_mhz * 524288.0) / 32.0);
+    uint32_t frf = frequencyToFrf(freq_mhz);
 
-    // Write the three bytes
-    writeRegister(REG_FRF_MSB, (frf >> 16) & 0xFF);
-    writeRegister(REG_FRF_MID, (frf >> 8) & 0xFF);
-    writeRegister(REG_FRF_LSB, frf & 0xFF);
+    // The FRF registers are consecutive, write the three bytes in one burst
+    const uint8_t values[3] = {static_cast<uint8_t>((frf >> 16) & 0xFF),
+                               static_cast<uint8_t>((frf >> 8) & 0xFF),
+                               static_cast<uint8_t>(frf & 0xFF)};
+    writeRegisters(REG_FRF_MSB, values, sizeof(values));
 }
 
-float RFM95::getFrequency()
+template <typename Bus>
+uint32_t RFM95T<Bus>::frequencyToFrf(float freq_mhz)
+{
+    return static_cast<uint32_t>((freq_mhz * 524288.0) / 32.0);
+}
+
+template <typename Bus>
+float RFM95T<Bus>::getFrequency()
 {
     // Read the three bytes from the registers
-    uint32_t msb = static_cast<uint32_t>(readRegister(REG_FRF_MSB));
-    uint32_t mid = static_cast<uint32_t>(readRegister(REG_FRF_MID));
-    uint32_t lsb = static_cast<uint32_t>(readRegister(REG_FRF_LSB));
+    uint8_t values[3] = {0, 0, 0};
+    readRegisters(REG_FRF_MSB, values, sizeof(values));
 
     // Combine the bytes to form the FRF value
-    uint32_t frf = (msb << 16) | (mid << 8) | lsb;
+    uint32_t frf = (static_cast<uint32_t>(values[0]) << 16) | (static_cast<uint32_t>(values[1]) << 8) | values[2];
 
     // Calculate the frequency using the formula from the datasheet
     float freq_mhz = (frf * 32.0) / 524288.0;
@@ -122,31 +172,38 @@ float RFM95::getFrequency()
     return freq_mhz;
 }
 
-void RFM95::setTxPower(int level, bool use_pa_boost)
+template <typename Bus>
+void RFM95T<Bus>::setTxPower(int level, bool use_pa_boost)
 {
     if (use_pa_boost)
     {
         level = std::max(2, std::min(level, 20));
-        writeRegister(REG_PA_CONFIG, PA_BOOST | (level - 2));
+        applySequence(SX127x::merge(SX127x::PaSelect::write(1),
+                                    SX127x::PaMaxPower::write(0),
+                                    SX127x::PaOutputPower::write(level - 2)));
     }
     else
     {
         level = std::max(0, std::min(level, 15));
-        writeRegister(REG_PA_CONFIG, level);
+        applySequence(SX127x::merge(SX127x::PaSelect::write(0),
+                                    SX127x::PaMaxPower::write(0),
+                                    SX127x::PaOutputPower::write(level)));
     }
 }
 
-int RFM95::getTxPower()
+template <typename Bus>
+int RFM95T<Bus>::getTxPower()
 {
     uint8_t pa = readRegister(REG_PA_CONFIG);
-    if (pa & PA_BOOST)
+    if (SX127x::PaSelect::decode(pa))
     {
-        return (pa & 0x0F) + 2;
+        return SX127x::PaOutputPower::decode(pa) + 2;
     }
-    return pa & 0x0F;
+    return SX127x::PaOutputPower::decode(pa);
 }
 
-void RFM95::setSpreadingFactor(int sf)
+template <typename Bus>
+void RFM95T<Bus>::setSpreadingFactor(int sf)
 {
     sf = std::max(6, std::min(sf, 12));
 
@@ -161,75 +218,75 @@ void RFM95::setSpreadingFactor(int sf)
         writeRegister(REG_DETECTION_THRESHOLD, 0x0A);
     }
 
-    uint8_t reg2 = readRegister(REG_MODEM_CONFIG_2);
-    reg2 = (reg2 & 0x0F) | ((sf << 4) & 0xF0);
-    writeRegister(REG_MODEM_CONFIG_2, reg2);
+    writeField<SX127x::ModemSpreadingFactor>(sf);
+}
+
+template <typename Bus>
+int RFM95T<Bus>::getSpreadingFactor()
+{
+    return readField<SX127x::ModemSpreadingFactor>();
 }
 
-int RFM95::getSpreadingFactor()
+template <typename Bus>
+void RFM95T<Bus>::setBandwidth(float bw_khz)
 {
-    uint8_t reg2 = readRegister(REG_MODEM_CONFIG_2);
-    return (reg2 >> 4) & 0x0F;
+    writeField<SX127x::ModemBandwidth>(bandwidthCode(bw_khz));
 }
 
-void RFM95::setBandwidth(float bw_khz)
+template <typename Bus>
+uint8_t RFM95T<Bus>::bandwidthCode(float bw_khz)
 {
     const float bws[] = {7.8, 10.4, 15.6, 20.8, 31.25, 41.7, 62.5, 125, 250, 500};
-    uint8_t bw_value = 9; // Default to 500kHz
 
     for (int i = 0; i < 10; i++)
     {
         if (bw_khz <= bws[i])
         {
-            bw_value = i;
-            break;
+            return i;
         }
     }
-
-    uint8_t reg1 = readRegister(REG_MODEM_CONFIG_1);
-    reg1 = (reg1 & 0x0F) | (bw_value << 4);
-    writeRegister(REG_MODEM_CONFIG_1, reg1);
+    return 9; // Default to 500kHz
 }
 
-float RFM95::getBandwidth()
+template <typename Bus>
+float RFM95T<Bus>::getBandwidth()
 {
     const float bws[] = {7.8, 10.4, 15.6, 20.8, 31.25, 41.7, 62.5, 125, 250, 500};
-    uint8_t reg1 = readRegister(REG_MODEM_CONFIG_1);
-    uint8_t bw_value = (reg1 >> 4) & 0x0F;
+    uint8_t bw_value = readField<SX127x::ModemBandwidth>();
     return bws[bw_value < 10 ? bw_value : 9];
 }
 
-void RFM95::setCodingRate(int denominator)
+template <typename Bus>
+void RFM95T<Bus>::setCodingRate(int denominator)
 {
     denominator = std::max(5, std::min(denominator, 8));
 
-    uint8_t cr = denominator - 4;
-    uint8_t reg1 = readRegister(REG_MODEM_CONFIG_1);
-    reg1 = (reg1 & 0xF1) | (cr << 1);
-    writeRegister(REG_MODEM_CONFIG_1, reg1);
+    writeField<SX127x::ModemCodingRate>(denominator - 4);
 }
 
-int RFM95::getCodingRate()
+template <typename Bus>
+int RFM95T<Bus>::getCodingRate()
 {
-    uint8_t reg1 = readRegister(REG_MODEM_CONFIG_1);
-    uint8_t cr = (reg1 >> 1) & 0x07;
-    return cr + 4;
+    return readField<SX127x::ModemCodingRate>() + 4;
 }
 
-void RFM95::setPreambleLength(int length)
+template <typename Bus>
+void RFM95T<Bus>::setPreambleLength(int length)
 {
     writeRegister(REG_PREAMBLE_MSB, (length >> 8) & 0xFF);
     writeRegister(REG_PREAMBLE_LSB, length & 0xFF);
 }
 
-int RFM95::getPreambleLength()
+template <typename Bus>
+int RFM95T<Bus>::getPreambleLength()
 {
     uint16_t msb = readRegister(REG_PREAMBLE_MSB);
     uint16_t lsb = readRegister(REG_PREAMBLE_LSB);
     return (msb << 8) | lsb;
 }
 
-void RFM95::setInvertIQ(bool invert)
+template <typename Bus>
+void RFM95T<Bus>::setInvertIQ(bool invert)
 {
     if (invert)
     {
@@ -245,22 +302,26 @@ void RFM95::setInvertIQ(bool invert)
     }
 }
 
-bool RFM95::getInvertIQ()
+template <typename Bus>
+bool RFM95T<Bus>::getInvertIQ()
 {
-    return (readRegister(REG_INVERTIQ) & 0x40) != 0;
+    return readField<SX127x::InvertIQRx>() != 0;
 }
 
-void RFM95::setSyncWord(uint8_t sync_word)
+template <typename Bus>
+void RFM95T<Bus>::setSyncWord(uint8_t sync_word)
 {
     writeRegister(REG_SYNC_WORD, sync_word);
 }
 
-uint8_t RFM95::getSyncWord()
+template <typename Bus>
+uint8_t RFM95T<Bus>::getSyncWord()
 {
     return readRegister(REG_SYNC_WORD);
 }
 
-void RFM95::setLNA(int lna_gain, bool lna_boost)
+template <typename Bus>
+void RFM95T<Bus>::setLNA(int lna_gain, bool lna_boost)
 {
     if (lna_gain >= 0)
     {
@@ -271,109 +332,103 @@ void RFM95::setLNA(int lna_gain, bool lna_boost)
         setAutoAGC(true);
     }
 
-    if (lna_boost)
-    {
-        writeRegister(REG_LNA, readRegister(REG_LNA) | 0x03);
-    }
-    else
-    {
-        writeRegister(REG_LNA, readRegister(REG_LNA) & 0xFC);
-    }
+    writeField<SX127x::LnaBoostHf>(lna_boost ? 0x03 : 0x00);
 }
 
-uint8_t RFM95::getLNA()
+template <typename Bus>
+uint8_t RFM95T<Bus>::getLNA()
 {
     return readRegister(REG_LNA);
 }
 
-void RFM95::setAutoAGC(bool enable)
+template <typename Bus>
+void RFM95T<Bus>::setAutoAGC(bool enable)
 {
-    if (enable)
-    {
-        writeRegister(REG_MODEM_CONFIG_3, readRegister(REG_MODEM_CONFIG_3) | 0x04);
-    }
-    else
-    {
-        writeRegister(REG_MODEM_CONFIG_3, readRegister(REG_MODEM_CONFIG_3) & ~0x04);
-    }
+    writeField<SX127x::ModemAgcAutoOn>(enable ? 1 : 0);
 }
 
-bool RFM95::getAutoAGC()
+template <typename Bus>
+bool RFM95T<Bus>::getAutoAGC()
 {
-    return (readRegister(REG_MODEM_CONFIG_3) & 0x04) != 0;
+    return readField<SX127x::ModemAgcAutoOn>() != 0;
 }
 
-void RFM95::clearIRQFlags()
+template <typename Bus>
+void RFM95T<Bus>::clearIRQFlags()
 {
     writeRegister(REG_IRQ_FLAGS, 0xFF);
 }
 
-uint8_t RFM95::getIRQFlags()
+template <typename Bus>
+uint8_t RFM95T<Bus>::getIRQFlags()
 {
     return readRegister(REG_IRQ_FLAGS);
 }
 
-void RFM95::clearIRQFlagTxDone()
+template <typename Bus>
+void RFM95T<Bus>::clearIRQFlagTxDone()
 {
     writeRegister(REG_IRQ_FLAGS, IRQ_TX_DONE_MASK);
 }
 
-void RFM95::clearIRQFlagRxDone()
+template <typename Bus>
+void RFM95T<Bus>::clearIRQFlagRxDone()
 {
     writeRegister(REG_IRQ_FLAGS, IRQ_RX_DONE_MASK);
 }
 
-bool RFM95::getRxDone()
+template <typename Bus>
+bool RFM95T<Bus>::getRxDone()
 {
     return (readRegister(REG_IRQ_FLAGS) & IRQ_RX_DONE_MASK) != 0;
 }
 
-bool RFM95::getTxDone()
+template <typename Bus>
+bool RFM95T<Bus>::getTxDone()
 {
     return (readRegister(REG_IRQ_FLAGS) & IRQ_TX_DONE_MASK) != 0;
 }
 
-bool RFM95::getRxError()
+template <typename Bus>
+bool RFM95T<Bus>::getRxError()
 {
     return (readRegister(REG_IRQ_FLAGS) & IRQ_PAYLOAD_CRC_ERROR_MASK) != 0;
 }
 
-bool RFM95::getValidHeader()
+template <typename Bus>
+bool RFM95T<Bus>::getValidHeader()
 {
     return (readRegister(REG_IRQ_FLAGS) & IRQ_VALID_HEADER_MASK) != 0;
 }
 
-bool RFM95::getCADDone()
+template <typename Bus>
+bool RFM95T<Bus>::getCADDone()
 {
     return (readRegister(REG_IRQ_FLAGS) & IRQ_CAD_DONE_MASK) != 0;
 }
 
-bool RFM95::getCADDetected()
+template <typename Bus>
+bool RFM95T<Bus>::getCADDetected()
 {
     return (readRegister(REG_IRQ_FLAGS) & IRQ_CAD_DETECTED_MASK) != 0;
 }
 
-bool RFM95::getPayloadCRCError()
+template <typename Bus>
+bool RFM95T<Bus>::getPayloadCRCError()
 {
     return (readRegister(REG_IRQ_FLAGS) & IRQ_PAYLOAD_CRC_ERROR_MASK) != 0;
 }
 
-void RFM95::setLoRaMode(bool enable)
+template <typename Bus>
+void RFM95T<Bus>::setLoRaMode(bool enable)
 {
-    uint8_t mode = readRegister(REG_OP_MODE);
-    if (enable)
-    {
-        mode = (mode & 0x7F) | 0x80; // Set bit 7 for LoRa mode
-    }
-    else
-    {
-        mode = mode & 0x7F; // Clear bit 7 for FSK mode
-    }
-    writeRegister(REG_OP_MODE, mode);
+    // Bit 7 selects LoRa (1) or FSK (0) mode
+    writeField<SX127x::OpModeLongRangeMode>(enable ? 1 : 0);
     std::this_thread::sleep_for(std::chrono::milliseconds(10)); // Wait for mode change
 }
 
-bool RFM95::send(const std::vector<uint8_t> &data, bool invert_iq)
+template <typename Bus>
+bool RFM95T<Bus>::send(const std::vector<uint8_t> &data, bool invert_iq)
 {
     if (data.size() > 255)
     {
@@ -390,18 +445,14 @@ bool RFM95::send(const std::vector<uint8_t> &data, bool invert_iq)
     std::this_thread::sleep_for(std::chrono::milliseconds(1));
 
     // Configure DIO3 for TxDone
-    uint8_t current = readRegister(REG_DIO_MAPPING_1);
-    writeRegister(REG_DIO_MAPPING_1, (current & 0x3F) | 0x40); // 01 for DIO3
+    writeField<SX127x::Dio0Mapping>(0x01); // 01 for DIO3
 
     // Clear IRQ flags
     writeRegister(REG_IRQ_FLAGS, 0xFF);
 
     // Write data
     writeRegister(REG_FIFO_ADDR_PTR, 0);
-    for (uint8_t byte : data)
-    {
-        writeRegister(REG_FIFO, byte);
-    }
+    writeRegisters(REG_FIFO, data.data(), data.size());
     writeRegister(REG_PAYLOAD_LENGTH, data.size());
 
     // Start TX
@@ -440,7 +491,8 @@ bool RFM95::send(const std::vector<uint8_t> &data, bool invert_iq)
     }
 }
 
-std::vector<uint8_t> RFM95::receive(float timeout, bool invert_iq)
+template <typename Bus>
+std::vector<uint8_t> RFM95T<Bus>::receive(float timeout, bool invert_iq)
 {
     // Configure IQ mode
     setInvertIQ(invert_iq);
@@ -481,12 +533,8 @@ std::vector<uint8_t> RFM95::receive(float timeout, bool invert_iq)
                     uint8_t current_addr = readRegister(REG_FIFO_RX_CURRENT_ADDR);
                     writeRegister(REG_FIFO_ADDR_PTR, current_addr);
 
-                    std::vector<uint8_t> data;
-                    data.reserve(length);
-                    for (int i = 0; i < length; i++)
-                    {
-                        data.push_back(readRegister(REG_FIFO));
-                    }
+                    std::vector<uint8_t> data(length);
+                    readRegisters(REG_FIFO, data.data(), length);
 
                     writeRegister(REG_IRQ_FLAGS, 0xFF); // Clear flags
 
@@ -519,7 +567,8 @@ std::vector<uint8_t> RFM95::receive(float timeout, bool invert_iq)
     }
 }
 
-void RFM95::setContinuousReceive()
+template <typename Bus>
+void RFM95T<Bus>::setContinuousReceive()
 {
     // Put the module in standby mode first
     standbyMode();
@@ -528,54 +577,117 @@ void RFM95::setContinuousReceive()
     writeRegister(REG_FIFO_ADDR_PTR, readRegister(REG_FIFO_RX_BASE_ADDR));
     
     // Configure DIO for reception
-    uint8_t dio_mapping = readRegister(REG_DIO_MAPPING_1);
-    dio_mapping &= 0x3F;  // Clear DIO0 bits (bits 6-7)
-    dio_mapping |= DIO0_RX_DONE;  // DIO0 = 0 (RX_DONE)
-    writeRegister(REG_DIO_MAPPING_1, dio_mapping);
+    writeField<SX127x::Dio0Mapping>(SX127x::Dio0Mapping::decode(DIO0_RX_DONE)); // DIO0 = 0 (RX_DONE)
     
     // Clear interrupt flags
     clearIRQFlags();
     
     // Change to RX_CONTINUOUS mode
-    uint8_t opmode = readRegister(REG_OP_MODE);
-    opmode = (opmode & 0xF8) | MODE_RX_CONTINUOUS;  // Modes: 1=STDBY, 5=RXCONT, 3=TX
-    writeRegister(REG_OP_MODE, opmode);
+    writeField<SX127x::OpModeMode>(MODE_RX_CONTINUOUS);  // Modes: 1=STDBY, 5=RXCONT, 3=TX
     
     // Debug: verify that the mode was changed correctly
-    opmode = readRegister(REG_OP_MODE);
-    if ((opmode & 0x07) != MODE_RX_CONTINUOUS) {
-        std::cerr << "Error: Could not change to RX_CONTINUOUS mode" << std::endl;
+    if (readField<SX127x::OpModeMode>() != MODE_RX_CONTINUOUS) {
+        LOG_ERROR("Could not change to RX_CONTINUOUS mode");
+    }
+}
+
+template <typename Bus>
+void RFM95T<Bus>::setSingleReceive(uint16_t symbol_timeout)
+{
+    standbyMode();
+
+    // Configure FIFO RX
+    writeRegister(REG_FIFO_ADDR_PTR, readRegister(REG_FIFO_RX_BASE_ADDR));
+
+    // RX timeout, 10 bits split over MODEM_CONFIG_2 and SYMB_TIMEOUT_LSB
+    symbol_timeout = std::max<uint16_t>(4, std::min<uint16_t>(symbol_timeout, 1023));
+    writeField<SX127x::ModemSymbTimeoutMsb>(symbol_timeout >> 8);
+    writeRegister(REG_SYMB_TIMEOUT_LSB, symbol_timeout & 0xFF);
+
+    writeField<SX127x::Dio0Mapping>(SX127x::Dio0Mapping::decode(DIO0_RX_DONE));
+    clearIRQFlags();
+
+    writeField<SX127x::OpModeMode>(MODE_RX_SINGLE);
+}
+
+template <typename Bus>
+void RFM95T<Bus>::startCAD()
+{
+    standbyMode();
+
+    writeField<SX127x::Dio0Mapping>(SX127x::Dio0Mapping::decode(DIO0_CAD_DONE));
+    clearIRQFlags();
+
+    writeField<SX127x::OpModeMode>(MODE_CAD);
+}
+
+template <typename Bus>
+Radio::Mode RFM95T<Bus>::getMode()
+{
+    switch (readField<SX127x::OpModeMode>())
+    {
+    case MODE_SLEEP:
+        return Mode::SLEEP;
+    case MODE_STDBY:
+        return Mode::STANDBY;
+    case MODE_TX:
+        return Mode::TX;
+    case MODE_RX_CONTINUOUS:
+        return Mode::RX_CONTINUOUS;
+    case MODE_RX_SINGLE:
+        return Mode::RX_SINGLE;
+    case MODE_CAD:
+        return Mode::CAD;
+    default:
+        return Mode::OTHER;
     }
 }
 
-void RFM95::standbyMode()
+template <typename Bus>
+uint16_t RFM95T<Bus>::getIrqStatus()
+{
+    return readRegister(REG_IRQ_FLAGS);
+}
+
+template <typename Bus>
+void RFM95T<Bus>::clearIrqStatus(uint16_t mask)
+{
+    writeRegister(REG_IRQ_FLAGS, mask & 0xFF);
+}
+
+template <typename Bus>
+void RFM95T<Bus>::standbyMode()
 {
     writeRegister(REG_OP_MODE, MODE_STDBY);
 }
 
-void RFM95::sleepMode()
+template <typename Bus>
+void RFM95T<Bus>::sleepMode()
 {
-    uint8_t current = readRegister(REG_OP_MODE);
-    writeRegister(REG_OP_MODE, (current & 0xF8) | MODE_SLEEP);
+    writeField<SX127x::OpModeMode>(MODE_SLEEP);
     std::this_thread::sleep_for(std::chrono::milliseconds(10));
 }
 
-void RFM95::resetPtrRx()
+template <typename Bus>
+void RFM95T<Bus>::resetPtrRx()
 {
     writeRegister(REG_FIFO_ADDR_PTR, 0);
 }
 
-uint8_t RFM95::getFifoRxCurrentAddr()
+template <typename Bus>
+uint8_t RFM95T<Bus>::getFifoRxCurrentAddr()
 {
     return readRegister(REG_FIFO_RX_CURRENT_ADDR);
 }
 
-uint8_t RFM95::getRxNbBytes()
+template <typename Bus>
+uint8_t RFM95T<Bus>::getRxNbBytes()
 {
     return readRegister(REG_RX_NB_BYTES);
 }
 
-std::vector<uint8_t> RFM95::readPayload()
+template <typename Bus>
+std::vector<uint8_t> RFM95T<Bus>::readPayload()
 {
     uint8_t length = readRegister(REG_RX_NB_BYTES);
     if (length > 0)
@@ -583,47 +695,126 @@ std::vector<uint8_t> RFM95::readPayload()
         uint8_t current_addr = readRegister(REG_FIFO_RX_CURRENT_ADDR);
         writeRegister(REG_FIFO_ADDR_PTR, current_addr);
 
-        std::vector<uint8_t> data;
-        data.reserve(length);
-        for (int i = 0; i < length; i++)
-        {
-            data.push_back(readRegister(REG_FIFO));
-        }
+        std::vector<uint8_t> data(length);
+        readRegisters(REG_FIFO, data.data(), length);
 
         return data;
     }
     return std::vector<uint8_t>();
 }
 
-float RFM95::getRSSI()
+template <typename Bus>
+float RFM95T<Bus>::getRSSI()
 {
     return -137 + readRegister(REG_PKT_RSSI_VALUE);
 }
 
-float RFM95::getSNR()
+template <typename Bus>
+float RFM95T<Bus>::getSNR()
 {
     int8_t snr = static_cast<int8_t>(readRegister(REG_PKT_SNR_VALUE));
     return snr * 0.25f;
 }
 
-uint8_t RFM95::readRegister(uint8_t address)
+template <typename Bus>
+Radio::PacketInfo RFM95T<Bus>::getPacketInfo()
 {
-    std::vector<uint8_t> cmd = {static_cast<uint8_t>(address & 0x7F)};
-    std::vector<uint8_t> response = spi->transfer(cmd, 1);
-    if (!response.empty())
+    // REG_PKT_SNR_VALUE and REG_PKT_RSSI_VALUE are consecutive
+    uint8_t values[2] = {0, 0};
+    readRegisters(REG_PKT_SNR_VALUE, values, sizeof(values));
+
+    PacketInfo info;
+    info.snr = static_cast<int8_t>(values[0]) * 0.25f;
+    info.rssi = -137 + values[1];
+    return info;
+}
+
+template <typename Bus>
+bool RFM95T<Bus>::sampleRSSI(float freq_mhz, float *samples, size_t count)
+{
+    // Retune in standby and restart RX; the RSSI settling time rides on the
+    // last setup write so the first read of the batch is already valid
+    const uint32_t frf = frequencyToFrf(freq_mhz);
+    const uint8_t standby[2] = {static_cast<uint8_t>(REG_OP_MODE | 0x80), MODE_STDBY};
+    const uint8_t tune[4] = {static_cast<uint8_t>(REG_FRF_MSB | 0x80), static_cast<uint8_t>((frf >> 16) & 0xFF),
+                             static_cast<uint8_t>((frf >> 8) & 0xFF), static_cast<uint8_t>(frf & 0xFF)};
+    const uint8_t receive[2] = {static_cast<uint8_t>(REG_OP_MODE | 0x80), MODE_RX_CONTINUOUS};
+    const uint8_t read = REG_RSSI_VALUE;
+
+    // RssiValue is offset by -157 dBm on the HF port and -164 dBm on the LF port
+    const float offset = freq_mhz < 525.0f ? -164.0f : -157.0f;
+
+    std::array<SPISegment, RSSI_BATCH + 3> segments;
+    std::array<uint8_t, RSSI_BATCH> raw;
+    size_t setup = 3;
+    segments[0] = {standby, sizeof(standby), nullptr, 0, 0};
+    segments[1] = {tune, sizeof(tune), nullptr, 0, 0};
+    segments[2] = {receive, sizeof(receive), nullptr, 0, RSSI_SETTLE_US};
+
+    size_t taken = 0;
+    while (taken < count)
     {
-        return response[0];
+        const size_t chunk = std::min(RSSI_BATCH, count - taken);
+        for (size_t i = 0; i < chunk; i++)
+        {
+            segments[setup + i] = {&read, 1, &raw[i], 1, RSSI_SAMPLE_US};
+        }
+        if (!bus.transferBatch(segments.data(), setup + chunk))
+        {
+            return false;
+        }
+        for (size_t i = 0; i < chunk; i++)
+        {
+            samples[taken + i] = offset + raw[i];
+        }
+        taken += chunk;
+        setup = 0;
     }
-    return 0;
+    return true;
 }
 
-void RFM95::writeRegister(uint8_t address, uint8_t value)
+template <typename Bus>
+uint8_t RFM95T<Bus>::readRegister(uint8_t address)
 {
-    std::vector<uint8_t> cmd = {static_cast<uint8_t>(address | 0x80), value};
-    spi->transfer(cmd, 0);
+    uint8_t cmd = static_cast<uint8_t>(address & 0x7F);
+    uint8_t value = 0;
+    if (!bus.transfer(&cmd, 1, &value, 1))
+    {
+        return 0;
+    }
+    return value;
+}
+
+template <typename Bus>
+void RFM95T<Bus>::writeRegister(uint8_t address, uint8_t value)
+{
+    uint8_t cmd[2] = {static_cast<uint8_t>(address | 0x80), value};
+    bus.transfer(cmd, sizeof(cmd), nullptr, 0);
+}
+
+template <typename Bus>
+bool RFM95T<Bus>::readRegisters(uint8_t address, uint8_t *data, size_t length)
+{
+    uint8_t cmd = static_cast<uint8_t>(address & 0x7F);
+    return bus.transfer(&cmd, 1, data, length);
 }
 
-void RFM95::receiveMode()
+template <typename Bus>
+bool RFM95T<Bus>::writeRegisters(uint8_t address, const uint8_t *data, size_t length)
+{
+    if (length > 255)
+    {
+        return false;
+    }
+
+    uint8_t cmd[256];
+    cmd[0] = static_cast<uint8_t>(address | 0x80);
+    std::copy(data, data + length, cmd + 1);
+    return bus.transfer(cmd, length + 1, nullptr, 0);
+}
+
+template <typename Bus>
+void RFM95T<Bus>::receiveMode()
 {
     // Clear FIFO
     writeRegister(REG_FIFO_ADDR_PTR, 0);
@@ -642,24 +833,22 @@ void RFM95::receiveMode()
     writeRegister(REG_OP_MODE, MODE_RX_CONTINUOUS);
 }
 
-void RFM95::setDIOMapping(uint8_t _dio3, uint8_t _dio4)
+template <typename Bus>
+void RFM95T<Bus>::setDIOMapping(uint8_t _dio3, uint8_t _dio4)
 {
     // RegDioMapping1 (0x40)
-    uint8_t dio_map1 = readRegister(REG_DIO_MAPPING_1);
-    dio_map1 = (dio_map1 & 0x3F) | (_dio3 & 0xC0);
-    writeRegister(REG_DIO_MAPPING_1, dio_map1);
+    writeField<SX127x::Dio0Mapping>(SX127x::Dio0Mapping::decode(_dio3));
 
     // RegDioMapping2 (0x41)
-    uint8_t dio_map2 = readRegister(REG_DIO_MAPPING_2);
-    dio_map2 = (dio_map2 & 0x3F) | (_dio4 & 0xC0);
-    writeRegister(REG_DIO_MAPPING_2, dio_map2);
+    writeField<SX127x::Dio4Mapping>(SX127x::Dio4Mapping::decode(_dio4));
 
     // Enable interrupts
     writeRegister(REG_IRQ_FLAGS_MASK, 0x00); // IRQ mask
     writeRegister(REG_IRQ_FLAGS, 0xFF);      // Clear flags
 }
 
-bool RFM95::calibrateTemperature(float actual_temp)
+template <typename Bus>
+bool RFM95T<Bus>::calibrateTemperature(float actual_temp)
 {
     try
     {
@@ -683,12 +872,13 @@ bool RFM95::calibrateTemperature(float actual_temp)
     }
     catch (const std::exception &e)
     {
-        std::cerr << "Error in temperature calibration: " << e.what() << std::endl;
+        LOG_ERROR("Error in temperature calibration: " << e.what());
         return false;
     }
 }
 
-float RFM95::readTemperature()
+template <typename Bus>
+float RFM95T<Bus>::readTemperature()
 {
     try
     {
@@ -716,12 +906,13 @@ float RFM95::readTemperature()
     }
     catch (const std::exception &e)
     {
-        std::cerr << "Error reading temperature: " << e.what() << std::endl;
+        LOG_ERROR("Error reading temperature: " << e.what());
         return 0.0f;
     }
 }
 
-bool RFM95::setBeaconMode(int interval_ms, const std::vector<uint8_t> &payload)
+template <typename Bus>
+bool RFM95T<Bus>::setBeaconMode(int interval_ms, const std::vector<uint8_t> &payload)
 {
     if (payload.size() > 255)
     {
@@ -735,10 +926,7 @@ bool RFM95::setBeaconMode(int interval_ms, const std::vector<uint8_t> &payload)
     writeRegister(REG_FIFO_ADDR_PTR, 0);
 
     // Write payload
-    for (uint8_t byte : payload)
-    {
-        writeRegister(REG_FIFO, byte);
-    }
+    writeRegisters(REG_FIFO, payload.data(), payload.size());
     writeRegister(REG_PAYLOAD_LENGTH, payload.size());
 
     // Set beacon interval
@@ -747,28 +935,29 @@ bool RFM95::setBeaconMode(int interval_ms, const std::vector<uint8_t> &payload)
     writeRegister(0x25, period & 0xFF);        // REG_BEACON_PERIOD LSB
 
     // Enable beacon mode
-    uint8_t mode = readRegister(REG_OP_MODE);
-    mode = (mode & 0x7F) | 0x80; // Set LoRa mode
-    mode = (mode & 0xF8) | 0x03; // Set beacon mode
-    writeRegister(REG_OP_MODE, mode);
+    applySequence(SX127x::merge(SX127x::OpModeLongRangeMode::write(1), // Set LoRa mode
+                                SX127x::OpModeMode::write(0x03)));        // Set beacon mode
 
     return true;
 }
 
-void RFM95::stopBeaconMode()
+template <typename Bus>
+void RFM95T<Bus>::stopBeaconMode()
 {
     standbyMode();
 }
 
-void RFM95::checkOperatingMode()
+template <typename Bus>
+void RFM95T<Bus>::checkOperatingMode()
 {
     uint8_t mode = readRegister(REG_OP_MODE);
     std::cout << "Operating Mode: 0x" << std::hex << static_cast<int>(mode) << std::dec << std::endl;
-    std::cout << "  LoRa Mode: " << ((mode & 0x80) ? "Yes" : "No") << std::endl;
-    std::cout << "  Mode: " << static_cast<int>(mode & 0x07) << std::endl; // 0=Sleep, 1=Standby, 2=FSTX, 3=TX, 4=FSRX, 5=RX
+    std::cout << "  LoRa Mode: " << (SX127x::OpModeLongRangeMode::decode(mode) ? "Yes" : "No") << std::endl;
+    std::cout << "  Mode: " << static_cast<int>(SX127x::OpModeMode::decode(mode)) << std::endl; // 0=Sleep, 1=Standby, 2=FSTX, 3=TX, 4=FSRX, 5=RX
 }
 
-void RFM95::checkIRQFlags()
+template <typename Bus>
+void RFM95T<Bus>::checkIRQFlags()
 {
     uint8_t flags = readRegister(REG_IRQ_FLAGS);
     std::cout << "IRQ Flags: 0x" << std::hex << static_cast<int>(flags) << std::dec << std::endl;
@@ -782,7 +971,8 @@ void RFM95::checkIRQFlags()
     std::cout << "  CadDetected: " << ((flags & 0x01) ? "true" : "false") << std::endl;
 }
 
-void RFM95::printRegisters()
+template <typename Bus>
+void RFM95T<Bus>::printRegisters()
 {
     std::cout << "\nRegister values:" << std::endl;
     std::cout << "OP_MODE: 0x" << std::hex << static_cast<int>(readRegister(REG_OP_MODE)) << std::dec << std::endl;
@@ -793,7 +983,8 @@ void RFM95::printRegisters()
     std::cout << "PA_CONFIG: 0x" << std::hex << static_cast<int>(readRegister(REG_PA_CONFIG)) << std::dec << std::endl;
 }
 
-bool RFM95::testCommunication()
+template <typename Bus>
+bool RFM95T<Bus>::testCommunication()
 {
     // Write a test value to sync word register
     uint8_t test_value = 0x42;
@@ -805,20 +996,30 @@ bool RFM95::testCommunication()
     return test_value == read_value;
 }
 
-uint8_t RFM95::readVersionRegister()
+template <typename Bus>
+uint8_t RFM95T<Bus>::readVersionRegister()
 {
     try
     {
-        std::vector<uint8_t> response = spi->transfer({0x42}, 1);
-        if (!response.empty())
-        {
-            return response[0];
-        }
-        return 0;
+        return readRegister(REG_VERSION);
     }
     catch (const std::exception &e)
     {
-        std::cerr << "Error reading VERSION register: " << e.what() << std::endl;
+        LOG_ERROR("Error reading VERSION register: " << e.what());
         return 0;
     }
-}
\ No newline at end of file
+}
+
+template class RFM95T<SPIInterfaceBus>;
+template class RFM95T<CH341Bus>;
+template class RFM95T<LinuxSPIBus>;
+
+RFM95::RFM95(std::unique_ptr<SPIInterface> spi_interface)
+    : RFM95T<SPIInterfaceBus>(SPIInterfaceBus(std::move(spi_interface)))
+{
+}
+
+RFM95::RFM95(int device_index)
+    : RFM95T<SPIInterfaceBus>(SPIInterfaceBus(SPIFactory::createCH341SPI(device_index)))
+{
+}
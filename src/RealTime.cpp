@@ -0,0 +1,180 @@
+/**
+ * @file RealTime.cpp
+ * @brief Implementation of the real-time settings and latency statistics
+ *
+ * mlockall(MCL_CURRENT | MCL_FUTURE) keeps every page resident, including
+ * the stacks and heap allocated later. glibc is also told never to trim the
+ * heap or serve allocations with mmap(), so memory freed and allocated again
+ * by the MAC layer stays mapped and locked. The stack of a real-time thread
+ * is touched once on entry, so its first deep call does not fault either.
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+#include "RealTime.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <alloca.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+std::atomic<bool> RealTime::enabled{false};
+RealTime::Settings RealTime::current;
+
+#ifdef __linux__
+
+bool RealTime::configure(const Settings &settings)
+{
+    current = settings;
+    enabled = settings.enabled;
+    if (!settings.enabled)
+        return true;
+
+    int min = sched_get_priority_min(SCHED_FIFO);
+    int max = sched_get_priority_max(SCHED_FIFO);
+    if (settings.priority < min || settings.priority > max)
+    {
+        LOG_ERROR("Real-time priority " << settings.priority << " outside " << min << "-" << max);
+        enabled = false;
+        return false;
+    }
+
+    if (settings.lock_memory)
+    {
+#ifdef __GLIBC__
+        mallopt(M_TRIM_THRESHOLD, -1);
+        mallopt(M_MMAP_MAX, 0);
+#endif
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+        {
+            // Not fatal: scheduling still applies, page faults may add latency
+            LOG_WARNING("Cannot lock memory: " << strerror(errno) << " (needs CAP_IPC_LOCK or RLIMIT_MEMLOCK)");
+        }
+    }
+    return true;
+}
+
+bool RealTime::enterThread(const char *name)
+{
+    if (!enabled)
+        return true;
+
+    pthread_t self = pthread_self();
+    if (name)
+        pthread_setname_np(self, name);
+
+    bool ok = true;
+    if (current.cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(current.cpu, &set);
+        int error = pthread_setaffinity_np(self, sizeof(set), &set);
+        if (error != 0)
+        {
+            LOG_ERROR("Cannot pin thread " << (name ? name : "") << " to CPU " << current.cpu << ": " << strerror(error));
+            ok = false;
+        }
+    }
+
+    sched_param param;
+    std::memset(&param, 0, sizeof(param));
+    param.sched_priority = current.priority;
+    int error = pthread_setschedparam(self, SCHED_FIFO, &param);
+    if (error != 0)
+    {
+        LOG_ERROR("Cannot set SCHED_FIFO for thread " << (name ? name : "") << ": " << strerror(error)
+                  << " (needs CAP_SYS_NICE or RLIMIT_RTPRIO)");
+        ok = false;
+    }
+
+    if (current.prefault_stack > 0)
+    {
+        // Touch every page of the stack the thread may use, below this frame
+        volatile uint8_t *stack = static_cast<volatile uint8_t *>(alloca(current.prefault_stack));
+        for (size_t i = 0; i < current.prefault_stack; i += 4096)
+            stack[i] = 0;
+        stack[current.prefault_stack - 1] = 0;
+    }
+    return ok;
+}
+
+#else
+
+bool RealTime::configure(const Settings &settings)
+{
+    current = settings;
+    if (!settings.enabled)
+        return true;
+
+    LOG_ERROR("Real-time mode is not supported on this platform");
+    return false;
+}
+
+bool RealTime::enterThread(const char *name)
+{
+    (void)name;
+    return true;
+}
+
+#endif
+
+void LatencyStats::record(std::chrono::steady_clock::time_point due, std::chrono::steady_clock::time_point now)
+{
+    uint64_t late_us = 0;
+    if (now > due)
+        late_us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - due).count());
+
+    int bucket = 0;
+    while (bucket < BUCKETS - 1 && (uint64_t(1) << bucket) <= late_us)
+        bucket++;
+
+    // Single writer: plain read-modify-write, atomics only for the readers
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    total_us.store(total_us.load(std::memory_order_relaxed) + late_us, std::memory_order_relaxed);
+    if (late_us > max_us.load(std::memory_order_relaxed))
+        max_us.store(late_us, std::memory_order_relaxed);
+    histogram[bucket].store(histogram[bucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+LatencyStats::Summary LatencyStats::summary() const
+{
+    Summary result;
+    result.count = count.load(std::memory_order_relaxed);
+    if (result.count == 0)
+        return result;
+
+    result.mean_us = total_us.load(std::memory_order_relaxed) / result.count;
+    result.max_us = max_us.load(std::memory_order_relaxed);
+
+    // Upper bound of the bucket holding the 99th percentile, capped by the maximum
+    uint64_t target = result.count - result.count / 100;
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++)
+    {
+        seen += histogram[i].load(std::memory_order_relaxed);
+        if (seen >= target)
+        {
+            result.p99_us = std::min(i == 0 ? uint64_t(0) : (uint64_t(1) << i) - 1, result.max_us);
+            break;
+        }
+    }
+    return result;
+}
+
+void LatencyStats::reset()
+{
+    count = 0;
+    total_us = 0;
+    max_us = 0;
+    for (auto &bucket : histogram)
+        bucket = 0;
+}
@@ -0,0 +1,886 @@
+/**
+ * @file SX126x.cpp
+ * @brief Implementation of the SX126x LoRa transceiver driver.
+ *
+ * Multi-command operations (profile changes, TX and RX setup, CAD) are queued in
+ * a CommandBatch and submitted with a single transferBatch() call. BUSY is only
+ * polled before each batch; within a batch the commands are separated by a short
+ * guard time.
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+
+#include "SX126x.hpp"
+#include "Logger.hpp"
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+namespace
+{
+    // Standby and packet type arguments
+    constexpr uint8_t STDBY_RC = 0x00;
+    constexpr uint8_t PACKET_TYPE_LORA = 0x01;
+    constexpr uint8_t REGULATOR_DC_DC = 0x01;
+    constexpr uint8_t SLEEP_WARM_START = 0x04;
+    constexpr uint8_t CALIBRATE_ALL = 0x7F;
+    constexpr uint8_t RAMP_200_US = 0x04;
+
+    // RX gain register values
+    constexpr uint8_t RX_GAIN_POWER_SAVING = 0x94;
+    constexpr uint8_t RX_GAIN_BOOSTED = 0x96;
+
+    // Over current protection: 140 mA for the SX1262 at +22 dBm
+    constexpr uint8_t OCP_140_MA = 0x38;
+
+    // Bit 2 of REG_IQ_POLARITY must be cleared for inverted IQ (datasheet 15.4)
+    constexpr uint8_t IQ_POLARITY_FIX = 0x04;
+}
+
+template <typename Bus>
+void SX126xT<Bus>::CommandBatch::add(uint8_t opcode, std::initializer_list<uint8_t> params,
+                                     const uint8_t *payload, size_t payload_length)
+{
+    const size_t length = 1 + params.size() + payload_length;
+    if (count >= segment_list.size() || used + length > buffer.size())
+    {
+        overflowed = true;
+        return;
+    }
+
+    uint8_t *start = buffer.data() + used;
+    uint8_t *ptr = start;
+    *ptr++ = opcode;
+    ptr = std::copy(params.begin(), params.end(), ptr);
+    if (payload_length > 0)
+    {
+        std::copy(payload, payload + payload_length, ptr);
+    }
+    used += length;
+
+    segment_list[count++] = {start, length, nullptr, 0, COMMAND_GUARD_US};
+}
+
+template <typename Bus>
+SX126xT<Bus>::SX126xT(Bus spi_bus, int busy_pin, int reset_pin)
+    : bus(std::move(spi_bus)),
+      busy_pin(busy_pin),
+      reset_pin(reset_pin)
+{
+}
+
+template <typename Bus>
+SX126xT<Bus>::~SX126xT()
+{
+    end();
+}
+
+template <typename Bus>
+bool SX126xT<Bus>::begin()
+{
+    if (!bus.open())
+    {
+        return false;
+    }
+
+    if (busy_pin >= 0)
+    {
+        bus.pinMode(busy_pin, SPIInterface::INPUT);
+    }
+
+    // Hardware reset
+    if (reset_pin >= 0)
+    {
+        bus.pinMode(reset_pin, SPIInterface::OUTPUT);
+        bus.digitalWrite(reset_pin, false);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        bus.digitalWrite(reset_pin, true);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    // Wake from a previous sleep and check that the chip answers
+    mode = Mode::STANDBY;
+    wakeup();
+    command(CMD_SET_STANDBY, {STDBY_RC});
+    if (((getStatus() >> 4) & 0x07) != CHIP_MODE_STDBY_RC)
+    {
+        LOG_ERROR("SX126x not responding");
+        return false;
+    }
+
+    // Board and modem setup
+    CommandBatch batch;
+    batch.add(CMD_SET_REGULATOR_MODE, {REGULATOR_DC_DC});
+    if (tcxo_voltage > 0.0f)
+    {
+        // Supply codes for 1.6, 1.7, 1.8, 2.2, 2.4, 2.7, 3.0 and 3.3 V
+        const float voltages[] = {1.6f, 1.7f, 1.8f, 2.2f, 2.4f, 2.7f, 3.0f, 3.3f};
+        uint8_t code = 7;
+        for (uint8_t i = 0; i < 8; i++)
+        {
+            if (tcxo_voltage <= voltages[i] + 0.01f)
+            {
+                code = i;
+                break;
+            }
+        }
+        // 5 ms start-up time in 15.625 us steps
+        batch.add(CMD_SET_DIO3_AS_TCXO_CTRL, {code, 0x00, 0x01, 0x40});
+    }
+    if (dio2_rf_switch)
+    {
+        batch.add(CMD_SET_DIO2_AS_RF_SWITCH_CTRL, {0x01});
+    }
+    batch.add(CMD_SET_PACKET_TYPE, {PACKET_TYPE_LORA});
+    batch.add(CMD_SET_BUFFER_BASE_ADDRESS, {0x00, 0x00});
+    batch.add(CMD_SET_PA_CONFIG, {0x04, 0x07, 0x00, 0x01}); // SX1262, up to +22 dBm
+    batch.add(CMD_WRITE_REGISTER, {REG_OCP >> 8, REG_OCP & 0xFF, OCP_140_MA});
+    if (!runBatch(batch))
+    {
+        return false;
+    }
+
+    // Calibration takes a few milliseconds
+    command(CMD_CALIBRATE, {CALIBRATE_ALL});
+    waitBusy(5);
+    command(CMD_CLEAR_DEVICE_ERRORS, {0x00, 0x00});
+
+    readRegisters(REG_IQ_POLARITY, &iq_register, 1);
+
+    image_band = 0;
+    applyProfile(profile);
+    setTxPower(tx_power);
+    setSyncWord(sync_word);
+    setLNA(-1, true);
+
+    return true;
+}
+
+template <typename Bus>
+void SX126xT<Bus>::end()
+{
+    bus.close();
+}
+
+template <typename Bus>
+bool SX126xT<Bus>::testCommunication()
+{
+    // Write a test value to the sync word register and read it back
+    const uint8_t test_value = 0x42;
+    writeRegisters(REG_SYNC_WORD, &test_value, 1);
+
+    uint8_t read_value = 0;
+    readRegisters(REG_SYNC_WORD, &read_value, 1);
+
+    setSyncWord(sync_word);
+
+    return test_value == read_value;
+}
+
+template <typename Bus>
+void SX126xT<Bus>::applyProfile(const Profile &new_profile)
+{
+    profile = new_profile;
+    profile.spreading_factor = std::max(5, std::min(profile.spreading_factor, 12));
+    profile.coding_rate = std::max(5, std::min(profile.coding_rate, 8));
+
+    calibrateImage(profile.frequency);
+
+    CommandBatch batch;
+    batch.add(CMD_SET_STANDBY, {STDBY_RC});
+    addRfFrequency(batch);
+    addModulationParams(batch);
+    addPacketParams(batch, 0xFF, profile.invert_iq);
+    addIqPolarity(batch, profile.invert_iq);
+    runBatch(batch);
+
+    mode = Mode::STANDBY;
+}
+
+template <typename Bus>
+void SX126xT<Bus>::setFrequency(float freq_mhz)
+{
+    profile.frequency = freq_mhz;
+    calibrateImage(freq_mhz);
+
+    CommandBatch batch;
+    addRfFrequency(batch);
+    runBatch(batch);
+}
+
+template <typename Bus>
+float SX126xT<Bus>::getFrequency()
+{
+    return profile.frequency;
+}
+
+template <typename Bus>
+void SX126xT<Bus>::setTxPower(int level, bool use_pa_boost)
+{
+    (void)use_pa_boost;
+    tx_power = std::max(-9, std::min(level, 22));
+    command(CMD_SET_TX_PARAMS, {static_cast<uint8_t>(static_cast<int8_t>(tx_power)), RAMP_200_US});
+}
+
+template <typename Bus>
+int SX126xT<Bus>::getTxPower()
+{
+    return tx_power;
+}
+
+template <typename Bus>
+void SX126xT<Bus>::setSpreadingFactor(int sf)
+{
+    profile.spreading_factor = std::max(5, std::min(sf, 12));
+
+    CommandBatch batch;
+    addModulationParams(batch);
+    runBatch(batch);
+}
+
+template <typename Bus>
+int SX126xT<Bus>::getSpreadingFactor()
+{
+    return profile.spreading_factor;
+}
+
+template <typename Bus>
+void SX126xT<Bus>::setBandwidth(float bw_khz)
+{
+    profile.bandwidth = bw_khz;
+
+    CommandBatch batch;
+    addModulationParams(batch);
+    runBatch(batch);
+}
+
+template <typename Bus>
+float SX126xT<Bus>::getBandwidth()
+{
+    return profile.bandwidth;
+}
+
+template <typename Bus>
+void SX126xT<Bus>::setCodingRate(int denominator)
+{
+    profile.coding_rate = std::max(5, std::min(denominator, 8));
+
+    CommandBatch batch;
+    addModulationParams(batch);
+    runBatch(batch);
+}
+
+template <typename Bus>
+int SX126xT<Bus>::getCodingRate()
+{
+    return profile.coding_rate;
+}
+
+template <typename Bus>
+void SX126xT<Bus>::setPreambleLength(int length)
+{
+    profile.preamble_length = length;
+
+    CommandBatch batch;
+    addPacketParams(batch, 0xFF, profile.invert_iq);
+    runBatch(batch);
+}
+
+template <typename Bus>
+int SX126xT<Bus>::getPreambleLength()
+{
+    return profile.preamble_length;
+}
+
+template <typename Bus>
+void SX126xT<Bus>::setInvertIQ(bool invert)
+{
+    profile.invert_iq = invert;
+
+    CommandBatch batch;
+    addPacketParams(batch, 0xFF, invert);
+    addIqPolarity(batch, invert);
+    runBatch(batch);
+}
+
+template <typename Bus>
+void SX126xT<Bus>::setSyncWord(uint8_t new_sync_word)
+{
+    sync_word = new_sync_word;
+
+    // Each nibble of the SX127x style sync word is followed by 0x4
+    const uint8_t value[2] = {static_cast<uint8_t>((sync_word & 0xF0) | 0x04),
+                              static_cast<uint8_t>(((sync_word & 0x0F) << 4) | 0x04)};
+    writeRegisters(REG_SYNC_WORD, value, sizeof(value));
+}
+
+template <typename Bus>
+void SX126xT<Bus>::setLNA(int lna_gain, bool lna_boost)
+{
+    (void)lna_gain;
+    const uint8_t value = lna_boost ? RX_GAIN_BOOSTED : RX_GAIN_POWER_SAVING;
+    writeRegisters(REG_RX_GAIN, &value, 1);
+}
+
+template <typename Bus>
+bool SX126xT<Bus>::send(const std::vector<uint8_t> &data, bool invert_iq)
+{
+    if (data.size() > 255)
+    {
+        return false;
+    }
+
+    const uint16_t irq_mask = IRQ_TX_DONE_MASK | IRQ_TIMEOUT_MASK;
+
+    CommandBatch batch;
+    batch.add(CMD_SET_STANDBY, {STDBY_RC});
+    batch.add(CMD_SET_BUFFER_BASE_ADDRESS, {0x00, 0x00});
+    batch.add(CMD_WRITE_BUFFER, {0x00}, data.data(), data.size());
+    addPacketParams(batch, static_cast<uint8_t>(data.size()), invert_iq);
+    addIqPolarity(batch, invert_iq);
+    batch.add(CMD_SET_DIO_IRQ_PARAMS, {irq_mask >> 8, irq_mask & 0xFF,
+                                       irq_mask >> 8, irq_mask & 0xFF,
+                                       0x00, 0x00, 0x00, 0x00});
+    batch.add(CMD_CLEAR_IRQ_STATUS, {0xFF, 0xFF});
+    batch.add(CMD_SET_TX, {0x00, 0x00, 0x00}); // No timeout
+    if (!runBatch(batch))
+    {
+        return false;
+    }
+    mode = Mode::TX;
+
+    // The radio is left with normal IQ, as the SX127x driver does
+    profile.invert_iq = false;
+
+    // Wait for TX done
+    auto start = std::chrono::steady_clock::now();
+    while (true)
+    {
+        uint8_t flags[2] = {0, 0};
+        readCommand(CMD_GET_IRQ_STATUS, {}, flags, sizeof(flags));
+        if (((flags[0] << 8) | flags[1]) & IRQ_TX_DONE_MASK)
+        {
+            command(CMD_CLEAR_IRQ_STATUS, {0xFF, 0xFF});
+            mode = Mode::STANDBY; // The chip falls back to STDBY_RC after TX
+            return true;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count() > 2000)
+        {
+            // Timeout after 2 seconds
+            standbyMode();
+            return false;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+template <typename Bus>
+std::vector<uint8_t> SX126xT<Bus>::receive(float timeout, bool invert_iq)
+{
+    profile.invert_iq = invert_iq;
+    setContinuousReceive();
+
+    // Wait for RX done or timeout
+    auto start_time = std::chrono::steady_clock::now();
+    while (true)
+    {
+        uint16_t flags = getIrqStatus();
+
+        if (flags & IRQ_RX_DONE)
+        {
+            if (flags & IRQ_CRC_ERROR)
+            {
+                clearIrqStatus();
+                continue; // Try again
+            }
+
+            std::vector<uint8_t> data = readPayload();
+            clearIrqStatus();
+
+            if (!data.empty())
+            {
+                profile.invert_iq = false;
+                return data;
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (std::chrono::duration_cast<std::chrono::milliseconds>(now - start_time).count() > timeout * 1000)
+        {
+            clearIrqStatus();
+            profile.invert_iq = false;
+            return std::vector<uint8_t>(); // Return empty vector on timeout
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+template <typename Bus>
+void SX126xT<Bus>::setContinuousReceive()
+{
+    CommandBatch batch;
+    addRxSetup(batch);
+    batch.add(CMD_SET_RX, {0xFF, 0xFF, 0xFF}); // Continuous
+    if (runBatch(batch))
+    {
+        mode = Mode::RX_CONTINUOUS;
+    }
+}
+
+template <typename Bus>
+void SX126xT<Bus>::setSingleReceive(uint16_t symbol_timeout)
+{
+    CommandBatch batch;
+    addRxSetup(batch);
+    batch.add(CMD_SET_LORA_SYMB_NUM_TIMEOUT, {static_cast<uint8_t>(std::min<uint16_t>(symbol_timeout, 255))});
+    batch.add(CMD_SET_RX, {0x00, 0x00, 0x00}); // Single, ended by the symbol timeout
+    if (runBatch(batch))
+    {
+        mode = Mode::RX_SINGLE;
+    }
+}
+
+template <typename Bus>
+void SX126xT<Bus>::startCAD()
+{
+    // Detection peak per spreading factor for 2 symbol CAD (AN1200.48)
+    const uint8_t det_peak[] = {22, 22, 22, 24, 25, 26, 30};
+    const uint8_t peak = det_peak[std::max(0, profile.spreading_factor - 6)];
+    const uint16_t irq_mask = IRQ_CAD_DONE_MASK | IRQ_CAD_DETECTED_MASK;
+
+    CommandBatch batch;
+    batch.add(CMD_SET_STANDBY, {STDBY_RC});
+    batch.add(CMD_SET_DIO_IRQ_PARAMS, {irq_mask >> 8, irq_mask & 0xFF,
+                                       irq_mask >> 8, irq_mask & 0xFF,
+                                       0x00, 0x00, 0x00, 0x00});
+    batch.add(CMD_CLEAR_IRQ_STATUS, {0xFF, 0xFF});
+    batch.add(CMD_SET_CAD_PARAMS, {0x01, peak, 10, 0x00, 0x00, 0x00, 0x00}); // 2 symbols, CAD only
+    batch.add(CMD_SET_CAD, {});
+    if (runBatch(batch))
+    {
+        mode = Mode::CAD;
+    }
+}
+
+template <typename Bus>
+void SX126xT<Bus>::standbyMode()
+{
+    command(CMD_SET_STANDBY, {STDBY_RC});
+    mode = Mode::STANDBY;
+}
+
+template <typename Bus>
+void SX126xT<Bus>::sleepMode()
+{
+    command(CMD_SET_SLEEP, {SLEEP_WARM_START});
+    mode = Mode::SLEEP;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+template <typename Bus>
+Radio::Mode SX126xT<Bus>::getMode()
+{
+    // Any SPI access would wake the chip up
+    if (mode == Mode::SLEEP)
+    {
+        return Mode::SLEEP;
+    }
+
+    switch ((getStatus() >> 4) & 0x07)
+    {
+    case CHIP_MODE_STDBY_RC:
+    case CHIP_MODE_STDBY_XOSC:
+        return Mode::STANDBY;
+    case CHIP_MODE_TX:
+        return Mode::TX;
+    case CHIP_MODE_RX:
+        // RX, single RX and CAD share the chip mode, the requested one tells them apart
+        return (mode == Mode::RX_SINGLE || mode == Mode::CAD) ? mode : Mode::RX_CONTINUOUS;
+    default:
+        return Mode::OTHER;
+    }
+}
+
+template <typename Bus>
+uint16_t SX126xT<Bus>::getIrqStatus()
+{
+    uint8_t flags[2] = {0, 0};
+    if (!readCommand(CMD_GET_IRQ_STATUS, {}, flags, sizeof(flags)))
+    {
+        return 0;
+    }
+    return toRadioIrq(static_cast<uint16_t>((flags[0] << 8) | flags[1]));
+}
+
+template <typename Bus>
+void SX126xT<Bus>::clearIrqStatus(uint16_t mask)
+{
+    const uint16_t flags = (mask == IRQ_ALL) ? 0xFFFF : toChipIrq(mask);
+    command(CMD_CLEAR_IRQ_STATUS, {static_cast<uint8_t>(flags >> 8), static_cast<uint8_t>(flags & 0xFF)});
+}
+
+template <typename Bus>
+std::vector<uint8_t> SX126xT<Bus>::readPayload()
+{
+    uint8_t status[2] = {0, 0}; // Payload length, start pointer
+    if (!readCommand(CMD_GET_RX_BUFFER_STATUS, {}, status, sizeof(status)) || status[0] == 0)
+    {
+        return std::vector<uint8_t>();
+    }
+
+    std::vector<uint8_t> data(status[0]);
+    if (!readCommand(CMD_READ_BUFFER, {status[1]}, data.data(), data.size()))
+    {
+        return std::vector<uint8_t>();
+    }
+    return data;
+}
+
+template <typename Bus>
+float SX126xT<Bus>::getRSSI()
+{
+    return getPacketInfo().rssi;
+}
+
+template <typename Bus>
+float SX126xT<Bus>::getSNR()
+{
+    return getPacketInfo().snr;
+}
+
+template <typename Bus>
+Radio::PacketInfo SX126xT<Bus>::getPacketInfo()
+{
+    PacketInfo info;
+    uint8_t status[3] = {0, 0, 0}; // RssiPkt, SnrPkt, SignalRssiPkt
+    if (readCommand(CMD_GET_PACKET_STATUS, {}, status, sizeof(status)))
+    {
+        info.rssi = -status[0] / 2.0f;
+        info.snr = static_cast<int8_t>(status[1]) * 0.25f;
+    }
+    return info;
+}
+
+template <typename Bus>
+bool SX126xT<Bus>::sampleRSSI(float freq_mhz, float *samples, size_t count)
+{
+    profile.frequency = freq_mhz;
+    calibrateImage(freq_mhz);
+
+    CommandBatch batch;
+    batch.add(CMD_SET_STANDBY, {STDBY_RC});
+    addRfFrequency(batch);
+    batch.add(CMD_SET_RX, {0xFF, 0xFF, 0xFF}); // Continuous
+    if (!runBatch(batch))
+    {
+        return false;
+    }
+    mode = Mode::RX_CONTINUOUS;
+    std::this_thread::sleep_for(std::chrono::microseconds(RSSI_SETTLE_US));
+    if (!waitBusy(0))
+    {
+        return false;
+    }
+
+    // GetRssiInst clocks out the status byte, then the RSSI
+    const uint8_t cmd = CMD_GET_RSSI_INST;
+    std::array<SPISegment, RSSI_BATCH> segments;
+    std::array<uint8_t, RSSI_BATCH * 2> raw;
+
+    size_t taken = 0;
+    while (taken < count)
+    {
+        const size_t chunk = std::min(RSSI_BATCH, count - taken);
+        for (size_t i = 0; i < chunk; i++)
+        {
+            segments[i] = {&cmd, 1, &raw[i * 2], 2, RSSI_SAMPLE_US};
+        }
+        if (!bus.transferBatch(segments.data(), chunk))
+        {
+            return false;
+        }
+        for (size_t i = 0; i < chunk; i++)
+        {
+            samples[taken + i] = -raw[i * 2 + 1] / 2.0f;
+        }
+        taken += chunk;
+    }
+    return true;
+}
+
+template <typename Bus>
+uint8_t SX126xT<Bus>::getStatus()
+{
+    const uint8_t cmd = CMD_GET_STATUS;
+    uint8_t status = 0;
+    transact(&cmd, 1, &status, 1);
+    return status;
+}
+
+template <typename Bus>
+bool SX126xT<Bus>::command(uint8_t opcode, std::initializer_list<uint8_t> params)
+{
+    CommandBatch batch;
+    batch.add(opcode, params);
+    return runBatch(batch);
+}
+
+template <typename Bus>
+bool SX126xT<Bus>::readCommand(uint8_t opcode, std::initializer_list<uint8_t> params, uint8_t *data, size_t length)
+{
+    if (params.size() > 3 || length > 255)
+    {
+        return false;
+    }
+
+    uint8_t cmd[4];
+    cmd[0] = opcode;
+    std::copy(params.begin(), params.end(), cmd + 1);
+
+    // The first byte clocked in is the status
+    uint8_t response[256];
+    if (!transact(cmd, 1 + params.size(), response, length + 1))
+    {
+        return false;
+    }
+    std::copy(response + 1, response + 1 + length, data);
+    return true;
+}
+
+template <typename Bus>
+bool SX126xT<Bus>::writeRegisters(uint16_t address, const uint8_t *data, size_t length)
+{
+    CommandBatch batch;
+    batch.add(CMD_WRITE_REGISTER, {static_cast<uint8_t>(address >> 8), static_cast<uint8_t>(address & 0xFF)},
+              data, length);
+    return runBatch(batch);
+}
+
+template <typename Bus>
+bool SX126xT<Bus>::readRegisters(uint16_t address, uint8_t *data, size_t length)
+{
+    return readCommand(CMD_READ_REGISTER, {static_cast<uint8_t>(address >> 8), static_cast<uint8_t>(address & 0xFF)},
+                       data, length);
+}
+
+template <typename Bus>
+bool SX126xT<Bus>::runBatch(const CommandBatch &batch)
+{
+    if (batch.overflow())
+    {
+        LOG_ERROR("SX126x command batch too large");
+        return false;
+    }
+    if (mode == Mode::SLEEP)
+    {
+        wakeup();
+    }
+    if (!waitBusy())
+    {
+        return false;
+    }
+    return bus.transferBatch(batch.segments(), batch.size());
+}
+
+template <typename Bus>
+bool SX126xT<Bus>::transact(const uint8_t *write_data, size_t write_length, uint8_t *read_data, size_t read_length)
+{
+    if (mode == Mode::SLEEP)
+    {
+        wakeup();
+    }
+    if (!waitBusy())
+    {
+        return false;
+    }
+
+    // Always through transferBatch, so chip select is released at the end
+    const SPISegment segment = {write_data, write_length, read_data, read_length, 0};
+    return bus.transferBatch(&segment, 1);
+}
+
+template <typename Bus>
+bool SX126xT<Bus>::waitBusy(int settle_ms)
+{
+    if (busy_pin < 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(settle_ms));
+        return true;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    while (bus.digitalRead(busy_pin))
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count() > BUSY_TIMEOUT_MS)
+        {
+            LOG_ERROR("SX126x BUSY timeout");
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    return true;
+}
+
+template <typename Bus>
+void SX126xT<Bus>::wakeup()
+{
+    // The falling edge of chip select wakes the chip, which then starts in STDBY_RC
+    const uint8_t cmd = CMD_GET_STATUS;
+    uint8_t status = 0;
+    const SPISegment segment = {&cmd, 1, &status, 1, 0};
+    bus.transferBatch(&segment, 1);
+    mode = Mode::STANDBY;
+    waitBusy(4);
+}
+
+template <typename Bus>
+void SX126xT<Bus>::calibrateImage(float freq_mhz)
+{
+    uint8_t band[2];
+    if (freq_mhz >= 902.0f)
+    {
+        band[0] = 0xE1;
+        band[1] = 0xE9;
+    }
+    else if (freq_mhz >= 863.0f)
+    {
+        band[0] = 0xD7;
+        band[1] = 0xDB;
+    }
+    else if (freq_mhz >= 779.0f)
+    {
+        band[0] = 0xC1;
+        band[1] = 0xC5;
+    }
+    else if (freq_mhz >= 470.0f)
+    {
+        band[0] = 0x75;
+        band[1] = 0x81;
+    }
+    else
+    {
+        band[0] = 0x6B;
+        band[1] = 0x6F;
+    }
+
+    if (band[0] == image_band)
+    {
+        return;
+    }
+
+    command(CMD_CALIBRATE_IMAGE, {band[0], band[1]});
+    waitBusy(5);
+    image_band = band[0];
+}
+
+template <typename Bus>
+void SX126xT<Bus>::addRfFrequency(CommandBatch &batch)
+{
+    // RF frequency = freq * 2^25 / 32 MHz
+    const uint32_t frf = static_cast<uint32_t>(profile.frequency * 1048576.0);
+    batch.add(CMD_SET_RF_FREQUENCY, {static_cast<uint8_t>(frf >> 24), static_cast<uint8_t>(frf >> 16),
+                                     static_cast<uint8_t>(frf >> 8), static_cast<uint8_t>(frf)});
+}
+
+template <typename Bus>
+void SX126xT<Bus>::addModulationParams(CommandBatch &batch)
+{
+    // Low data rate optimization is mandatory for symbols of 16 ms and longer
+    const bool ldro = (1 << profile.spreading_factor) / profile.bandwidth >= 16.0f;
+    batch.add(CMD_SET_MODULATION_PARAMS, {static_cast<uint8_t>(profile.spreading_factor),
+                                          bandwidthCode(profile.bandwidth),
+                                          static_cast<uint8_t>(profile.coding_rate - 4),
+                                          static_cast<uint8_t>(ldro ? 0x01 : 0x00)});
+}
+
+template <typename Bus>
+void SX126xT<Bus>::addPacketParams(CommandBatch &batch, uint8_t payload_length, bool invert_iq)
+{
+    // Explicit header; LoRaWAN uplinks carry a payload CRC, downlinks do not
+    batch.add(CMD_SET_PACKET_PARAMS, {static_cast<uint8_t>((profile.preamble_length >> 8) & 0xFF),
+                                      static_cast<uint8_t>(profile.preamble_length & 0xFF),
+                                      0x00, payload_length,
+                                      static_cast<uint8_t>(invert_iq ? 0x00 : 0x01),
+                                      static_cast<uint8_t>(invert_iq ? 0x01 : 0x00)});
+}
+
+template <typename Bus>
+void SX126xT<Bus>::addIqPolarity(CommandBatch &batch, bool invert_iq)
+{
+    const uint8_t value = invert_iq ? (iq_register & ~IQ_POLARITY_FIX) : (iq_register | IQ_POLARITY_FIX);
+    batch.add(CMD_WRITE_REGISTER, {REG_IQ_POLARITY >> 8, REG_IQ_POLARITY & 0xFF, value});
+}
+
+template <typename Bus>
+void SX126xT<Bus>::addRxSetup(CommandBatch &batch)
+{
+    const uint16_t irq_mask = IRQ_RX_DONE_MASK | IRQ_CRC_ERROR_MASK | IRQ_HEADER_VALID_MASK | IRQ_TIMEOUT_MASK;
+
+    batch.add(CMD_SET_STANDBY, {STDBY_RC});
+    batch.add(CMD_SET_BUFFER_BASE_ADDRESS, {0x00, 0x00});
+    addPacketParams(batch, 0xFF, profile.invert_iq);
+    addIqPolarity(batch, profile.invert_iq);
+    batch.add(CMD_SET_DIO_IRQ_PARAMS, {irq_mask >> 8, irq_mask & 0xFF,
+                                       irq_mask >> 8, irq_mask & 0xFF,
+                                       0x00, 0x00, 0x00, 0x00});
+    batch.add(CMD_CLEAR_IRQ_STATUS, {0xFF, 0xFF});
+}
+
+template <typename Bus>
+uint8_t SX126xT<Bus>::bandwidthCode(float bw_khz)
+{
+    const float bws[] = {7.8, 10.4, 15.6, 20.8, 31.25, 41.7, 62.5, 125, 250, 500};
+    const uint8_t codes[] = {0x00, 0x08, 0x01, 0x09, 0x02, 0x0A, 0x03, 0x04, 0x05, 0x06};
+
+    for (int i = 0; i < 10; i++)
+    {
+        if (bw_khz <= bws[i])
+        {
+            return codes[i];
+        }
+    }
+    return 0x06; // Default to 500kHz
+}
+
+template <typename Bus>
+uint16_t SX126xT<Bus>::toRadioIrq(uint16_t flags)
+{
+    uint16_t result = 0;
+    if (flags & IRQ_TX_DONE_MASK) result |= IRQ_TX_DONE;
+    if (flags & IRQ_RX_DONE_MASK) result |= IRQ_RX_DONE;
+    if (flags & IRQ_HEADER_VALID_MASK) result |= IRQ_VALID_HEADER;
+    if (flags & (IRQ_CRC_ERROR_MASK | IRQ_HEADER_ERROR_MASK)) result |= IRQ_CRC_ERROR;
+    if (flags & IRQ_CAD_DONE_MASK) result |= IRQ_CAD_DONE;
+    if (flags & IRQ_CAD_DETECTED_MASK) result |= IRQ_CAD_DETECTED;
+    if (flags & IRQ_TIMEOUT_MASK) result |= IRQ_RX_TIMEOUT;
+    return result;
+}
+
+template <typename Bus>
+uint16_t SX126xT<Bus>::toChipIrq(uint16_t flags)
+{
+    uint16_t result = 0;
+    if (flags & IRQ_TX_DONE) result |= IRQ_TX_DONE_MASK;
+    if (flags & IRQ_RX_DONE) result |= IRQ_RX_DONE_MASK | IRQ_PREAMBLE_DETECTED_MASK;
+    if (flags & IRQ_VALID_HEADER) result |= IRQ_HEADER_VALID_MASK;
+    if (flags & IRQ_CRC_ERROR) result |= IRQ_CRC_ERROR_MASK | IRQ_HEADER_ERROR_MASK;
+    if (flags & IRQ_CAD_DONE) result |= IRQ_CAD_DONE_MASK;
+    if (flags & IRQ_CAD_DETECTED) result |= IRQ_CAD_DETECTED_MASK;
+    if (flags & IRQ_RX_TIMEOUT) result |= IRQ_TIMEOUT_MASK;
+    return result;
+}
+
+template class SX126xT<SPIInterfaceBus>;
+template class SX126xT<CH341Bus>;
+template class SX126xT<LinuxSPIBus>;
+
+SX126x::SX126x(std::unique_ptr<SPIInterface> spi_interface, int busy_pin, int reset_pin)
+    : SX126xT<SPIInterfaceBus>(SPIInterfaceBus(std::move(spi_interface)), busy_pin, reset_pin)
+{
+}
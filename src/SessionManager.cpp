@@ -1,4 +1,5 @@
 #include "SessionManager.hpp"
+#include "IOExecutor.hpp"
 #include <cjson/cJSON.h>
 #include <fstream>
 #include <sstream>
@@ -20,7 +21,7 @@ static void hexToBytes(const std::string& hex, uint8_t* data, size_t len) {
     }
 }
 
-bool SessionManager::saveSession(const std::string& filename, const SessionData& data) {
+bool SessionManager::saveSession(const std::string& filename, const SessionData& data, IOExecutor* executor) {
     cJSON* root = cJSON_CreateObject();
     
     // Convert binary data to hex strings
@@ -38,6 +39,12 @@ bool SessionManager::saveSession(const std::string& filename, const SessionData&
     cJSON_AddBoolToObject(root, "joined", data.joined);
 
     char* jsonStr = cJSON_Print(root);
+    if (executor && jsonStr && executor->replaceFile(filename, jsonStr)) {
+        cJSON_Delete(root);
+        free(jsonStr);
+        return true;
+    }
+
     std::ofstream file(filename);
     if (!file) {
         cJSON_Delete(root);
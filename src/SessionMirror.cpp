@@ -0,0 +1,324 @@
+/**
+ * @file SessionMirror.cpp
+ * @brief Implementation of the session mirror
+ *
+ * Messages are fixed-size packets on a SOCK_STREAM Unix socket. The active
+ * side never blocks: a message is either queued whole in the standby's socket
+ * buffer or the standby is dropped, and a dropped standby reconnects. Data already queued stays readable by the
+ * standby after the active process dies, so an FCnt reservation that was
+ * published is never lost.
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+#include "SessionMirror.hpp"
+#include "IOExecutor.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const char MIRROR_MAGIC[4] = {'L', 'W', 'S', 'M'};
+    constexpr uint32_t MIRROR_VERSION = 2;
+}
+
+SessionMirror::~SessionMirror()
+{
+    close();
+}
+
+#ifndef _WIN32
+
+namespace
+{
+    bool socketAddress(const std::string &path, sockaddr_un &addr)
+    {
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(addr.sun_path))
+        {
+            std::cerr << "Invalid session mirror socket path: " << path << std::endl;
+            return false;
+        }
+        std::memcpy(addr.sun_path, path.c_str(), path.size());
+        return true;
+    }
+
+    void setNonBlocking(int fd)
+    {
+        int flags = fcntl(fd, F_GETFL, 0);
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    }
+}
+
+bool SessionMirror::listen(const std::string &path)
+{
+    static_assert(std::is_trivially_copyable<Packet>::value, "packets are sent as raw bytes");
+    close();
+
+    sockaddr_un addr;
+    if (!socketAddress(path, addr))
+        return false;
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        std::cerr << "Cannot create session mirror socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // A previous active process that died leaves its socket file behind
+    ::unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || ::listen(fd, 4) != 0)
+    {
+        std::cerr << "Cannot listen on session mirror " << path << ": " << strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+    setNonBlocking(fd);
+
+    listening = true;
+    socketPath = path;
+    return true;
+}
+
+bool SessionMirror::connect(const std::string &path)
+{
+    close();
+
+    sockaddr_un addr;
+    if (!socketAddress(path, addr))
+        return false;
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        std::cerr << "Cannot create session mirror socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // No active process yet is not an error worth reporting, the caller retries
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+    {
+        close();
+        return false;
+    }
+    setNonBlocking(fd);
+
+    socketPath = path;
+    lastMessage = std::chrono::steady_clock::now();
+    goodbyeReceived = false;
+    return true;
+}
+
+void SessionMirror::close()
+{
+    // Deliveries still queued use the sockets
+    if (executor)
+        executor->flush();
+
+    // Tell the standbys this is an exit, not a dropped connection
+    if (listening && fd >= 0)
+        deliver(makePacket(MESSAGE_GOODBYE, published));
+
+    for (int standby : standbys)
+        ::close(standby);
+    standbys.clear();
+
+    if (fd >= 0)
+        ::close(fd);
+    if (listening && !socketPath.empty())
+        ::unlink(socketPath.c_str());
+
+    fd = -1;
+    listening = false;
+    socketPath.clear();
+    rxBuffer.clear();
+}
+
+void SessionMirror::acceptStandbys()
+{
+    while (true)
+    {
+        int standby = accept(fd, nullptr, nullptr);
+        if (standby < 0)
+            break;
+        setNonBlocking(standby);
+        standbys.push_back(standby);
+    }
+}
+
+SessionMirror::Packet SessionMirror::makePacket(MessageType type, const State &state)
+{
+    Packet packet{};
+    std::memcpy(packet.magic, MIRROR_MAGIC, sizeof(packet.magic));
+    packet.version = MIRROR_VERSION;
+    packet.type = type;
+    packet.sequence = sequence++;
+    packet.state = state;
+    return packet;
+}
+
+int SessionMirror::publish(const State &state, bool sync)
+{
+    if (!listening)
+        return 0;
+
+    Packet packet = makePacket(MESSAGE_STATE, state);
+    published = state;
+
+    if (executor)
+    {
+        if (!sync && executor->call([this, packet]() { deliver(packet); }))
+            return -1;
+        // Keep the stream order and the standby list to one thread at a time
+        executor->flush();
+    }
+    return deliver(packet);
+}
+
+int SessionMirror::deliver(const Packet &packet)
+{
+    acceptStandbys();
+
+    int count = 0;
+    for (auto it = standbys.begin(); it != standbys.end();)
+    {
+        ssize_t sent = send(*it, &packet, sizeof(packet), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent != static_cast<ssize_t>(sizeof(packet)))
+        {
+            // A partial packet would desynchronise the stream, drop the standby
+            std::cerr << "Session mirror: dropping standby ("
+                      << (sent < 0 ? strerror(errno) : "buffer full") << ")" << std::endl;
+            ::close(*it);
+            it = standbys.erase(it);
+            continue;
+        }
+        count++;
+        ++it;
+    }
+    return count;
+}
+
+bool SessionMirror::poll(int timeout_ms)
+{
+    if (fd < 0 || listening)
+        return false;
+
+    pollfd pfd = {fd, POLLIN, 0};
+    if (::poll(&pfd, 1, timeout_ms) <= 0)
+        return true;
+
+    uint8_t buffer[4096];
+    while (true)
+    {
+        ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received > 0)
+        {
+            rxBuffer.insert(rxBuffer.end(), buffer, buffer + received);
+            continue;
+        }
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (received < 0 && errno == EINTR)
+            continue;
+
+        // EOF or error: the active process exited or dropped this standby,
+        // only a goodbye tells which. Keep the replica.
+        ::close(fd);
+        fd = -1;
+        break;
+    }
+
+    size_t offset = 0;
+    while (rxBuffer.size() - offset >= sizeof(Packet))
+    {
+        Packet packet;
+        std::memcpy(&packet, rxBuffer.data() + offset, sizeof(packet));
+        offset += sizeof(packet);
+
+        if (std::memcmp(packet.magic, MIRROR_MAGIC, sizeof(packet.magic)) != 0 || packet.version != MIRROR_VERSION)
+        {
+            std::cerr << "Session mirror: unknown message format, disconnecting" << std::endl;
+            close();
+            return false;
+        }
+        lastMessage = std::chrono::steady_clock::now();
+        if (packet.type == MESSAGE_GOODBYE)
+        {
+            goodbyeReceived = true;
+            continue;
+        }
+        replicaState = packet.state;
+        replicaValid = true;
+    }
+    rxBuffer.erase(rxBuffer.begin(), rxBuffer.begin() + offset);
+
+    return fd >= 0;
+}
+
+#else
+
+bool SessionMirror::listen(const std::string &path)
+{
+    (void)path;
+    std::cerr << "Session mirror is not supported on this platform" << std::endl;
+    return false;
+}
+
+bool SessionMirror::connect(const std::string &path)
+{
+    (void)path;
+    std::cerr << "Session mirror is not supported on this platform" << std::endl;
+    return false;
+}
+
+void SessionMirror::close()
+{
+    fd = -1;
+    listening = false;
+}
+
+int SessionMirror::publish(const State &state, bool sync)
+{
+    (void)state;
+    (void)sync;
+    return 0;
+}
+
+int SessionMirror::deliver(const Packet &packet)
+{
+    (void)packet;
+    return 0;
+}
+
+bool SessionMirror::poll(int timeout_ms)
+{
+    (void)timeout_ms;
+    return false;
+}
+
+#endif
+
+void SessionMirror::setExecutor(IOExecutor *io)
+{
+    if (executor)
+        executor->flush();
+    executor = io;
+}
+
+std::chrono::milliseconds SessionMirror::silence() const
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - lastMessage);
+}
@@ -0,0 +1,269 @@
+/**
+ * @file UplinkQueue.cpp
+ * @brief Implementation of the persistent uplink queue
+ *
+ * Record N lives in slot N % slot_count. A record is written payload first and
+ * its CRC last, then the slot is flushed with msync(), so a record is either
+ * complete or fails its CRC check. pop() only advances the head sequence in the
+ * file header; if power is lost before that header reaches the disk the record
+ * is sent again, never lost.
+ *
+ * @author Sergio Pérez
+ * @date 2025
+ */
+#include "UplinkQueue.hpp"
+#include "IOExecutor.hpp"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const char QUEUE_MAGIC[4] = {'L', 'W', 'U', 'Q'};
+    constexpr uint32_t QUEUE_VERSION = 1;
+
+    // Record field offsets inside a slot
+    constexpr size_t REC_SEQUENCE = 0;
+    constexpr size_t REC_CRC = 8;
+    constexpr size_t REC_PORT = 12;
+    constexpr size_t REC_FLAGS = 13;
+    constexpr size_t REC_LENGTH = 14;
+    constexpr size_t REC_DATA = 16;
+
+    constexpr uint8_t FLAG_CONFIRMED = 0x01;
+
+    uint32_t crc32(const uint8_t *data, size_t length, uint32_t crc = 0)
+    {
+        crc = ~crc;
+        for (size_t i = 0; i < length; i++)
+        {
+            crc ^= data[i];
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+        return ~crc;
+    }
+
+    // CRC over everything in the record except the CRC field itself
+    uint32_t recordCrc(const uint8_t *record, uint16_t length)
+    {
+        uint32_t crc = crc32(record + REC_SEQUENCE, REC_CRC - REC_SEQUENCE);
+        return crc32(record + REC_PORT, REC_DATA - REC_PORT + length, crc);
+    }
+}
+
+UplinkQueue::~UplinkQueue()
+{
+    close();
+}
+
+bool UplinkQueue::open(const std::string &filename, size_t capacity)
+{
+    static_assert(sizeof(FileHeader) <= SLOT_SIZE, "file header must fit in one slot");
+    close();
+
+#ifndef _WIN32
+    if (capacity == 0)
+    {
+        std::cerr << "Uplink queue capacity must be greater than zero" << std::endl;
+        return false;
+    }
+
+    fd = ::open(filename.c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd < 0)
+    {
+        std::cerr << "Cannot open uplink queue " << filename << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        std::cerr << "Cannot stat uplink queue " << filename << ": " << strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+
+    FileHeader header{};
+    bool created = st.st_size == 0;
+    if (created)
+    {
+        std::memcpy(header.magic, QUEUE_MAGIC, sizeof(header.magic));
+        header.version = QUEUE_VERSION;
+        header.slot_count = static_cast<uint32_t>(capacity);
+        header.slot_size = SLOT_SIZE;
+        header.head = 0;
+    }
+    else if (pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+             std::memcmp(header.magic, QUEUE_MAGIC, sizeof(header.magic)) != 0 ||
+             header.version != QUEUE_VERSION || header.slot_size != SLOT_SIZE || header.slot_count == 0)
+    {
+        std::cerr << "Uplink queue " << filename << " has an unknown format" << std::endl;
+        close();
+        return false;
+    }
+
+    slots = header.slot_count;
+    mapped_length = SLOT_SIZE * (slots + 1);
+    if (static_cast<size_t>(st.st_size) < mapped_length && ftruncate(fd, mapped_length) != 0)
+    {
+        std::cerr << "Cannot resize uplink queue " << filename << ": " << strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+
+    void *map = mmap(nullptr, mapped_length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        std::cerr << "Cannot map uplink queue " << filename << ": " << strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+    base = static_cast<uint8_t *>(map);
+
+    if (created)
+    {
+        std::memcpy(base, &header, sizeof(header));
+        sync(base, SLOT_SIZE);
+    }
+
+    // The tail is the first sequence after head without a valid record
+    head = header.head;
+    tail = head;
+    while (tail - head < slots && validRecord(tail))
+        tail++;
+
+    return true;
+#else
+    (void)filename;
+    (void)capacity;
+    std::cerr << "Uplink queue is not supported on this platform" << std::endl;
+    return false;
+#endif
+}
+
+void UplinkQueue::close()
+{
+#ifndef _WIN32
+    // Background syncs still use the descriptor
+    if (executor)
+        executor->flush();
+    if (base)
+    {
+        msync(base, mapped_length, MS_SYNC);
+        munmap(base, mapped_length);
+    }
+    if (fd >= 0)
+        ::close(fd);
+#endif
+    base = nullptr;
+    fd = -1;
+    mapped_length = 0;
+    slots = 0;
+    head = tail = 0;
+}
+
+bool UplinkQueue::push(const std::vector<uint8_t> &payload, uint8_t port, bool confirmed)
+{
+    if (!base || payload.size() > MAX_PAYLOAD || size() >= slots)
+        return false;
+
+    uint8_t *record = slot(tail);
+    uint16_t length = static_cast<uint16_t>(payload.size());
+    uint32_t crc = 0;
+
+    // Invalidate the old record first so a torn write never passes the CRC check
+    std::memcpy(record + REC_CRC, &crc, sizeof(crc));
+    std::memcpy(record + REC_SEQUENCE, &tail, sizeof(tail));
+    record[REC_PORT] = port;
+    record[REC_FLAGS] = confirmed ? FLAG_CONFIRMED : 0;
+    std::memcpy(record + REC_LENGTH, &length, sizeof(length));
+    if (length > 0)
+        std::memcpy(record + REC_DATA, payload.data(), length);
+
+    crc = recordCrc(record, length);
+    std::memcpy(record + REC_CRC, &crc, sizeof(crc));
+    sync(record, SLOT_SIZE);
+
+    tail++;
+    return true;
+}
+
+bool UplinkQueue::peek(Entry &entry) const
+{
+    if (!base || head == tail)
+        return false;
+
+    const uint8_t *record = slot(head);
+    uint16_t length;
+    std::memcpy(&length, record + REC_LENGTH, sizeof(length));
+
+    entry.sequence = head;
+    entry.port = record[REC_PORT];
+    entry.confirmed = (record[REC_FLAGS] & FLAG_CONFIRMED) != 0;
+    entry.payload.assign(record + REC_DATA, record + REC_DATA + length);
+    return true;
+}
+
+bool UplinkQueue::pop()
+{
+    if (!base || head == tail)
+        return false;
+
+    head++;
+    std::memcpy(base + offsetof(FileHeader, head), &head, sizeof(head));
+    sync(base, SLOT_SIZE);
+    return true;
+}
+
+void UplinkQueue::setExecutor(IOExecutor *io)
+{
+    if (executor)
+        executor->flush();
+    executor = io;
+}
+
+uint8_t *UplinkQueue::slot(uint64_t sequence) const
+{
+    return base + SLOT_SIZE * (1 + sequence % slots);
+}
+
+bool UplinkQueue::validRecord(uint64_t sequence) const
+{
+    const uint8_t *record = slot(sequence);
+    uint64_t stored_sequence;
+    uint32_t stored_crc;
+    uint16_t length;
+    std::memcpy(&stored_sequence, record + REC_SEQUENCE, sizeof(stored_sequence));
+    std::memcpy(&stored_crc, record + REC_CRC, sizeof(stored_crc));
+    std::memcpy(&length, record + REC_LENGTH, sizeof(length));
+
+    return stored_sequence == sequence && length <= MAX_PAYLOAD &&
+           stored_crc == recordCrc(record, length);
+}
+
+void UplinkQueue::sync(void *address, size_t length)
+{
+#ifndef _WIN32
+    if (executor && executor->sync(fd, static_cast<uint64_t>(static_cast<uint8_t *>(address) - base), length))
+        return;
+
+    // msync() needs a page aligned address
+    static const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t start = reinterpret_cast<uintptr_t>(address) & ~(page - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t>(address) + length;
+    msync(reinterpret_cast<void *>(start), end - start, MS_SYNC);
+#else
+    (void)address;
+    (void)length;
+#endif
+}
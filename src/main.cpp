@@ -10,12 +10,23 @@
 #include <iomanip>
 #include <array>
 #include <vector>
+#include <algorithm>
 #include "SPIInterface.hpp"
+#include "RFM95.hpp"
+#include "SX126x.hpp"
+#include "PacketForwarder.hpp"
+#include "RealTime.hpp"
+#include "SessionMirror.hpp"
+#include "Logger.hpp"
+
+#ifdef __linux__
+#include <poll.h>
+#endif
 
 // Helper for conditional debug
-#define DEBUG_PRINT(x) do { if(LoRaWAN::getVerbose()) { std::cout << x; } } while(0)
-#define DEBUG_PRINTLN(x) do { if(LoRaWAN::getVerbose()) { std::cout << x << std::endl; } } while(0)
-#define DEBUG_HEX(x) do { if(LoRaWAN::getVerbose()) { std::cout << std::hex << (x) << std::dec; } } while(0)
+#define DEBUG_PRINT(x) do { if(LoRaWAN::getVerbose()) { Logger::debugStream() << x; Logger::instance().flushDebug(); } } while(0)
+#define DEBUG_PRINTLN(x) do { if(LoRaWAN::getVerbose()) { Logger::debugStream() << x << '\n'; Logger::instance().flushDebug(); } } while(0)
+#define DEBUG_HEX(x) do { if(LoRaWAN::getVerbose()) { Logger::debugStream() << std::hex << (x) << std::dec; Logger::instance().flushDebug(); } } while(0)
 
 LoRaWAN lora;
 
@@ -46,9 +57,11 @@ void showHelp() {
     std::cout << "Usage: LoRaWANCH341 [options]" << std::endl;
     std::cout << "Options:" << std::endl;
     std::cout << "  -o, --one-channel  Single channel mode (868.1 MHz, SF9, BW 125 KHz)" << std::endl;
+    std::cout << "  -g, --gateway       Run as packet forwarder gateway (see \"gateway\" in config.json)" << std::endl;
     std::cout << "  -r, --reset         Force LoRaWAN session reset" << std::endl;
     std::cout << "  -c, --config        Specify configuration file (default: config.json)" << std::endl;
     std::cout << "  -v, --verbose       Enable detailed debug messages" << std::endl;
+    std::cout << "  -s, --standby       Mirror the session of the active process and take over when it stops" << std::endl;
     std::cout << "  --spi=<type>        SPI type: 'ch341' or 'linux' (overrides config.json)" << std::endl;
     std::cout << "  --device=<path>     Linux SPI device path (overrides config.json)" << std::endl;
     std::cout << "  --device-index=<n>  CH341 device index (0,1,2...) (overrides config.json)" << std::endl;
@@ -66,12 +79,200 @@ void receiveCallback(const LoRaWAN::Message& message)
     std::cout << std::dec << std::endl;
 }
 
+// Create a radio driver on the given SPI interface, nullptr on error
+std::unique_ptr<Radio> createRadio(const std::string& spi_type, int device_index,
+                                   const std::string& spi_device, uint32_t spi_speed,
+                                   const std::string& radio_type, int busy_pin, int reset_pin,
+                                   int tcxo_voltage_mv)
+{
+    std::unique_ptr<SPIInterface> spi_interface;
+
+    if (spi_type == "ch341") {
+        DEBUG_PRINTLN("Using CH341 as SPI interface (device #" << device_index << ")");
+        spi_interface = SPIFactory::createCH341SPI(device_index, true);
+    } 
+    else if (spi_type == "linux") {
+        DEBUG_PRINTLN("Using native Linux SPI: " << spi_device << " at " << spi_speed << " Hz");
+        spi_interface = SPIFactory::createLinuxSPI(spi_device, spi_speed);
+    }
+    else {
+        std::cerr << "Unsupported SPI type: " << spi_type << std::endl;
+        return nullptr;
+    }
+
+    if (radio_type == "rfm95") {
+        return std::make_unique<RFM95>(std::move(spi_interface));
+    }
+    if (radio_type == "sx1262") {
+        DEBUG_PRINTLN("Using SX1262 radio (BUSY pin: " << busy_pin << ", RESET pin: " << reset_pin << ")");
+        auto sx126x = std::make_unique<SX126x>(std::move(spi_interface), busy_pin, reset_pin);
+        sx126x->setTcxoVoltage(tcxo_voltage_mv / 1000.0f);
+        return sx126x;
+    }
+
+    std::cerr << "Unsupported radio: " << radio_type << std::endl;
+    return nullptr;
+}
+
+// Follow the session of the active process until it exits or hangs. Returns
+// true if a session was mirrored, the replica then holds it.
+bool followActive(const std::string& socket_path, int timeout_ms, SessionMirror::State& replica)
+{
+    SessionMirror mirror;
+    std::cout << "Standby: waiting for the active process on " << socket_path << std::endl;
+    while (!mirror.connect(socket_path)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+
+    std::cout << "Standby: following the active process" << std::endl;
+    while (true) {
+        bool hung = false;
+        while (mirror.poll(50)) {
+            // Only a process that mirrored a session and then stopped sending
+            // heartbeats is considered hung; before that it may still be joining
+            if (mirror.hasReplica() && mirror.silence().count() > timeout_ms) {
+                std::cout << "Standby: no heartbeat for " << mirror.silence().count() << " ms" << std::endl;
+                hung = true;
+                break;
+            }
+        }
+        if (hung || mirror.activeClosed()) {
+            break;
+        }
+
+        // Closed without a goodbye: the active process dropped this standby,
+        // or died. Only a dead one leaves nobody listening on the socket.
+        bool reconnected = false;
+        for (int attempt = 0; attempt < 3 && !reconnected; attempt++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            reconnected = mirror.connect(socket_path);
+        }
+        if (!reconnected) {
+            break;
+        }
+        std::cout << "Standby: reconnected to the active process" << std::endl;
+    }
+
+    std::cout << "Standby: active process " << (mirror.activeClosed() ? "exited" : "lost") << ", taking over"
+              << std::endl;
+    if (!mirror.hasReplica()) {
+        return false;
+    }
+    replica = mirror.replica();
+    return true;
+}
+
+// Apply the "realtime" section; each timing-critical thread switches itself
+// with RealTime::enterThread()
+bool setupRealTime(ConfigManager& config)
+{
+    RealTime::Settings settings;
+    settings.enabled = config.getNestedBool("realtime.enabled", false);
+    settings.priority = config.getNestedInt("realtime.priority", settings.priority);
+    settings.cpu = config.getNestedInt("realtime.cpu", settings.cpu);
+    settings.lock_memory = config.getNestedBool("realtime.lock_memory", settings.lock_memory);
+    settings.prefault_stack = static_cast<size_t>(std::max(config.getNestedInt("realtime.prefault_stack_kb", 256), 0)) * 1024;
+    if (!RealTime::configure(settings)) {
+        return false;
+    }
+    if (settings.enabled) {
+        std::cout << "Real-time mode: SCHED_FIFO priority " << settings.priority;
+        if (settings.cpu >= 0) {
+            std::cout << " on CPU " << settings.cpu;
+        }
+        std::cout << (settings.lock_memory ? ", memory locked" : "") << std::endl;
+    }
+    return true;
+}
+
+// Print lateness statistics
+void reportLatency(const char* what, const LatencyStats::Summary& summary)
+{
+    std::cout << "Lateness of " << what << ": " << summary.count << " samples, mean " << summary.mean_us
+              << " us, p99 " << summary.p99_us << " us, max " << summary.max_us << " us" << std::endl;
+}
+
+// Run as a Semtech UDP packet forwarder using the radios in the "gateway" section
+int runGateway(ConfigManager& config)
+{
+    std::string gateway_eui = config.getNestedString("gateway.gateway_eui", "");
+    std::string server = config.getNestedString("gateway.server", "localhost");
+    int port_up = config.getNestedInt("gateway.port_up", 1700);
+    int port_down = config.getNestedInt("gateway.port_down", 1700);
+
+    PacketForwarder forwarder(gateway_eui, server, port_up, port_down);
+    forwarder.setKeepaliveInterval(config.getNestedInt("gateway.keepalive_interval", 10));
+    forwarder.setStatInterval(config.getNestedInt("gateway.stat_interval", 30));
+    forwarder.setBatchWindow(config.getNestedInt("gateway.batch_window_ms", 50));
+
+    int radio_count = config.getNestedArraySize("gateway.radios");
+    if (radio_count == 0) {
+        std::cerr << "No radios configured in gateway.radios" << std::endl;
+        return 1;
+    }
+
+    for (int i = 0; i < radio_count; i++) {
+        std::string prefix = "gateway.radios." + std::to_string(i) + ".";
+        std::unique_ptr<Radio> radio = createRadio(
+            config.getNestedString(prefix + "spi_type", "ch341"),
+            config.getNestedInt(prefix + "device_index", i),
+            config.getNestedString(prefix + "spi_device", "/dev/spidev0.0"),
+            config.getNestedInt(prefix + "spi_speed", 1000000),
+            config.getNestedString(prefix + "radio", "rfm95"),
+            config.getNestedInt(prefix + "busy_pin", -1),
+            config.getNestedInt(prefix + "reset_pin", -1),
+            config.getNestedInt(prefix + "tcxo_voltage_mv", 0));
+        if (!radio) {
+            return 1;
+        }
+
+        Radio::Profile profile;
+        profile.frequency = static_cast<float>(config.getNestedDouble(prefix + "frequency", 868.1));
+        profile.spreading_factor = config.getNestedInt(prefix + "sf", 7);
+        profile.bandwidth = static_cast<float>(config.getNestedDouble(prefix + "bw", 125.0));
+
+        DEBUG_PRINTLN("Gateway radio " << i << ": " << profile.frequency << " MHz SF"
+                      << profile.spreading_factor << " BW" << profile.bandwidth);
+        forwarder.addRadio(std::move(radio), profile);
+    }
+    forwarder.setTxRadio(config.getNestedInt("gateway.tx_radio", 0));
+
+    if (!forwarder.begin()) {
+        std::cerr << "Failed to start packet forwarder" << std::endl;
+        return 1;
+    }
+
+    // The radio threads are running, the forwarder loop that times the
+    // downlinks goes real-time last so that nothing inherits its policy
+    RealTime::enterThread("lorawan-gw");
+    LatencyStats loopLateness;
+    int reportInterval = config.getNestedInt("realtime.report_interval", 300);
+    auto nextReport = std::chrono::steady_clock::now() + std::chrono::seconds(reportInterval);
+
+    while (true) {
+        forwarder.update();
+        auto due = std::chrono::steady_clock::now() + std::chrono::milliseconds(1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        loopLateness.record(due);
+
+        if (RealTime::isEnabled() && reportInterval > 0 && std::chrono::steady_clock::now() >= nextReport) {
+            reportLatency("the forwarder loop", loopLateness.summary());
+            loopLateness.reset();
+            nextReport += std::chrono::seconds(reportInterval);
+        }
+    }
+
+    return 0;
+}
+
 int main(int argc, char* argv[])
 {
     // Default initial values
     bool one_channel = false;
     bool forceReset = false;
     bool verbose = false; // Default silent mode
+    bool gateway_mode = false;
+    bool standby = false;
     std::string configPath = "config.json";
     
     // Variables for command line options that override config.json
@@ -95,6 +296,12 @@ int main(int argc, char* argv[])
         else if (arg == "-o" || arg == "--one-channel") {
             one_channel = true;
         }
+        else if (arg == "-g" || arg == "--gateway") {
+            gateway_mode = true;
+        }
+        else if (arg == "-s" || arg == "--standby") {
+            standby = true;
+        }
         else if (arg == "-r" || arg == "--reset") {
             forceReset = true;
         } 
@@ -160,6 +367,10 @@ int main(int argc, char* argv[])
     std::string spi_device = config.getNestedString("connection.spi_device", "/dev/spidev0.0");
     int device_index = config.getNestedInt("connection.device_index", 0);
     uint32_t spi_speed = config.getNestedInt("connection.spi_speed", 1000000);
+    std::string radio_type = config.getNestedString("connection.radio", "rfm95");
+    int busy_pin = config.getNestedInt("connection.busy_pin", -1);
+    int reset_pin = config.getNestedInt("connection.reset_pin", -1);
+    int tcxo_voltage_mv = config.getNestedInt("connection.tcxo_voltage_mv", 0);
     
     // Override with command line values if provided
     if (hasSpiType) {
@@ -191,6 +402,22 @@ int main(int argc, char* argv[])
     bool configForceReset = config.getNestedBool("options.force_reset", false);
     bool configVerbose = config.getNestedBool("options.verbose", false);
     int sendInterval = config.getNestedInt("options.send_interval", 60);
+    std::string queueFile = config.getNestedString("options.queue_file", "");
+    int queueCapacity = config.getNestedInt("options.queue_capacity", 1024);
+    int backfillInterval = config.getNestedInt("options.backfill_interval_ms", 0);
+    std::string ledgerFile = config.getNestedString("options.airtime_ledger", "");
+    bool slotted = config.getNestedBool("options.slotted", false);
+    int slotJitter = config.getNestedInt("options.slot_jitter_ms", 2000);
+    std::string mirrorSocket = config.getNestedString("options.mirror_socket", "");
+    int mirrorTimeout = config.getNestedInt("options.mirror_timeout_ms", 5000);
+    std::string logSink = config.getNestedString("options.log_sink", "console");
+    std::string logFile = config.getNestedString("options.log_file", "lorawan.log");
+    std::string logLevel = config.getNestedString("options.log_level", "debug");
+    std::string captureFile = config.getNestedString("options.capture_file", "");
+    int captureMaxBytes = config.getNestedInt("options.capture_max_bytes", 10 * 1024 * 1024);
+    int captureFiles = config.getNestedInt("options.capture_files", 5);
+    bool asyncIO = config.getNestedBool("options.async_io", false);
+    int latencyReport = config.getNestedInt("realtime.report_interval", 300);
     
     // Command line option takes priority
     forceReset = forceReset || configForceReset;
@@ -206,35 +433,70 @@ int main(int argc, char* argv[])
     } else {
         DEBUG_PRINTLN(" (unknown)");
     }
+    DEBUG_PRINTLN("  Radio: " << radio_type);
 
     DEBUG_PRINTLN(std::endl << "  DevEUI: " << devEUI);
     DEBUG_PRINTLN("  AppEUI: " << appEUI);
     DEBUG_PRINTLN("  AppKey: " << appKey);
-    DEBUG_PRINTLN("  Send interval: " << sendInterval << " seconds");
+    DEBUG_PRINTLN("  Send interval: " << sendInterval << " seconds" << (slotted ? " (slotted)" : ""));
     DEBUG_PRINTLN("  Force reset: " << (forceReset ? "Yes" : "No"));
     DEBUG_PRINTLN("  Verbose: " << (verbose ? "Yes" : "No"));
 
-    // Create the corresponding SPI instance
-    std::unique_ptr<SPIInterface> spi_interface;
-    
-    if (spi_type == "ch341") {
-        DEBUG_PRINTLN("Using CH341 as SPI interface (device #" << device_index << ")");
-        spi_interface = SPIFactory::createCH341SPI(device_index, true);
-    } 
-    else if (spi_type == "linux") {
-        DEBUG_PRINTLN("Using native Linux SPI: " << spi_device << " at " << spi_speed << " Hz");
-        spi_interface = SPIFactory::createLinuxSPI(spi_device, spi_speed);
+    // Set verbose mode for all components
+    LoRaWAN::setVerbose(verbose);
+
+    // From here on the radio and MAC layers log through the writer thread
+    Logger::Level level;
+    if (!Logger::parseLevel(logLevel, level)) {
+        std::cerr << "Invalid log level: " << logLevel << std::endl;
+        return 1;
     }
-    else {
-        std::cerr << "Unsupported SPI type: " << spi_type << std::endl;
+    Logger::instance().setLevel(level);
+    bool loggerStarted;
+    if (logSink == "console") {
+        loggerStarted = Logger::instance().start(Logger::Sink::Console);
+    } else if (logSink == "file") {
+        loggerStarted = Logger::instance().start(Logger::Sink::File, logFile);
+    } else if (logSink == "journald") {
+        loggerStarted = Logger::instance().start(Logger::Sink::Journald);
+    } else {
+        std::cerr << "Invalid log sink: " << logSink << std::endl;
+        return 1;
+    }
+    if (!loggerStarted) {
+        return 1;
+    }
+
+    // Lock the memory before the radio and the MAC layer allocate theirs
+    if (!setupRealTime(config)) {
         return 1;
     }
 
-    // Create LoRaWAN instance with the selected SPI
-    LoRaWAN lorawan(std::move(spi_interface));
+    // Gateway mode replaces the end device
+    if (gateway_mode || config.getNestedBool("gateway.enabled", false)) {
+        return runGateway(config);
+    }
 
-    // Set verbose mode for all components
-    LoRaWAN::setVerbose(verbose);
+    // A standby only opens the radio once the active process is gone
+    SessionMirror::State replica;
+    bool haveReplica = false;
+    if (standby) {
+        if (mirrorSocket.empty()) {
+            std::cerr << "Standby mode needs options.mirror_socket" << std::endl;
+            return 1;
+        }
+        haveReplica = followActive(mirrorSocket, mirrorTimeout, replica);
+    }
+
+    // Create the radio driver on the selected SPI interface
+    std::unique_ptr<Radio> radio = createRadio(spi_type, device_index, spi_device, spi_speed,
+                                               radio_type, busy_pin, reset_pin, tcxo_voltage_mv);
+    if (!radio) {
+        return 1;
+    }
+
+    // Create LoRaWAN instance with the selected radio
+    LoRaWAN lorawan(std::move(radio));
 
     // Initialize
     if (!lorawan.init())
@@ -254,8 +516,43 @@ int main(int argc, char* argv[])
     lorawan.setAppEUI(appEUI);
     lorawan.setAppKey(appKey);
 
-    // If reset was requested, force it now
-    if (forceReset) {
+    // Before the capture, ledger and queue so that their I/O is batched too
+    if (asyncIO && !lorawan.enableAsyncIO()) {
+        std::cerr << "Asynchronous I/O not available, using synchronous I/O" << std::endl;
+    }
+
+    // Capture from the Join Request on
+    if (!captureFile.empty() && !lorawan.enableCapture(captureFile, captureMaxBytes, captureFiles)) {
+        std::cerr << "Failed to open capture file " << captureFile << std::endl;
+        return 1;
+    }
+
+    // Restore the duty-cycle state of previous runs before transmitting
+    if (!ledgerFile.empty() && !lorawan.enableAirtimeLedger(ledgerFile)) {
+        std::cerr << "Failed to open airtime ledger " << ledgerFile << std::endl;
+        return 1;
+    }
+
+    // Keep uplinks produced while offline, they are sent once joined
+    if (!queueFile.empty()) {
+        if (!lorawan.enableUplinkQueue(queueFile, queueCapacity)) {
+            std::cerr << "Failed to open uplink queue " << queueFile << std::endl;
+            return 1;
+        }
+        lorawan.setBackfillInterval(backfillInterval);
+        std::cout << "Uplink queue: " << lorawan.getQueuedUplinks() << " messages pending" << std::endl;
+    }
+
+    // Background threads are started, only the MAC thread and the SPI
+    // interrupt threads run real-time
+    RealTime::enterThread("lorawan-mac");
+
+    // Continue the mirrored session, or reset/join as usual
+    if (haveReplica && replica.joined) {
+        lorawan.resumeSession(replica);
+        std::cout << "Resumed session of the previous active process" << std::endl;
+    }
+    else if (forceReset) {
         resetAndRejoin(lorawan, devEUI, appEUI, appKey);
     } 
     // If not, do normal join
@@ -266,6 +563,12 @@ int main(int argc, char* argv[])
         resetAndRejoin(lorawan, devEUI, appEUI, appKey);
     }
 
+    // Mirror the session so a standby can take over
+    if (!mirrorSocket.empty() && !lorawan.enableSessionMirror(mirrorSocket)) {
+        std::cerr << "Failed to open session mirror " << mirrorSocket << std::endl;
+        return 1;
+    }
+
     // Explicitly switch to Class C and configure to listen on RX2
     std::cout << "Switching to Class C mode for continuous reception at 869.525 MHz..." << std::endl;
     lorawan.setDeviceClass(LoRaWAN::DeviceClass::CLASS_C);
@@ -278,10 +581,50 @@ int main(int argc, char* argv[])
     lorawan.onReceive(receiveCallback);
 
     lorawan.requestLinkCheck();
+
+    // Keep the MAC layer running until the given time. With the event
+    // descriptor the loop sleeps until the stack has something due.
+    int eventFd = -1;
+#ifdef __linux__
+    eventFd = lorawan.getEventFd();
+#endif
+    LatencyStats wakeLateness;
+    auto serviceUntil = [&lorawan, &wakeLateness, eventFd](std::chrono::steady_clock::time_point until) {
+        while (std::chrono::steady_clock::now() < until) {
+#ifdef __linux__
+            if (eventFd >= 0) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(until - std::chrono::steady_clock::now());
+                pollfd pfd = {eventFd, POLLIN, 0};
+                if (poll(&pfd, 1, static_cast<int>(std::max<int64_t>(left.count(), 0)) + 1) > 0) {
+                    lorawan.processEvents();
+                }
+                continue;
+            }
+#endif
+            // Sleep until the next deadline of the stack, or the caller's
+            auto wait = lorawan.update();
+            auto left = std::chrono::ceil<std::chrono::milliseconds>(until - std::chrono::steady_clock::now());
+            auto due = std::chrono::steady_clock::now() + std::min(wait, left);
+            std::this_thread::sleep_for(std::min(wait, left));
+            wakeLateness.record(due);
+        }
+    };
     
+    auto nextReport = std::chrono::steady_clock::now() + std::chrono::seconds(latencyReport);
+
     // In the main loop, display information about the current frequency
     while (true)
     {
+        // In slotted mode every device waits for its own slot, so a fleet that
+        // powers up together does not transmit in lockstep
+        if (slotted) {
+            int64_t gpsTime;
+            if (!lorawan.getNetworkTime(gpsTime)) {
+                lorawan.requestDeviceTime();
+            }
+            serviceUntil(lorawan.nextUplinkSlot(sendInterval, slotJitter));
+        }
+
         // Send data
         std::vector<uint8_t> data = {1, 2, 3, 4};
         if (lorawan.send(data, 1, false)) {
@@ -302,11 +645,18 @@ int main(int argc, char* argv[])
         // Show current listening frequency
         std::cout << "Listening on: " << lorawan.getFrequency() << " MHz" << std::endl;
         
-        auto start = std::chrono::steady_clock::now();
-        while (std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - start).count() < sendInterval)
-        {
-            lorawan.update();
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (!slotted) {
+            serviceUntil(std::chrono::steady_clock::now() + std::chrono::seconds(sendInterval));
+        }
+
+        // Scheduling latency under the current load
+        if (RealTime::isEnabled() && latencyReport > 0 && std::chrono::steady_clock::now() >= nextReport) {
+            reportLatency("the receive windows", lorawan.getWindowLateness());
+            if (wakeLateness.summary().count > 0) {
+                reportLatency("the MAC loop wakeups", wakeLateness.summary());
+                wakeLateness.reset();
+            }
+            nextReport = std::chrono::steady_clock::now() + std::chrono::seconds(latencyReport);
         }
     }
 